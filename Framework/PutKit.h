@@ -55,10 +55,25 @@ FOUNDATION_EXPORT const unsigned char PutKitVersionString[];
 #pragma mark - Methods
 
 #import <PutKit/PIOAPI.h>
+#import <PutKit/PIOFuture.h>
+#import <PutKit/PIOConfiguration.h>
+#import <PutKit/PIORetryPolicy.h>
+#import <PutKit/PIORateLimiter.h>
+#import <PutKit/PIOResumableUpload.h>
+#import <PutKit/PIODownloadManager.h>
+#import <PutKit/PIOTransferMonitor.h>
+#import <PutKit/PIOTransferStore.h>
+#import <PutKit/PIOMP4ConversionWatcher.h>
+#import <PutKit/PIOBulkOperation.h>
+#import <PutKit/PIOFileCache.h>
+#import <PutKit/PIOEventSync.h>
+#import <PutKit/PIOFolderWalker.h>
+#import <PutKit/PIOSearchSession.h>
 #import <PutKit/PIOAPI+Files.h>
 #import <PutKit/PIOAPI+Transfers.h>
 #import <PutKit/PIOAPI+Friends.h>
 #import <PutKit/PIOAPI+Account.h>
+#import <PutKit/PIOAPI+Futures.h>
 
 #pragma mark - Authentication
 
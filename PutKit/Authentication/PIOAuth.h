@@ -97,7 +97,7 @@ typedef void (^PIOSignOutCallback)(NSError * _Nullable error);
 - (NSURLSessionDataTask *)getCredentialForCode:(NSString *)code callback:(PIOAuthCallback _Nullable)callback NS_SWIFT_NAME(credential(for:callback:));
 
 /**
- Locally and remotely removes the user's access token.
+ Locally and remotely removes the user's access token, and empties the shared `PIOFileCache` and `PIOEventSync` so that nothing fetched for the account is left behind.
  
  @param callback    The block called when the request completes. If the request fails, the underlying error will be returned, otherwise, this parameter will be `nil`.
  
@@ -129,7 +129,7 @@ typedef void (^PIOSignOutCallback)(NSError * _Nullable error);
 /** A boolean value indicating whether the user has authenticated or not. */
 @property (nonatomic, readonly, getter=isUserAuthenticated) BOOL userAuthenticated;
 
-/** The OAuth credential retrieved from a successful authentication, if any */
+/** The OAuth credential retrieved from a successful authentication, if any. The credential is read from the keychain once and kept in memory until the user signs in again or signs out. This property is safe to access from any thread. */
 @property (strong, nonatomic, nullable, readonly) AFOAuthCredential *credential;
 
 @end
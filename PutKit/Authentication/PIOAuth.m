@@ -28,6 +28,11 @@
 #import "PIOAuthenticatorDelegate.h"
 #import "AFOAuthCredential.h"
 #import "PIOError.h"
+#import "PIOSession.h"
+#import "PIODate.h"
+#import "PIOCallbackQueue.h"
+#import "PIOFileCache.h"
+#import "PIOEventSync.h"
 
 NSString * const kPIOOAuthCredentialIdentifier = @"PutKitCredential";
 
@@ -37,7 +42,10 @@ NSString * const kPIOOAuthCredentialIdentifier = @"PutKitCredential";
 
 @end
 
-@implementation PIOAuth
+@implementation PIOAuth {
+    AFOAuthCredential *_credential;
+    BOOL _credentialCached; // `_credential` can legitimately be `nil`, so a separate flag is needed to know whether the keychain has been read.
+}
 
 + (PIOAuth *)sharedInstance {
     static PIOAuth *sharedInstance;
@@ -69,7 +77,21 @@ NSString * const kPIOOAuthCredentialIdentifier = @"PutKitCredential";
 }
 
 - (AFOAuthCredential *)credential {
-    return [AFOAuthCredential retrieveCredentialWithIdentifier:kPIOOAuthCredentialIdentifier];
+    @synchronized (self) {
+        if (!_credentialCached) {
+            _credential = [AFOAuthCredential retrieveCredentialWithIdentifier:kPIOOAuthCredentialIdentifier];
+            _credentialCached = YES;
+        }
+        
+        return _credential;
+    }
+}
+
+- (void)invalidateCachedCredential {
+    @synchronized (self) {
+        _credential = nil;
+        _credentialCached = NO;
+    }
 }
 
 - (NSString *)APISecret {
@@ -92,7 +114,18 @@ NSString * const kPIOOAuthCredentialIdentifier = @"PutKitCredential";
 }
 
 - (BOOL)signOut {
-    return [AFOAuthCredential deleteCredentialWithIdentifier:kPIOOAuthCredentialIdentifier];
+    BOOL deleted;
+    
+    @synchronized (self) {
+        deleted = [AFOAuthCredential deleteCredentialWithIdentifier:kPIOOAuthCredentialIdentifier];
+        [self invalidateCachedCredential];
+    }
+    
+    // Nothing fetched for the account is left for whoever signs in next. Done outside the lock, as both read the credential while holding their own.
+    [[PIOEventSync sharedInstance] reset];
+    [[PIOFileCache sharedInstance] removeAllFiles];
+    
+    return deleted;
 }
 
 - (NSURL *)signInURL {
@@ -105,13 +138,13 @@ NSString * const kPIOOAuthCredentialIdentifier = @"PutKitCredential";
 }
 
 - (NSURLSessionDataTask *)getCredentialForCode:(NSString *)code callback:(PIOAuthCallback)callback {
-    [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+    pk_dispatch_callback(^{
         for (id<PIOAuthenticatorDelegate> delegate in [[self listeners] allObjects]) {
             if ([delegate respondsToSelector:@selector(authenticationDidStart)]) [delegate authenticationDidStart];
         }
-    }];
+    });
     
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointAccessToken];
     
@@ -124,48 +157,48 @@ NSString * const kPIOOAuthCredentialIdentifier = @"PutKitCredential";
     return [session dataTaskWithURL:components.URL completionHandler:^(NSData * _Nullable data,
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error) {
-        pk_response_validate(data, &error);
-        
-        NSDictionary *responseDictionary = error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error];
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
         NSString *token = responseDictionary[@"access_token"];
     
         if (token != nil) {
-            [[AFOAuthCredential credentialWithOAuthToken:token tokenType:@"token"] storeWithIdentifier:kPIOOAuthCredentialIdentifier];
+            @synchronized (self) {
+                [[AFOAuthCredential credentialWithOAuthToken:token tokenType:@"token"] storeWithIdentifier:kPIOOAuthCredentialIdentifier];
+                [self invalidateCachedCredential];
+            }
         }
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if(callback != nil) callback(error, [self credential]);
             for (id<PIOAuthenticatorDelegate> delegate in [self.listeners allObjects]) {
                 if ([delegate respondsToSelector:@selector(authenticationDidFinishWithError:)]) [delegate authenticationDidFinishWithError: error];
             }
-        }];
+        });
     }];
 }
 
 - (NSURLSessionDataTask *)signOutAndRevokeAccessTokenWithCallback:(PIOSignOutCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:kPIOEndpointClients]];
+    AFOAuthCredential *credential = self.credential;
     
-    [request setValue:[NSString stringWithFormat:@"%@ %@", self.credential.tokenType, self.credential.accessToken] forHTTPHeaderField:@"authorization"];
+    [request setValue:[NSString stringWithFormat:@"%@ %@", credential.tokenType, credential.accessToken] forHTTPHeaderField:@"authorization"];
     
     return [session dataTaskWithRequest:request completionHandler:^(NSData * _Nullable data,
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error) {
-        if (error == nil && pk_response_validate(data, &error)) {
-            NSDictionary *responseDictionary = [NSJSONSerialization JSONObjectWithData:data options:0 error:&error];
-            
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
+        
+        if (error == nil) {
             __block NSNumber *clientID;
             [responseDictionary[@"clients"] enumerateObjectsUsingBlock:^(NSDictionary *app,
                                                                       NSUInteger index,
                                                                       BOOL *stop) {
-                NSDateFormatter *formatter = [NSDateFormatter new];
-                [formatter setDateFormat:@"YYYY-MM-DD'T'HH:mm:ss"];
-                NSDate *dateOfCreation = [formatter dateFromString:app[@"created_at"]];
+                NSDate *dateOfCreation = pk_date_from_string(app[@"created_at"]);
                 NSInteger appID = [app[@"app_id"] integerValue];
                 
-                BOOL dateIsAroundTheSame = [dateOfCreation timeIntervalSinceDate:self.credential.dateOfCreation] < 60; // There is no system on the Put.io api to help us determine which client we are so we can get which one it is most likely to be by comparing the date on which the authentication occurred. The tolerance here is for any server lag between Sonix and Put.io.
+                BOOL dateIsAroundTheSame = [dateOfCreation timeIntervalSinceDate:credential.dateOfCreation] < 60; // There is no system on the Put.io api to help us determine which client we are so we can get which one it is most likely to be by comparing the date on which the authentication occurred. The tolerance here is for any server lag between Sonix and Put.io.
                 
                 if (appID == 3257 && dateIsAroundTheSame) {
                     *stop = YES;
@@ -187,9 +220,7 @@ NSString * const kPIOOAuthCredentialIdentifier = @"PutKitCredential";
             [[session dataTaskWithRequest:request completionHandler:^(NSData * _Nullable data,
                                                                       NSURLResponse * _Nullable response,
                                                                       NSError * _Nullable error) {
-                if (error == nil) {
-                    pk_response_validate(data, &error);
-                }
+                pk_response_decode(data, response, &error);
                 [self signOut];
                 if (callback != nil) callback(error);
             }] resume];
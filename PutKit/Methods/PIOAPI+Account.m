@@ -25,17 +25,19 @@
 
 #import "PIOAPI+Account.h"
 #import "PIOError.h"
+#import "PIOSession.h"
 #import "PIOEndpoints.h"
-#import "PIOObjectProtocol.h"
+#import "PIOModelDecoder.h"
 #import "PIOAccount.h"
 #import "PIOAccountSettings.h"
 #import "PIOAuth.h"
 #import "AFOAuthCredential.h"
+#import "PIOCallbackQueue.h"
 
 @implementation PIOAPI (Account)
 
 + (NSURLSessionDataTask *)getAccountInformationWithCallback:(void (^)(NSError * _Nullable, PIOAccount * _Nullable))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointAccountInfo];
     
@@ -46,27 +48,19 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        PIOAccount *account = pk_model_from_dictionary(PIOAccount.class, [responseDictionary objectForKey:@"info"]);
         
-        id account = [PIOAccount alloc];
         
-        if ([account conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-            account = [account initFromDictionary:[responseDictionary objectForKey:@"info"]];
-        } else {
-            account = nil;
-        }
-        
-        
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, account);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)getAccountSettingsWithCallback:(void (^)(NSError * _Nullable, PIOAccountSettings * _Nullable))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointAccountSettings];
     
@@ -77,27 +71,19 @@
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
-        
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
-        
-        id settings = [PIOAccountSettings alloc];
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        if ([settings conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-            settings = [settings initFromDictionary:[responseDictionary objectForKey:@"settings"]];
-        } else {
-            settings = nil;
-        }
+        PIOAccountSettings *settings = pk_model_from_dictionary(PIOAccountSettings.class, [responseDictionary objectForKey:@"settings"]);
         
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, settings);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)updateAccountSettings:(PIOAccountSettings *)newAccountSettings callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointAccountSettings];
     
@@ -119,11 +105,11 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
@@ -32,6 +32,21 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ A folder listing started by `enumerateFilesInFolderWithID:perPage:usingBlock:completion:`.
+ */
+NS_SWIFT_NAME(FileEnumeration)
+@interface PIOFileEnumeration : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ Stops the listing and cancels the request for the page that is in flight, including the first. No more pages are handed over, and unless the listing has already finished, the completion block is called with `NSURLErrorCancelled`.
+ */
+- (void)cancel;
+
+@end
+
 @interface PIOAPI (Files)
 
 
@@ -47,7 +62,63 @@ NS_ASSUME_NONNULL_BEGIN
                                          callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> *, PIOFile * _Nullable))callback NS_SWIFT_NAME(listFiles(in:callback:));
 
 /**
- Searches your files and files that have been shared with you. Returns 50 results at a time. The url for next 50 results is returned in the callback block.
+ Lists one page of the files in a specified folder. The cursor for the next page is returned in the callback block and can be passed to `continueListingFilesWithCursor:perPage:callback:`, in the same way as the next page url returned by `searchFilesWithQuery:onPage:callback:`.
+ 
+ @param folderIdentifier    The ID of the folder whose contents is to be listed. The root directory has an identifier of @b 0.
+ @param perPage             The maximum number of files to return. @b Put.io allows at most 1000.
+ @param callback            The block that is called when the request completes. If the request completes successfully, the first page of the folder's contents, the folder itself and the cursor for the next page, if there is a next page, will be returned. However, if it fails, the underlying error will be returned.
+ 
+ @return    The request's `NSURLSessionDataTask` to be resumed.
+ */
++ (NSURLSessionDataTask *)listFilesInFolderWithID:(NSInteger)folderIdentifier
+                                          perPage:(NSUInteger)perPage
+                                         callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> *, PIOFile * _Nullable, NSString * _Nullable))callback NS_SWIFT_NAME(listFiles(in:perPage:callback:));
+
+/**
+ Lists the next page of the files in a folder.
+ 
+ @param cursor      The cursor returned with the previous page.
+ @param perPage     The maximum number of files to return. @b Put.io allows at most 1000.
+ @param callback    The block that is called when the request completes. If the request completes successfully, the page of files and the cursor for the next page, if there is a next page, will be returned. However, if it fails, the underlying error will be returned.
+ 
+ @return    The request's `NSURLSessionDataTask` to be resumed.
+ */
++ (NSURLSessionDataTask *)continueListingFilesWithCursor:(NSString *)cursor
+                                                 perPage:(NSUInteger)perPage
+                                                callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> *, NSString * _Nullable))callback NS_SWIFT_NAME(listFiles(continuing:perPage:callback:));
+
+/**
+ Lists one page of the files in a specified folder like `listFilesInFolderWithID:perPage:callback:`, but hands the files over while the page is still downloading. The response is decoded as it arrives rather than all at once, so the first files of a large page can be shown straight away and the page is never held in memory as a whole.
+ 
+ @param folderIdentifier    The ID of the folder whose contents is to be listed. The root directory has an identifier of @b 0.
+ @param perPage             The maximum number of files to return. @b Put.io allows at most 1000.
+ @param filesCallback       The block that is called on the callback queue, any number of times, with the files that have arrived since it was last called, in order.
+ @param completion          The block that is called once the whole page has arrived and been handed over. If the request completes successfully, the folder itself and the cursor for the next page, if there is a next page, will be returned. However, if it fails, the underlying error will be returned.
+ 
+ @return    The request's `NSURLSessionDataTask` to be resumed.
+ */
++ (NSURLSessionDataTask *)streamFilesInFolderWithID:(NSInteger)folderIdentifier
+                                            perPage:(NSUInteger)perPage
+                                      filesCallback:(void (^)(NSArray<PIOFile *> *files))filesCallback
+                                         completion:(void (^)(NSError * _Nullable, PIOFile * _Nullable, NSString * _Nullable))completion NS_SWIFT_NAME(streamFiles(in:perPage:files:completion:));
+
+/**
+ Lists all the files in a specified folder a page at a time, handing each page over as soon as it arrives so that large folders don't have to be held in memory all at once. The next page is requested while the current one is being handled. The listing starts immediately.
+ 
+ @param folderIdentifier    The ID of the folder whose contents is to be listed. The root directory has an identifier of @b 0.
+ @param perPage             The maximum number of files in each page. @b Put.io allows at most 1000.
+ @param block               The block that is called on the callback queue with each page, in order, along with the folder itself. Setting `stop` to `YES` ends the listing without requesting any more pages.
+ @param completion          The block that is called once there are no more pages, the listing has been stopped, or a request has failed, in which case the underlying error will be returned.
+ 
+ @return    The listing, which can be cancelled while a page is still on its way.
+ */
++ (PIOFileEnumeration *)enumerateFilesInFolderWithID:(NSInteger)folderIdentifier
+                                             perPage:(NSUInteger)perPage
+                                          usingBlock:(void (^)(NSArray<PIOFile *> *files, PIOFile * _Nullable folder, BOOL *stop))block
+                                          completion:(PIOErrorOnlyCallback _Nullable)completion NS_SWIFT_NAME(enumerateFiles(in:perPage:using:completion:));
+
+/**
+ Searches your files and files that have been shared with you. Returns 50 results at a time. The url for next 50 results is returned in the callback block. A search field that searches as the user types is better served by a `PIOSearchSession`, which caches and prefetches pages.
  
  There is a special search syntax that can be deployed if more control is needed to filter results. There are three search keywords that can help filter a search's results: @b from, @b type, @b ext.
  
@@ -67,6 +138,21 @@ NS_ASSUME_NONNULL_BEGIN
                                         onPage:(NSInteger)page
                                       callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> *, NSURL * _Nullable))callback NS_SWIFT_NAME(searchFiles(query:page:callback:));
 
+/**
+ Searches your files like `searchFilesWithQuery:onPage:callback:`, but hands the results over while they are still downloading.
+ 
+ @param query           The keyword to search, in the syntax described in `searchFilesWithQuery:onPage:callback:`.
+ @param page            The page of results to fetch
+ @param filesCallback   The block that is called on the callback queue, any number of times, with the results that have arrived since it was last called, in order.
+ @param completion      The block that is called once all the results have arrived and been handed over. If the request completes successfully, an `NSURL` object indicating the next page of search results will be returned, if there is a next page. However, if it fails, the underlying error will be returned.
+ 
+ @return    The request's `NSURLSessionDataTask` to be resumed.
+ */
++ (NSURLSessionDataTask *)streamSearchResultsForQuery:(NSString *)query
+                                               onPage:(NSInteger)page
+                                        filesCallback:(void (^)(NSArray<PIOFile *> *files))filesCallback
+                                           completion:(void (^)(NSError * _Nullable, NSURL * _Nullable))completion NS_SWIFT_NAME(streamSearchResults(query:page:files:completion:));
+
 /**
  Uploads a file to @b Put.io. This must @b not be a `.torrent` file otherwise an exception will be raised. The method `uploadTorrentFileAtURL:toFolderWithID:newFileName:callback:` must be used to upload torrents.
  
@@ -180,7 +266,7 @@ NS_ASSUME_NONNULL_BEGIN
                                                      callback:(void (^)(NSError * _Nullable, PIOMP4Conversion * _Nullable))callback NS_SWIFT_NAME(mp4ConversionStatus(for:callback:));
 
 /**
- Downloads a given file.
+ Downloads a given file. The download starts over from the beginning if it is interrupted; `PIODownloadManager` should be used for large files.
  
  @param fileIdentifier  The identifier of the file to be downloaded.
  @param callback        The block that is called when the request completes. If the request completes successfully, the local file `NSURL` will be returned. This file will have been moved to the `NSDownloadsDirectory`. However, if it fails, the underlying error will be returned.
@@ -25,23 +25,61 @@
 
 #import "PIOAPI+Files.h"
 #import "PIOError.h"
+#import "PIOSession.h"
+#import "PIOModelStream.h"
+#import "PIOMultipartBodyStream.h"
+#import "PIOChecksum.h"
 #import "PIOEndpoints.h"
 #import "PIOFile.h"
-#import "PIOObjectProtocol.h"
+#import "PIOModelDecoder.h"
 #import "PIOTransfer.h"
 #import "PIOAuth.h"
 #import "AFOAuthCredential.h"
 #import "PIOMP4Conversion.h"
 #import "PIOShare.h"
 #import "PIOShareRecipient.h"
+#import "PIOFileCache.h"
 #import "PIOSubtitle.h"
 #import "PIOEvent.h"
+#import "PIOCallbackQueue.h"
+
+/**
+ The state of the listing, which is only touched on the callback queue the listing was started with, which every page calls back on, apart from `task` and `cancelled`.
+ */
+@interface PIOFileEnumeration ()
+
+@property (nonatomic) NSUInteger perPage;
+@property (strong, nonatomic, nullable) PIOFile *folder;
+@property (copy, nonatomic) void (^block)(NSArray<PIOFile *> *, PIOFile * _Nullable, BOOL *);
+@property (copy, nonatomic, nullable) PIOErrorOnlyCallback completion;
+@property (strong, atomic, nullable) NSURLSessionDataTask *task; // The request for the next page, if one has been made.
+@property (nonatomic, getter=isStopped) BOOL stopped;
+@property (atomic, getter=isCancelled) BOOL cancelled;
+
+@end
+
+@implementation PIOFileEnumeration
+
+- (void)cancel {
+    // Set straight away, so that a page already on its way to the callback queue isn't handed over either.
+    self.cancelled = YES;
+    
+    [self.task cancel];
+}
+
+@end
+
+static NSString *pk_cursor_from_response(NSDictionary *responseDictionary) {
+    NSString *cursor = [responseDictionary objectForKey:@"cursor"];
+    
+    return [cursor isKindOfClass:NSString.class] && cursor.length > 0 ? cursor : nil;
+}
 
 @implementation PIOAPI (Files)
 
 + (NSURLSessionDataTask *)listFilesInFolderWithID:(NSInteger)folderIdentifier
                                          callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> * _Nonnull, PIOFile * _Nullable))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointListFiles];
     
@@ -51,38 +89,153 @@
     return [session dataTaskWithURL:components.URL completionHandler:^(NSData * _Nullable data,
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error) {
-        pk_response_validate(data, &error);
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSArray *files = pk_models_from_dictionaries(PIOFile.class, [responseDictionary objectForKey:@"files"]);
         
-        NSMutableArray *files = [NSMutableArray array];
+        PIOFile *parent = pk_model_from_dictionary(PIOFile.class, [responseDictionary objectForKey:@"parent"]);
         
-        for (NSDictionary *filesDictionary in [responseDictionary objectForKey:@"files"]) {
-            id file = [PIOFile alloc];
-            
-            if ([file conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-                file = [file initFromDictionary:filesDictionary];
-                
-                file == nil ?: [files addObject:file];
-            }
-        }
+        pk_dispatch_callback(^{
+            callback(error, files, parent);
+        });
+    }];
+}
+
++ (NSURLSessionDataTask *)listFilesInFolderWithID:(NSInteger)folderIdentifier
+                                          perPage:(NSUInteger)perPage
+                                         callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> * _Nonnull, PIOFile * _Nullable, NSString * _Nullable))callback {
+    PIOSession *session = [PIOSession sharedInstance];
+    
+    NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointListFiles];
+    
+    components.queryItems = @[[NSURLQueryItem queryItemWithName:@"parent_id" value:@(folderIdentifier).stringValue],
+                              [NSURLQueryItem queryItemWithName:@"per_page" value:@(perPage).stringValue],
+                              [NSURLQueryItem queryItemWithName:@"oauth_token" value:[PIOAuth sharedInstance].credential.accessToken]];
+    
+    return [session dataTaskWithURL:components.URL completionHandler:^(NSData * _Nullable data,
+                                                                       NSURLResponse * _Nullable response,
+                                                                       NSError * _Nullable error) {
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        id parent = [PIOFile alloc];
+        NSArray *files = pk_models_from_dictionaries(PIOFile.class, [responseDictionary objectForKey:@"files"]);
+        NSString *cursor = pk_cursor_from_response(responseDictionary);
         
-        if ([parent conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-            parent = [parent initFromDictionary:[responseDictionary objectForKey:@"parent"]];
-        }
+        PIOFile *parent = pk_model_from_dictionary(PIOFile.class, [responseDictionary objectForKey:@"parent"]);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
-            callback(error, files, parent);
-        }];
+        pk_dispatch_callback(^{
+            callback(error, files, parent, cursor);
+        });
     }];
 }
 
++ (NSURLSessionDataTask *)continueListingFilesWithCursor:(NSString *)cursor
+                                                 perPage:(NSUInteger)perPage
+                                                callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> * _Nonnull, NSString * _Nullable))callback {
+    PIOSession *session = [PIOSession sharedInstance];
+    
+    NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointContinueListingFiles];
+    
+    components.queryItems = @[[NSURLQueryItem queryItemWithName:@"oauth_token" value:[PIOAuth sharedInstance].credential.accessToken]];
+    
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:components.URL];
+    [request setHTTPMethod:@"POST"];
+    [request setValue:@"application/json" forHTTPHeaderField:@"content-type"];
+    request.HTTPBody = [NSJSONSerialization dataWithJSONObject:@{@"cursor" : cursor,
+                                                                 @"per_page" : @(perPage).stringValue}
+                                                       options:0 error:nil];
+    
+    return [session dataTaskWithRequest:request completionHandler:^(NSData * _Nullable data,
+                                                                    NSURLResponse * _Nullable response,
+                                                                    NSError * _Nullable error)
+    {
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
+        
+        NSArray *files = pk_models_from_dictionaries(PIOFile.class, [responseDictionary objectForKey:@"files"]);
+        NSString *nextCursor = pk_cursor_from_response(responseDictionary);
+        
+        pk_dispatch_callback(^{
+            callback(error, files, nextCursor);
+        });
+    }];
+}
+
++ (NSURLSessionDataTask *)streamFilesInFolderWithID:(NSInteger)folderIdentifier
+                                            perPage:(NSUInteger)perPage
+                                      filesCallback:(void (^)(NSArray<PIOFile *> * _Nonnull))filesCallback
+                                         completion:(void (^)(NSError * _Nullable, PIOFile * _Nullable, NSString * _Nullable))completion {
+    NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointListFiles];
+    
+    components.queryItems = @[[NSURLQueryItem queryItemWithName:@"parent_id" value:@(folderIdentifier).stringValue],
+                              [NSURLQueryItem queryItemWithName:@"per_page" value:@(perPage).stringValue],
+                              [NSURLQueryItem queryItemWithName:@"oauth_token" value:[PIOAuth sharedInstance].credential.accessToken]];
+    
+    PIOModelStream *stream = [[PIOModelStream alloc] initWithModelClass:PIOFile.class arrayKey:@"files" modelsCallback:filesCallback completion:^(NSError * _Nullable error, NSDictionary * _Nullable responseDictionary) {
+        PIOFile *parent = pk_model_from_dictionary(PIOFile.class, [responseDictionary objectForKey:@"parent"]);
+        
+        completion(error, parent, pk_cursor_from_response(responseDictionary));
+    }];
+    
+    return [[PIOSession sharedInstance] dataTaskWithRequest:[NSURLRequest requestWithURL:components.URL] delegate:stream];
+}
+
++ (PIOFileEnumeration *)enumerateFilesInFolderWithID:(NSInteger)folderIdentifier
+                                             perPage:(NSUInteger)perPage
+                                          usingBlock:(void (^)(NSArray<PIOFile *> * _Nonnull, PIOFile * _Nullable, BOOL * _Nonnull))block
+                                          completion:(PIOErrorOnlyCallback)completion {
+    PIOFileEnumeration *enumeration = [PIOFileEnumeration new];
+    
+    enumeration.perPage = perPage;
+    enumeration.block = block;
+    enumeration.completion = completion;
+    
+    enumeration.task = [self listFilesInFolderWithID:folderIdentifier perPage:perPage callback:^(NSError * _Nullable error, NSArray<PIOFile *> * _Nonnull files, PIOFile * _Nullable folder, NSString * _Nullable cursor) {
+        enumeration.folder = folder;
+        [self continueEnumeration:enumeration withError:error files:files cursor:cursor];
+    }];
+    
+    [enumeration.task resume];
+    
+    return enumeration;
+}
+
++ (void)continueEnumeration:(PIOFileEnumeration *)enumeration withError:(NSError *)error files:(NSArray<PIOFile *> *)files cursor:(NSString *)cursor {
+    if (enumeration.isStopped) return;
+    
+    if (enumeration.isCancelled) error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+    
+    if (error != nil) {
+        enumeration.stopped = YES;
+        enumeration.completion == nil ?: enumeration.completion(error);
+        return;
+    }
+    
+    // The next page is requested before this one is handed over, so that it downloads while this one is being handled.
+    if (cursor != nil) {
+        enumeration.task = [self continueListingFilesWithCursor:cursor perPage:enumeration.perPage callback:^(NSError * _Nullable error, NSArray<PIOFile *> * _Nonnull files, NSString * _Nullable cursor) {
+            [self continueEnumeration:enumeration withError:error files:files cursor:cursor];
+        }];
+        
+        [enumeration.task resume];
+    }
+    
+    BOOL stop = NO;
+    
+    enumeration.block(files, enumeration.folder, &stop);
+    
+    if (!stop && cursor != nil) return;
+    
+    enumeration.stopped = YES;
+    
+    [enumeration.task cancel];
+    enumeration.task = nil;
+    
+    enumeration.completion == nil ?: enumeration.completion(nil);
+}
+
 + (NSURLSessionDataTask *)searchFilesWithQuery:(NSString *)query
                                         onPage:(NSInteger)page
                                       callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> * _Nonnull, NSURL * _Nullable))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[kPIOEndpointSearchFiles stringByAppendingFormat:@"/%@/page/%@", [query stringByAddingPercentEncodingWithAllowedCharacters:[NSCharacterSet URLQueryAllowedCharacterSet]], @(page).stringValue]];
     
@@ -91,32 +244,36 @@
     return [session dataTaskWithURL:components.URL completionHandler:^(NSData * _Nullable data,
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error) {
-        pk_response_validate(data, &error);
-        
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
-        
-        NSMutableArray *files = [NSMutableArray array];
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        for (NSDictionary *filesDictionary in [responseDictionary objectForKey:@"files"]) {
-            id file = [PIOFile alloc];
-            
-            if ([file conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-                file = [file initFromDictionary:filesDictionary];
-                
-                file == nil ?: [files addObject:file];
-            }
-        }
+        NSArray *files = pk_models_from_dictionaries(PIOFile.class, [responseDictionary objectForKey:@"files"]);
         
-
         NSString *nextPageString = [responseDictionary objectForKey:@"next"];
         NSURL *nextPageURL = [nextPageString isKindOfClass:NSString.class] ? [NSURL URLWithString:nextPageString] : nil;
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, files, nextPageURL);
-        }];
+        });
     }];
 }
 
++ (NSURLSessionDataTask *)streamSearchResultsForQuery:(NSString *)query
+                                               onPage:(NSInteger)page
+                                        filesCallback:(void (^)(NSArray<PIOFile *> * _Nonnull))filesCallback
+                                           completion:(void (^)(NSError * _Nullable, NSURL * _Nullable))completion {
+    NSURLComponents *components = [NSURLComponents componentsWithString:[kPIOEndpointSearchFiles stringByAppendingFormat:@"/%@/page/%@", [query stringByAddingPercentEncodingWithAllowedCharacters:[NSCharacterSet URLQueryAllowedCharacterSet]], @(page).stringValue]];
+    
+    components.queryItems = @[[NSURLQueryItem queryItemWithName:@"oauth_token" value:[PIOAuth sharedInstance].credential.accessToken]];
+    
+    PIOModelStream *stream = [[PIOModelStream alloc] initWithModelClass:PIOFile.class arrayKey:@"files" modelsCallback:filesCallback completion:^(NSError * _Nullable error, NSDictionary * _Nullable responseDictionary) {
+        NSString *nextPageString = [responseDictionary objectForKey:@"next"];
+        
+        completion(error, [nextPageString isKindOfClass:NSString.class] ? [NSURL URLWithString:nextPageString] : nil);
+    }];
+    
+    return [[PIOSession sharedInstance] dataTaskWithRequest:[NSURLRequest requestWithURL:components.URL] delegate:stream];
+}
+
 + (NSURLSessionUploadTask *)uploadFileAtURL:(NSURL *)fileURL
                              toFolderWithID:(NSInteger)parentIdentifier
                                 newFileName:(NSString * _Nullable)fileName
@@ -125,28 +282,28 @@
     
     if (fileName == nil) fileName = [fileURL lastPathComponent];
     
-    NSData *data = [NSData dataWithContentsOfFile:fileURL.path];
     NSString *contentType = @"application/octet-stream";
     
-    return [self uploadData:data
-                     ofType:contentType
-             toFolderWithID:parentIdentifier
-                newFileName:fileName
-                   callback:^(NSData * _Nullable data,  NSURLResponse * _Nullable response, NSError * _Nullable error)
+    return [self uploadFileAtURL:fileURL
+                          ofType:contentType
+                  toFolderWithID:parentIdentifier
+                     newFileName:fileName
+                        callback:^(NSData * _Nullable data,  NSURLResponse * _Nullable response, NSError * _Nullable error, NSNumber * _Nullable checksum)
     {
-        pk_response_validate(data, &error);
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        PIOFile *file = pk_model_from_dictionary(PIOFile.class, [responseDictionary objectForKey:@"file"]);
         
-        id file = [PIOFile alloc];
+        uint32_t expectedChecksum;
         
-        if ([file conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-            file = [file initFromDictionary:[responseDictionary objectForKey:@"file"]];
+        // The checksum of what was sent was computed as it was sent, so catching a file that was corrupted on the way costs nothing extra.
+        if (error == nil && checksum != nil && pk_crc32_from_string([file cyclicRedundancyCode], &expectedChecksum) && checksum.unsignedIntValue != expectedChecksum) {
+            error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:@{NSLocalizedDescriptionKey: @"The uploaded file does not match its checksum."}];
         }
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, file);
-        }];
+        });
     }];
 }
 
@@ -158,72 +315,60 @@
     
     if (fileName == nil) fileName = [torrentURL lastPathComponent];
     
-    NSData *data = [NSData dataWithContentsOfFile:torrentURL.path];
     NSString *contentType = @"application/x-bittorrent";
     
-    return [self uploadData:data
-                     ofType:contentType
-             toFolderWithID:parentIdentifier
-                newFileName:fileName
-                   callback:^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error)
+    return [self uploadFileAtURL:torrentURL
+                          ofType:contentType
+                  toFolderWithID:parentIdentifier
+                     newFileName:fileName
+                        callback:^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error, NSNumber * _Nullable checksum)
     {
-        pk_response_validate(data, &error);
-                
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
                 
-        id transfer = [PIOTransfer alloc];
-                
-        if ([transfer conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-            transfer = [transfer initFromDictionary:[responseDictionary objectForKey:@"transfer"]];
-        }
+        PIOTransfer *transfer = pk_model_from_dictionary(PIOTransfer.class, [responseDictionary objectForKey:@"transfer"]);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, transfer);
-        }];
+        });
     }];
 }
 
-+ (NSURLSessionUploadTask *)uploadData:(NSData *)data
-                                ofType:(NSString *)dataType
-                        toFolderWithID:(NSInteger)parentIdentifier
-                           newFileName:(NSString *)fileName
-                              callback:(void (^)(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error))callback {
++ (NSURLSessionUploadTask *)uploadFileAtURL:(NSURL *)fileURL
+                                     ofType:(NSString *)fileType
+                             toFolderWithID:(NSInteger)parentIdentifier
+                                newFileName:(NSString *)fileName
+                                   callback:(void (^)(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error, NSNumber * _Nullable checksum))callback {
     NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:kPIOEndpointUploadFiles]];
     AFOAuthCredential *credential = [PIOAuth sharedInstance].credential;
     
     [request setHTTPMethod:@"POST"];
     [request setValue:[NSString stringWithFormat:@"%@ %@", credential.tokenType, credential.accessToken] forHTTPHeaderField:@"authorization"];
     
-    NSString *boundary = [NSString stringWithFormat:@"----%@", [NSUUID UUID].UUIDString];
-    NSString *contentType = [NSString stringWithFormat:@"multipart/form-data; boundary=%@", boundary];
-    [request addValue:contentType forHTTPHeaderField: @"Content-Type"];
-    
-    NSMutableData *body = [NSMutableData data];
+    // The file is streamed from disk as the request is sent, so only one chunk of it is ever in memory.
+    PIOMultipartBodyStream *body = [PIOMultipartBodyStream new];
+    NSError *fileError;
     
-    [body appendData:[[NSString stringWithFormat:@"--%@\n", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
-    [body appendData:[[NSString stringWithFormat:@"Content-Disposition: form-data; name=\"file\"; filename=\"%@\"\n", fileName] dataUsingEncoding:NSUTF8StringEncoding]];
-    [body appendData:[[NSString stringWithFormat:@"Content-Type: %@\n\n", dataType] dataUsingEncoding:NSUTF8StringEncoding]];
-    [body appendData:data];
+    BOOL appended = [body appendFileAtURL:fileURL name:@"file" fileName:fileName mimeType:fileType error:&fileError];
+    [body appendFormFieldWithValue:fileName name:@"filename"];
+    [body appendFormFieldWithValue:[NSString stringWithFormat:@"%zd", parentIdentifier] name:@"parent_id"];
     
-    [body appendData:[[NSString stringWithFormat:@"\n\n--%@\n", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
-    [body appendData:[[NSString stringWithFormat:@"Content-Disposition: form-data; name=\"filename\"\n\n%@\n", fileName] dataUsingEncoding:NSUTF8StringEncoding]];
+    [body attachToRequest:request];
     
-    [body appendData:[[NSString stringWithFormat:@"--%@\n", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
-    [body appendData:[[NSString stringWithFormat:@"Content-Disposition: form-data; name=\"parent_id\"\n\n%zd", parentIdentifier] dataUsingEncoding:NSUTF8StringEncoding]];
-    
-    [body appendData:[[NSString stringWithFormat:@"\n--%@--", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
+    PIOSession *session = [PIOSession sharedInstance];
+    NSURLSessionDataTask *task = [session dataTaskWithRequest:request completionHandler:^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
+        appended ? callback(data, response, error, [body checksumOfFileAtURL:fileURL]) : callback(nil, nil, fileError, nil);
+    }];
     
-    NSInputStream *stream = [[NSInputStream alloc] initWithData:body];
-    [request setHTTPBodyStream:stream];
+    // A file that can't be read is reported through the callback, the same way a failed request is, instead of sending a body without it.
+    if (!appended) [task cancel];
     
-    NSURLSession *session = [NSURLSession sharedSession];
-    return (NSURLSessionUploadTask *)[session dataTaskWithRequest:request completionHandler:callback];
+    return (NSURLSessionUploadTask *)task;
 }
 
 + (NSURLSessionDataTask *)createFolderNamed:(NSString *)folderName
                           inDirectoryWithID:(NSInteger)parentIdentifier
                                    callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointCreateFolder];
     
@@ -240,16 +385,17 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
+        [[PIOFileCache sharedInstance] invalidateFolderWithID:parentIdentifier];
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)getFileForID:(NSInteger)fileIdentifier callback:(void (^)(NSError * _Nullable, PIOFile * _Nullable))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd", kPIOEndpointFiles, fileIdentifier]];
     
@@ -258,19 +404,13 @@
     return [session dataTaskWithURL:components.URL completionHandler:^(NSData * _Nullable data,
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error) {
-        pk_response_validate(data, &error);
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        PIOFile *file = pk_model_from_dictionary(PIOFile.class, [responseDictionary objectForKey:@"file"]);
         
-        id file = [PIOFile alloc];
-        
-        if ([file conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-            file = [file initFromDictionary:[responseDictionary objectForKey:@"file"]];
-        }
-        
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, file);
-        }];
+        });
     }];
 }
 
@@ -278,7 +418,7 @@
                                     callback:(PIOErrorOnlyCallback)callback {
     NSParameterAssert(fileIdentifiers.count > 0);
     
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointDeleteFiles];
     
@@ -294,18 +434,19 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
+        [[PIOFileCache sharedInstance] invalidateFoldersContainingFilesWithIDs:fileIdentifiers]; // Even a failed request may have gone through for some of the files.
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)renameFileWithID:(NSInteger)fileIdentifier
                                     toName:(NSString *)newName
                                   callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointRenameFile];
     
@@ -321,18 +462,19 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
+        [[PIOFileCache sharedInstance] invalidateFoldersContainingFilesWithIDs:@[@(fileIdentifier)]];
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)moveFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers
                             toFolderWithID:(NSInteger)destinationIdentifier
                                   callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointMoveFile];
     
@@ -349,17 +491,19 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
+        [[PIOFileCache sharedInstance] invalidateFoldersContainingFilesWithIDs:fileIdentifiers];
+        [[PIOFileCache sharedInstance] invalidateFolderWithID:destinationIdentifier];
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)beginConvertingFileWithIDToMP4:(NSInteger)fileIdentifier
                                                 callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd/mp4", kPIOEndpointFiles, fileIdentifier]];
     
@@ -373,17 +517,17 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)getMP4ConversionStatusForFileWithID:(NSInteger)fileIdentifier
                                                      callback:(void (^)(NSError * _Nullable, PIOMP4Conversion *  _Nullable))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd/mp4", kPIOEndpointFiles, fileIdentifier]];
     
@@ -394,24 +538,18 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
-        
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        id status = [PIOMP4Conversion alloc];
-        
-        if ([status conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-            status = [status initFromDictionary:[responseDictionary objectForKey:@"mp4"]];
-        }
+        PIOMP4Conversion *status = pk_model_from_dictionary(PIOMP4Conversion.class, [responseDictionary objectForKey:@"mp4"]);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, status);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDownloadTask *)downloadFileForID:(NSInteger)fileIdentifier callback:(void (^)(NSError * _Nullable, NSURL * _Nullable))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd/download", kPIOEndpointFiles, fileIdentifier]];
     
@@ -428,21 +566,22 @@
             NSURL *downloadsDirectoryURL = [[manager URLsForDirectory:NSDownloadsDirectory inDomains:NSUserDomainMask] firstObject];
             fileURL = [downloadsDirectoryURL URLByAppendingPathComponent:response.suggestedFilename];
             
-            [manager moveItemAtURL:downloadsDirectoryURL toURL:fileURL error:&error];
+            [manager createDirectoryAtURL:downloadsDirectoryURL withIntermediateDirectories:YES attributes:nil error:nil];
+            [manager moveItemAtURL:location toURL:fileURL error:&error];
             
             if (error != nil) fileURL = nil; // Set fileURL to `nil` if there was an error moving the fileURL so as to not confuse the developer with both a nonull "error" and "url" parameter.
         }
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, fileURL);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)shareFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers
                            withFriendsNamed:(NSArray<NSString *> *)friends
                                    callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointShareFiles];
     
@@ -460,16 +599,16 @@
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)listSharesWithCallback:(void (^)(NSError * _Nullable, NSArray<PIOShare *> * _Nonnull))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointSharedFiles];
     
@@ -480,30 +619,18 @@
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSArray<PIOShare *> *shares = pk_models_from_dictionaries(PIOShare.class, [responseDictionary objectForKey:@"shared"]);
         
-        NSMutableArray *shares = [NSMutableArray array];
-        
-        for (NSDictionary *sharesDictionary in [responseDictionary objectForKey:@"shared"]) {
-            id share = [PIOShare alloc];
-            
-            if ([share conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-                share = [share initFromDictionary:sharesDictionary];
-            }
-            
-            share == nil ?: [shares addObject:share];
-        }
-        
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, shares);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)listShareRecipientsForFileWithID:(NSInteger)fileIdentifier callback:(void (^)(NSError * _Nullable, NSArray<PIOShareRecipient *> * _Nonnull))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd/shared-with", kPIOEndpointFiles, fileIdentifier]];
     
@@ -514,30 +641,18 @@
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
-        
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        NSMutableArray *recipients = [NSMutableArray array];
-        
-        for (NSDictionary *sharesDictionary in [responseDictionary objectForKey:@"shared-with"]) {
-            id recipient = [PIOShareRecipient alloc];
-            
-            if ([recipient conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-                recipient = [recipient initFromDictionary:sharesDictionary];
-            }
-            
-            recipient == nil ?: [recipients addObject:recipient];
-        }
+        NSArray<PIOShareRecipient *> *recipients = pk_models_from_dictionaries(PIOShareRecipient.class, [responseDictionary objectForKey:@"shared-with"]);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, recipients);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)stopSharingFileWithID:(NSInteger)fileIdentifier withShareRecipientsWithIDs:(NSArray<NSNumber *> *)shareIdentifiers callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd/unshare", kPIOEndpointFiles, fileIdentifier]];
     
@@ -556,16 +671,16 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)listSubtitlesForFileWithID:(NSInteger)fileIdentifier callback:(void (^)(NSError * _Nullable, NSArray<PIOSubtitle *> * _Nonnull))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd/subtitles", kPIOEndpointFiles, fileIdentifier]];
     
@@ -576,25 +691,13 @@
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
-        
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        NSMutableArray *subtitles = [NSMutableArray array];
+        NSArray<PIOSubtitle *> *subtitles = pk_models_from_dictionaries(PIOSubtitle.class, [responseDictionary objectForKey:@"subtitles"]);
         
-        for (NSDictionary *subtitleDictionary in [responseDictionary objectForKey:@"subtitles"]) {
-            id subtitle = [PIOSubtitle alloc];
-            
-            if ([subtitle conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-                subtitle = [subtitle initFromDictionary:subtitleDictionary];
-            }
-            
-            subtitle == nil ?: [subtitles addObject:subtitle];
-        }
-        
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, subtitles);
-        }];
+        });
     }];
 }
 
@@ -605,7 +708,7 @@
 {
     subtitleIdentifier = subtitleIdentifier == nil ? @"default" : subtitleIdentifier;
     
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd/subtitles/%@", kPIOEndpointFiles, fileIdentifier, subtitleIdentifier]];
     
@@ -624,14 +727,15 @@
             NSURL *downloadsDirectoryURL = [[manager URLsForDirectory:NSDownloadsDirectory inDomains:NSUserDomainMask] firstObject];
             subtitleURL = [downloadsDirectoryURL URLByAppendingPathComponent:response.suggestedFilename];
             
-            [manager moveItemAtURL:downloadsDirectoryURL toURL:subtitleURL error:&error];
+            [manager createDirectoryAtURL:downloadsDirectoryURL withIntermediateDirectories:YES attributes:nil error:nil];
+            [manager moveItemAtURL:location toURL:subtitleURL error:&error];
             
             if (error != nil) subtitleURL = nil; // Set subtitleURL to `nil` if there was an error moving the subtitleURL so as to not confuse the developer with both a nonull "error" and "url" parameter.
         }
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, subtitleURL);
-        }];
+        });
     }];
 }
 
@@ -645,7 +749,7 @@
 }
 
 + (NSURLSessionDataTask *)listEventsWithCallback:(void (^)(NSError * _Nullable, NSArray<PIOEvent *> * _Nonnull))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointListEvents];
     
@@ -656,30 +760,18 @@
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSArray<PIOEvent *> *events = pk_models_from_dictionaries(PIOEvent.class, [responseDictionary objectForKey:@"events"]);
         
-        NSMutableArray *events = [NSMutableArray array];
-        
-        for (NSDictionary *eventDictionary in [responseDictionary objectForKey:@"events"]) {
-            id event = [PIOEvent alloc];
-            
-            if ([event conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-                event = [event initFromDictionary:eventDictionary];
-            }
-            
-            event == nil ?: [events addObject:event];
-        }
-        
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, events);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)deleteAllEventsWithCallback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointDeleteEvents];
     
@@ -693,18 +785,18 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)setStartPosition:(NSTimeInterval)startPosition
                              forFileWithID:(NSInteger)fileIdentifier
                                   callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd/start-from", kPIOEndpointFiles, fileIdentifier]];
     
@@ -719,16 +811,16 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)removeStartPositionFromFileWithID:(NSInteger)fileIdentifier callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd/start-from/delete", kPIOEndpointFiles, fileIdentifier]];
     
@@ -742,11 +834,11 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
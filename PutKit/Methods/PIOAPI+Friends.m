@@ -25,16 +25,18 @@
 
 #import "PIOAPI+Friends.h"
 #import "PIOError.h"
+#import "PIOSession.h"
 #import "PIOEndpoints.h"
-#import "PIOObjectProtocol.h"
+#import "PIOModelDecoder.h"
 #import "PIOFriend.h"
 #import "PIOAuth.h"
 #import "AFOAuthCredential.h"
+#import "PIOCallbackQueue.h"
 
 @implementation PIOAPI (Friends)
 
 + (NSURLSessionDataTask *)listFriendsWithCallback:(void (^)(NSError * _Nullable, NSArray<PIOFriend *> * _Nonnull))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointListFriends];
     
@@ -45,30 +47,18 @@
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSArray<PIOFriend *> *friends = pk_models_from_dictionaries(PIOFriend.class, [responseDictionary objectForKey:@"friends"]);
         
-        NSMutableArray *friends = [NSMutableArray array];
-        
-        for (NSDictionary *friendDictionary in [responseDictionary objectForKey:@"friends"]) {
-            id friend = [PIOFriend alloc];
-            
-            if ([friend conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-                friend = [friend initFromDictionary:friendDictionary];
-                
-                friend == nil ?: [friends addObject:friend];
-            }
-        }
-        
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, friends);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)getFriendRequestsWithCallback:(void (^)(NSError * _Nullable, NSArray<PIOFriend *> * _Nonnull))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointFriendRequests];
     
@@ -79,30 +69,18 @@
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
-        
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
-        
-        NSMutableArray *friends = [NSMutableArray array];
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        for (NSDictionary *friendDictionary in [responseDictionary objectForKey:@"friends"]) {
-            id friend = [PIOFriend alloc];
-            
-            if ([friend conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-                friend = [friend initFromDictionary:friendDictionary];
-                
-                friend == nil ?: [friends addObject:friend];
-            }
-        }
+        NSArray<PIOFriend *> *friends = pk_models_from_dictionaries(PIOFriend.class, [responseDictionary objectForKey:@"friends"]);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, friends);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)sendFriendRequestToFriendNamed:(NSString *)username callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%@/request", kPIOEndpointFriends, username]];
     
@@ -116,16 +94,16 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
                                    
 + (NSURLSessionDataTask *)approveFriendRequestFromFriendNamed:(NSString *)username callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%@/approve", kPIOEndpointFriends, username]];
     
@@ -139,16 +117,16 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)denyFriendRequestFromFriendNamed:(NSString *)username callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%@/deny", kPIOEndpointFriends, username]];
     
@@ -162,16 +140,16 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)unfriendFriendRequestFromFriendNamed:(NSString *)username callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%@/unfriend", kPIOEndpointFriends, username]];
     
@@ -185,11 +163,11 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
@@ -0,0 +1,104 @@
+//
+//  PIOAPI+Futures.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+#import "PIOAPI.h"
+#import "PIOFuture.h"
+
+@class PIOFile, PIOSubtitle, PIOMP4Conversion, PIOTransfer, PIOAccount;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Versions of the most common requests that return a `PIOFuture` instead of taking a callback. The requests are sent straight away, so independent requests can be started together and joined with `+[PIOFuture all:]`:
+ 
+    [[PIOFuture all:@[[PIOAPI futureForFileWithID:fileID], [PIOAPI futureForSubtitlesOfFileWithID:fileID], [PIOAPI futureForMP4ConversionStatusOfFileWithID:fileID]]] getValueWithCompletionHandler:^(NSArray *values, NSError *error) { ... }];
+ 
+ Any other request can be wrapped with `-[PIOFuture initWithTaskBlock:]`.
+ */
+@interface PIOAPI (Futures)
+
+/**
+ Returns a file's properties, like `getFileForID:callback:`.
+ 
+ @param fileIdentifier  The identifier of the file whose properties are to be returned.
+ 
+ @return    A future for the `PIOFile` object.
+ */
++ (PIOFuture<PIOFile *> *)futureForFileWithID:(NSInteger)fileIdentifier NS_SWIFT_NAME(file(for:));
+
+/**
+ Lists all the files in a specified folder, like `listFilesInFolderWithID:callback:`.
+ 
+ @param folderIdentifier    The ID of the folder whose contents is to be listed. The root directory has an identifier of @b 0.
+ 
+ @return    A future for the folder's contents, as an array of `PIOFile` objects.
+ */
++ (PIOFuture<NSArray<PIOFile *> *> *)futureForFilesInFolderWithID:(NSInteger)folderIdentifier NS_SWIFT_NAME(files(in:));
+
+/**
+ Lists available subtitles for a file, like `listSubtitlesForFileWithID:callback:`.
+ 
+ @param fileIdentifier  The identifier of the file for which subtitles are to be fetched.
+ 
+ @return    A future for an array of `PIOSubtitle` objects.
+ */
++ (PIOFuture<NSArray<PIOSubtitle *> *> *)futureForSubtitlesOfFileWithID:(NSInteger)fileIdentifier NS_SWIFT_NAME(subtitles(for:));
+
+/**
+ Returns the status of the MP4 conversion of a file, like `getMP4ConversionStatusForFileWithID:callback:`.
+ 
+ @param fileIdentifier  The identifier of the file being converted.
+ 
+ @return    A future for the `PIOMP4Conversion` object.
+ */
++ (PIOFuture<PIOMP4Conversion *> *)futureForMP4ConversionStatusOfFileWithID:(NSInteger)fileIdentifier NS_SWIFT_NAME(mp4ConversionStatus(for:));
+
+/**
+ Returns a transfer's properties, like `getTransferForID:callback:`.
+ 
+ @param transferIdentifier  The identifier of the transfer whose properties are to be returned.
+ 
+ @return    A future for the `PIOTransfer` object.
+ */
++ (PIOFuture<PIOTransfer *> *)futureForTransferWithID:(NSInteger)transferIdentifier NS_SWIFT_NAME(transfer(for:));
+
+/**
+ Lists the active transfers, like `listActiveTransfersWithCallback:`.
+ 
+ @return    A future for an array of `PIOTransfer` objects.
+ */
++ (PIOFuture<NSArray<PIOTransfer *> *> *)futureForActiveTransfers NS_SWIFT_NAME(activeTransfers());
+
+/**
+ Returns information about the user's account, like `getAccountInformationWithCallback:`.
+ 
+ @return    A future for the `PIOAccount` object.
+ */
++ (PIOFuture<PIOAccount *> *)futureForAccountInformation NS_SWIFT_NAME(accountInformation());
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,89 @@
+//
+//  PIOAPI+Futures.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIOAPI+Futures.h"
+#import "PIOAPI+Files.h"
+#import "PIOAPI+Transfers.h"
+#import "PIOAPI+Account.h"
+
+@implementation PIOAPI (Futures)
+
++ (PIOFuture<PIOFile *> *)futureForFileWithID:(NSInteger)fileIdentifier {
+    return [[PIOFuture alloc] initWithTaskBlock:^NSURLSessionTask *(void (^resolve)(id, NSError *)) {
+        return [self getFileForID:fileIdentifier callback:^(NSError * _Nullable error, PIOFile * _Nullable file) {
+            resolve(file, error);
+        }];
+    }];
+}
+
++ (PIOFuture<NSArray<PIOFile *> *> *)futureForFilesInFolderWithID:(NSInteger)folderIdentifier {
+    return [[PIOFuture alloc] initWithTaskBlock:^NSURLSessionTask *(void (^resolve)(id, NSError *)) {
+        return [self listFilesInFolderWithID:folderIdentifier callback:^(NSError * _Nullable error, NSArray<PIOFile *> * _Nonnull files, PIOFile * _Nullable folder) {
+            resolve(files, error);
+        }];
+    }];
+}
+
++ (PIOFuture<NSArray<PIOSubtitle *> *> *)futureForSubtitlesOfFileWithID:(NSInteger)fileIdentifier {
+    return [[PIOFuture alloc] initWithTaskBlock:^NSURLSessionTask *(void (^resolve)(id, NSError *)) {
+        return [self listSubtitlesForFileWithID:fileIdentifier callback:^(NSError * _Nullable error, NSArray<PIOSubtitle *> * _Nonnull subtitles) {
+            resolve(subtitles, error);
+        }];
+    }];
+}
+
++ (PIOFuture<PIOMP4Conversion *> *)futureForMP4ConversionStatusOfFileWithID:(NSInteger)fileIdentifier {
+    return [[PIOFuture alloc] initWithTaskBlock:^NSURLSessionTask *(void (^resolve)(id, NSError *)) {
+        return [self getMP4ConversionStatusForFileWithID:fileIdentifier callback:^(NSError * _Nullable error, PIOMP4Conversion * _Nullable conversion) {
+            resolve(conversion, error);
+        }];
+    }];
+}
+
++ (PIOFuture<PIOTransfer *> *)futureForTransferWithID:(NSInteger)transferIdentifier {
+    return [[PIOFuture alloc] initWithTaskBlock:^NSURLSessionTask *(void (^resolve)(id, NSError *)) {
+        return [self getTransferForID:transferIdentifier callback:^(NSError * _Nullable error, PIOTransfer * _Nullable transfer) {
+            resolve(transfer, error);
+        }];
+    }];
+}
+
++ (PIOFuture<NSArray<PIOTransfer *> *> *)futureForActiveTransfers {
+    return [[PIOFuture alloc] initWithTaskBlock:^NSURLSessionTask *(void (^resolve)(id, NSError *)) {
+        return [self listActiveTransfersWithCallback:^(NSError * _Nullable error, NSArray<PIOTransfer *> * _Nonnull transfers) {
+            resolve(transfers, error);
+        }];
+    }];
+}
+
++ (PIOFuture<PIOAccount *> *)futureForAccountInformation {
+    return [[PIOFuture alloc] initWithTaskBlock:^NSURLSessionTask *(void (^resolve)(id, NSError *)) {
+        return [self getAccountInformationWithCallback:^(NSError * _Nullable error, PIOAccount * _Nullable account) {
+            resolve(account, error);
+        }];
+    }];
+}
+
+@end
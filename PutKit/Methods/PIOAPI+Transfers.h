@@ -42,6 +42,17 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (NSURLSessionDataTask *)listActiveTransfersWithCallback:(void (^)(NSError * _Nullable, NSArray<PIOTransfer *> *))callback NS_SWIFT_NAME(activeTransfers(callback:));
 
+/**
+ Lists active transfers like `listActiveTransfersWithCallback:`, but hands the transfers over while the list is still downloading, so that a long list is never held in memory as a whole.
+ 
+ @param transfersCallback   The block that is called on the callback queue, any number of times, with the transfers that have arrived since it was last called, in order.
+ @param completion          The block that is called once the whole list has arrived and been handed over. If the request fails, the underlying error will be returned.
+ 
+ @return    The request's `NSURLSessionDataTask` to be resumed.
+ */
++ (NSURLSessionDataTask *)streamActiveTransfersWithTransfersCallback:(void (^)(NSArray<PIOTransfer *> *transfers))transfersCallback
+                                                          completion:(PIOErrorOnlyCallback _Nullable)completion NS_SWIFT_NAME(streamActiveTransfers(transfers:completion:));
+
 /**
  Starts a new transfer.
  
@@ -60,21 +71,19 @@ NS_ASSUME_NONNULL_BEGIN
                                     callback:(void (^)(NSError * _Nullable, PIOTransfer * _Nullable))callback NS_SWIFT_NAME(addTransfer(url:saveFolder:callbackURL:callback:));
 
 /**
- Recursively returns a transfer’s properties until the transfer has completed.
- 
- @note  Due to `NSTimer` APIs, this method is only available on systems greater than: iOS 10.0, tvOS 10.0, watchOS 3.0 and macOS 10.12. For earlier versions please use: `getTransferForID:callback`;
+ Recursively returns a transfer’s properties until the transfer has finished. The transfer is watched by the shared `PIOTransferMonitor`, so any number of transfers can be followed at once for the cost of one request per poll. Every block is called on the callback queue in effect when this is called, including the ones the monitor calls later on.
  
  @param transferIdentifier  The identifier of the transfer whose properties are to be returned.
  @param errorCallback       The block that is called when there is an error fetching the transfer with the specified id. If there is an error in this callback, none of the other blocks will be called. Note: If there is an error later on in the transfer, it will be returned in the `progressCallback`  or the `completionCallback`.
- @param progressCallback    The block that is called every second to give updates on the transfer progress. If the progress fails to be fetched, the underlying error will be returned, otherwise a `PIOTransfer` object will be returned describing the progress.
- @param completionCallback  The block that is called at most once when the transfer completes. The status of the transfer will be included in the `PIOTransfer` object. If the transfer fails, the `error` parameter of the `PIOTransfer` object will be set.
+ @param progressCallback    The block that is called each time the transfer monitor polls, which is at most every `minimumPollInterval` seconds, to give updates on the transfer progress. If the progress fails to be fetched, the underlying error will be returned, otherwise a `PIOTransfer` object will be returned describing the progress.
+ @param completionCallback  The block that is called at most once when the transfer completes, starts seeding, fails or is cancelled. The status of the transfer will be included in the `PIOTransfer` object. If the transfer fails, the `error` parameter of the `PIOTransfer` object will be set.
  
  @return    The request's `NSURLSessionDataTask` to be resumed.
  */
 + (NSURLSessionDataTask *)getTransferForID:(NSInteger)transferIdentifier
                              errorCallback:(PIOErrorOnlyCallback)errorCallback
                           progressCallback:(void (^ _Nullable)(NSError * _Nullable, PIOTransfer * _Nullable))progressCallback
-                        completionCallback:(void (^ _Nullable)(PIOTransfer *))completionCallback NS_SWIFT_NAME(transfer(for:error:progress:completion:)) API_AVAILABLE(macosx(10.12), ios(10.0), watchos(3.0), tvos(10.0));
+                        completionCallback:(void (^ _Nullable)(PIOTransfer *))completionCallback NS_SWIFT_NAME(transfer(for:error:progress:completion:));
 
 /**
  Returns a transfer’s properties.
@@ -25,16 +25,20 @@
 
 #import "PIOAPI+Transfers.h"
 #import "PIOError.h"
+#import "PIOSession.h"
+#import "PIOModelStream.h"
 #import "PIOEndpoints.h"
-#import "PIOObjectProtocol.h"
+#import "PIOModelDecoder.h"
 #import "PIOTransfer.h"
+#import "PIOTransferMonitor.h"
 #import "PIOAuth.h"
 #import "AFOAuthCredential.h"
+#import "PIOCallbackQueue.h"
 
 @implementation PIOAPI (Transfers)
 
 + (NSURLSessionDataTask *)listActiveTransfersWithCallback:(void (^)(NSError * _Nullable, NSArray<PIOTransfer *> * _Nonnull))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointListTransfers];
     
@@ -45,33 +49,35 @@
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSArray<PIOTransfer *> *transfers = pk_models_from_dictionaries(PIOTransfer.class, [responseDictionary objectForKey:@"transfers"]);
         
-        NSMutableArray *transfers = [NSMutableArray array];
-        
-        for (NSDictionary *transferDictionary in [responseDictionary objectForKey:@"transfers"]) {
-            id transfer = [PIOTransfer alloc];
-            
-            if ([transfer conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-                transfer = [transfer initFromDictionary:transferDictionary];
-                
-                transfer == nil ?: [transfers addObject:transfer];
-            }
-        }
-        
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, transfers);
-        }];
+        });
+    }];
+}
+
++ (NSURLSessionDataTask *)streamActiveTransfersWithTransfersCallback:(void (^)(NSArray<PIOTransfer *> * _Nonnull))transfersCallback
+                                                          completion:(PIOErrorOnlyCallback)completion {
+    NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointListTransfers];
+    
+    components.queryItems = @[[NSURLQueryItem queryItemWithName:@"oauth_token"
+                                                          value:[PIOAuth sharedInstance].credential.accessToken]];
+    
+    PIOModelStream *stream = [[PIOModelStream alloc] initWithModelClass:PIOTransfer.class arrayKey:@"transfers" modelsCallback:transfersCallback completion:^(NSError * _Nullable error, NSDictionary * _Nullable responseDictionary) {
+        completion == nil ?: completion(error);
     }];
+    
+    return [[PIOSession sharedInstance] dataTaskWithRequest:[NSURLRequest requestWithURL:components.URL] delegate:stream];
 }
 
 + (NSURLSessionDataTask *)addTransferWithURL:(NSURL *)URL
                         saveFolderIdentifier:(NSInteger)parentIdentifier
                                  callbackURL:(NSURL *)callbackURL
                                     callback:(void (^)(NSError * _Nullable, PIOTransfer * _Nullable))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointAddTransfer];
     
@@ -92,20 +98,12 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
-                
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
                 
-        id transfer = [PIOTransfer alloc];
-                
-        if ([transfer conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-            transfer = [transfer initFromDictionary:responseDictionary[@"transfer"]];
-        } else {
-            transfer = nil;
-        }
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        PIOTransfer *transfer = pk_model_from_dictionary(PIOTransfer.class, responseDictionary[@"transfer"]);
+        pk_dispatch_callback(^{
             callback(error, transfer);
-        }];
+        });
     }];
 }
 
@@ -120,23 +118,19 @@
             return;
         }
         
-        [NSTimer scheduledTimerWithTimeInterval:1 repeats:YES block:^(NSTimer * _Nonnull timer) {
-            [[PIOAPI getTransferForID:((PIOTransfer *)transfer).identifier
-                             callback:^(NSError *error, PIOTransfer *transfer)
-              {
-                  if ([transfer.status isEqualToString:PIOTransferStatusCompleted]) {
-                      [timer invalidate];
-                      if (completionCallback != nil) completionCallback(transfer);
-                  } else {
-                      if (progressCallback != nil) progressCallback(error, transfer);
-                  }
-              }] resume];
-        }];
+        if (transfer.isFinished) {
+            if (completionCallback != nil) completionCallback(transfer);
+            return;
+        }
+        
+        [[PIOTransferMonitor sharedInstance] monitorTransferWithID:transfer.identifier
+                                                  progressCallback:progressCallback
+                                                completionCallback:completionCallback];
     }];
 }
 
 + (NSURLSessionDataTask *)getTransferForID:(NSInteger)transferIdentifier callback:(void (^)(NSError * _Nullable, PIOTransfer * _Nullable))callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd", kPIOEndpointTransfers, transferIdentifier]];
     
@@ -147,27 +141,19 @@
                                                                        NSURLResponse * _Nullable response,
                                                                        NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
-        
-        NSDictionary *responseDictionary = data ? error ? nil : [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
         
-        id transfer = [PIOTransfer alloc];
-        
-        if ([transfer conformsToProtocol:@protocol(PIOObjectProtocol)]) {
-            transfer = [transfer initFromDictionary:responseDictionary[@"transfer"]];
-        } else {
-            transfer = nil;
-        }
+        PIOTransfer *transfer = pk_model_from_dictionary(PIOTransfer.class, responseDictionary[@"transfer"]);
         
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             callback(error, transfer);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)retryTransferWithIdentifier:(NSInteger)transferIdentifier callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointRetryTransfer];
     
@@ -185,16 +171,16 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)cancelTransfersWithIdentifiers:(NSArray<NSNumber *> *)transferIdentifiers callback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointCancelTransfer];
     
@@ -212,16 +198,16 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
 + (NSURLSessionDataTask *)cleanCompletedTransfersWithCallback:(PIOErrorOnlyCallback)callback {
-    NSURLSession *session = [NSURLSession sharedSession];
+    PIOSession *session = [PIOSession sharedInstance];
     
     NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointCleanTransfers];
     
@@ -235,11 +221,11 @@
                                                                     NSURLResponse * _Nullable response,
                                                                     NSError * _Nullable error)
     {
-        pk_response_validate(data, &error);
+        pk_response_decode(data, response, &error);
         
-        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+        pk_dispatch_callback(^{
             if (callback != nil) callback(error);
-        }];
+        });
     }];
 }
 
@@ -25,10 +25,29 @@
 
 #import <Foundation/NSObject.h>
 
+@class PIOConfiguration, NSOperationQueue;
+
+NS_ASSUME_NONNULL_BEGIN
+
 /**
  This class provides helper methods for interacting with the @b Put.io api.
  */
 NS_SWIFT_NAME(PutKit)
 @interface PIOAPI : NSObject
 
+/**
+ The configuration of the sessions through which every request is sent. The configuration is copied when set. Tasks already in flight finish on the sessions they were created on; only tasks created afterwards use the new configuration.
+ */
+@property (class, copy, nonatomic) PIOConfiguration *configuration;
+
+/**
+ Performs a block, calling back on the specified queue from every request that is started inside it, instead of on the `callbackQueue` of the configuration. Requests started by those callbacks, such as the later pages of a listing, call back on the same queue.
+ 
+ @param callbackQueue   The queue to call back on. If `nil`, callbacks are called straight from the session's delegate queue.
+ @param block           The block that starts the requests. It is performed synchronously, on the calling thread.
+ */
++ (void)performWithCallbackQueue:(NSOperationQueue * _Nullable)callbackQueue block:(NS_NOESCAPE void (^)(void))block NS_SWIFT_NAME(perform(callbackQueue:_:));
+
 @end
+
+NS_ASSUME_NONNULL_END
@@ -24,6 +24,21 @@
 //
 
 #import "PIOAPI.h"
+#import "PIOSession.h"
+#import "PIOCallbackQueue.h"
 
 @implementation PIOAPI
+
++ (PIOConfiguration *)configuration {
+    return [PIOSession sharedInstance].configuration;
+}
+
++ (void)setConfiguration:(PIOConfiguration *)configuration {
+    [PIOSession sharedInstance].configuration = configuration;
+}
+
++ (void)performWithCallbackQueue:(NSOperationQueue *)callbackQueue block:(void (^)(void))block {
+    pk_perform_with_callback_queue(callbackQueue, block);
+}
+
 @end
@@ -0,0 +1,107 @@
+//
+//  PIOBulkOperation.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+#import "PIOErrorOnlyCallback.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Runs an operation on any number of files by splitting their identifiers into batches and sending several batches at once.
+ 
+ A batch that fails with a network or server error is sent again, waiting longer each time, up to `maximumRetryCount` times. A batch that is turned down because one of its identifiers doesn't exist or can't be operated on (404 or 422) is split in half and each half is sent again, so that the identifiers that caused it are narrowed down to themselves and every other identifier still goes through. If the server says a batch was too large (413 or 414), it is split in the same way and every batch after it is kept to half that size. Any other error from the server, such as an expired token, is true of every batch, so the whole operation fails with it straight away.
+ 
+ Once every identifier has either gone through or failed, the completion block is called with which ones did and the error each of the others failed with, so that the failed ones can be tried again later.
+ */
+NS_SWIFT_NAME(BulkOperation)
+@interface PIOBulkOperation : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ Creates an operation that sends a request for every batch of identifiers.
+ 
+ @param identifiers     The identifiers to be operated on. Duplicates are only sent once.
+ @param requestBlock    The block that creates the request for a batch of identifiers. The request must call the callback passed in when it completes.
+ */
+- (instancetype)initWithIdentifiers:(NSArray<NSNumber *> *)identifiers
+                       requestBlock:(NSURLSessionDataTask *(^)(NSArray<NSNumber *> *, PIOErrorOnlyCallback))requestBlock NS_DESIGNATED_INITIALIZER NS_SWIFT_NAME(init(ids:request:));
+
+/**
+ Creates an operation that deletes the given files.
+ 
+ @param fileIdentifiers The identifiers of the files to be deleted.
+ */
++ (PIOBulkOperation *)deleteFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers NS_SWIFT_NAME(delete(files:));
+
+/**
+ Creates an operation that moves the given files to a folder.
+ 
+ @param fileIdentifiers         The identifiers of the files to be moved.
+ @param destinationIdentifier   The identifier of the folder to which the files should be moved.
+ */
++ (PIOBulkOperation *)moveFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers
+                        toFolderWithID:(NSInteger)destinationIdentifier NS_SWIFT_NAME(move(files:to:));
+
+/**
+ Creates an operation that shares the given files with specified friends.
+ 
+ @param fileIdentifiers The identifiers of the files to be shared.
+ @param friends         The names of the friends with whom to share the files.
+ */
++ (PIOBulkOperation *)shareFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers
+                       withFriendsNamed:(NSArray<NSString *> *)friends NS_SWIFT_NAME(share(files:with:));
+
+/** Every identifier the operation was created with. */
+@property (strong, nonatomic, readonly) NSArray<NSNumber *> *identifiers NS_SWIFT_NAME(ids);
+
+/** The most identifiers sent in one request. Defaults to @b 200. */
+@property (nonatomic) NSUInteger batchSize;
+
+/** The most requests running at the same time. Defaults to @b 4. */
+@property (nonatomic) NSUInteger maximumConcurrentBatches;
+
+/** The number of times a batch is sent again after a network failure or server error before its identifiers are given up on. Defaults to @b 3. */
+@property (nonatomic) NSUInteger maximumRetryCount;
+
+/** A block called on the callback queue whenever a batch finishes, with the number of identifiers that have either gone through or failed so far and the number of identifiers altogether. */
+@property (copy, nonatomic, nullable) void (^progressCallback)(NSUInteger, NSUInteger);
+
+/**
+ Starts the operation. An operation can only be started once.
+ 
+ @param completion  The block that is called on the callback queue when every identifier has either gone through or failed. The identifiers that went through are passed in, along with the error that each of the others failed with.
+ */
+- (void)startWithCompletion:(void (^ _Nullable)(NSArray<NSNumber *> *, NSDictionary<NSNumber *, NSError *> *))completion NS_SWIFT_NAME(start(completion:));
+
+/**
+ Stops sending batches and cancels the ones that are running. The completion block is called straight away, with every identifier that hadn't gone through failed with `NSURLErrorCancelled`.
+ */
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,274 @@
+//
+//  PIOBulkOperation.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOBulkOperation.h"
+#import "PIOAPI+Files.h"
+#import "PIOError.h"
+#import "PIOCallbackQueue.h"
+#import "PIORateLimiter.h"
+#import "PIOSession.h"
+
+static NSUInteger const kPIOBulkOperationDefaultBatchSize = 200;
+static NSUInteger const kPIOBulkOperationDefaultMaximumConcurrentBatches = 4;
+static NSUInteger const kPIOBulkOperationDefaultMaximumRetryCount = 3;
+static NSTimeInterval const kPIOBulkOperationRetryDelay = 0.5; // Doubled for every retry of the same batch.
+
+/**
+ Identifiers sent together in one request. Only touched on the operation's queue.
+ */
+@interface PIOBulkOperationBatch : NSObject
+
+@property (strong, nonatomic) NSArray<NSNumber *> *identifiers;
+@property (nonatomic) NSUInteger attempt;
+@property (strong, nonatomic, nullable) NSURLSessionDataTask *task;
+
+@end
+
+@implementation PIOBulkOperationBatch
+
+@end
+
+@implementation PIOBulkOperation {
+    NSURLSessionDataTask *(^_requestBlock)(NSArray<NSNumber *> *, PIOErrorOnlyCallback);
+    void (^_completion)(NSArray<NSNumber *> *, NSDictionary<NSNumber *, NSError *> *);
+    NSOperationQueue *_queue; // Serial, and where the requests call back.
+    
+    // Only touched on `_queue`.
+    NSOperationQueue *_callbackQueue; // The callback queue the operation was started with.
+    NSUInteger _nextIndex; // The index of the first identifier that hasn't been put into a batch yet.
+    NSUInteger _currentBatchSize; // `batchSize`, unless the server has said that was too large.
+    NSMutableArray<PIOBulkOperationBatch *> *_queuedBatches; // Batches to be sent again, ahead of new ones.
+    NSMutableArray<PIOBulkOperationBatch *> *_runningBatches;
+    NSUInteger _waitingBatchCount; // Batches waiting to be retried.
+    NSMutableArray<NSNumber *> *_succeeded;
+    NSMutableDictionary<NSNumber *, NSError *> *_failed;
+    BOOL _started;
+    BOOL _finished;
+}
+
+- (instancetype)initWithIdentifiers:(NSArray<NSNumber *> *)identifiers
+                       requestBlock:(NSURLSessionDataTask * _Nonnull (^)(NSArray<NSNumber *> * _Nonnull, PIOErrorOnlyCallback _Nonnull))requestBlock {
+    self = [super init];
+    
+    if (self) {
+        _identifiers = [[NSOrderedSet orderedSetWithArray:identifiers] array];
+        _requestBlock = [requestBlock copy];
+        _batchSize = kPIOBulkOperationDefaultBatchSize;
+        _maximumConcurrentBatches = kPIOBulkOperationDefaultMaximumConcurrentBatches;
+        _maximumRetryCount = kPIOBulkOperationDefaultMaximumRetryCount;
+        _queuedBatches = [NSMutableArray array];
+        _runningBatches = [NSMutableArray array];
+        _succeeded = [NSMutableArray arrayWithCapacity:_identifiers.count];
+        _failed = [NSMutableDictionary dictionary];
+        _queue = [NSOperationQueue new];
+        _queue.name = @"io.put.kit.bulk-operation";
+        _queue.maxConcurrentOperationCount = 1;
+    }
+    
+    return self;
+}
+
++ (PIOBulkOperation *)deleteFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers {
+    return [[PIOBulkOperation alloc] initWithIdentifiers:fileIdentifiers requestBlock:^NSURLSessionDataTask *(NSArray<NSNumber *> *batch, PIOErrorOnlyCallback callback) {
+        return [PIOAPI deleteFilesWithIDs:batch callback:callback];
+    }];
+}
+
++ (PIOBulkOperation *)moveFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers toFolderWithID:(NSInteger)destinationIdentifier {
+    return [[PIOBulkOperation alloc] initWithIdentifiers:fileIdentifiers requestBlock:^NSURLSessionDataTask *(NSArray<NSNumber *> *batch, PIOErrorOnlyCallback callback) {
+        return [PIOAPI moveFilesWithIDs:batch toFolderWithID:destinationIdentifier callback:callback];
+    }];
+}
+
++ (PIOBulkOperation *)shareFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers withFriendsNamed:(NSArray<NSString *> *)friends {
+    return [[PIOBulkOperation alloc] initWithIdentifiers:fileIdentifiers requestBlock:^NSURLSessionDataTask *(NSArray<NSNumber *> *batch, PIOErrorOnlyCallback callback) {
+        return [PIOAPI shareFilesWithIDs:batch withFriendsNamed:friends callback:callback];
+    }];
+}
+
+- (void)startWithCompletion:(void (^)(NSArray<NSNumber *> * _Nonnull, NSDictionary<NSNumber *, NSError *> * _Nonnull))completion {
+    NSOperationQueue *callbackQueue = pk_callback_queue();
+    
+    [_queue addOperationWithBlock:^{
+        NSAssert(!self->_started, @"An operation can only be started once.");
+        
+        self->_started = YES;
+        self->_completion = [completion copy];
+        self->_callbackQueue = callbackQueue;
+        self->_currentBatchSize = MAX(self.batchSize, 1);
+        
+        [self sendBatches];
+    }];
+}
+
+- (void)cancel {
+    [_queue addOperationWithBlock:^{
+        if (!self->_started || self->_finished) return;
+        
+        [self failWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+    }];
+}
+
+#pragma mark - Batches
+
+- (void)sendBatches {
+    while (!_finished && _runningBatches.count < MAX(self.maximumConcurrentBatches, 1)) {
+        PIOBulkOperationBatch *batch = _queuedBatches.firstObject;
+        
+        if (batch != nil) {
+            [_queuedBatches removeObjectAtIndex:0];
+        } else if (_nextIndex < self.identifiers.count) {
+            NSUInteger length = MIN(_currentBatchSize, self.identifiers.count - _nextIndex);
+            
+            batch = [PIOBulkOperationBatch new];
+            batch.identifiers = [self.identifiers subarrayWithRange:NSMakeRange(_nextIndex, length)];
+            _nextIndex += length;
+        } else {
+            break;
+        }
+        
+        [self sendBatch:batch];
+    }
+    
+    if (!_finished && _runningBatches.count == 0 && _waitingBatchCount == 0 && _queuedBatches.count == 0 && _nextIndex == self.identifiers.count) [self finish];
+}
+
+- (void)sendBatch:(PIOBulkOperationBatch *)batch {
+    [_runningBatches addObject:batch];
+    
+    // Everything is kept on the operation's queue, whatever queue the configuration calls back on, and the requests queue for the rate limiter apart from everyone else's. Failed batches are retried by `handleError:forBatch:` rather than by the session as well.
+    [PIORateLimiter performAsCaller:@"PIOBulkOperation" block:^{
+        [PIOSession performWithoutRetries:^{
+            pk_perform_with_callback_queue(self->_queue, ^{
+                batch.task = self->_requestBlock(batch.identifiers, ^(NSError * _Nullable error) {
+                    batch.task = nil;
+                    
+                    if (self->_finished) return;
+                    
+                    [self->_runningBatches removeObjectIdenticalTo:batch];
+                    
+                    if (error == nil) {
+                        [self->_succeeded addObjectsFromArray:batch.identifiers];
+                        [self reportProgress];
+                    } else {
+                        [self handleError:error forBatch:batch];
+                    }
+                    
+                    [self sendBatches];
+                });
+            });
+        }];
+    }];
+    
+    [batch.task resume];
+}
+
+- (void)handleError:(NSError *)error forBatch:(PIOBulkOperationBatch *)batch {
+    BOOL serverError = [error.domain isEqualToString:kPIOErrorDomain];
+    BOOL tooLarge = serverError && (error.code == 413 || error.code == 414);
+    BOOL turnedDown = serverError && (error.code == 404 || error.code == 422); // One of the identifiers doesn't exist or can't be operated on.
+    
+    if (pk_error_is_transient(error) && batch.attempt < self.maximumRetryCount) {
+        NSTimeInterval delay = kPIOBulkOperationRetryDelay * (1 << batch.attempt);
+        
+        batch.attempt++;
+        _waitingBatchCount++;
+        
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            [self->_queue addOperationWithBlock:^{
+                self->_waitingBatchCount--;
+                
+                if (self->_finished) return;
+                
+                [self->_queuedBatches insertObject:batch atIndex:0];
+                [self sendBatches];
+            }];
+        });
+    } else if ((tooLarge || turnedDown) && batch.identifiers.count > 1) {
+        // Something in the batch was turned down; halving it narrows that down without holding up the rest.
+        NSUInteger half = batch.identifiers.count / 2;
+        PIOBulkOperationBatch *first = [PIOBulkOperationBatch new];
+        PIOBulkOperationBatch *second = [PIOBulkOperationBatch new];
+        
+        first.identifiers = [batch.identifiers subarrayWithRange:NSMakeRange(0, half)];
+        second.identifiers = [batch.identifiers subarrayWithRange:NSMakeRange(half, batch.identifiers.count - half)];
+        
+        if (tooLarge) _currentBatchSize = MIN(_currentBatchSize, MAX(half, 1));
+        
+        [_queuedBatches insertObjects:@[first, second] atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, 2)]];
+    } else if (serverError && !tooLarge && !turnedDown && !pk_error_is_transient(error)) {
+        // Anything else the server turns down, e.g. an expired token (401), a forbidden account (403) or an error with no status at all, would turn down every other batch too.
+        [self failWithError:error];
+    } else {
+        for (NSNumber *identifier in batch.identifiers) [_failed setObject:error forKey:identifier];
+        
+        [self reportProgress];
+    }
+}
+
+- (void)reportProgress {
+    void (^progressCallback)(NSUInteger, NSUInteger) = self.progressCallback;
+    NSUInteger completed = _succeeded.count + _failed.count;
+    NSUInteger total = self.identifiers.count;
+    
+    if (progressCallback == nil) return;
+    
+    pk_dispatch_callback_on(_callbackQueue, ^{
+        progressCallback(completed, total);
+    });
+}
+
+- (void)failWithError:(NSError *)error {
+    NSSet<NSNumber *> *succeeded = [NSSet setWithArray:_succeeded];
+    
+    for (PIOBulkOperationBatch *batch in _runningBatches) [batch.task cancel];
+    
+    for (NSNumber *identifier in self.identifiers) {
+        if (![succeeded containsObject:identifier] && [_failed objectForKey:identifier] == nil) [_failed setObject:error forKey:identifier];
+    }
+    
+    [self finish];
+}
+
+- (void)finish {
+    _finished = YES;
+    [_runningBatches removeAllObjects];
+    [_queuedBatches removeAllObjects];
+    
+    void (^completion)(NSArray<NSNumber *> *, NSDictionary<NSNumber *, NSError *> *) = _completion;
+    NSArray<NSNumber *> *succeeded = [_succeeded copy];
+    NSDictionary<NSNumber *, NSError *> *failed = [_failed copy];
+    
+    _completion = nil;
+    
+    if (completion == nil) return;
+    
+    pk_dispatch_callback_on(_callbackQueue, ^{
+        completion(succeeded, failed);
+    });
+}
+
+@end
@@ -0,0 +1,86 @@
+//
+//  PIOConfiguration.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+
+@class PIORetryPolicy, PIORateLimiter;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An object describing how PutKit talks to the @b Put.io servers. Every request made through the `PIOAPI` categories and `PIOAuth` is sent through sessions owned by PutKit that are built from this object, rather than through the application's `[NSURLSession sharedSession]`.
+ 
+ Configurations are copied when they are set on `PIOAPI`, so changing an object after it has been set has no effect until it is set again.
+ */
+NS_SWIFT_NAME(Configuration)
+@interface PIOConfiguration : NSObject <NSCopying>
+
+/**
+ A configuration with the default values for every property. This is the configuration used if one is never explicitly set.
+ */
++ (PIOConfiguration *)defaultConfiguration NS_SWIFT_NAME(default());
+
+/** The maximum number of simultaneous connections made to @b api.put.io. Requests over this limit are queued by the session until a connection becomes free. Defaults to the system default. */
+@property (nonatomic) NSInteger maximumConnectionsPerAPIHost NS_SWIFT_NAME(maximumConnectionsPerApiHost);
+
+/** The maximum number of simultaneous connections made to @b upload.put.io. Defaults to @b 2 so that uploads do not saturate the link at the expense of api calls. */
+@property (nonatomic) NSInteger maximumConnectionsPerUploadHost;
+
+/** The time (in seconds) a request waits for additional data to arrive before timing out. Defaults to @b 60. */
+@property (nonatomic) NSTimeInterval timeoutIntervalForRequest;
+
+/** The maximum time (in seconds) a request is allowed to take, including retries by the system. Defaults to @b 7 days. */
+@property (nonatomic) NSTimeInterval timeoutIntervalForResource;
+
+/** The cache policy used for every request. Defaults to `NSURLRequestUseProtocolCachePolicy`. */
+@property (nonatomic) NSURLRequestCachePolicy requestCachePolicy;
+
+/** The URL cache used to store responses. If `nil`, responses are not cached. Defaults to a cache private to PutKit, which every configuration shares. */
+@property (strong, nonatomic, nullable) NSURLCache *URLCache NS_SWIFT_NAME(urlCache);
+
+/** A boolean value indicating whether HTTP pipelining should be used. Defaults to `NO`. */
+@property (nonatomic) BOOL HTTPShouldUsePipelining NS_SWIFT_NAME(httpShouldUsePipelining);
+
+/** Custom `NSURLProtocol` subclasses that are given the first chance to handle every request, ahead of the system's own protocols. Useful for pointing PutKit at a local stand-in server in tests. Defaults to `nil`. */
+@property (copy, nonatomic, nullable) NSArray<Class> *protocolClasses;
+
+/** The queue on which all session delegate calls and completion handlers are performed, before results are handed back to the caller. This should be a serial queue. If `nil`, a serial queue private to PutKit is used. */
+@property (strong, nonatomic, nullable) NSOperationQueue *delegateQueue;
+
+/** The queue on which completion handlers and other callbacks are called. Defaults to the main queue. If `nil`, callbacks are called straight from the delegate queue, without hopping to another queue, which suits callers that only pass the results on to a queue of their own. This should be a serial queue, so that callbacks that are called more than once are called in order. A single call can be given a different queue with `+[PIOAPI performWithCallbackQueue:block:]`. */
+@property (strong, nonatomic, nullable) NSOperationQueue *callbackQueue;
+
+/** How requests that fail for a reason that may go away on its own, such as a dropped connection or a @b 503, are sent again. If `nil`, requests are never retried by the session. Defaults to `[PIORetryPolicy defaultPolicy]`. */
+@property (copy, nonatomic, nullable) PIORetryPolicy *retryPolicy;
+
+/** The token bucket every request to @b api.put.io, retries included, has to wait its turn in. Unlike the other properties, the limiter is shared rather than copied, so that it keeps limiting across configuration changes. If `nil`, requests are sent as soon as they are resumed. Defaults to `nil`. */
+@property (strong, nonatomic, nullable) PIORateLimiter *rateLimiter;
+
+/** A boolean value indicating whether a GET that is identical to one already in flight, down to its URL, access token and headers, waits for that request's response instead of being sent again. Every caller still gets their own task and their own callback, and cancelling one task doesn't affect the others. Defaults to `YES`. */
+@property (nonatomic) BOOL sharesIdenticalRequests;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,92 @@
+//
+//  PIOConfiguration.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIOConfiguration.h"
+#import "PIORetryPolicy.h"
+
+/**
+ The cache every configuration starts with. Caches that share a disk path would fight over its files, so there is only ever one.
+ */
+static NSURLCache *pk_default_URL_cache(void) {
+    static NSURLCache *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[NSURLCache alloc] initWithMemoryCapacity:4 * 1024 * 1024 diskCapacity:20 * 1024 * 1024 diskPath:@"io.put.kit.cache"];
+    });
+    return cache;
+}
+
+@implementation PIOConfiguration
+
++ (PIOConfiguration *)defaultConfiguration {
+    return [PIOConfiguration new];
+}
+
+- (instancetype)init {
+    self = [super init];
+    
+    if (self) {
+        NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+        
+        _maximumConnectionsPerAPIHost = configuration.HTTPMaximumConnectionsPerHost;
+        _maximumConnectionsPerUploadHost = 2;
+        _timeoutIntervalForRequest = configuration.timeoutIntervalForRequest;
+        _timeoutIntervalForResource = configuration.timeoutIntervalForResource;
+        _requestCachePolicy = NSURLRequestUseProtocolCachePolicy;
+        _URLCache = pk_default_URL_cache();
+        _HTTPShouldUsePipelining = NO;
+        _callbackQueue = [NSOperationQueue mainQueue];
+        _retryPolicy = [PIORetryPolicy defaultPolicy];
+        _sharesIdenticalRequests = YES;
+    }
+    
+    return self;
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    PIOConfiguration *configuration = [[self.class allocWithZone:zone] init];
+    
+    configuration.maximumConnectionsPerAPIHost = self.maximumConnectionsPerAPIHost;
+    configuration.maximumConnectionsPerUploadHost = self.maximumConnectionsPerUploadHost;
+    configuration.timeoutIntervalForRequest = self.timeoutIntervalForRequest;
+    configuration.timeoutIntervalForResource = self.timeoutIntervalForResource;
+    configuration.requestCachePolicy = self.requestCachePolicy;
+    configuration.URLCache = self.URLCache;
+    configuration.HTTPShouldUsePipelining = self.HTTPShouldUsePipelining;
+    configuration.protocolClasses = self.protocolClasses;
+    configuration.delegateQueue = self.delegateQueue;
+    configuration.callbackQueue = self.callbackQueue;
+    configuration.retryPolicy = self.retryPolicy;
+    configuration.rateLimiter = self.rateLimiter;
+    configuration.sharesIdenticalRequests = self.sharesIdenticalRequests;
+    
+    return configuration;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p> maximumConnectionsPerAPIHost = %zd; maximumConnectionsPerUploadHost = %zd; timeoutIntervalForRequest = %lf; timeoutIntervalForResource = %lf; requestCachePolicy = %tu; URLCache = %@; HTTPShouldUsePipelining = %@; protocolClasses = %@; delegateQueue = %@; callbackQueue = %@; retryPolicy = %@; rateLimiter = %@; sharesIdenticalRequests = %@", [self class], self, self.maximumConnectionsPerAPIHost, self.maximumConnectionsPerUploadHost, self.timeoutIntervalForRequest, self.timeoutIntervalForResource, self.requestCachePolicy, self.URLCache, self.HTTPShouldUsePipelining ? @"YES" : @"NO", self.protocolClasses, self.delegateQueue, self.callbackQueue, self.retryPolicy, self.rateLimiter, self.sharesIdenticalRequests ? @"YES" : @"NO"];
+}
+
+@end
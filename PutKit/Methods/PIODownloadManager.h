@@ -0,0 +1,174 @@
+//
+//  PIODownloadManager.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+#import "PIOSubtitleFormat.h"
+
+@class PIOFile;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The state of a `PIODownload`.
+ */
+typedef NS_ENUM(NSInteger, PIODownloadState) {
+    /** The download is not running and will not start until it is resumed. Downloads restored from a previous launch start in this state. */
+    PIODownloadStateSuspended,
+    /** The download has been resumed and is waiting for one of the manager's download slots to become free. */
+    PIODownloadStateWaiting,
+    /** The download is receiving data. */
+    PIODownloadStateRunning,
+    /** The download finished and the file has been moved to its destination. */
+    PIODownloadStateCompleted,
+    /** The download gave up after an error. It can be resumed again. */
+    PIODownloadStateFailed
+} NS_SWIFT_NAME(DownloadState);
+
+/**
+ A single download managed by a `PIODownloadManager`.
+ 
+ Data is written straight to a partial file next to the download's journal. If the download is interrupted, it is resumed with an HTTP `Range` request from the last byte on disk, and the server's `ETag` is sent back with it so that a file that changed in the meantime is downloaded again from the start rather than stitched together.
+ 
+ A download of a file whose size is known can be split into segments, each fetched over its own connection and written at its own offset into a file that is allocated in full before the first byte arrives. If the server ignores the ranges, the download falls back to a single connection.
+ */
+NS_SWIFT_NAME(Download)
+@interface PIODownload : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/** A unique identifier for the download that stays the same across launches. */
+@property (strong, nonatomic, readonly) NSString *identifier;
+
+/** The location the file will be moved to when the download finishes. If `nil` was passed when the download was created, this is `nil` until the server has suggested a file name, after which it points to that file name in the `NSDownloadsDirectory`. */
+@property (strong, nonatomic, readonly, nullable) NSURL *destinationURL NS_SWIFT_NAME(destinationUrl);
+
+/** The state of the download. */
+@property (nonatomic, readonly) PIODownloadState state;
+
+/** The number of bytes on disk. */
+@property (nonatomic, readonly) int64_t receivedBytes;
+
+/** The size of the file (in bytes), or `NSURLSessionTransferSizeUnknown` if the server hasn't said yet. */
+@property (nonatomic, readonly) int64_t expectedBytes;
+
+/** A smoothed estimate of the current download speed. */
+@property (nonatomic, readonly) double bytesPerSecond;
+
+/** The number of connections the download is split across. */
+@property (nonatomic, readonly) NSUInteger segmentCount;
+
+/** A block called on the callback queue, at most a few times a second, as data is received. */
+@property (copy, nonatomic, nullable) void (^progressCallback)(PIODownload *download);
+
+/** A block called on the callback queue when the download finishes or gives up. If it finishes, the url of the downloaded file is passed in; otherwise the underlying error is. */
+@property (copy, nonatomic, nullable) void (^completionCallback)(NSError * _Nullable error, NSURL * _Nullable fileURL);
+
+/**
+ Queues the download to be started as soon as the manager has a free slot. Downloads carry on from the last byte on disk.
+ */
+- (void)resume;
+
+/**
+ Stops the download but keeps what has been downloaded so far, so it can be resumed later, even after a relaunch.
+ */
+- (void)suspend;
+
+/**
+ Stops the download and deletes everything downloaded so far. The download is removed from its manager.
+ */
+- (void)cancel;
+
+@end
+
+/**
+ Downloads files from @b Put.io in a way that survives dropped connections and application restarts, with a limit on how many downloads run at once.
+ */
+NS_SWIFT_NAME(DownloadManager)
+@interface PIODownloadManager : NSObject
+
+/**
+ Shared singleton instance of the `PIODownloadManager` class. Downloads that were started but not finished in a previous launch are restored in the `PIODownloadStateSuspended` state.
+ */
++ (PIODownloadManager *)sharedInstance NS_SWIFT_NAME(shared());
+
+/** The maximum number of downloads that run at the same time. Downloads over the limit wait in the order they were resumed. Defaults to @b 2. */
+@property (nonatomic) NSUInteger maximumConcurrentDownloads;
+
+/** The number of times in a row a download is resumed automatically after a network failure or server error before it gives up. Defaults to @b 5. */
+@property (nonatomic) NSUInteger maximumRetryCount;
+
+/** Every download that has neither finished nor been cancelled. */
+@property (strong, nonatomic, readonly) NSArray<PIODownload *> *downloads;
+
+/**
+ Downloads a given file. The download is resumed immediately.
+ 
+ @param fileIdentifier      The identifier of the file to be downloaded.
+ @param destinationURL      The location the file should be moved to when the download finishes. Anything already at that location is replaced. If `nil`, the file is moved to the `NSDownloadsDirectory`, keeping the name suggested by the server.
+ @param callback            The block that is called when the download finishes or gives up. If the download finishes, the local file `NSURL` will be returned. However, if it fails, the underlying error will be returned.
+ 
+ @return    The download, whose progress can be observed by setting its `progressCallback`.
+ */
+- (PIODownload *)downloadFileWithID:(NSInteger)fileIdentifier
+                              toURL:(NSURL * _Nullable)destinationURL
+                           callback:(void (^ _Nullable)(NSError * _Nullable, NSURL * _Nullable))callback NS_SWIFT_NAME(download(file:to:callback:));
+
+/**
+ Downloads a given file over several connections at once, then checks the result against the file's `cyclicRedundancyCode`. The download is resumed immediately.
+ 
+ A single connection is often far slower than the link can carry, so splitting large files across @b 4 to @b 8 connections can make a big difference. Files whose size is unknown are downloaded over a single connection.
+ 
+ @param file                The file to be downloaded.
+ @param destinationURL      The location the file should be moved to when the download finishes. Anything already at that location is replaced. If `nil`, the file is moved to the `NSDownloadsDirectory`, keeping the name suggested by the server.
+ @param segmentCount        The number of byte ranges to fetch at once.
+ @param callback            The block that is called when the download finishes or gives up. If the download finishes and the checksum matches, the local file `NSURL` will be returned. However, if it fails, the underlying error will be returned.
+ 
+ @return    The download, whose progress can be observed by setting its `progressCallback`.
+ */
+- (PIODownload *)downloadFile:(PIOFile *)file
+                        toURL:(NSURL * _Nullable)destinationURL
+                 segmentCount:(NSUInteger)segmentCount
+                     callback:(void (^ _Nullable)(NSError * _Nullable, NSURL * _Nullable))callback NS_SWIFT_NAME(download(file:to:segments:callback:));
+
+/**
+ Downloads a subtitle with a specified identifier. The download is resumed immediately.
+ 
+ @param subtitleIdentifier  The identifier of the subtitle obtained by calling `listSubtitlesForFileWithID:callback:`. If `nil` is passed in, a subtitle will be automatically selected by @b Put.io.
+ @param format              The format that the returned subtitle should be in.
+ @param fileIdentifier      The identifier of the file for which subtitles are to be fetched.
+ @param destinationURL      The location the subtitle should be moved to when the download finishes. If `nil`, the subtitle is moved to the `NSDownloadsDirectory`, keeping the name suggested by the server.
+ @param callback            The block that is called when the download finishes or gives up. If the download finishes, the local file `NSURL` will be returned. However, if it fails, the underlying error will be returned.
+ 
+ @return    The download, whose progress can be observed by setting its `progressCallback`.
+ */
+- (PIODownload *)downloadSubtitleWithID:(NSString * _Nullable)subtitleIdentifier
+                             withFormat:(PIOSubtitleFormat)format
+                          forFileWithID:(NSInteger)fileIdentifier
+                                  toURL:(NSURL * _Nullable)destinationURL
+                               callback:(void (^ _Nullable)(NSError * _Nullable, NSURL * _Nullable))callback NS_SWIFT_NAME(download(subtitle:format:forFile:to:callback:));
+
+@end
+
+NS_ASSUME_NONNULL_END
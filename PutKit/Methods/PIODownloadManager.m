@@ -0,0 +1,964 @@
+//
+//  PIODownloadManager.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIODownloadManager.h"
+#import "PIOSession.h"
+#import "PIOEndpoints.h"
+#import "PIOError.h"
+#import "PIOAuth.h"
+#import "AFOAuthCredential.h"
+#import "PIOChecksum.h"
+#import "PIOFile.h"
+#import "PIOCallbackQueue.h"
+#import <fcntl.h>
+#import <unistd.h>
+
+static NSUInteger const kPIODownloadManagerDefaultMaximumConcurrentDownloads = 2;
+static NSUInteger const kPIODownloadManagerDefaultMaximumRetryCount = 5;
+static NSTimeInterval const kPIODownloadRetryBaseDelay = 1;
+static NSTimeInterval const kPIODownloadRetryMaximumDelay = 60;
+static NSTimeInterval const kPIODownloadProgressInterval = 0.25;
+static double const kPIODownloadRateSmoothing = 0.3;
+static int64_t const kPIODownloadMaximumPendingBytes = 4 * 1024 * 1024; // Received but not yet written to disk, per download.
+
+static void *kPIODownloadManagerQueueKey = &kPIODownloadManagerQueueKey;
+
+static NSString * const kPIOJournalIdentifierKey = @"identifier";
+static NSString * const kPIOJournalSourceURLKey = @"source_url";
+static NSString * const kPIOJournalDestinationPathKey = @"destination_path";
+static NSString * const kPIOJournalExpectedBytesKey = @"expected_bytes";
+static NSString * const kPIOJournalValidatorKey = @"validator";
+static NSString * const kPIOJournalChecksumKey = @"checksum";
+static NSString * const kPIOJournalSegmentCountKey = @"segment_count";
+static NSString * const kPIOJournalSegmentsKey = @"segments";
+static NSString * const kPIOJournalPreallocatedKey = @"preallocated";
+
+@interface PIODownloadManager ()
+
+@property (strong, nonatomic, readonly) dispatch_queue_t queue;
+
++ (NSURL *)journalDirectoryURL;
+- (void)startWaitingDownloads;
+- (void)removeDownload:(PIODownload *)download;
+
+@end
+
+@interface PIODownload () <NSURLSessionDataDelegate>
+
+@property (strong, nonatomic, readwrite) NSString *identifier;
+@property (strong, nonatomic, readwrite, nullable) NSURL *destinationURL;
+@property (nonatomic, readwrite) PIODownloadState state;
+@property (nonatomic, readwrite) int64_t receivedBytes;
+@property (nonatomic, readwrite) int64_t expectedBytes;
+@property (nonatomic, readwrite) double bytesPerSecond;
+@property (nonatomic, readwrite) NSUInteger segmentCount;
+
+- (instancetype)initWithSourceURL:(NSURL *)sourceURL
+                   destinationURL:(NSURL * _Nullable)destinationURL
+                    expectedBytes:(int64_t)expectedBytes
+                     segmentCount:(NSUInteger)segmentCount
+                         checksum:(NSString * _Nullable)checksum
+                          manager:(PIODownloadManager *)manager NS_DESIGNATED_INITIALIZER;
+- (instancetype)initWithJournal:(NSDictionary *)journal manager:(PIODownloadManager *)manager;
+- (void)start;
+
+@end
+
+/**
+ A byte range of a download that is fetched over its own connection.
+ */
+@interface PIODownloadSegment : NSObject
+
+/** The offset of the first byte of the segment. */
+@property (nonatomic) int64_t start;
+
+/** The offset one past the last byte of the segment, or `NSURLSessionTransferSizeUnknown` if the segment runs to the end of a file of unknown size. */
+@property (nonatomic) int64_t end;
+
+/** The number of bytes of the segment that have been written to disk. */
+@property (nonatomic) int64_t received;
+
+/** The checksum of the bytes of the segment that have been written to disk, kept up to date as they are written so that the finished file never has to be read back. */
+@property (nonatomic) uint32_t checksum;
+
+/** Whether `checksum` covers every received byte. It doesn't if the partial file was restored from a journal that didn't record one. */
+@property (nonatomic, getter=isChecksummed) BOOL checksummed;
+
+/** The task fetching the rest of the segment, if one is running. */
+@property (strong, nonatomic, nullable) NSURLSessionDataTask *task;
+
+@property (nonatomic, readonly, getter=isComplete) BOOL complete;
+
+@end
+
+@implementation PIODownloadSegment
+
+- (BOOL)isComplete {
+    return _end != NSURLSessionTransferSizeUnknown && _start + _received >= _end;
+}
+
+@end
+
+@implementation PIODownload {
+    PIODownloadManager * __weak _manager;
+    dispatch_queue_t _queue;
+    NSOperationQueue *_callbackQueue; // The callback queue of whoever started the download, or `nil` to call back inline.
+    NSURL *_sourceURL; // Without the access token, which is added each time a request is made in case it has changed.
+    NSString *_validator;
+    NSString *_checksum;
+    NSArray<PIODownloadSegment *> *_segments;
+    BOOL _preallocated; // Whether the partial file has been grown to its full size, in which case its length says nothing about how much has been downloaded.
+    int _fileDescriptor;
+    NSUInteger _retryCount;
+    NSUInteger _generation; // Bumped every time the download is stopped so that pending retries and checks do nothing.
+    CFAbsoluteTime _sampleTime;
+    int64_t _sampleBytes;
+    int64_t _pendingBytes; // Guarded by `self`, as it is added to on the session's delegate queue.
+    NSMutableArray<NSURLSessionTask *> *_throttledTasks; // Tasks suspended until the disk catches up. Guarded by `self`.
+}
+
+#pragma mark - Initialisation
+
+- (instancetype)initWithSourceURL:(NSURL *)sourceURL
+                   destinationURL:(NSURL *)destinationURL
+                    expectedBytes:(int64_t)expectedBytes
+                     segmentCount:(NSUInteger)segmentCount
+                         checksum:(NSString *)checksum
+                          manager:(PIODownloadManager *)manager {
+    self = [super init];
+    
+    if (self) {
+        _identifier = [NSUUID UUID].UUIDString;
+        _sourceURL = sourceURL;
+        _destinationURL = destinationURL;
+        _expectedBytes = expectedBytes;
+        _segmentCount = MAX(segmentCount, 1);
+        _checksum = checksum;
+        _manager = manager;
+        _queue = manager.queue;
+        _callbackQueue = pk_callback_queue();
+        _state = PIODownloadStateSuspended;
+        _fileDescriptor = -1;
+        _throttledTasks = [NSMutableArray array];
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithJournal:(NSDictionary *)journal manager:(PIODownloadManager *)manager {
+    NSString *identifier = [journal objectForKey:kPIOJournalIdentifierKey];
+    NSString *sourceURLString = [journal objectForKey:kPIOJournalSourceURLKey];
+    NSString *destinationPath = [journal objectForKey:kPIOJournalDestinationPathKey];
+    NSString *validator = [journal objectForKey:kPIOJournalValidatorKey];
+    NSString *checksum = [journal objectForKey:kPIOJournalChecksumKey];
+    NSArray *segments = [journal objectForKey:kPIOJournalSegmentsKey];
+    
+    if (![identifier isKindOfClass:NSString.class] || ![sourceURLString isKindOfClass:NSString.class]) return nil;
+    
+    NSURL *destinationURL = [destinationPath isKindOfClass:NSString.class] ? [NSURL fileURLWithPath:destinationPath.stringByExpandingTildeInPath] : nil;
+    
+    self = [self initWithSourceURL:[NSURL URLWithString:sourceURLString]
+                    destinationURL:destinationURL
+                     expectedBytes:[[journal objectForKey:kPIOJournalExpectedBytesKey] longLongValue]
+                      segmentCount:[[journal objectForKey:kPIOJournalSegmentCountKey] unsignedIntegerValue]
+                          checksum:[checksum isKindOfClass:NSString.class] ? checksum : nil
+                           manager:manager];
+    
+    if (self) {
+        _identifier = identifier;
+        _validator = [validator isKindOfClass:NSString.class] ? validator : nil;
+        _preallocated = [[journal objectForKey:kPIOJournalPreallocatedKey] boolValue];
+        
+        if ([segments isKindOfClass:NSArray.class]) {
+            NSMutableArray *restoredSegments = [NSMutableArray arrayWithCapacity:segments.count];
+            
+            for (NSArray<NSNumber *> *values in segments) {
+                if (![values isKindOfClass:NSArray.class] || values.count < 3) continue;
+                
+                PIODownloadSegment *segment = [PIODownloadSegment new];
+                segment.start = values[0].longLongValue;
+                segment.end = values[1].longLongValue;
+                segment.received = values[2].longLongValue;
+                segment.checksum = values.count > 3 ? values[3].unsignedIntValue : 0;
+                segment.checksummed = values.count > 3;
+                [restoredSegments addObject:segment];
+            }
+            
+            _segments = restoredSegments.count == 0 ? nil : restoredSegments;
+        }
+        
+        _receivedBytes = [self segmentReceivedBytes];
+    }
+    
+    return self;
+}
+
+#pragma mark - Journal
+
+- (NSURL *)journalURL {
+    return [[PIODownloadManager journalDirectoryURL] URLByAppendingPathComponent:[_identifier stringByAppendingPathExtension:@"plist"]];
+}
+
+- (NSURL *)partialFileURL {
+    return [[PIODownloadManager journalDirectoryURL] URLByAppendingPathComponent:[_identifier stringByAppendingPathExtension:@"part"]];
+}
+
+- (void)writeJournal {
+    NSMutableDictionary *journal = [NSMutableDictionary dictionary];
+    NSMutableArray *segments = [NSMutableArray arrayWithCapacity:_segments.count];
+    
+    for (PIODownloadSegment *segment in _segments) {
+        NSArray *values = @[@(segment.start), @(segment.end), @(segment.received)];
+        [segments addObject:segment.isChecksummed ? [values arrayByAddingObject:@(segment.checksum)] : values];
+    }
+    
+    // Paths are stored relative to the home directory, which moves when an iOS application is updated.
+    [journal setObject:_identifier forKey:kPIOJournalIdentifierKey];
+    [journal setObject:_sourceURL.absoluteString forKey:kPIOJournalSourceURLKey];
+    [journal setObject:@(_expectedBytes) forKey:kPIOJournalExpectedBytesKey];
+    [journal setObject:@(_segmentCount) forKey:kPIOJournalSegmentCountKey];
+    [journal setObject:segments forKey:kPIOJournalSegmentsKey];
+    [journal setObject:@(_preallocated) forKey:kPIOJournalPreallocatedKey];
+    
+    _destinationURL == nil ?: [journal setObject:_destinationURL.path.stringByAbbreviatingWithTildeInPath forKey:kPIOJournalDestinationPathKey];
+    _validator == nil ?: [journal setObject:_validator forKey:kPIOJournalValidatorKey];
+    _checksum == nil ?: [journal setObject:_checksum forKey:kPIOJournalChecksumKey];
+    
+    [[NSFileManager defaultManager] createDirectoryAtURL:[PIODownloadManager journalDirectoryURL] withIntermediateDirectories:YES attributes:nil error:nil];
+    [journal writeToURL:[self journalURL] atomically:YES];
+}
+
+- (void)removeJournal {
+    [[NSFileManager defaultManager] removeItemAtURL:[self journalURL] error:nil];
+    [[NSFileManager defaultManager] removeItemAtURL:[self partialFileURL] error:nil];
+}
+
+#pragma mark - Partial file
+
+- (NSArray<PIODownloadSegment *> *)makeSegments {
+    NSUInteger segmentCount = _expectedBytes > 0 ? (NSUInteger)MIN((int64_t)_segmentCount, _expectedBytes) : 1;
+    NSMutableArray *segments = [NSMutableArray arrayWithCapacity:segmentCount];
+    
+    for (NSUInteger i = 0; i < segmentCount; i++) {
+        PIODownloadSegment *segment = [PIODownloadSegment new];
+        
+        segment.start = segmentCount == 1 ? 0 : _expectedBytes * i / segmentCount;
+        segment.end = segmentCount == 1 ? _expectedBytes : _expectedBytes * (i + 1) / segmentCount;
+        segment.checksummed = YES;
+        [segments addObject:segment];
+    }
+    
+    return segments;
+}
+
+- (int64_t)segmentReceivedBytes {
+    int64_t receivedBytes = 0;
+    
+    for (PIODownloadSegment *segment in _segments) receivedBytes += segment.received;
+    
+    return receivedBytes;
+}
+
+- (BOOL)openPartialFileWithError:(NSError * _Nullable *)error {
+    if (_fileDescriptor >= 0) return YES;
+    
+    [[NSFileManager defaultManager] createDirectoryAtURL:[PIODownloadManager journalDirectoryURL] withIntermediateDirectories:YES attributes:nil error:nil];
+    
+    _fileDescriptor = open([self partialFileURL].fileSystemRepresentation, O_RDWR | O_CREAT, 0644);
+    
+    off_t length = _fileDescriptor < 0 ? -1 : lseek(_fileDescriptor, 0, SEEK_END);
+    
+    if (length < 0) {
+        *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSFilePathErrorKey: [self partialFileURL].path}];
+        [self closePartialFile];
+        return NO;
+    }
+    
+    if (_segments == nil) _segments = [self makeSegments];
+    
+    if (_segments.count > 1 && !_preallocated) {
+        // Reserve the whole file up front so that every segment can be written at its own offset, and so that running out of space is noticed before anything is downloaded.
+        fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, _expectedBytes, 0};
+        
+        if (fcntl(_fileDescriptor, F_PREALLOCATE, &store) == -1) {
+            store.fst_flags = F_ALLOCATEALL;
+            fcntl(_fileDescriptor, F_PREALLOCATE, &store);
+        }
+        
+        if (ftruncate(_fileDescriptor, _expectedBytes) != 0) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSFilePathErrorKey: [self partialFileURL].path}];
+            [self closePartialFile];
+            return NO;
+        }
+        
+        _preallocated = YES;
+        [self writeJournal];
+    } else if (!_preallocated) {
+        PIODownloadSegment *segment = _segments.firstObject;
+        
+        if (segment.isChecksummed && length >= segment.received) {
+            // Anything written after the journal was last saved isn't covered by its checksum, so it is downloaded again.
+            if (length > segment.received && ftruncate(_fileDescriptor, segment.received) != 0) {
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSFilePathErrorKey: [self partialFileURL].path}];
+                [self closePartialFile];
+                return NO;
+            }
+        } else {
+            // Whatever is on disk is what has been downloaded; the download carries on from there, and the file is read back to check it once it is done.
+            segment.received = length;
+            segment.checksum = 0;
+            segment.checksummed = length == 0;
+        }
+    }
+    
+    self.receivedBytes = [self segmentReceivedBytes];
+    
+    return YES;
+}
+
+- (void)closePartialFile {
+    if (_fileDescriptor < 0) return;
+    
+    close(_fileDescriptor);
+    _fileDescriptor = -1;
+}
+
+- (void)discardPartialFile {
+    [self closePartialFile];
+    [[NSFileManager defaultManager] removeItemAtURL:[self partialFileURL] error:nil];
+    
+    _segments = nil;
+    _preallocated = NO;
+    _validator = nil;
+    self.receivedBytes = 0;
+}
+
+#pragma mark - Downloading
+
+- (void)resume {
+    dispatch_async(_queue, ^{
+        if (self.state == PIODownloadStateRunning || self.state == PIODownloadStateWaiting || self.state == PIODownloadStateCompleted) return;
+        
+        self.state = PIODownloadStateWaiting;
+        self->_retryCount = 0;
+        
+        [self writeJournal];
+        [self->_manager startWaitingDownloads];
+    });
+}
+
+- (void)suspend {
+    dispatch_async(_queue, ^{
+        if (self.state == PIODownloadStateCompleted) return;
+        
+        [self stop];
+        
+        self.state = PIODownloadStateSuspended;
+        
+        [self writeJournal];
+        [self->_manager startWaitingDownloads];
+    });
+}
+
+- (void)cancel {
+    dispatch_async(_queue, ^{
+        [self stop];
+        [self removeJournal];
+        [self->_manager removeDownload:self];
+    });
+}
+
+- (void)stop {
+    _generation++;
+    
+    for (PIODownloadSegment *segment in _segments) {
+        [segment.task cancel];
+        segment.task = nil;
+    }
+    
+    [self closePartialFile];
+}
+
+- (NSURL *)authorizedSourceURL {
+    NSURLComponents *components = [NSURLComponents componentsWithURL:_sourceURL resolvingAgainstBaseURL:NO];
+    NSMutableArray *queryItems = [NSMutableArray arrayWithArray:components.queryItems ?: @[]];
+    
+    [queryItems addObject:[NSURLQueryItem queryItemWithName:@"oauth_token" value:[PIOAuth sharedInstance].credential.accessToken]];
+    components.queryItems = queryItems;
+    
+    return components.URL;
+}
+
+- (void)start {
+    NSError *error;
+    
+    if (![self openPartialFileWithError:&error]) {
+        [self failWithError:error];
+        return;
+    }
+    
+    self.state = PIODownloadStateRunning;
+    _sampleTime = CFAbsoluteTimeGetCurrent();
+    _sampleBytes = _receivedBytes;
+    
+    for (PIODownloadSegment *segment in _segments) {
+        if (!segment.isComplete && segment.task == nil) [self startSegment:segment];
+    }
+    
+    [self completeIfFinished];
+}
+
+- (void)startSegment:(PIODownloadSegment *)segment {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[self authorizedSourceURL]];
+    int64_t offset = segment.start + segment.received;
+    
+    request.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+    
+    if (offset > 0 || _segments.count > 1) {
+        NSString *last = segment.end == NSURLSessionTransferSizeUnknown ? @"" : @(segment.end - 1).stringValue;
+        
+        // If the file has changed since the validator was recieved, the server ignores the range and sends the whole file.
+        [request setValue:[NSString stringWithFormat:@"bytes=%lld-%@", offset, last] forHTTPHeaderField:@"Range"];
+        _validator == nil ?: [request setValue:_validator forHTTPHeaderField:@"If-Range"];
+    }
+    
+    segment.task = [[PIOSession sharedInstance] dataTaskWithRequest:request delegate:self];
+    [segment.task resume];
+}
+
+- (PIODownloadSegment *)segmentForTask:(NSURLSessionTask *)task {
+    for (PIODownloadSegment *segment in _segments) {
+        if (segment.task == task) return segment;
+    }
+    
+    return nil;
+}
+
+- (NSError *)handleResponse:(NSURLResponse *)response forSegment:(PIODownloadSegment *)segment {
+    NSInteger statusCode = [response isKindOfClass:NSHTTPURLResponse.class] ? ((NSHTTPURLResponse *)response).statusCode : 200;
+    
+    if (statusCode == 206) {
+        NSString *contentRange = pk_header_value(response, @"Content-Range");
+        long long start = -1, total = NSURLSessionTransferSizeUnknown;
+        NSScanner *scanner = contentRange == nil ? nil : [NSScanner scannerWithString:contentRange];
+        
+        // Content-Range: bytes <start>-<end>/<total or *>
+        if (![scanner scanString:@"bytes" intoString:nil] || ![scanner scanLongLong:&start] || start != segment.start + segment.received) {
+            return [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil];
+        }
+        
+        if ([scanner scanUpToString:@"/" intoString:nil] && [scanner scanString:@"/" intoString:nil]) [scanner scanLongLong:&total];
+        
+        if (total != NSURLSessionTransferSizeUnknown) {
+            self.expectedBytes = total;
+            if (segment.end == NSURLSessionTransferSizeUnknown) segment.end = total;
+        }
+    } else if (statusCode < 300) {
+        // The server ignored the range, either because the file changed or because it doesn't support ranges, so the whole file is coming over this connection.
+        for (PIODownloadSegment *other in _segments) {
+            if (other == segment) continue;
+            
+            [other.task cancel];
+            other.task = nil;
+        }
+        
+        _segments = @[segment];
+        _preallocated = NO;
+        
+        if (ftruncate(_fileDescriptor, 0) != 0) return [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        
+        segment.start = 0;
+        segment.received = 0;
+        segment.end = response.expectedContentLength;
+        segment.checksum = 0;
+        segment.checksummed = YES;
+        
+        self.expectedBytes = response.expectedContentLength;
+        self.receivedBytes = 0;
+    } else {
+        return [NSError errorWithDomain:kPIOErrorDomain code:statusCode userInfo:@{NSLocalizedDescriptionKey: [NSHTTPURLResponse localizedStringForStatusCode:statusCode]}];
+    }
+    
+    _retryCount = 0;
+    _validator = pk_header_value(response, @"ETag") ?: pk_header_value(response, @"Last-Modified");
+    
+    if (_destinationURL == nil) {
+        NSURL *downloadsDirectoryURL = [[[NSFileManager defaultManager] URLsForDirectory:NSDownloadsDirectory inDomains:NSUserDomainMask] firstObject];
+        self.destinationURL = [downloadsDirectoryURL URLByAppendingPathComponent:response.suggestedFilename];
+    }
+    
+    [self writeJournal];
+    
+    return nil;
+}
+
+- (void)completeIfFinished {
+    for (PIODownloadSegment *segment in _segments) {
+        if (!segment.isComplete) return;
+    }
+    
+    [self closePartialFile];
+    
+    uint32_t expectedChecksum;
+    
+    if (!pk_crc32_from_string(_checksum, &expectedChecksum)) {
+        [self complete];
+        return;
+    }
+    
+    uint32_t checksum = 0;
+    BOOL checksummed = YES;
+    
+    for (PIODownloadSegment *segment in _segments) {
+        checksummed = checksummed && segment.isChecksummed;
+        checksum = pk_crc32_combine(checksum, segment.checksum, segment.received);
+    }
+    
+    if (checksummed) {
+        [self completeWithChecksum:checksum expectedChecksum:expectedChecksum];
+        return;
+    }
+    
+    NSUInteger generation = _generation;
+    NSURL *partialFileURL = [self partialFileURL];
+    
+    // Reading a large file back takes a while, so it is done off the queue; the download keeps its slot until it is done.
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        uint32_t checksum = 0;
+        NSError *error;
+        BOOL read = pk_crc32_file(partialFileURL, &checksum, &error);
+        
+        dispatch_async(self->_queue, ^{
+            if (generation != self->_generation) return;
+            
+            read ? [self completeWithChecksum:checksum expectedChecksum:expectedChecksum] : [self failWithError:error];
+        });
+    });
+}
+
+- (void)completeWithChecksum:(uint32_t)checksum expectedChecksum:(uint32_t)expectedChecksum {
+    if (checksum == expectedChecksum) {
+        [self complete];
+        return;
+    }
+    
+    // There is no telling which bytes are wrong, so the whole file has to be downloaded again.
+    [self discardPartialFile];
+    [self failWithError:[NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:@{NSLocalizedDescriptionKey: @"The downloaded file does not match its checksum."}]];
+}
+
+- (void)complete {
+    NSFileManager *manager = [NSFileManager defaultManager];
+    NSError *error;
+    
+    [self closePartialFile];
+    
+    [manager createDirectoryAtURL:_destinationURL.URLByDeletingLastPathComponent withIntermediateDirectories:YES attributes:nil error:nil];
+    [manager removeItemAtURL:_destinationURL error:nil];
+    
+    if (![manager moveItemAtURL:[self partialFileURL] toURL:_destinationURL error:&error]) {
+        [self failWithError:error];
+        return;
+    }
+    
+    [self removeJournal];
+    
+    self.state = PIODownloadStateCompleted;
+    self.bytesPerSecond = 0;
+    
+    [self reportProgress];
+    [self callCompletionCallbackWithError:nil fileURL:_destinationURL];
+    [_manager removeDownload:self];
+}
+
+- (void)retrySegment:(PIODownloadSegment *)segment afterError:(NSError *)error {
+    if (!pk_error_is_transient(error) || _retryCount >= _manager.maximumRetryCount) {
+        [self failWithError:error];
+        return;
+    }
+    
+    NSTimeInterval delay = MIN(kPIODownloadRetryBaseDelay * pow(2, _retryCount), kPIODownloadRetryMaximumDelay);
+    NSUInteger generation = _generation;
+    
+    _retryCount++;
+    
+    // The download keeps its slot while it waits, so that a flaky link doesn't let other downloads jump the queue.
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), _queue, ^{
+        if (generation != self->_generation || self.state != PIODownloadStateRunning) return;
+        
+        if ([self->_segments containsObject:segment] && segment.task == nil) [self startSegment:segment];
+    });
+}
+
+- (void)failWithError:(NSError *)error {
+    [self stop];
+    [self writeJournal];
+    
+    self.state = PIODownloadStateFailed;
+    self.bytesPerSecond = 0;
+    
+    [self callCompletionCallbackWithError:error fileURL:nil];
+    [_manager startWaitingDownloads];
+}
+
+- (void)callCompletionCallbackWithError:(NSError *)error fileURL:(NSURL *)fileURL {
+    void (^callback)(NSError *, NSURL *) = self.completionCallback;
+    
+    pk_dispatch_callback_on(_callbackQueue, ^{
+        callback == nil ?: callback(error, fileURL);
+    });
+}
+
+- (void)reportProgress {
+    void (^progressCallback)(PIODownload *) = self.progressCallback;
+    
+    if (progressCallback == nil) return;
+    
+    pk_dispatch_callback_on(_callbackQueue, ^{
+        progressCallback(self);
+    });
+}
+
+- (void)sampleProgress {
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    CFTimeInterval elapsed = now - _sampleTime;
+    
+    if (elapsed < kPIODownloadProgressInterval) return;
+    
+    // An exponential moving average keeps the estimate steady over a bursty connection.
+    double rate = (_receivedBytes - _sampleBytes) / elapsed;
+    self.bytesPerSecond = _bytesPerSecond == 0 ? rate : _bytesPerSecond + kPIODownloadRateSmoothing * (rate - _bytesPerSecond);
+    
+    _sampleTime = now;
+    _sampleBytes = _receivedBytes;
+    
+    // The journal records how much of each segment has been downloaded along with its checksum so far, so that a resumed download doesn't have to read the partial file back.
+    [self writeJournal];
+    
+    [self reportProgress];
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
+    // No more data arrives until the completion handler is called, so the response can be handled off the delegate queue.
+    dispatch_async(_queue, ^{
+        PIODownloadSegment *segment = [self segmentForTask:dataTask];
+        
+        if (segment == nil) {
+            completionHandler(NSURLSessionResponseCancel);
+            return;
+        }
+        
+        NSError *error = [self handleResponse:response forSegment:segment];
+        
+        if (error != nil) {
+            segment.task = nil;
+            completionHandler(NSURLSessionResponseCancel);
+            [self retrySegment:segment afterError:error];
+            return;
+        }
+        
+        completionHandler(NSURLSessionResponseAllow);
+    });
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+    BOOL throttle;
+    
+    @synchronized (self) {
+        _pendingBytes += data.length;
+        throttle = _pendingBytes > kPIODownloadMaximumPendingBytes;
+        
+        if (throttle) [_throttledTasks addObject:dataTask];
+    }
+    
+    // The data is written on the download's own queue, so that disk writes never hold up the session's delegate queue, which every other request calls back on. A disk that can't keep up suspends the connection instead, rather than piling data up in memory.
+    if (throttle) [dataTask suspend];
+    
+    dispatch_async(_queue, ^{
+        [self writeData:data forTask:dataTask];
+        [self didWriteBytes:data.length];
+    });
+}
+
+- (void)writeData:(NSData *)data forTask:(NSURLSessionTask *)task {
+    PIODownloadSegment *segment = [self segmentForTask:task];
+    
+    if (segment == nil) return;
+    
+    int64_t start = segment.start + segment.received;
+    int64_t limit = segment.end == NSURLSessionTransferSizeUnknown ? INT64_MAX : segment.end;
+    __block int64_t offset = start;
+    __block uint32_t checksum = segment.checksum;
+    __block int code = 0;
+    int fileDescriptor = _fileDescriptor;
+    
+    [data enumerateByteRangesUsingBlock:^(const void * _Nonnull bytes, NSRange byteRange, BOOL * _Nonnull stop) {
+        size_t length = (size_t)MIN((int64_t)byteRange.length, limit - offset);
+        
+        if (pwrite(fileDescriptor, bytes, length, offset) != (ssize_t)length) {
+            code = errno ?: EIO;
+            *stop = YES;
+            return;
+        }
+        
+        checksum = pk_crc32(checksum, bytes, length);
+        offset += length;
+        *stop = offset >= limit;
+    }];
+    
+    if (code != 0) {
+        [self failWithError:[NSError errorWithDomain:NSPOSIXErrorDomain code:code userInfo:@{NSFilePathErrorKey: [self partialFileURL].path}]];
+        return;
+    }
+    
+    segment.received += offset - start;
+    segment.checksum = checksum;
+    self.receivedBytes += offset - start;
+    
+    [self sampleProgress];
+}
+
+- (void)didWriteBytes:(int64_t)length {
+    NSArray<NSURLSessionTask *> *tasks;
+    
+    @synchronized (self) {
+        _pendingBytes -= length;
+        
+        // Connections are let go again once half the buffer has been written, so that they aren't suspended and resumed on every chunk.
+        if (_pendingBytes > kPIODownloadMaximumPendingBytes / 2 || _throttledTasks.count == 0) return;
+        
+        tasks = [_throttledTasks copy];
+        [_throttledTasks removeAllObjects];
+    }
+    
+    // A task that has since been cancelled stays cancelled.
+    for (NSURLSessionTask *task in tasks) [task resume];
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    dispatch_async(_queue, ^{
+        PIODownloadSegment *segment = [self segmentForTask:task];
+        
+        if (segment == nil) return;
+        
+        segment.task = nil;
+        
+        if (error == nil && segment.end == NSURLSessionTransferSizeUnknown) {
+            // The server never said how big the file is, so it ends wherever the connection did.
+            segment.end = segment.start + segment.received;
+            self.expectedBytes = self->_receivedBytes;
+        }
+        
+        if (error != nil) {
+            [self retrySegment:segment afterError:error];
+        } else if (!segment.isComplete) {
+            [self retrySegment:segment afterError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:nil]];
+        } else {
+            [self completeIfFinished];
+        }
+    });
+}
+
+@end
+
+@implementation PIODownloadManager {
+    NSMutableArray<PIODownload *> *_downloads;
+}
+
+@synthesize maximumConcurrentDownloads = _maximumConcurrentDownloads;
+
++ (PIODownloadManager *)sharedInstance {
+    static PIODownloadManager *sharedInstance;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [PIODownloadManager new];
+    });
+    return sharedInstance;
+}
+
++ (NSURL *)journalDirectoryURL {
+#if TARGET_OS_TV
+    NSSearchPathDirectory directory = NSCachesDirectory; // tvOS applications can't write to Application Support.
+#else
+    NSSearchPathDirectory directory = NSApplicationSupportDirectory;
+#endif
+    NSURL *URL = [[NSFileManager defaultManager] URLsForDirectory:directory inDomains:NSUserDomainMask].firstObject;
+    
+    return [URL URLByAppendingPathComponent:@"io.put.kit/downloads" isDirectory:YES];
+}
+
+- (instancetype)init {
+    self = [super init];
+    
+    if (self) {
+        _queue = dispatch_queue_create("io.put.kit.downloads", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(_queue, kPIODownloadManagerQueueKey, kPIODownloadManagerQueueKey, NULL);
+        _maximumConcurrentDownloads = kPIODownloadManagerDefaultMaximumConcurrentDownloads;
+        _maximumRetryCount = kPIODownloadManagerDefaultMaximumRetryCount;
+        _downloads = [NSMutableArray array];
+        
+        NSArray<NSURL *> *URLs = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:[self.class journalDirectoryURL] includingPropertiesForKeys:nil options:NSDirectoryEnumerationSkipsHiddenFiles error:nil];
+        
+        for (NSURL *URL in URLs) {
+            if (![URL.pathExtension isEqualToString:@"plist"]) continue;
+            
+            PIODownload *download = [[PIODownload alloc] initWithJournal:[NSDictionary dictionaryWithContentsOfURL:URL] manager:self];
+            
+            download == nil ?: [_downloads addObject:download];
+        }
+    }
+    
+    return self;
+}
+
+/**
+ Performs a block on the queue and waits for it to finish, or performs it straight away if this is already the queue, as it is for callbacks that are called inline.
+ */
+- (void)performAndWait:(NS_NOESCAPE dispatch_block_t)block {
+    dispatch_get_specific(kPIODownloadManagerQueueKey) == kPIODownloadManagerQueueKey ? block() : dispatch_sync(_queue, block);
+}
+
+- (NSArray<PIODownload *> *)downloads {
+    __block NSArray *downloads;
+    
+    [self performAndWait:^{
+        downloads = [self->_downloads copy];
+    }];
+    
+    return downloads;
+}
+
+- (NSUInteger)maximumConcurrentDownloads {
+    __block NSUInteger maximumConcurrentDownloads;
+    
+    [self performAndWait:^{
+        maximumConcurrentDownloads = self->_maximumConcurrentDownloads;
+    }];
+    
+    return maximumConcurrentDownloads;
+}
+
+- (void)setMaximumConcurrentDownloads:(NSUInteger)maximumConcurrentDownloads {
+    dispatch_async(_queue, ^{
+        self->_maximumConcurrentDownloads = maximumConcurrentDownloads;
+        [self startWaitingDownloads];
+    });
+}
+
+- (void)startWaitingDownloads {
+    NSUInteger running = 0;
+    
+    for (PIODownload *download in _downloads) {
+        if (download.state == PIODownloadStateRunning) running++;
+    }
+    
+    for (PIODownload *download in _downloads) {
+        if (running >= _maximumConcurrentDownloads) break;
+        
+        if (download.state == PIODownloadStateWaiting) {
+            [download start];
+            running++;
+        }
+    }
+}
+
+- (void)removeDownload:(PIODownload *)download {
+    [_downloads removeObjectIdenticalTo:download];
+    [self startWaitingDownloads];
+}
+
+- (PIODownload *)downloadWithSourceURL:(NSURL *)sourceURL
+                        destinationURL:(NSURL *)destinationURL
+                         expectedBytes:(int64_t)expectedBytes
+                          segmentCount:(NSUInteger)segmentCount
+                              checksum:(NSString *)checksum
+                              callback:(void (^)(NSError * _Nullable, NSURL * _Nullable))callback {
+    PIODownload *download = [[PIODownload alloc] initWithSourceURL:sourceURL
+                                                    destinationURL:destinationURL
+                                                     expectedBytes:expectedBytes
+                                                      segmentCount:segmentCount
+                                                          checksum:checksum
+                                                           manager:self];
+    
+    download.completionCallback = callback;
+    
+    dispatch_async(_queue, ^{
+        [self->_downloads addObject:download];
+    });
+    
+    [download resume];
+    
+    return download;
+}
+
+- (PIODownload *)downloadFileWithID:(NSInteger)fileIdentifier
+                              toURL:(NSURL *)destinationURL
+                           callback:(void (^)(NSError * _Nullable, NSURL * _Nullable))callback {
+    NSURL *sourceURL = [NSURL URLWithString:[NSString stringWithFormat:@"%@/%zd/download", kPIOEndpointFiles, fileIdentifier]];
+    
+    return [self downloadWithSourceURL:sourceURL
+                        destinationURL:destinationURL
+                         expectedBytes:NSURLSessionTransferSizeUnknown
+                          segmentCount:1
+                              checksum:nil
+                              callback:callback];
+}
+
+- (PIODownload *)downloadFile:(PIOFile *)file
+                        toURL:(NSURL *)destinationURL
+                 segmentCount:(NSUInteger)segmentCount
+                     callback:(void (^)(NSError * _Nullable, NSURL * _Nullable))callback {
+    NSURL *sourceURL = [NSURL URLWithString:[NSString stringWithFormat:@"%@/%zd/download", kPIOEndpointFiles, file.identifier]];
+    
+    return [self downloadWithSourceURL:sourceURL
+                        destinationURL:destinationURL
+                         expectedBytes:file.size > 0 ? (int64_t)file.size : NSURLSessionTransferSizeUnknown
+                          segmentCount:segmentCount
+                              checksum:file.cyclicRedundancyCode
+                              callback:callback];
+}
+
+- (PIODownload *)downloadSubtitleWithID:(NSString *)subtitleIdentifier
+                             withFormat:(PIOSubtitleFormat)format
+                          forFileWithID:(NSInteger)fileIdentifier
+                                  toURL:(NSURL *)destinationURL
+                               callback:(void (^)(NSError * _Nullable, NSURL * _Nullable))callback {
+    subtitleIdentifier = subtitleIdentifier == nil ? @"default" : subtitleIdentifier;
+    
+    NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd/subtitles/%@", kPIOEndpointFiles, fileIdentifier, subtitleIdentifier]];
+    
+    components.queryItems = @[[NSURLQueryItem queryItemWithName:@"format" value:format]];
+    
+    return [self downloadWithSourceURL:components.URL
+                        destinationURL:destinationURL
+                         expectedBytes:NSURLSessionTransferSizeUnknown
+                          segmentCount:1
+                              checksum:nil
+                              callback:callback];
+}
+
+@end
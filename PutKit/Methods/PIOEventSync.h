@@ -0,0 +1,79 @@
+//
+//  PIOEventSync.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+
+@class PIOEvent, PIOFileCache;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Keeps up with @b Put.io's event feed, fetching only the events that happened since the last sync and remembering where it got to across launches.
+ 
+ The feed is read newest first, one page at a time, stopping as soon as it reaches an event that has been seen before. Every new event is passed on to a `PIOFileCache` so that the folders it changed are checked with the server the next time they are listed, which makes polling the event feed a cheap stand-in for re-listing folders on a timer. If more than `maximumPageCount` pages of events have piled up since the last sync, or there has never been one, there is no telling what was missed and every cached folder is invalidated.
+ 
+ The place in the feed is remembered for the account that is signed in. When somebody else signs in, the next sync starts over, and a sync that was under way for the previous account fails with `NSURLErrorCancelled`.
+ */
+NS_SWIFT_NAME(EventSync)
+@interface PIOEventSync : NSObject
+
+/**
+ Shared singleton instance of the `PIOEventSync` class, which invalidates the shared `PIOFileCache` and keeps its place in the application's caches directory. It is reset when the user signs out.
+ */
++ (PIOEventSync *)sharedInstance NS_SWIFT_NAME(shared());
+
+/**
+ Creates a sync engine.
+ 
+ @param fileCache       The cache to be invalidated by new events, if any.
+ @param stateFileURL    The location of the file in which the last event seen is remembered. If `nil`, it is only remembered in memory.
+ */
+- (instancetype)initWithFileCache:(PIOFileCache * _Nullable)fileCache
+                     stateFileURL:(NSURL * _Nullable)stateFileURL NS_DESIGNATED_INITIALIZER NS_SWIFT_NAME(init(fileCache:stateFile:));
+
+/** The identifier of the newest event seen so far, or @b 0 if there hasn't been a sync yet. */
+@property (nonatomic, readonly) NSInteger lastEventIdentifier NS_SWIFT_NAME(lastEventId);
+
+/** The most pages of events fetched in one sync. Defaults to @b 10. */
+@property (nonatomic) NSUInteger maximumPageCount;
+
+/**
+ Fetches the events that happened since the last sync and invalidates the cached folders they changed.
+ 
+ @param callback    The block that is called on the callback queue when the sync completes. If it completes successfully, the new events will be returned, oldest first. However, if it fails, the underlying error will be returned and the next sync starts from the same place.
+ 
+ @return    The request for the first page's `NSURLSessionDataTask` to be resumed.
+ */
+- (NSURLSessionDataTask *)syncWithCallback:(void (^ _Nullable)(NSError * _Nullable, NSArray<PIOEvent *> *))callback NS_SWIFT_NAME(sync(callback:));
+
+/**
+ Forgets the last event seen, so that the next sync starts over.
+ */
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,225 @@
+//
+//  PIOEventSync.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOEventSync.h"
+#import "PIOFileCache.h"
+#import "PIOEvent.h"
+#import "PIOModelDecoder.h"
+#import "PIOSession.h"
+#import "PIOEndpoints.h"
+#import "PIOAuth.h"
+#import "AFOAuthCredential.h"
+#import "PIOError.h"
+#import "PIOCallbackQueue.h"
+#import "PIOAccountScope.h"
+
+static NSUInteger const kPIOEventSyncDefaultMaximumPageCount = 10;
+static NSString * const kPIOEventSyncLastEventIdentifierKey = @"last_event_id";
+static NSString * const kPIOEventSyncAccountKey = @"account";
+
+@implementation PIOEventSync {
+    PIOFileCache *_fileCache;
+    NSURL *_stateFileURL;
+    
+    // Guarded by `@synchronized (self)`.
+    NSInteger _lastEventIdentifier;
+    NSString *_account; // The account `_lastEventIdentifier` was seen by, or `nil` if the state hasn't been read yet.
+}
+
++ (PIOEventSync *)sharedInstance {
+    static PIOEventSync *sharedInstance;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSURL *URL = [[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask].firstObject;
+        sharedInstance = [[PIOEventSync alloc] initWithFileCache:[PIOFileCache sharedInstance] stateFileURL:[URL URLByAppendingPathComponent:@"io.put.kit/events.plist" isDirectory:NO]];
+    });
+    return sharedInstance;
+}
+
+- (instancetype)init {
+    return [self initWithFileCache:nil stateFileURL:nil];
+}
+
+- (instancetype)initWithFileCache:(PIOFileCache *)fileCache stateFileURL:(NSURL *)stateFileURL {
+    self = [super init];
+    
+    if (self) {
+        _fileCache = fileCache;
+        _stateFileURL = stateFileURL;
+        _maximumPageCount = kPIOEventSyncDefaultMaximumPageCount;
+    }
+    
+    return self;
+}
+
+- (void)reset {
+    @synchronized (self) {
+        _lastEventIdentifier = 0;
+        
+        _stateFileURL == nil ?: [[NSFileManager defaultManager] removeItemAtURL:_stateFileURL error:nil];
+    }
+}
+
+- (NSInteger)lastEventIdentifier {
+    @synchronized (self) {
+        [self currentAccount];
+        
+        return _lastEventIdentifier;
+    }
+}
+
+/**
+ Reads the last event seen by whoever is signed in now, if it was read for somebody else. Another account's place in the feed means nothing for this one, so it is started over. Must be called inside `@synchronized (self)`.
+ 
+ @returns   The account the last event seen belongs to.
+ */
+- (NSString *)currentAccount {
+    NSString *account = pk_account_scope() ?: @"";
+    
+    if ([account isEqualToString:_account]) return _account;
+    
+    NSDictionary *state = _stateFileURL == nil ? nil : [NSDictionary dictionaryWithContentsOfURL:_stateFileURL];
+    
+    _account = account;
+    _lastEventIdentifier = [account isEqualToString:[state objectForKey:kPIOEventSyncAccountKey] ?: @""] ? [[state objectForKey:kPIOEventSyncLastEventIdentifierKey] integerValue] : 0;
+    
+    return _account;
+}
+
+#pragma mark - Syncing
+
+- (NSURLSessionDataTask *)syncWithCallback:(void (^)(NSError * _Nullable, NSArray<PIOEvent *> * _Nonnull))callback {
+    NSString *account;
+    
+    @synchronized (self) {
+        account = [self currentAccount];
+    }
+    
+    return [self taskForPageBeforeEventWithID:0 newEvents:[NSMutableArray array] pageCount:1 account:account callback:callback];
+}
+
+/**
+ Fetches a page of events and either carries on with the page before it or finishes the sync.
+ 
+ @param eventIdentifier The identifier of the oldest event fetched so far, or @b 0 for the newest page.
+ @param newEvents       The events newer than the last one seen that have been fetched so far, newest first.
+ @param account         The account the sync was started for.
+ */
+- (NSURLSessionDataTask *)taskForPageBeforeEventWithID:(NSInteger)eventIdentifier
+                                             newEvents:(NSMutableArray<PIOEvent *> *)newEvents
+                                             pageCount:(NSUInteger)pageCount
+                                               account:(NSString *)account
+                                              callback:(void (^)(NSError * _Nullable, NSArray<PIOEvent *> * _Nonnull))callback {
+    NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointListEvents];
+    NSMutableArray<NSURLQueryItem *> *queryItems = [NSMutableArray array];
+    
+    eventIdentifier == 0 ?: [queryItems addObject:[NSURLQueryItem queryItemWithName:@"before" value:@(eventIdentifier).stringValue]];
+    [queryItems addObject:[NSURLQueryItem queryItemWithName:@"oauth_token" value:[PIOAuth sharedInstance].credential.accessToken]];
+    
+    components.queryItems = queryItems;
+    
+    return [[PIOSession sharedInstance] dataTaskWithURL:components.URL completionHandler:^(NSData * _Nullable data,
+                                                                                           NSURLResponse * _Nullable response,
+                                                                                           NSError * _Nullable error)
+    {
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
+        NSArray<PIOEvent *> *events = pk_models_from_dictionaries(PIOEvent.class, [responseDictionary objectForKey:@"events"]);
+        
+        pk_dispatch_callback(^{
+            if (error != nil) {
+                if (callback != nil) callback(error, @[]);
+                return;
+            }
+            
+            NSInteger lastEventIdentifier = self.lastEventIdentifier;
+            NSInteger oldestIdentifier = NSIntegerMax;
+            
+            for (PIOEvent *event in events) {
+                oldestIdentifier = MIN(oldestIdentifier, event.identifier);
+                
+                if (event.identifier > lastEventIdentifier) [newEvents addObject:event];
+            }
+            
+            // Without a last event there is nothing to page back to; the newest page is as far as it is worth going.
+            BOOL caughtUp = lastEventIdentifier == 0 || events.count == 0 || oldestIdentifier <= lastEventIdentifier;
+            
+            if (!caughtUp && pageCount < self.maximumPageCount) {
+                [[self taskForPageBeforeEventWithID:oldestIdentifier newEvents:newEvents pageCount:pageCount + 1 account:account callback:callback] resume];
+                return;
+            }
+            
+            [self finishWithNewEvents:newEvents missedEvents:!caughtUp || lastEventIdentifier == 0 account:account callback:callback];
+        });
+    }];
+}
+
+- (void)finishWithNewEvents:(NSArray<PIOEvent *> *)newEvents
+               missedEvents:(BOOL)missedEvents
+                    account:(NSString *)account
+                   callback:(void (^)(NSError * _Nullable, NSArray<PIOEvent *> * _Nonnull))callback {
+    NSMutableArray<PIOEvent *> *events = [NSMutableArray arrayWithCapacity:newEvents.count];
+    NSMutableIndexSet *identifiers = [NSMutableIndexSet indexSet];
+    BOOL signedOut;
+    
+    @synchronized (self) {
+        signedOut = ![account isEqualToString:[self currentAccount]];
+        
+        // Another sync may have finished while this one was paging back.
+        for (PIOEvent *event in newEvents) {
+            if (!signedOut && event.identifier > _lastEventIdentifier && ![identifiers containsIndex:event.identifier]) {
+                [identifiers addIndex:event.identifier];
+                [events addObject:event];
+            }
+        }
+        
+        [events sortUsingComparator:^NSComparisonResult(PIOEvent *event1, PIOEvent *event2) {
+            return [@(event1.identifier) compare:@(event2.identifier)];
+        }];
+        
+        if (events.count > 0) {
+            _lastEventIdentifier = events.lastObject.identifier;
+            
+            if (_stateFileURL != nil) {
+                [[NSFileManager defaultManager] createDirectoryAtURL:_stateFileURL.URLByDeletingLastPathComponent withIntermediateDirectories:YES attributes:nil error:nil];
+                [@{kPIOEventSyncLastEventIdentifierKey: @(_lastEventIdentifier), kPIOEventSyncAccountKey: _account} writeToURL:_stateFileURL atomically:YES];
+            }
+        }
+    }
+    
+    // The events belong to somebody who has since signed out, and say nothing about whoever is signed in now.
+    if (signedOut) {
+        if (callback != nil) callback([NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil], @[]);
+        return;
+    }
+    
+    [_fileCache invalidateFilesForEvents:events];
+    
+    if (missedEvents) [_fileCache invalidateAllFolders];
+    
+    if (callback != nil) callback(nil, events);
+}
+
+@end
@@ -0,0 +1,135 @@
+//
+//  PIOFileCache.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+
+@class PIOFile, PIOEvent;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Keeps the files and folder listings fetched from @b Put.io so that they can be shown straight away the next time they are needed, even after a relaunch.
+ 
+ Cached listings are handed out immediately and then checked with the server in the background. The check is a conditional request carrying the `ETag` and `Last-Modified` the listing was fetched with, so a folder that hasn't changed costs an empty `304` response; if the server doesn't send validators, the body is compared with the cached one instead. Listings checked within the last `revalidationInterval` seconds aren't checked again, unless they have since been invalidated, e.g. by `PIOEventSync` reading the event feed.
+ 
+ Listings are evicted least recently used first once the estimated size of everything cached goes over `memoryBudget`.
+ 
+ Everything is cached on behalf of the account that is signed in at the time. When somebody else signs in, their own listings are loaded in its place, and anything still being fetched for the previous account is dropped rather than handed out.
+ */
+NS_SWIFT_NAME(FileCache)
+@interface PIOFileCache : NSObject
+
+/**
+ Shared singleton instance of the `PIOFileCache` class, kept in the application's caches directory. It is emptied when the user signs out.
+ */
++ (PIOFileCache *)sharedInstance NS_SWIFT_NAME(shared());
+
+/**
+ Creates a cache that is kept in a given file.
+ 
+ @param fileURL The location of the file the cache is loaded from and saved to while nobody is signed in. Each account's cache is kept in a file next to it, with the account added to its name. If `nil`, the cache is only kept in memory.
+ */
+- (instancetype)initWithFileURL:(NSURL * _Nullable)fileURL NS_DESIGNATED_INITIALIZER;
+
+/** The estimated size (in bytes) the cache is allowed to grow to before listings are evicted. Defaults to @b 8MB. */
+@property (nonatomic) NSUInteger memoryBudget;
+
+/** The estimated size (in bytes) of everything cached. */
+@property (nonatomic, readonly) NSUInteger cost;
+
+/** The time (in seconds) after a listing has been checked with the server during which it is handed out without being checked again. Defaults to @b 30. */
+@property (nonatomic) NSTimeInterval revalidationInterval;
+
+/**
+ Returns the cached file with a given identifier, without making any requests.
+ 
+ @param fileIdentifier  The identifier of the file.
+ */
+- (nullable PIOFile *)cachedFileWithID:(NSInteger)fileIdentifier NS_SWIFT_NAME(cachedFile(for:));
+
+/**
+ Returns the cached contents of a given folder, without making any requests.
+ 
+ @param folderIdentifier    The identifier of the folder.
+ */
+- (nullable NSArray<PIOFile *> *)cachedFilesInFolderWithID:(NSInteger)folderIdentifier NS_SWIFT_NAME(cachedFiles(in:));
+
+/**
+ Lists the contents of a given folder, handing out the cached contents first if there are any.
+ 
+ @param folderIdentifier    The identifier of the folder whose contents are to be listed. 0 indicates the root directory.
+ @param callback            The block that is called on the callback queue with the contents of the folder. If the folder is cached, it is called straight away with the cached files and `YES`, then again with `NO` only if the server's listing turns out to be different. Otherwise it is called once, when the request completes; if it fails, the underlying error will be returned.
+ 
+ @return    The request's `NSURLSessionDataTask` to be resumed, or `nil` if the cached contents were checked recently enough that no request is needed.
+ */
+- (nullable NSURLSessionDataTask *)listFilesInFolderWithID:(NSInteger)folderIdentifier
+                                                  callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> *, PIOFile * _Nullable, BOOL))callback NS_SWIFT_NAME(listFiles(in:callback:));
+
+/**
+ Returns a file with a given identifier, handing out the cached file first if there is one.
+ 
+ @param fileIdentifier  The identifier of the file.
+ @param callback        The block that is called on the callback queue with the file. If the file is cached, it is called straight away with the cached file and `YES`, then again with `NO` if the server's copy may be different. Otherwise it is called once, when the request completes; if it fails, the underlying error will be returned.
+ 
+ @return    The request's `NSURLSessionDataTask` to be resumed, or `nil` if the cached file was checked recently enough that no request is needed.
+ */
+- (nullable NSURLSessionDataTask *)getFileForID:(NSInteger)fileIdentifier
+                                       callback:(void (^)(NSError * _Nullable, PIOFile * _Nullable, BOOL))callback NS_SWIFT_NAME(file(for:callback:));
+
+/**
+ Marks every listing that a group of events may have changed as needing to be checked with the server the next time it is listed, however recently it was checked. A finished transfer or a newly shared file invalidates the folder it is in, or every folder if the cache doesn't know where it is.
+ 
+ @param events  The events, usually the new ones found by `PIOEventSync`.
+ */
+- (void)invalidateFilesForEvents:(NSArray<PIOEvent *> *)events NS_SWIFT_NAME(invalidate(for:));
+
+/**
+ Marks every folder's listing as needing to be checked with the server the next time it is listed.
+ */
+- (void)invalidateAllFolders;
+
+/**
+ Marks a folder's listing as needing to be checked with the server the next time it is listed. Useful after changing its contents.
+ 
+ @param folderIdentifier    The identifier of the folder.
+ */
+- (void)invalidateFolderWithID:(NSInteger)folderIdentifier NS_SWIFT_NAME(invalidate(folder:));
+
+/**
+ Marks the listings that a group of files are in, and the listings of any of them that are folders, as needing to be checked with the server the next time they are listed. Called by `PIOAPI` whenever it deletes, moves or renames files.
+ 
+ @param fileIdentifiers The identifiers of the files.
+ */
+- (void)invalidateFoldersContainingFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers NS_SWIFT_NAME(invalidateFolders(containing:));
+
+/**
+ Empties the cache, in memory and on disk, for every account.
+ */
+- (void)removeAllFiles;
+
+@end
+
+NS_ASSUME_NONNULL_END
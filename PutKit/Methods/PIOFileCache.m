@@ -0,0 +1,600 @@
+//
+//  PIOFileCache.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOFileCache.h"
+#import "PIOFile.h"
+#import "PIOEvent.h"
+#import "PIOModelDecoder.h"
+#import "PIOSession.h"
+#import "PIOEndpoints.h"
+#import "PIOAuth.h"
+#import "AFOAuthCredential.h"
+#import "PIOChecksum.h"
+#import "PIOError.h"
+#import "PIOCallbackQueue.h"
+#import "PIOAccountScope.h"
+
+static NSUInteger const kPIOFileCacheDefaultMemoryBudget = 8 * 1024 * 1024;
+static NSTimeInterval const kPIOFileCacheDefaultRevalidationInterval = 30;
+static NSTimeInterval const kPIOFileCacheSaveDelay = 1; // Saves are put off by this long so that a burst of changes is written once.
+
+// Keys start with the account they were fetched for, so that nothing fetched for one account is ever handed out to another.
+static NSString *pk_folder_key(NSString *account, NSInteger folderIdentifier) {
+    return [NSString stringWithFormat:@"%@/folder/%zd", account, folderIdentifier];
+}
+
+static NSString *pk_file_key(NSString *account, NSInteger fileIdentifier) {
+    return [NSString stringWithFormat:@"%@/file/%zd", account, fileIdentifier];
+}
+
+/**
+ The file an account's cache is kept in: the cache's own file, with the account added to its name.
+ */
+static NSURL *pk_account_file_URL(NSURL *fileURL, NSString *account) {
+    NSString *name = [NSString stringWithFormat:@"%@-%@", fileURL.URLByDeletingPathExtension.lastPathComponent, account];
+    NSURL *URL = [fileURL.URLByDeletingLastPathComponent URLByAppendingPathComponent:name isDirectory:NO];
+    
+    return fileURL.pathExtension.length == 0 ? URL : [URL URLByAppendingPathExtension:fileURL.pathExtension];
+}
+
+/**
+ A rough estimate of the memory taken up by a file and its strings.
+ */
+static NSUInteger pk_file_cost(PIOFile *file) {
+    return 256 + 2 * (file.name.length + file.contentType.length + file.cyclicRedundancyCode.length + file.openSubtitlesHash.length + file.iconURL.absoluteString.length + file.screenshotURL.absoluteString.length);
+}
+
+/**
+ A folder's listing, or a single file, as it was last fetched, along with what is needed to ask the server whether it has changed.
+ */
+@interface PIOFileCacheEntry : NSObject <NSSecureCoding>
+
+@property (strong, nonatomic) NSString *key;
+@property (strong, nonatomic) NSArray<PIOFile *> *files;
+@property (strong, nonatomic, nullable) PIOFile *folder;
+@property (strong, nonatomic, nullable) NSString *entityTag;
+@property (strong, nonatomic, nullable) NSString *lastModified;
+@property (nonatomic) uint32_t bodyChecksum; // The CRC32 of the response body, for servers that send no validators.
+@property (strong, nonatomic) NSDate *dateValidated; // When the server last confirmed the entry, or `distantPast` if it has to be checked before it is trusted again.
+@property (nonatomic) NSUInteger cost;
+
+- (void)updateCost;
+
+@end
+
+@implementation PIOFileCacheEntry
+
++ (BOOL)supportsSecureCoding {
+    return YES;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder {
+    [coder encodeObject:self.key forKey:@"key"];
+    [coder encodeObject:self.files forKey:@"files"];
+    [coder encodeObject:self.folder forKey:@"folder"];
+    [coder encodeObject:self.entityTag forKey:@"entityTag"];
+    [coder encodeObject:self.lastModified forKey:@"lastModified"];
+    [coder encodeInt64:self.bodyChecksum forKey:@"bodyChecksum"];
+    [coder encodeObject:self.dateValidated forKey:@"dateValidated"];
+}
+
+- (nullable instancetype)initWithCoder:(NSCoder *)coder {
+    self = [super init];
+    
+    if (self) {
+        _key = [coder decodeObjectOfClass:NSString.class forKey:@"key"];
+        _files = [coder decodeObjectOfClasses:[NSSet setWithObjects:NSArray.class, PIOFile.class, nil] forKey:@"files"];
+        _folder = [coder decodeObjectOfClass:PIOFile.class forKey:@"folder"];
+        _entityTag = [coder decodeObjectOfClass:NSString.class forKey:@"entityTag"];
+        _lastModified = [coder decodeObjectOfClass:NSString.class forKey:@"lastModified"];
+        _bodyChecksum = (uint32_t)[coder decodeInt64ForKey:@"bodyChecksum"];
+        _dateValidated = [coder decodeObjectOfClass:NSDate.class forKey:@"dateValidated"] ?: [NSDate distantPast];
+        
+        if (_key != nil && _files != nil) {
+            [self updateCost];
+            return self;
+        }
+    }
+    
+    return nil;
+}
+
+- (void)updateCost {
+    NSUInteger cost = 128 + (self.folder == nil ? 0 : pk_file_cost(self.folder));
+    
+    for (PIOFile *file in self.files) cost += pk_file_cost(file);
+    
+    _cost = cost;
+}
+
+@end
+
+/**
+ Creates a request that the server answers with `304 Not Modified` if the entry is still current.
+ */
+static NSURLRequest *pk_conditional_request(NSURL *URL, PIOFileCacheEntry *entry) {
+    // The session's own cache would answer a `304` with its stored copy and hide it.
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:URL cachePolicy:NSURLRequestReloadIgnoringLocalCacheData timeoutInterval:60];
+    
+    entry.entityTag == nil ?: [request setValue:entry.entityTag forHTTPHeaderField:@"If-None-Match"];
+    entry.lastModified == nil ?: [request setValue:entry.lastModified forHTTPHeaderField:@"If-Modified-Since"];
+    
+    return request;
+}
+
+@implementation PIOFileCache {
+    // Guarded by `@synchronized (self)`; requests call back on the session's delegate queue.
+    NSURL *_fileURL; // The file every account's cache is named after.
+    NSString *_account; // The account whose files are loaded, or an empty string if nobody is signed in.
+    NSMutableDictionary<NSString *, PIOFileCacheEntry *> *_entries;
+    NSMutableOrderedSet<NSString *> *_recentKeys; // Least recently used first.
+    NSMutableDictionary<NSNumber *, NSString *> *_fileKeys; // The key of the entry each file was last cached in.
+    NSUInteger _cost;
+    BOOL _saveScheduled;
+    dispatch_queue_t _saveQueue;
+}
+
++ (PIOFileCache *)sharedInstance {
+    static PIOFileCache *sharedInstance;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSURL *URL = [[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask].firstObject;
+        sharedInstance = [[PIOFileCache alloc] initWithFileURL:[URL URLByAppendingPathComponent:@"io.put.kit/files.archive" isDirectory:NO]];
+    });
+    return sharedInstance;
+}
+
+- (instancetype)init {
+    return [self initWithFileURL:nil];
+}
+
+- (instancetype)initWithFileURL:(NSURL *)fileURL {
+    self = [super init];
+    
+    if (self) {
+        _fileURL = fileURL;
+        _memoryBudget = kPIOFileCacheDefaultMemoryBudget;
+        _revalidationInterval = kPIOFileCacheDefaultRevalidationInterval;
+        _entries = [NSMutableDictionary dictionary];
+        _recentKeys = [NSMutableOrderedSet orderedSet];
+        _fileKeys = [NSMutableDictionary dictionary];
+        _saveQueue = dispatch_queue_create("io.put.kit.file-cache", DISPATCH_QUEUE_SERIAL);
+    }
+    
+    return self;
+}
+
+#pragma mark - Storage
+
+/** The file the signed in account's cache is kept in, or `nil` if it is only kept in memory. Must be called inside `@synchronized (self)`. */
+- (NSURL *)accountFileURL {
+    return _fileURL == nil || _account.length == 0 ? _fileURL : pk_account_file_URL(_fileURL, _account);
+}
+
+/**
+ Swaps the files in memory for those of whoever is signed in now, if that isn't who they were loaded for. Must be called inside `@synchronized (self)`.
+ 
+ @returns   The account whose files are now loaded.
+ */
+- (NSString *)currentAccount {
+    NSString *account = pk_account_scope() ?: @"";
+    
+    if ([account isEqualToString:_account]) return _account;
+    
+    [_entries removeAllObjects];
+    [_recentKeys removeAllObjects];
+    [_fileKeys removeAllObjects];
+    _cost = 0;
+    _account = account;
+    
+    [self load];
+    
+    return _account;
+}
+
+/** Must be called inside `@synchronized (self)`. */
+- (void)load {
+    NSURL *fileURL = [self accountFileURL];
+    NSData *data = fileURL == nil ? nil : [NSData dataWithContentsOfURL:fileURL];
+    
+    if (data == nil) return;
+    
+    NSKeyedUnarchiver *unarchiver = [[NSKeyedUnarchiver alloc] initForReadingWithData:data];
+    unarchiver.requiresSecureCoding = YES;
+    
+    NSSet *classes = [NSSet setWithObjects:NSDictionary.class, NSArray.class, NSString.class, NSDate.class, PIOFileCacheEntry.class, PIOFile.class, nil];
+    NSDictionary *root;
+    
+    @try {
+        root = [unarchiver decodeObjectOfClasses:classes forKey:NSKeyedArchiveRootObjectKey];
+    } @catch (NSException *exception) {
+        root = nil; // A cache written by an incompatible version is started over.
+    }
+    
+    [unarchiver finishDecoding];
+    
+    NSArray *entries = [root isKindOfClass:NSDictionary.class] ? [root objectForKey:@"entries"] : nil;
+    if (![entries isKindOfClass:NSArray.class]) return;
+    
+    NSString *prefix = [_account stringByAppendingString:@"/"];
+    
+    for (PIOFileCacheEntry *entry in entries) {
+        if ([entry isKindOfClass:PIOFileCacheEntry.class] && [entry.key hasPrefix:prefix]) [self insertEntry:entry];
+    }
+}
+
+- (void)scheduleSave {
+    if ([self accountFileURL] == nil || _saveScheduled) return;
+    
+    _saveScheduled = YES;
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kPIOFileCacheSaveDelay * NSEC_PER_SEC)), _saveQueue, ^{
+        NSMutableDictionary *root = [NSMutableDictionary dictionary];
+        NSURL *fileURL;
+        
+        @synchronized (self) {
+            self->_saveScheduled = NO;
+            fileURL = [self accountFileURL]; // Whoever is signed in by now, whose files are the ones in memory.
+            
+            if (fileURL == nil) return;
+            
+            NSMutableArray *entries = [NSMutableArray arrayWithCapacity:self->_recentKeys.count];
+            
+            for (NSString *key in self->_recentKeys) [entries addObject:[self->_entries objectForKey:key]];
+            
+            [root setObject:entries forKey:@"entries"];
+        }
+        
+        NSMutableData *data = [NSMutableData data];
+        NSKeyedArchiver *archiver = [[NSKeyedArchiver alloc] initForWritingWithMutableData:data];
+        archiver.requiresSecureCoding = YES;
+        [archiver encodeObject:root forKey:NSKeyedArchiveRootObjectKey];
+        [archiver finishEncoding];
+        
+        [[NSFileManager defaultManager] createDirectoryAtURL:fileURL.URLByDeletingLastPathComponent withIntermediateDirectories:YES attributes:nil error:nil];
+        [data writeToURL:fileURL atomically:YES];
+    });
+}
+
+#pragma mark - Entries
+
+/** Must be called inside `@synchronized (self)`. Entries fetched for an account that has since signed out are dropped. */
+- (void)insertEntry:(PIOFileCacheEntry *)entry {
+    if (![entry.key hasPrefix:[_account stringByAppendingString:@"/"]]) return;
+    
+    [self removeEntryForKey:entry.key];
+    
+    [_entries setObject:entry forKey:entry.key];
+    [_recentKeys addObject:entry.key];
+    _cost += entry.cost;
+    
+    for (PIOFile *file in entry.files) [_fileKeys setObject:entry.key forKey:@(file.identifier)];
+    
+    entry.folder == nil ?: [_fileKeys setObject:entry.key forKey:@(entry.folder.identifier)];
+    
+    while (_cost > self.memoryBudget && _recentKeys.count > 1) [self removeEntryForKey:_recentKeys.firstObject];
+    
+    [self scheduleSave];
+}
+
+/** Must be called inside `@synchronized (self)`. */
+- (void)removeEntryForKey:(NSString *)key {
+    PIOFileCacheEntry *entry = [_entries objectForKey:key];
+    
+    if (entry == nil) return;
+    
+    [_entries removeObjectForKey:key];
+    [_recentKeys removeObject:key];
+    _cost -= entry.cost;
+    
+    NSMutableArray<PIOFile *> *files = [entry.files mutableCopy];
+    entry.folder == nil ?: [files addObject:entry.folder];
+    
+    for (PIOFile *file in files) {
+        if ([[_fileKeys objectForKey:@(file.identifier)] isEqualToString:key]) [_fileKeys removeObjectForKey:@(file.identifier)];
+    }
+}
+
+/** Must be called inside `@synchronized (self)`. Returns the entry and marks it as the most recently used. */
+- (PIOFileCacheEntry *)entryForKey:(NSString *)key {
+    PIOFileCacheEntry *entry = [_entries objectForKey:key];
+    
+    if (entry != nil) {
+        [_recentKeys removeObject:key];
+        [_recentKeys addObject:key];
+    }
+    
+    return entry;
+}
+
+- (BOOL)isEntryFresh:(PIOFileCacheEntry *)entry {
+    return -entry.dateValidated.timeIntervalSinceNow < self.revalidationInterval;
+}
+
+- (void)markEntryValidated:(PIOFileCacheEntry *)entry withResponse:(NSURLResponse *)response {
+    @synchronized (self) {
+        entry.dateValidated = [NSDate date];
+        entry.entityTag = pk_header_value(response, @"ETag") ?: entry.entityTag;
+        entry.lastModified = pk_header_value(response, @"Last-Modified") ?: entry.lastModified;
+        
+        [self scheduleSave];
+    }
+}
+
+- (NSUInteger)cost {
+    @synchronized (self) {
+        [self currentAccount];
+        
+        return _cost;
+    }
+}
+
+- (PIOFile *)cachedFileWithID:(NSInteger)fileIdentifier {
+    @synchronized (self) {
+        PIOFileCacheEntry *entry = [self entryForKey:pk_file_key([self currentAccount], fileIdentifier)] ?: [self entryForKey:[_fileKeys objectForKey:@(fileIdentifier)] ?: @""];
+        
+        if (entry.folder.identifier == fileIdentifier) return entry.folder;
+        
+        for (PIOFile *file in entry.files) {
+            if (file.identifier == fileIdentifier) return file;
+        }
+        
+        return nil;
+    }
+}
+
+- (NSArray<PIOFile *> *)cachedFilesInFolderWithID:(NSInteger)folderIdentifier {
+    @synchronized (self) {
+        return [self entryForKey:pk_folder_key([self currentAccount], folderIdentifier)].files;
+    }
+}
+
+- (void)invalidateFolderWithID:(NSInteger)folderIdentifier {
+    @synchronized (self) {
+        [_entries objectForKey:pk_folder_key([self currentAccount], folderIdentifier)].dateValidated = [NSDate distantPast];
+    }
+}
+
+- (void)invalidateFoldersContainingFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers {
+    @synchronized (self) {
+        NSString *account = [self currentAccount];
+        
+        for (NSNumber *fileIdentifier in fileIdentifiers) {
+            PIOFile *file = [self cachedFileWithID:fileIdentifier.integerValue];
+            
+            [_entries objectForKey:[_fileKeys objectForKey:fileIdentifier] ?: @""].dateValidated = [NSDate distantPast];
+            [_entries objectForKey:pk_file_key(account, fileIdentifier.integerValue)].dateValidated = [NSDate distantPast];
+            [_entries objectForKey:pk_folder_key(account, fileIdentifier.integerValue)].dateValidated = [NSDate distantPast];
+            
+            if (file != nil) [_entries objectForKey:pk_folder_key(account, file.parentIdentifier)].dateValidated = [NSDate distantPast];
+        }
+        
+        [self scheduleSave];
+    }
+}
+
+- (void)removeAllFiles {
+    @synchronized (self) {
+        [_entries removeAllObjects];
+        [_recentKeys removeAllObjects];
+        [_fileKeys removeAllObjects];
+        _cost = 0;
+        
+        if (_fileURL == nil) return;
+        
+        // Every account's file goes, not just the signed in one's; the cache's own file is kept for when nobody is signed in.
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        NSString *prefix = [_fileURL.URLByDeletingPathExtension.lastPathComponent stringByAppendingString:@"-"];
+        
+        for (NSURL *URL in [fileManager contentsOfDirectoryAtURL:_fileURL.URLByDeletingLastPathComponent includingPropertiesForKeys:nil options:0 error:nil]) {
+            if ([URL.lastPathComponent hasPrefix:prefix] && [URL.pathExtension isEqualToString:_fileURL.pathExtension]) [fileManager removeItemAtURL:URL error:nil];
+        }
+        
+        [fileManager removeItemAtURL:_fileURL error:nil];
+    }
+}
+
+#pragma mark - Requests
+
+/**
+ Sends a conditional request for an entry, and replaces the entry with the new one built from the response if it turns out to have changed.
+ 
+ @param entryBlock  The block that builds the new entry from the decoded response. Called off the main queue.
+ @param callback    The block that is called off the main queue with the new entry, or the error if the request failed. Not called if the entry hasn't changed.
+ */
+- (NSURLSessionDataTask *)revalidateEntry:(PIOFileCacheEntry *)entry
+                                      URL:(NSURL *)URL
+                               entryBlock:(PIOFileCacheEntry * _Nullable (^)(NSDictionary *))entryBlock
+                                 callback:(void (^)(NSError * _Nullable, PIOFileCacheEntry * _Nullable))callback {
+    return [[PIOSession sharedInstance] dataTaskWithRequest:pk_conditional_request(URL, entry) completionHandler:^(NSData * _Nullable data,
+                                                                                                                    NSURLResponse * _Nullable response,
+                                                                                                                    NSError * _Nullable error)
+    {
+        if (error == nil && entry != nil && [response isKindOfClass:NSHTTPURLResponse.class] && ((NSHTTPURLResponse *)response).statusCode == 304) {
+            [self markEntryValidated:entry withResponse:response];
+            return;
+        }
+        
+        NSDictionary *responseDictionary = pk_response_decode(data, response, &error);
+        uint32_t bodyChecksum = pk_crc32(0, data.bytes, data.length);
+        
+        if (error != nil) {
+            callback(error, nil);
+            return;
+        }
+        
+        if (entry != nil && entry.bodyChecksum == bodyChecksum && bodyChecksum != 0) {
+            [self markEntryValidated:entry withResponse:response];
+            return;
+        }
+        
+        PIOFileCacheEntry *newEntry = entryBlock(responseDictionary);
+        
+        if (newEntry == nil) {
+            callback([NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil], nil);
+            return;
+        }
+        
+        newEntry.entityTag = pk_header_value(response, @"ETag");
+        newEntry.lastModified = pk_header_value(response, @"Last-Modified");
+        newEntry.bodyChecksum = bodyChecksum;
+        newEntry.dateValidated = [NSDate date];
+        [newEntry updateCost];
+        
+        @synchronized (self) {
+            [self currentAccount];
+            [self insertEntry:newEntry];
+        }
+        
+        callback(nil, newEntry);
+    }];
+}
+
+- (NSURLSessionDataTask *)listFilesInFolderWithID:(NSInteger)folderIdentifier
+                                         callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> * _Nonnull, PIOFile * _Nullable, BOOL))callback {
+    NSString *key;
+    PIOFileCacheEntry *entry;
+    
+    @synchronized (self) {
+        key = pk_folder_key([self currentAccount], folderIdentifier);
+        entry = [self entryForKey:key];
+    }
+    
+    if (entry != nil) {
+        NSArray<PIOFile *> *files = entry.files;
+        PIOFile *folder = entry.folder;
+        
+        pk_dispatch_callback(^{
+            callback(nil, files, folder, YES);
+        });
+        
+        if ([self isEntryFresh:entry]) return nil;
+    }
+    
+    NSURLComponents *components = [NSURLComponents componentsWithString:kPIOEndpointListFiles];
+    
+    components.queryItems = @[[NSURLQueryItem queryItemWithName:@"parent_id" value:@(folderIdentifier).stringValue],
+                              [NSURLQueryItem queryItemWithName:@"oauth_token" value:[PIOAuth sharedInstance].credential.accessToken]];
+    
+    return [self revalidateEntry:entry URL:components.URL entryBlock:^PIOFileCacheEntry *(NSDictionary *responseDictionary) {
+        PIOFileCacheEntry *newEntry = [PIOFileCacheEntry new];
+        
+        newEntry.key = key;
+        newEntry.files = pk_models_from_dictionaries(PIOFile.class, [responseDictionary objectForKey:@"files"]);
+        newEntry.folder = pk_model_from_dictionary(PIOFile.class, [responseDictionary objectForKey:@"parent"]);
+        
+        return newEntry;
+    } callback:^(NSError * _Nullable error, PIOFileCacheEntry * _Nullable newEntry) {
+        // Once the cached files have been handed out, a failed check has nothing to add.
+        if (error != nil && entry != nil) return;
+        
+        pk_dispatch_callback(^{
+            callback(error, newEntry.files ?: @[], newEntry.folder, NO);
+        });
+    }];
+}
+
+- (NSURLSessionDataTask *)getFileForID:(NSInteger)fileIdentifier callback:(void (^)(NSError * _Nullable, PIOFile * _Nullable, BOOL))callback {
+    NSString *key;
+    PIOFileCacheEntry *entry, *containingEntry;
+    PIOFile *file = [self cachedFileWithID:fileIdentifier];
+    
+    @synchronized (self) {
+        key = pk_file_key([self currentAccount], fileIdentifier);
+        entry = [_entries objectForKey:key];
+        containingEntry = entry ?: [_entries objectForKey:[_fileKeys objectForKey:@(fileIdentifier)] ?: @""];
+    }
+    
+    if (file != nil) {
+        pk_dispatch_callback(^{
+            callback(nil, file, YES);
+        });
+        
+        if ([self isEntryFresh:containingEntry]) return nil;
+    }
+    
+    NSURLComponents *components = [NSURLComponents componentsWithString:[NSString stringWithFormat:@"%@/%zd", kPIOEndpointFiles, fileIdentifier]];
+    
+    components.queryItems = @[[NSURLQueryItem queryItemWithName:@"oauth_token" value:[PIOAuth sharedInstance].credential.accessToken]];
+    
+    // A file only known from a folder's listing has no validators of its own, so it is fetched in full.
+    return [self revalidateEntry:entry URL:components.URL entryBlock:^PIOFileCacheEntry *(NSDictionary *responseDictionary) {
+        PIOFile *newFile = pk_model_from_dictionary(PIOFile.class, [responseDictionary objectForKey:@"file"]);
+        PIOFileCacheEntry *newEntry = [PIOFileCacheEntry new];
+        
+        newEntry.key = key;
+        newEntry.files = newFile == nil ? @[] : @[newFile];
+        
+        return newFile == nil ? nil : newEntry;
+    } callback:^(NSError * _Nullable error, PIOFileCacheEntry * _Nullable newEntry) {
+        if (error != nil && file != nil) return;
+        
+        pk_dispatch_callback(^{
+            callback(error, newEntry.files.firstObject, NO);
+        });
+    }];
+}
+
+- (void)invalidateFilesForEvents:(NSArray<PIOEvent *> *)events {
+    @synchronized (self) {
+        NSString *account = [self currentAccount];
+        BOOL unknownFile = NO;
+        
+        for (PIOEvent *event in events) {
+            // Neither a zip being ready nor an RSS feed failing changes any folder.
+            if (![event.type isEqualToString:PIOEventTypeTransferCompleted] && ![event.type isEqualToString:PIOEventTypeFileShared]) continue;
+            
+            PIOFileCacheEntry *entry = [_entries objectForKey:[_fileKeys objectForKey:@(event.fileIdentifier)] ?: @""];
+            PIOFile *file = event.fileIdentifier == 0 ? nil : [self cachedFileWithID:event.fileIdentifier];
+            
+            if (file == nil) {
+                unknownFile = YES; // Something new turned up, and there is no telling in which folder.
+                continue;
+            }
+            
+            entry.dateValidated = [NSDate distantPast];
+            [_entries objectForKey:pk_file_key(account, event.fileIdentifier)].dateValidated = [NSDate distantPast];
+            [_entries objectForKey:pk_folder_key(account, event.fileIdentifier)].dateValidated = [NSDate distantPast];
+            [_entries objectForKey:pk_folder_key(account, file.parentIdentifier)].dateValidated = [NSDate distantPast];
+        }
+        
+        if (unknownFile) [self invalidateAllFolders];
+        
+        [self scheduleSave];
+    }
+}
+
+- (void)invalidateAllFolders {
+    @synchronized (self) {
+        NSString *prefix = [[self currentAccount] stringByAppendingString:@"/folder/"];
+        
+        for (PIOFileCacheEntry *entry in _entries.objectEnumerator) {
+            if ([entry.key hasPrefix:prefix]) entry.dateValidated = [NSDate distantPast];
+        }
+    }
+}
+
+@end
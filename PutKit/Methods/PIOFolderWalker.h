@@ -0,0 +1,106 @@
+//
+//  PIOFolderWalker.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+
+@class PIOFile;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The order in which a `PIOFolderWalker` lists the folders it finds.
+ */
+typedef NS_ENUM(NSInteger, PIOFolderWalkOrder) {
+    /** Every folder at one depth is listed before any folder below it. */
+    PIOFolderWalkOrderBreadthFirst,
+    /** The folders inside a folder are listed before the ones next to it. */
+    PIOFolderWalkOrderDepthFirst
+} NS_SWIFT_NAME(FolderWalkOrder);
+
+/**
+ Lists every file below a folder, several folders at a time.
+ 
+ Each folder is listed a page at a time and every page is handed over as soon as it arrives, so a large library never has to be held in memory all at once. As several folders are listed at the same time, pages from different folders arrive interleaved and the order only says which folders are started first.
+ 
+ A request that fails with a network or server error is sent again a couple of times before the walk gives up.
+ */
+NS_SWIFT_NAME(FolderWalker)
+@interface PIOFolderWalker : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ Creates a walker for the files below a given folder.
+ 
+ @param folderIdentifier    The identifier of the folder to be walked. The root directory has an identifier of @b 0.
+ */
+- (instancetype)initWithFolderID:(NSInteger)folderIdentifier NS_DESIGNATED_INITIALIZER NS_SWIFT_NAME(init(folder:));
+
+/** The identifier of the folder being walked. */
+@property (nonatomic, readonly) NSInteger folderIdentifier NS_SWIFT_NAME(folderId);
+
+/** The number of levels below the folder that are listed. @b 1 only lists the folder's own contents. Defaults to `NSUIntegerMax`. */
+@property (nonatomic) NSUInteger maximumDepth;
+
+/** The order in which folders are listed. Defaults to `PIOFolderWalkOrderBreadthFirst`. */
+@property (nonatomic) PIOFolderWalkOrder order;
+
+/** The most list requests running at the same time. Defaults to @b 4. */
+@property (nonatomic) NSUInteger maximumConcurrentRequests;
+
+/** The number of files asked for in each request. @b Put.io allows at most 1000, which is the default. */
+@property (nonatomic) NSUInteger perPage;
+
+/** A block that decides which files are handed over and counted, e.g. only those whose content type starts with `video/`. Folders are walked into whether they pass or not. If `nil`, every file passes. Called on the walker's own queue, not the callback queue. */
+@property (copy, nonatomic, nullable) BOOL (^filter)(PIOFile *file);
+
+/** A block called on the callback queue with every page of files that passed the filter, along with how many levels below the folder they are, starting at @b 1. */
+@property (copy, nonatomic, nullable) void (^filesCallback)(NSArray<PIOFile *> *files, NSUInteger depth);
+
+/** The combined size (in bytes) of the files, not counting folders, that have passed the filter so far. */
+@property (atomic, readonly) uint64_t totalSize;
+
+/** The number of files, not counting folders, that have passed the filter so far. */
+@property (atomic, readonly) NSUInteger fileCount;
+
+/** The number of folders that have been listed so far. */
+@property (atomic, readonly) NSUInteger folderCount;
+
+/**
+ Starts the walk. A walker can only be started once.
+ 
+ @param completion  The block that is called on the callback queue when every folder has been listed, or the walk has been cancelled or given up, in which case the underlying error will be returned. The combined size of the files that passed the filter is passed in either way.
+ */
+- (void)startWithCompletion:(void (^ _Nullable)(NSError * _Nullable, uint64_t))completion NS_SWIFT_NAME(start(completion:));
+
+/**
+ Stops the walk and cancels the requests that are running. The completion block is called with `NSURLErrorCancelled`.
+ */
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,263 @@
+//
+//  PIOFolderWalker.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOFolderWalker.h"
+#import "PIOAPI+Files.h"
+#import "PIOFile.h"
+#import "PIOError.h"
+#import "PIOCallbackQueue.h"
+#import "PIORateLimiter.h"
+#import "PIOSession.h"
+
+static NSUInteger const kPIOFolderWalkerDefaultMaximumConcurrentRequests = 4;
+static NSUInteger const kPIOFolderWalkerDefaultPerPage = 1000;
+static NSUInteger const kPIOFolderWalkerMaximumRetryCount = 2;
+static NSTimeInterval const kPIOFolderWalkerRetryDelay = 0.5; // Doubled for every retry of the same request.
+
+/**
+ A page of a folder still to be listed. Only touched on the walker's queue.
+ */
+@interface PIOFolderWalkItem : NSObject
+
+@property (nonatomic) NSInteger folderIdentifier;
+@property (nonatomic) NSUInteger depth; // The depth of the folder's contents.
+@property (strong, nonatomic, nullable) NSString *cursor; // The cursor for the next page, or `nil` for the first one.
+@property (nonatomic) NSUInteger attempt;
+
+@end
+
+@implementation PIOFolderWalkItem
+
+@end
+
+@interface PIOFolderWalker ()
+
+@property (atomic, readwrite) uint64_t totalSize;
+@property (atomic, readwrite) NSUInteger fileCount;
+@property (atomic, readwrite) NSUInteger folderCount;
+
+@end
+
+@implementation PIOFolderWalker {
+    void (^_completion)(NSError * _Nullable, uint64_t);
+    NSOperationQueue *_queue; // Serial, and where the requests call back.
+    
+    // Only touched on `_queue`.
+    NSOperationQueue *_callbackQueue; // The callback queue the walk was started with.
+    NSMutableArray<PIOFolderWalkItem *> *_pendingItems; // Taken from the front when walking breadth first and from the back when walking depth first.
+    NSMutableSet<NSURLSessionDataTask *> *_tasks;
+    NSUInteger _waitingItemCount; // Items waiting to be retried.
+    BOOL _started;
+    BOOL _finished;
+}
+
+- (instancetype)initWithFolderID:(NSInteger)folderIdentifier {
+    self = [super init];
+    
+    if (self) {
+        _folderIdentifier = folderIdentifier;
+        _maximumDepth = NSUIntegerMax;
+        _order = PIOFolderWalkOrderBreadthFirst;
+        _maximumConcurrentRequests = kPIOFolderWalkerDefaultMaximumConcurrentRequests;
+        _perPage = kPIOFolderWalkerDefaultPerPage;
+        _pendingItems = [NSMutableArray array];
+        _tasks = [NSMutableSet set];
+        _queue = [NSOperationQueue new];
+        _queue.name = @"io.put.kit.folder-walker";
+        _queue.maxConcurrentOperationCount = 1;
+    }
+    
+    return self;
+}
+
+- (void)startWithCompletion:(void (^)(NSError * _Nullable, uint64_t))completion {
+    NSOperationQueue *callbackQueue = pk_callback_queue();
+    
+    [_queue addOperationWithBlock:^{
+        NSAssert(!self->_started, @"A walker can only be started once.");
+        
+        PIOFolderWalkItem *item = [PIOFolderWalkItem new];
+        item.folderIdentifier = self.folderIdentifier;
+        item.depth = 1;
+        
+        self->_started = YES;
+        self->_completion = [completion copy];
+        self->_callbackQueue = callbackQueue;
+        [self->_pendingItems addObject:item];
+        
+        [self sendRequests];
+    }];
+}
+
+- (void)cancel {
+    [_queue addOperationWithBlock:^{
+        if (self->_started) [self finishWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+    }];
+}
+
+- (void)sendRequests {
+    while (!_finished && _pendingItems.count > 0 && _tasks.count < MAX(self.maximumConcurrentRequests, 1)) {
+        PIOFolderWalkItem *item = self.order == PIOFolderWalkOrderBreadthFirst ? _pendingItems.firstObject : _pendingItems.lastObject;
+        
+        self.order == PIOFolderWalkOrderBreadthFirst ? [_pendingItems removeObjectAtIndex:0] : [_pendingItems removeLastObject];
+        
+        [self sendRequestForItem:item];
+    }
+    
+    if (!_finished && _pendingItems.count == 0 && _tasks.count == 0 && _waitingItemCount == 0) [self finishWithError:nil];
+}
+
+- (void)sendRequestForItem:(PIOFolderWalkItem *)item {
+    __block NSURLSessionDataTask *task;
+    
+    void (^handler)(NSError *, NSArray<PIOFile *> *, NSString *) = ^(NSError *error, NSArray<PIOFile *> *files, NSString *cursor) {
+        if (self->_finished) return;
+        
+        [self->_tasks removeObject:task];
+        
+        if (error == nil) {
+            [self handleFiles:files cursor:cursor forItem:item];
+        } else {
+            [self handleError:error forItem:item];
+        }
+        
+        [self sendRequests];
+    };
+    
+    // Everything is kept on the walker's queue, whatever queue the configuration calls back on, and the requests queue for the rate limiter apart from everyone else's. Failed requests are retried by `handleError:forItem:` rather than by the session as well.
+    [PIORateLimiter performAsCaller:@"PIOFolderWalker" block:^{
+        [PIOSession performWithoutRetries:^{
+            pk_perform_with_callback_queue(self->_queue, ^{
+                if (item.cursor == nil) {
+                    task = [PIOAPI listFilesInFolderWithID:item.folderIdentifier perPage:self.perPage callback:^(NSError * _Nullable error, NSArray<PIOFile *> * _Nonnull files, PIOFile * _Nullable folder, NSString * _Nullable cursor) {
+                        handler(error, files, cursor);
+                    }];
+                } else {
+                    task = [PIOAPI continueListingFilesWithCursor:item.cursor perPage:self.perPage callback:handler];
+                }
+            });
+        }];
+    }];
+    
+    [_tasks addObject:task];
+    [task resume];
+}
+
+- (void)handleFiles:(NSArray<PIOFile *> *)files cursor:(NSString *)cursor forItem:(PIOFolderWalkItem *)item {
+    NSMutableArray<PIOFile *> *matchingFiles = [NSMutableArray arrayWithCapacity:files.count];
+    NSMutableArray<PIOFolderWalkItem *> *folderItems = [NSMutableArray array];
+    
+    if (item.cursor == nil) self.folderCount++;
+    
+    for (PIOFile *file in files) {
+        if (self.filter == nil || self.filter(file)) {
+            [matchingFiles addObject:file];
+            
+            // The size of a folder is the size of its contents, which are counted by themselves.
+            if (!file.isFolder) {
+                self.totalSize += file.size;
+                self.fileCount++;
+            }
+        }
+        
+        if (file.isFolder && item.depth < self.maximumDepth) {
+            PIOFolderWalkItem *folderItem = [PIOFolderWalkItem new];
+            folderItem.folderIdentifier = file.identifier;
+            folderItem.depth = item.depth + 1;
+            
+            [folderItems addObject:folderItem];
+        }
+    }
+    
+    // The rest of a folder is listed before anything else is started, so that it isn't left half done.
+    if (cursor != nil) {
+        PIOFolderWalkItem *nextItem = [PIOFolderWalkItem new];
+        nextItem.folderIdentifier = item.folderIdentifier;
+        nextItem.depth = item.depth;
+        nextItem.cursor = cursor;
+        
+        self.order == PIOFolderWalkOrderBreadthFirst ? [_pendingItems insertObject:nextItem atIndex:0] : [_pendingItems addObject:nextItem];
+    }
+    
+    // When walking depth first the last item is taken first, so the folders go in backwards to be listed in order.
+    [_pendingItems addObjectsFromArray:self.order == PIOFolderWalkOrderBreadthFirst ? folderItems : folderItems.reverseObjectEnumerator.allObjects];
+    
+    void (^filesCallback)(NSArray<PIOFile *> *, NSUInteger) = self.filesCallback;
+    NSUInteger depth = item.depth;
+    
+    if (matchingFiles.count == 0 || filesCallback == nil) return;
+    
+    pk_dispatch_callback_on(_callbackQueue, ^{
+        filesCallback(matchingFiles, depth);
+    });
+}
+
+- (void)handleError:(NSError *)error forItem:(PIOFolderWalkItem *)item {
+    if (!pk_error_is_transient(error) || item.attempt >= kPIOFolderWalkerMaximumRetryCount) {
+        [self finishWithError:error];
+        return;
+    }
+    
+    NSTimeInterval delay = kPIOFolderWalkerRetryDelay * (1 << item.attempt);
+    
+    item.attempt++;
+    _waitingItemCount++;
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [self->_queue addOperationWithBlock:^{
+            self->_waitingItemCount--;
+            
+            if (self->_finished) return;
+            
+            [self->_pendingItems addObject:item];
+            [self sendRequests];
+        }];
+    });
+}
+
+- (void)finishWithError:(NSError *)error {
+    if (_finished) return;
+    
+    _finished = YES;
+    
+    for (NSURLSessionDataTask *task in _tasks) [task cancel];
+    
+    [_tasks removeAllObjects];
+    [_pendingItems removeAllObjects];
+    
+    void (^completion)(NSError *, uint64_t) = _completion;
+    uint64_t totalSize = self.totalSize;
+    
+    _completion = nil;
+    
+    if (completion == nil) return;
+    
+    pk_dispatch_callback_on(_callbackQueue, ^{
+        completion(error, totalSize);
+    });
+}
+
+@end
@@ -0,0 +1,120 @@
+//
+//  PIOFuture.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The eventual result of one or more requests: either a value or an error.
+ 
+ Futures start their work as soon as they are made, so there is nothing to resume. Any number of blocks can wait for the result, including after it has arrived. Cancelling a future cancels the requests behind it and finishes it with an `NSURLErrorCancelled` error; a future made from other futures, with `then:`, `timeoutAfter:`, `all:` or `race:`, cancels those too.
+ 
+ In Swift, `getValue(completionHandler:)` can be awaited as `try await future.value()`. Cancelling the awaiting `Task` does not cancel the future, so wrap the call in `withTaskCancellationHandler` and cancel the future from its `onCancel` block when the work should stop with the task.
+ */
+NS_SWIFT_NAME(Future)
+@interface PIOFuture<__covariant ObjectType> : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ Creates a future from any request, and resumes the request.
+ 
+ @param taskBlock   The block that creates the request. It is passed the block that the request's callback should call with the value or error. If a task is returned, it is resumed and cancelled along with the future.
+ */
+- (instancetype)initWithTaskBlock:(NSURLSessionTask * _Nullable (^)(void (^resolve)(ObjectType _Nullable value, NSError * _Nullable error)))taskBlock NS_SWIFT_NAME(init(task:));
+
+/**
+ Creates a future that has already finished with a value.
+ */
++ (instancetype)futureWithValue:(ObjectType)value NS_SWIFT_NAME(init(value:));
+
+/**
+ Creates a future that has already failed with an error.
+ */
++ (instancetype)futureWithError:(NSError *)error NS_SWIFT_NAME(init(error:));
+
+/**
+ Returns a future that finishes once every one of the specified futures has finished, with their values in the same order. A `nil` value is replaced with `NSNull`. If any of the futures fails, the returned future fails with the same error straight away and the others are cancelled.
+ 
+ @param futures The futures to wait for.
+ */
++ (PIOFuture<NSArray *> *)all:(NSArray<PIOFuture *> *)futures NS_SWIFT_NAME(all(_:));
+
+/**
+ Returns a future that finishes the same way as whichever of the specified futures finishes first, successfully or not. The others are cancelled.
+ 
+ @param futures The futures to race. If the array is empty, the returned future never finishes unless it is cancelled.
+ */
++ (PIOFuture *)race:(NSArray<PIOFuture *> *)futures NS_SWIFT_NAME(race(_:));
+
+/** Whether the future has finished, successfully or not. */
+@property (nonatomic, readonly, getter=isFinished) BOOL finished;
+
+/** Whether the future was cancelled before it finished. */
+@property (nonatomic, readonly, getter=isCancelled) BOOL cancelled;
+
+/** The value the future finished with, or `nil` if it hasn't finished or failed. */
+@property (strong, nonatomic, readonly, nullable) ObjectType value;
+
+/** The error the future failed with, or `nil` if it hasn't finished or succeeded. */
+@property (strong, nonatomic, readonly, nullable) NSError *error;
+
+/**
+ Registers a block to be called with the result of the future. If the future has already finished, the block is called straight away on the callback queue.
+ 
+ @param completionHandler   The block that is called on the callback queue once the future has finished, with either its value or its error.
+ */
+- (void)getValueWithCompletionHandler:(void (^)(ObjectType _Nullable value, NSError * _Nullable error))completionHandler NS_SWIFT_NAME(getValue(completionHandler:));
+
+/**
+ Returns a future that carries on from this one once it has succeeded. If this future fails, the returned future fails with the same error and the block isn't called.
+ 
+ @param block   The block that is called on the callback queue with the value of this future. The future it returns is what the returned future finishes with; if it returns `nil`, the returned future finishes with a `nil` value.
+ */
+- (PIOFuture *)then:(PIOFuture * _Nullable (^)(ObjectType _Nullable value))block NS_SWIFT_NAME(then(_:));
+
+/**
+ Returns a future that finishes with the value of this future passed through a block. If this future fails, the returned future fails with the same error and the block isn't called.
+ 
+ @param block   The block that is called on the callback queue with the value of this future.
+ */
+- (PIOFuture *)map:(id _Nullable (^)(ObjectType _Nullable value))block NS_SWIFT_NAME(map(_:));
+
+/**
+ Returns a future that finishes the same way as this one, unless this one takes longer than the specified interval. In that case, it fails with an `NSURLErrorTimedOut` error and this future is cancelled.
+ 
+ @param interval    The time (in seconds) to wait.
+ */
+- (PIOFuture<ObjectType> *)timeoutAfter:(NSTimeInterval)interval NS_SWIFT_NAME(timeout(after:));
+
+/**
+ Cancels the future and the requests behind it. Blocks waiting for its result are called with an `NSURLErrorCancelled` error. Does nothing if the future has already finished.
+ */
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
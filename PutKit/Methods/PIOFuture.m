@@ -0,0 +1,318 @@
+//
+//  PIOFuture.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIOFuture.h"
+#import "PIOCallbackQueue.h"
+
+typedef void (^PIOFutureCallback)(id _Nullable value, NSError * _Nullable error);
+
+@implementation PIOFuture {
+    // Both are only touched while synchronized on the future, and are released once it finishes.
+    NSMutableArray<PIOFutureCallback> *_callbacks;
+    NSMutableArray<dispatch_block_t> *_cancellationHandlers;
+}
+
+@synthesize finished = _finished;
+@synthesize cancelled = _cancelled;
+@synthesize value = _value;
+@synthesize error = _error;
+
+- (instancetype)initPending {
+    self = [super init];
+    
+    if (self) {
+        _callbacks = [NSMutableArray array];
+        _cancellationHandlers = [NSMutableArray array];
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithTaskBlock:(NSURLSessionTask * _Nullable (^)(void (^)(id _Nullable, NSError * _Nullable)))taskBlock {
+    self = [self initPending];
+    
+    if (self) {
+        __block NSURLSessionTask *task;
+        
+        // The request calls back inline, as the result is handed on to whoever is waiting on their own queues anyway.
+        pk_perform_with_callback_queue(nil, ^{
+            task = taskBlock(^(id value, NSError *error) {
+                [self finishWithValue:value error:error];
+            });
+        });
+        
+        if (task != nil) {
+            [self addCancellationHandler:^{
+                [task cancel];
+            }];
+            
+            [task resume];
+        }
+    }
+    
+    return self;
+}
+
++ (instancetype)futureWithValue:(id)value {
+    PIOFuture *future = [[self alloc] initPending];
+    [future finishWithValue:value error:nil];
+    return future;
+}
+
++ (instancetype)futureWithError:(NSError *)error {
+    PIOFuture *future = [[self alloc] initPending];
+    [future finishWithValue:nil error:error];
+    return future;
+}
+
+#pragma mark - State
+
+- (BOOL)isFinished {
+    @synchronized (self) {
+        return _finished;
+    }
+}
+
+- (BOOL)isCancelled {
+    @synchronized (self) {
+        return _cancelled;
+    }
+}
+
+- (id)value {
+    @synchronized (self) {
+        return _value;
+    }
+}
+
+- (NSError *)error {
+    @synchronized (self) {
+        return _error;
+    }
+}
+
+- (BOOL)finishWithValue:(id)value error:(NSError *)error {
+    return [self finishWithValue:value error:error cancelled:NO];
+}
+
+/**
+ Finishes the future and calls everything waiting on it. If it is being cancelled, the cancellation handlers are called afterwards.
+ 
+ @return    Whether the future was finished by this call, rather than having finished already.
+ */
+- (BOOL)finishWithValue:(id)value error:(NSError *)error cancelled:(BOOL)cancelled {
+    NSArray<PIOFutureCallback> *callbacks;
+    NSArray<dispatch_block_t> *cancellationHandlers;
+    id result = error == nil ? value : nil;
+    
+    @synchronized (self) {
+        if (_finished) return NO;
+        
+        _finished = YES;
+        _cancelled = cancelled;
+        _value = result;
+        _error = error;
+        
+        callbacks = _callbacks;
+        cancellationHandlers = cancelled ? _cancellationHandlers : nil;
+        _callbacks = nil;
+        _cancellationHandlers = nil;
+    }
+    
+    for (PIOFutureCallback callback in callbacks) callback(result, error);
+    for (dispatch_block_t handler in cancellationHandlers) handler();
+    
+    return YES;
+}
+
+/**
+ Registers a block to be called inline, on whichever thread the future finishes on, or straight away if it has already finished.
+ */
+- (void)whenFinished:(PIOFutureCallback)callback {
+    @synchronized (self) {
+        if (!_finished) {
+            [_callbacks addObject:[callback copy]];
+            return;
+        }
+    }
+    
+    callback(self.value, self.error);
+}
+
+/**
+ Registers a block to be called if the future is cancelled before it finishes, or straight away if it already has been.
+ */
+- (void)addCancellationHandler:(dispatch_block_t)handler {
+    @synchronized (self) {
+        if (!_finished) {
+            [_cancellationHandlers addObject:[handler copy]];
+            return;
+        }
+        
+        if (!_cancelled) return;
+    }
+    
+    handler();
+}
+
+- (void)cancel {
+    [self finishWithValue:nil error:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil] cancelled:YES];
+}
+
+#pragma mark - Waiting
+
+- (void)getValueWithCompletionHandler:(void (^)(id _Nullable, NSError * _Nullable))completionHandler {
+    NSOperationQueue *queue = pk_callback_queue();
+    
+    [self whenFinished:^(id value, NSError *error) {
+        pk_dispatch_callback_on(queue, ^{
+            completionHandler(value, error);
+        });
+    }];
+}
+
+#pragma mark - Combining
+
+/**
+ Finishes the future the same way as another future, whenever that one finishes.
+ */
+- (void)finishWithFuture:(PIOFuture *)future {
+    [self addCancellationHandler:^{
+        [future cancel];
+    }];
+    
+    [future whenFinished:^(id value, NSError *error) {
+        [self finishWithValue:value error:error];
+    }];
+}
+
+- (PIOFuture *)then:(PIOFuture * _Nullable (^)(id _Nullable))block {
+    PIOFuture *future = [[PIOFuture alloc] initPending];
+    NSOperationQueue *queue = pk_callback_queue();
+    
+    [future addCancellationHandler:^{
+        [self cancel];
+    }];
+    
+    [self whenFinished:^(id value, NSError *error) {
+        if (error != nil) {
+            [future finishWithValue:nil error:error];
+            return;
+        }
+        
+        pk_dispatch_callback_on(queue, ^{
+            if (future.isFinished) return; // Cancelled while waiting for the queue.
+            
+            PIOFuture *next = block(value);
+            
+            next == nil ? [future finishWithValue:nil error:nil] : [future finishWithFuture:next];
+        });
+    }];
+    
+    return future;
+}
+
+- (PIOFuture *)map:(id _Nullable (^)(id _Nullable))block {
+    return [self then:^PIOFuture *(id value) {
+        return [PIOFuture futureWithValue:block(value)];
+    }];
+}
+
+- (PIOFuture *)timeoutAfter:(NSTimeInterval)interval {
+    PIOFuture *future = [[PIOFuture alloc] initPending];
+    
+    [future finishWithFuture:self];
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(interval * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        if ([future finishWithValue:nil error:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil]]) [self cancel];
+    });
+    
+    return future;
+}
+
++ (PIOFuture<NSArray *> *)all:(NSArray<PIOFuture *> *)futures {
+    PIOFuture *future = [[PIOFuture alloc] initPending];
+    NSMutableArray *values = [NSMutableArray arrayWithCapacity:futures.count];
+    __block NSUInteger remaining = futures.count;
+    
+    if (futures.count == 0) {
+        [future finishWithValue:@[] error:nil];
+        return future;
+    }
+    
+    for (NSUInteger i = 0; i < futures.count; i++) [values addObject:[NSNull null]];
+    
+    [future addCancellationHandler:^{
+        for (PIOFuture *input in futures) [input cancel];
+    }];
+    
+    [futures enumerateObjectsUsingBlock:^(PIOFuture *input, NSUInteger index, BOOL *stop) {
+        [input whenFinished:^(id value, NSError *error) {
+            if (error != nil) {
+                if ([future finishWithValue:nil error:error]) {
+                    for (PIOFuture *other in futures) [other cancel];
+                }
+                return;
+            }
+            
+            BOOL done;
+            
+            @synchronized (values) {
+                values[index] = value ?: [NSNull null];
+                done = --remaining == 0;
+            }
+            
+            if (done) [future finishWithValue:[values copy] error:nil];
+        }];
+    }];
+    
+    return future;
+}
+
++ (PIOFuture *)race:(NSArray<PIOFuture *> *)futures {
+    PIOFuture *future = [[PIOFuture alloc] initPending];
+    
+    [future addCancellationHandler:^{
+        for (PIOFuture *input in futures) [input cancel];
+    }];
+    
+    for (PIOFuture *input in futures) {
+        [input whenFinished:^(id value, NSError *error) {
+            if (![future finishWithValue:value error:error]) return;
+            
+            for (PIOFuture *other in futures) [other cancel];
+        }];
+    }
+    
+    return future;
+}
+
+- (NSString *)description {
+    @synchronized (self) {
+        return [NSString stringWithFormat:@"<%@: %p> finished = %@; cancelled = %@; value = %@; error = %@", [self class], self, _finished ? @"YES" : @"NO", _cancelled ? @"YES" : @"NO", _value, _error];
+    }
+}
+
+@end
@@ -0,0 +1,92 @@
+//
+//  PIOMP4ConversionWatcher.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+
+@class PIOMP4Conversion;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A group of files whose conversions are being watched by a `PIOMP4ConversionWatcher`.
+ */
+NS_SWIFT_NAME(Mp4ConversionWatch)
+@interface PIOMP4ConversionWatch : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/** The identifiers of the files whose conversions haven't finished yet. */
+@property (strong, nonatomic, readonly) NSArray<NSNumber *> *pendingFileIdentifiers NS_SWIFT_NAME(pendingFileIds);
+
+/**
+ Stops watching every file in the group that hasn't finished. Neither callback is called again.
+ */
+- (void)cancel;
+
+@end
+
+/**
+ Watches the MP4 conversions of any number of files, sharing a single request budget between all of them.
+ 
+ Each file is polled on its own schedule. A file that is converting is polled again at about the time its conversion should be done, judging by how quickly its percentage has been going up, and a file that is waiting in the queue or making no progress is polled less and less often, up to `maximumPollInterval`. However many files are being watched, no more than `maximumRequestsPerMinute` requests are sent, so when there are more files due than the budget allows, the ones that have waited longest go first.
+ 
+ A file that is watched by more than one group is only polled once for all of them.
+ */
+NS_SWIFT_NAME(Mp4ConversionWatcher)
+@interface PIOMP4ConversionWatcher : NSObject
+
+/**
+ Shared singleton instance of the `PIOMP4ConversionWatcher` class.
+ */
++ (PIOMP4ConversionWatcher *)sharedInstance NS_SWIFT_NAME(shared());
+
+/** The shortest time (in seconds) between two polls of the same file. Defaults to @b 2. */
+@property (nonatomic) NSTimeInterval minimumPollInterval;
+
+/** The longest time (in seconds) between two polls of the same file, however long it has been waiting. Defaults to @b 60. */
+@property (nonatomic) NSTimeInterval maximumPollInterval;
+
+/** The most requests sent in any minute, across every file being watched. Defaults to @b 60. */
+@property (nonatomic) NSUInteger maximumRequestsPerMinute;
+
+/**
+ Starts watching the conversions of a group of files.
+ 
+ @param fileIdentifiers     The identifiers of the files to be watched.
+ @param startConverting     Whether a conversion should be started for each file before it is watched. Starting the conversions counts against the same request budget as polling them.
+ @param progressCallback    The block that is called on the callback queue every time the status of one of the files has been fetched and it hasn't finished converting.
+ @param completionCallback  The block that is called on the callback queue once for every file in the group, as soon as it finishes. If the conversion finished, it is returned with a status of `PIOMP4StatusCompleted`, or `PIOMP4StatusUnavailable` if there is no conversion and none is on its way. However, if the status couldn't be fetched, the underlying error will be returned.
+ 
+ @return    The watch, which can be cancelled to stop watching the files.
+ */
+- (PIOMP4ConversionWatch *)watchFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers
+                             startConverting:(BOOL)startConverting
+                            progressCallback:(void (^ _Nullable)(NSInteger, PIOMP4Conversion *))progressCallback
+                          completionCallback:(void (^ _Nullable)(NSInteger, NSError * _Nullable, PIOMP4Conversion * _Nullable))completionCallback NS_SWIFT_NAME(watch(files:startConverting:progress:completion:));
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,358 @@
+//
+//  PIOMP4ConversionWatcher.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOMP4ConversionWatcher.h"
+#import "PIOAPI+Files.h"
+#import "PIOMP4Conversion.h"
+#import "PIOError.h"
+#import "PIOCallbackQueue.h"
+#import "PIORateLimiter.h"
+
+static NSTimeInterval const kPIOMP4ConversionWatcherDefaultMinimumPollInterval = 2;
+static NSTimeInterval const kPIOMP4ConversionWatcherDefaultMaximumPollInterval = 60;
+static NSUInteger const kPIOMP4ConversionWatcherDefaultMaximumRequestsPerMinute = 60;
+static NSUInteger const kPIOMP4ConversionWatcherMaximumRequestsInFlight = 4;
+static double const kPIOMP4ConversionWatcherBackoffFactor = 2;
+
+@interface PIOMP4ConversionWatcher ()
+
+- (void)removeWatch:(PIOMP4ConversionWatch *)watch;
+
+@end
+
+@interface PIOMP4ConversionWatch ()
+
+@property (copy, nonatomic, nullable) void (^progressCallback)(NSInteger, PIOMP4Conversion *);
+@property (copy, nonatomic, nullable) void (^completionCallback)(NSInteger, NSError * _Nullable, PIOMP4Conversion * _Nullable);
+@property (strong, nonatomic, nullable) NSOperationQueue *callbackQueue; // The callback queue the watch was made with.
+@property (weak, nonatomic) PIOMP4ConversionWatcher *watcher;
+@property (strong, nonatomic) NSMutableArray<NSNumber *> *pending; // Guarded by the watch itself.
+@property (atomic, getter=isCancelled) BOOL cancelled;
+
+@end
+
+@implementation PIOMP4ConversionWatch
+
+- (NSArray<NSNumber *> *)pendingFileIdentifiers {
+    @synchronized (self) {
+        return [self.pending copy];
+    }
+}
+
+- (void)cancel {
+    // Set straight away, so that callbacks already on their way to the callback queue aren't called either.
+    self.cancelled = YES;
+    
+    [self.watcher removeWatch:self];
+}
+
+@end
+
+/**
+ A file being polled on behalf of every watch that includes it. Only touched on the watcher's queue.
+ */
+@interface PIOMP4ConversionEntry : NSObject
+
+@property (nonatomic) NSInteger fileIdentifier;
+@property (strong, nonatomic) NSMutableArray<PIOMP4ConversionWatch *> *watches;
+@property (nonatomic) BOOL needsStart; // Whether the conversion still has to be started before it is polled.
+@property (nonatomic, getter=isRequesting) BOOL requesting;
+@property (nonatomic) CFAbsoluteTime dueTime; // When the file should next be polled.
+@property (nonatomic) NSTimeInterval interval; // The time waited before the last poll.
+@property (nonatomic) NSInteger lastPercentage; // The percentage at `lastSampleTime`, or -1 if the file hasn't been seen converting.
+@property (nonatomic) CFAbsoluteTime lastSampleTime;
+
+@end
+
+@implementation PIOMP4ConversionEntry
+
+@end
+
+@implementation PIOMP4ConversionWatcher {
+    NSOperationQueue *_queue; // Serial, and where the requests call back.
+    
+    // Only touched on `_queue`.
+    NSMutableDictionary<NSNumber *, PIOMP4ConversionEntry *> *_entries;
+    NSUInteger _requestsInFlight;
+    CFAbsoluteTime _nextRequestTime; // The earliest the budget allows the next request to be sent.
+    NSUInteger _generation; // Bumped whenever a pump is scheduled, so that pumps scheduled before it do nothing.
+}
+
++ (PIOMP4ConversionWatcher *)sharedInstance {
+    static PIOMP4ConversionWatcher *sharedInstance;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [PIOMP4ConversionWatcher new];
+    });
+    return sharedInstance;
+}
+
+- (instancetype)init {
+    self = [super init];
+    
+    if (self) {
+        _minimumPollInterval = kPIOMP4ConversionWatcherDefaultMinimumPollInterval;
+        _maximumPollInterval = kPIOMP4ConversionWatcherDefaultMaximumPollInterval;
+        _maximumRequestsPerMinute = kPIOMP4ConversionWatcherDefaultMaximumRequestsPerMinute;
+        _entries = [NSMutableDictionary dictionary];
+        _queue = [NSOperationQueue new];
+        _queue.name = @"io.put.kit.mp4-conversion-watcher";
+        _queue.maxConcurrentOperationCount = 1;
+    }
+    
+    return self;
+}
+
+- (PIOMP4ConversionWatch *)watchFilesWithIDs:(NSArray<NSNumber *> *)fileIdentifiers
+                             startConverting:(BOOL)startConverting
+                            progressCallback:(void (^)(NSInteger, PIOMP4Conversion * _Nonnull))progressCallback
+                          completionCallback:(void (^)(NSInteger, NSError * _Nullable, PIOMP4Conversion * _Nullable))completionCallback {
+    PIOMP4ConversionWatch *watch = [PIOMP4ConversionWatch new];
+    
+    watch.progressCallback = progressCallback;
+    watch.completionCallback = completionCallback;
+    watch.callbackQueue = pk_callback_queue();
+    watch.watcher = self;
+    watch.pending = [[[NSOrderedSet orderedSetWithArray:fileIdentifiers] array] mutableCopy];
+    
+    [_queue addOperationWithBlock:^{
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        
+        for (NSNumber *fileIdentifier in watch.pendingFileIdentifiers) {
+            PIOMP4ConversionEntry *entry = [self->_entries objectForKey:fileIdentifier];
+            
+            if (entry == nil) {
+                entry = [PIOMP4ConversionEntry new];
+                entry.fileIdentifier = fileIdentifier.integerValue;
+                entry.watches = [NSMutableArray array];
+                entry.needsStart = startConverting;
+                entry.dueTime = now;
+                entry.interval = self.minimumPollInterval;
+                entry.lastPercentage = -1;
+                
+                [self->_entries setObject:entry forKey:fileIdentifier];
+            }
+            
+            [entry.watches addObject:watch];
+        }
+        
+        [self pump];
+    }];
+    
+    return watch;
+}
+
+- (void)removeWatch:(PIOMP4ConversionWatch *)watch {
+    [_queue addOperationWithBlock:^{
+        for (NSNumber *fileIdentifier in watch.pendingFileIdentifiers) {
+            PIOMP4ConversionEntry *entry = [self->_entries objectForKey:fileIdentifier];
+            
+            [entry.watches removeObjectIdenticalTo:watch];
+            
+            // A request that is still running for it is ignored when it comes back.
+            if (entry.watches.count == 0) [self->_entries removeObjectForKey:fileIdentifier];
+        }
+        
+        @synchronized (watch) {
+            [watch.pending removeAllObjects];
+        }
+    }];
+}
+
+#pragma mark - Scheduling
+
+- (void)schedulePumpAtTime:(CFAbsoluteTime)time {
+    NSUInteger generation = ++_generation;
+    NSTimeInterval delay = MAX(time - CFAbsoluteTimeGetCurrent(), 0);
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [self->_queue addOperationWithBlock:^{
+            if (generation == self->_generation) [self pump];
+        }];
+    });
+}
+
+/**
+ Sends the request for the file that has been due the longest, if the budget allows it, then schedules itself for when the next request can be sent.
+ */
+- (void)pump {
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    PIOMP4ConversionEntry *next;
+    
+    for (PIOMP4ConversionEntry *entry in _entries.objectEnumerator) {
+        if (!entry.isRequesting && (next == nil || entry.dueTime < next.dueTime)) next = entry;
+    }
+    
+    // Either nothing is left to poll, or every slot is taken and the next request to come back pumps again.
+    if (next == nil || _requestsInFlight >= kPIOMP4ConversionWatcherMaximumRequestsInFlight) return;
+    
+    if (next.dueTime > now || _nextRequestTime > now) {
+        [self schedulePumpAtTime:MAX(next.dueTime, _nextRequestTime)];
+        return;
+    }
+    
+    _nextRequestTime = now + 60.0 / MAX(self.maximumRequestsPerMinute, 1);
+    [self sendRequestForEntry:next];
+    [self pump];
+}
+
+- (void)sendRequestForEntry:(PIOMP4ConversionEntry *)entry {
+    entry.requesting = YES;
+    _requestsInFlight++;
+    
+    // Everything is kept on the watcher's queue, whatever queue the configuration calls back on, and the requests queue for the rate limiter apart from everyone else's.
+    [PIORateLimiter performAsCaller:@"PIOMP4ConversionWatcher" block:^{
+        pk_perform_with_callback_queue(self->_queue, ^{
+            if (entry.needsStart) {
+                [[PIOAPI beginConvertingFileWithIDToMP4:entry.fileIdentifier callback:^(NSError * _Nullable error) {
+                    if (![self finishRequestForEntry:entry]) return;
+                    
+                    if (error == nil) {
+                        entry.needsStart = NO;
+                        entry.interval = self.minimumPollInterval;
+                        entry.dueTime = CFAbsoluteTimeGetCurrent() + entry.interval;
+                    } else {
+                        [self handleError:error forEntry:entry];
+                    }
+                    
+                    [self pump];
+                }] resume];
+            } else {
+                [[PIOAPI getMP4ConversionStatusForFileWithID:entry.fileIdentifier callback:^(NSError * _Nullable error, PIOMP4Conversion * _Nullable conversion) {
+                    if (![self finishRequestForEntry:entry]) return;
+                    
+                    if (conversion != nil) {
+                        [self handleConversion:conversion forEntry:entry];
+                    } else {
+                        [self handleError:error ?: [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil] forEntry:entry];
+                    }
+                    
+                    [self pump];
+                }] resume];
+            }
+        });
+    }];
+}
+
+/**
+ Frees the request's slot. Returns whether the file is still being watched.
+ */
+- (BOOL)finishRequestForEntry:(PIOMP4ConversionEntry *)entry {
+    entry.requesting = NO;
+    _requestsInFlight--;
+    
+    if ([_entries objectForKey:@(entry.fileIdentifier)] == entry) return YES;
+    
+    [self pump];
+    return NO;
+}
+
+#pragma mark - Results
+
+- (void)handleError:(NSError *)error forEntry:(PIOMP4ConversionEntry *)entry {
+    if (pk_error_is_transient(error)) {
+        [self backOffEntry:entry];
+    } else {
+        [self completeEntry:entry withError:error conversion:nil];
+    }
+}
+
+- (void)handleConversion:(PIOMP4Conversion *)conversion forEntry:(PIOMP4ConversionEntry *)entry {
+    if ([conversion.status isEqualToString:PIOMP4StatusCompleted] || [conversion.status isEqualToString:PIOMP4StatusUnavailable]) {
+        [self completeEntry:entry withError:nil conversion:conversion];
+        return;
+    }
+    
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    
+    if ([conversion.status isEqualToString:PIOMP4StatusFinishing]) {
+        entry.interval = self.minimumPollInterval;
+        entry.dueTime = now + entry.interval;
+    } else if ([conversion.status isEqualToString:PIOMP4StatusConverting] && entry.lastPercentage >= 0 && conversion.percentageCompleted > entry.lastPercentage) {
+        // Poll again halfway to when the conversion should be done at its current rate, so the estimate is refined as it gets closer.
+        double percentagePerSecond = (conversion.percentageCompleted - entry.lastPercentage) / MAX(now - entry.lastSampleTime, DBL_EPSILON);
+        NSTimeInterval remaining = (100 - conversion.percentageCompleted) / percentagePerSecond;
+        
+        entry.interval = MIN(MAX(remaining / 2, self.minimumPollInterval), self.maximumPollInterval);
+        entry.dueTime = now + entry.interval;
+    } else {
+        // Queued, preparing or stalled: nothing to estimate from, so wait longer each time.
+        [self backOffEntry:entry];
+    }
+    
+    if ([conversion.status isEqualToString:PIOMP4StatusConverting] && conversion.percentageCompleted != entry.lastPercentage) {
+        entry.lastPercentage = conversion.percentageCompleted;
+        entry.lastSampleTime = now;
+    }
+    
+    NSInteger fileIdentifier = entry.fileIdentifier;
+    
+    for (PIOMP4ConversionWatch *watch in entry.watches) {
+        void (^progressCallback)(NSInteger, PIOMP4Conversion *) = watch.progressCallback;
+        
+        if (progressCallback == nil) continue;
+        
+        [self callBackWatch:watch block:^{
+            progressCallback(fileIdentifier, conversion);
+        }];
+    }
+}
+
+- (void)backOffEntry:(PIOMP4ConversionEntry *)entry {
+    entry.interval = MIN(entry.interval * kPIOMP4ConversionWatcherBackoffFactor, self.maximumPollInterval);
+    entry.dueTime = CFAbsoluteTimeGetCurrent() + entry.interval;
+}
+
+- (void)completeEntry:(PIOMP4ConversionEntry *)entry withError:(NSError *)error conversion:(PIOMP4Conversion *)conversion {
+    NSNumber *fileIdentifier = @(entry.fileIdentifier);
+    
+    [_entries removeObjectForKey:fileIdentifier];
+    
+    for (PIOMP4ConversionWatch *watch in entry.watches) {
+        void (^completionCallback)(NSInteger, NSError *, PIOMP4Conversion *) = watch.completionCallback;
+        
+        @synchronized (watch) {
+            [watch.pending removeObject:fileIdentifier];
+        }
+        
+        if (completionCallback == nil) continue;
+        
+        [self callBackWatch:watch block:^{
+            completionCallback(fileIdentifier.integerValue, error, conversion);
+        }];
+    }
+}
+
+/**
+ Performs a block on the watch's callback queue, unless the watch has been cancelled by the time it gets there.
+ */
+- (void)callBackWatch:(PIOMP4ConversionWatch *)watch block:(dispatch_block_t)block {
+    pk_dispatch_callback_on(watch.callbackQueue, ^{
+        if (!watch.isCancelled) block();
+    });
+}
+
+@end
@@ -0,0 +1,175 @@
+//
+//  PIORateLimiter.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A class of @b Put.io endpoints that cost about the same to the server, and so are given the same weight by a `PIORateLimiter`.
+ */
+typedef NSString *PIOEndpointClass NS_EXTENSIBLE_STRING_ENUM NS_SWIFT_NAME(EndpointClass);
+
+/** Endpoints that read or change a single object, e.g. `getFileForID:callback:`. */
+extern PIOEndpointClass const PIOEndpointClassDefault;
+
+/** Endpoints that return a list, e.g. folder listings, the transfer list and the event feed. */
+extern PIOEndpointClass const PIOEndpointClassListing;
+
+/** File search. */
+extern PIOEndpointClass const PIOEndpointClassSearch;
+
+/**
+ A snapshot of how much a `PIORateLimiter` has been holding requests back.
+ */
+NS_SWIFT_NAME(RateLimiterMetrics)
+@interface PIORateLimiterMetrics : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/** The number of requests that have been let through since the metrics were last reset. */
+@property (nonatomic, readonly) NSUInteger requestCount;
+
+/** The number of those requests that had to wait for tokens. */
+@property (nonatomic, readonly) NSUInteger delayedRequestCount;
+
+/** The number of requests that are waiting. */
+@property (nonatomic, readonly) NSUInteger queueDepth;
+
+/** The number of requests that are waiting, by the caller that made them. */
+@property (copy, nonatomic, readonly) NSDictionary<NSString *, NSNumber *> *queueDepthByCaller;
+
+/** The largest number of requests that have been waiting at once since the metrics were last reset. */
+@property (nonatomic, readonly) NSUInteger peakQueueDepth;
+
+/** The time (in seconds) requests that have been let through spent waiting, added together. */
+@property (nonatomic, readonly) NSTimeInterval totalWaitTime;
+
+/** The average time (in seconds) a request that has been let through spent waiting, counting those that didn't wait at all. */
+@property (nonatomic, readonly) NSTimeInterval averageWaitTime;
+
+/** The longest time (in seconds) a request that has been let through spent waiting. */
+@property (nonatomic, readonly) NSTimeInterval maximumWaitTime;
+
+@end
+
+/**
+ A token bucket that every request to @b api.put.io has to take tokens out of before it is sent, so that bursts of requests from batch work are spread out instead of running into @b Put.io's rate limits, which apply to the whole account.
+ 
+ The bucket fills at `rate` tokens per second, up to `capacity`. Each request costs the weight of its endpoint class, so a search can be made to cost more than fetching a single file. A request that can't be paid for waits, without holding up the thread that resumed it.
+ 
+ Waiting requests are queued by caller, and the tokens are shared out fairly between callers rather than in the order requests were made, so a batch job that queues hundreds of requests doesn't hold up the requests made while it runs. Requests are attributed to the caller named with `performAsCaller:block:`; PutKit's own batch components each name themselves.
+ 
+ A limiter is shared by every copy of the `PIOConfiguration` it is set on.
+ */
+NS_SWIFT_NAME(RateLimiter)
+@interface PIORateLimiter : NSObject
+
+/**
+ Creates a limiter.
+ 
+ @param rate        The number of tokens added to the bucket per second.
+ @param capacity    The largest number of tokens the bucket holds, which is the largest burst of requests that is sent without waiting. The bucket starts full.
+ */
+- (instancetype)initWithRate:(double)rate capacity:(double)capacity NS_DESIGNATED_INITIALIZER NS_SWIFT_NAME(init(rate:capacity:));
+
+/**
+ Creates a limiter that adds @b 10 tokens per second, up to @b 20.
+ */
+- (instancetype)init;
+
+/** The number of tokens added to the bucket per second. */
+@property (nonatomic, readonly) double rate;
+
+/** The largest number of tokens the bucket holds. */
+@property (nonatomic, readonly) double capacity;
+
+/**
+ Sets the number of tokens requests to a class of endpoints cost. Weights larger than `capacity` are treated as `capacity`.
+ 
+ By default, @b PIOEndpointClassDefault costs @b 1, @b PIOEndpointClassListing @b 2 and @b PIOEndpointClassSearch @b 5.
+ 
+ @param weight          The number of tokens.
+ @param endpointClass   The class of endpoints.
+ */
+- (void)setWeight:(double)weight forEndpointClass:(PIOEndpointClass)endpointClass NS_SWIFT_NAME(setWeight(_:for:));
+
+/**
+ Returns the number of tokens requests to a class of endpoints cost.
+ 
+ @param endpointClass   The class of endpoints.
+ */
+- (double)weightForEndpointClass:(PIOEndpointClass)endpointClass NS_SWIFT_NAME(weight(for:));
+
+/**
+ Returns the class of the endpoint a request is sent to.
+ 
+ @param request The request.
+ */
++ (PIOEndpointClass)endpointClassForRequest:(NSURLRequest *)request NS_SWIFT_NAME(endpointClass(for:));
+
+/**
+ Performs a block, attributing every request that is created inside it to the named caller, so that it is queued fairly against those of other callers. Requests that aren't made inside such a block are attributed to a caller of their own.
+ 
+ @param caller  The name of the caller, e.g. @b "sync".
+ @param block   The block that creates the requests. It is performed synchronously, on the calling thread.
+ */
++ (void)performAsCaller:(NSString *)caller block:(NS_NOESCAPE void (^)(void))block NS_SWIFT_NAME(perform(asCaller:_:));
+
+/** The caller named by the innermost `performAsCaller:block:` being performed on the current thread, if any. */
+@property (class, nonatomic, readonly, nullable) NSString *currentCaller;
+
+/**
+ Waits until the tokens a request costs can be taken out of the bucket. The session does this for every request to @b api.put.io when it is resumed; it only needs to be called directly for requests that are sent some other way.
+ 
+ @param request The request, which decides the weight.
+ @param caller  The caller the request is attributed to, or `nil` for the same caller as requests made outside `performAsCaller:block:`.
+ @param handler The block that is called once the tokens have been taken, on an arbitrary queue. It is called straight away, on the calling thread, if no other request is waiting and the tokens are there.
+ 
+ @return    An opaque object to be passed to `cancelWait:`.
+ */
+- (id<NSObject>)waitForRequest:(NSURLRequest *)request caller:(nullable NSString *)caller handler:(dispatch_block_t)handler;
+
+/**
+ Stops waiting for tokens, without calling the handler. Does nothing if the handler has already been called.
+ 
+ @param wait    The object returned by `waitForRequest:caller:handler:`.
+ */
+- (void)cancelWait:(id<NSObject>)wait;
+
+/**
+ Returns a snapshot of the limiter's metrics.
+ */
+- (PIORateLimiterMetrics *)metrics;
+
+/**
+ Resets the request counts and wait times of the metrics.
+ */
+- (void)resetMetrics;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,347 @@
+//
+//  PIORateLimiter.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIORateLimiter.h"
+
+PIOEndpointClass const PIOEndpointClassDefault = @"default";
+PIOEndpointClass const PIOEndpointClassListing = @"listing";
+PIOEndpointClass const PIOEndpointClassSearch = @"search";
+
+static double const kPIORateLimiterDefaultRate = 10;
+static double const kPIORateLimiterDefaultCapacity = 20;
+static NSString * const kPIORateLimiterDefaultCaller = @"default";
+static NSString * const kPIORateLimiterCallerThreadKey = @"io.put.kit.rate-limiter-caller";
+
+@interface PIORateLimiterMetrics ()
+
+- (instancetype)initWithRequestCount:(NSUInteger)requestCount
+                 delayedRequestCount:(NSUInteger)delayedRequestCount
+                  queueDepthByCaller:(NSDictionary<NSString *, NSNumber *> *)queueDepthByCaller
+                      peakQueueDepth:(NSUInteger)peakQueueDepth
+                       totalWaitTime:(NSTimeInterval)totalWaitTime
+                     maximumWaitTime:(NSTimeInterval)maximumWaitTime NS_DESIGNATED_INITIALIZER;
+
+@end
+
+@implementation PIORateLimiterMetrics
+
+- (instancetype)initWithRequestCount:(NSUInteger)requestCount
+                 delayedRequestCount:(NSUInteger)delayedRequestCount
+                  queueDepthByCaller:(NSDictionary<NSString *, NSNumber *> *)queueDepthByCaller
+                      peakQueueDepth:(NSUInteger)peakQueueDepth
+                       totalWaitTime:(NSTimeInterval)totalWaitTime
+                     maximumWaitTime:(NSTimeInterval)maximumWaitTime {
+    self = [super init];
+    
+    if (self) {
+        _requestCount = requestCount;
+        _delayedRequestCount = delayedRequestCount;
+        _queueDepthByCaller = [queueDepthByCaller copy];
+        _peakQueueDepth = peakQueueDepth;
+        _totalWaitTime = totalWaitTime;
+        _maximumWaitTime = maximumWaitTime;
+        
+        for (NSNumber *depth in queueDepthByCaller.objectEnumerator) _queueDepth += depth.unsignedIntegerValue;
+    }
+    
+    return self;
+}
+
+- (NSTimeInterval)averageWaitTime {
+    return self.requestCount == 0 ? 0 : self.totalWaitTime / self.requestCount;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p> requestCount = %tu; delayedRequestCount = %tu; queueDepth = %tu; peakQueueDepth = %tu; averageWaitTime = %lf; maximumWaitTime = %lf", [self class], self, self.requestCount, self.delayedRequestCount, self.queueDepth, self.peakQueueDepth, self.averageWaitTime, self.maximumWaitTime];
+}
+
+@end
+
+/**
+ A request waiting for tokens.
+ */
+@interface PIORateLimiterWait : NSObject
+
+@property (copy, nonatomic) NSString *caller;
+@property (nonatomic) double weight;
+
+/** The virtual time at which the request would have been let through had every caller been given its share of tokens. The request with the earliest finish is let through first. */
+@property (nonatomic) double finish;
+
+@property (nonatomic) NSTimeInterval enqueuedAt;
+@property (copy, nonatomic, nullable) dispatch_block_t handler;
+
+@end
+
+@implementation PIORateLimiterWait
+
+@end
+
+@implementation PIORateLimiter {
+    // Everything is guarded by `self`.
+    NSMutableDictionary<PIOEndpointClass, NSNumber *> *_weights;
+    double _tokens;
+    NSTimeInterval _refilledAt;
+    NSMutableDictionary<NSString *, NSMutableArray<PIORateLimiterWait *> *> *_queues; // Waiting requests, by caller. Callers without any are removed.
+    NSMutableDictionary<NSString *, NSNumber *> *_lastFinishes; // The finish of the last request queued by each waiting caller.
+    double _virtualTime;
+    NSUInteger _generation; // Bumped whenever a drain is scheduled, so that drains scheduled before it do nothing.
+    NSUInteger _queueDepth;
+    
+    // Metrics.
+    NSUInteger _requestCount;
+    NSUInteger _delayedRequestCount;
+    NSUInteger _peakQueueDepth;
+    NSTimeInterval _totalWaitTime;
+    NSTimeInterval _maximumWaitTime;
+}
+
+- (instancetype)init {
+    return [self initWithRate:kPIORateLimiterDefaultRate capacity:kPIORateLimiterDefaultCapacity];
+}
+
+- (instancetype)initWithRate:(double)rate capacity:(double)capacity {
+    NSAssert(rate > 0 && capacity > 0, @"A rate limiter must let some requests through.");
+    
+    self = [super init];
+    
+    if (self) {
+        _rate = rate;
+        _capacity = capacity;
+        _tokens = capacity;
+        _refilledAt = [NSProcessInfo processInfo].systemUptime;
+        _weights = [@{PIOEndpointClassDefault: @1, PIOEndpointClassListing: @2, PIOEndpointClassSearch: @5} mutableCopy];
+        _queues = [NSMutableDictionary dictionary];
+        _lastFinishes = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+- (void)setWeight:(double)weight forEndpointClass:(PIOEndpointClass)endpointClass {
+    @synchronized (self) {
+        [_weights setObject:@(weight) forKey:endpointClass];
+    }
+}
+
+- (double)weightForEndpointClass:(PIOEndpointClass)endpointClass {
+    @synchronized (self) {
+        return [([_weights objectForKey:endpointClass] ?: [_weights objectForKey:PIOEndpointClassDefault]) doubleValue];
+    }
+}
+
++ (PIOEndpointClass)endpointClassForRequest:(NSURLRequest *)request {
+    NSArray<NSString *> *components = request.URL.pathComponents; // "/", "v2", "files", "search", ...
+    
+    if ([components containsObject:@"search"]) return PIOEndpointClassSearch;
+    
+    // The first page of a list and every page after it.
+    if ([components.lastObject isEqualToString:@"list"] || [components containsObject:@"continue"]) return PIOEndpointClassListing;
+    
+    return PIOEndpointClassDefault;
+}
+
+#pragma mark - Callers
+
++ (void)performAsCaller:(NSString *)caller block:(void (^)(void))block {
+    NSMutableDictionary *threadDictionary = [NSThread currentThread].threadDictionary;
+    NSString *previousCaller = threadDictionary[kPIORateLimiterCallerThreadKey];
+    
+    threadDictionary[kPIORateLimiterCallerThreadKey] = caller;
+    
+    @try {
+        block();
+    } @finally {
+        threadDictionary[kPIORateLimiterCallerThreadKey] = previousCaller;
+    }
+}
+
++ (NSString *)currentCaller {
+    return [NSThread currentThread].threadDictionary[kPIORateLimiterCallerThreadKey];
+}
+
+#pragma mark - Waiting
+
+- (void)refill {
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+    
+    _tokens = MIN(_tokens + (now - _refilledAt) * _rate, _capacity);
+    _refilledAt = now;
+}
+
+- (id<NSObject>)waitForRequest:(NSURLRequest *)request caller:(NSString *)caller handler:(dispatch_block_t)handler {
+    PIORateLimiterWait *wait = [PIORateLimiterWait new];
+    double weight = MIN([self weightForEndpointClass:[PIORateLimiter endpointClassForRequest:request]], _capacity);
+    
+    wait.caller = caller ?: kPIORateLimiterDefaultCaller;
+    wait.weight = weight;
+    wait.handler = handler;
+    
+    @synchronized (self) {
+        [self refill];
+        
+        wait.enqueuedAt = _refilledAt;
+        
+        // Nobody is waiting, so there's nobody to be fair to.
+        if (_queues.count == 0 && _tokens >= weight) {
+            _tokens -= weight;
+            _requestCount++;
+            wait.handler = nil;
+        } else {
+            NSMutableArray<PIORateLimiterWait *> *queue = _queues[wait.caller];
+            
+            if (queue == nil) _queues[wait.caller] = queue = [NSMutableArray array];
+            
+            wait.finish = MAX(_virtualTime, [_lastFinishes[wait.caller] doubleValue]) + weight;
+            _lastFinishes[wait.caller] = @(wait.finish);
+            
+            [queue addObject:wait];
+            
+            _queueDepth++;
+            _peakQueueDepth = MAX(_peakQueueDepth, _queueDepth);
+            
+            if (_queueDepth == 1) [self scheduleDrainAfterDelay:(weight - _tokens) / _rate];
+            
+            return wait;
+        }
+    }
+    
+    handler();
+    
+    return wait;
+}
+
+- (void)cancelWait:(id<NSObject>)wait {
+    PIORateLimiterWait *limiterWait = (PIORateLimiterWait *)wait;
+    
+    @synchronized (self) {
+        NSMutableArray<PIORateLimiterWait *> *queue = _queues[limiterWait.caller];
+        
+        if (![queue containsObject:limiterWait]) return;
+        
+        [self removeWait:limiterWait];
+        
+        // The request that was holding the others up may have been the one that was cancelled.
+        [self scheduleDrainAfterDelay:0];
+    }
+}
+
+- (void)removeWait:(PIORateLimiterWait *)wait {
+    NSMutableArray<PIORateLimiterWait *> *queue = _queues[wait.caller];
+    
+    [queue removeObjectIdenticalTo:wait];
+    _queueDepth--;
+    
+    if (queue.count == 0) {
+        [_queues removeObjectForKey:wait.caller];
+        [_lastFinishes removeObjectForKey:wait.caller];
+    }
+}
+
+- (void)scheduleDrainAfterDelay:(NSTimeInterval)delay {
+    NSUInteger generation = ++_generation;
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(MAX(delay, 0) * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [self drainWithGeneration:generation];
+    });
+}
+
+/**
+ Lets through as many waiting requests as there are tokens for, earliest finish first, and schedules the next drain for when the next request can be paid for.
+ */
+- (void)drainWithGeneration:(NSUInteger)generation {
+    NSMutableArray<dispatch_block_t> *handlers = [NSMutableArray array];
+    
+    @synchronized (self) {
+        if (generation != _generation) return;
+        
+        [self refill];
+        
+        while (_queues.count > 0) {
+            PIORateLimiterWait *next;
+            
+            for (NSMutableArray<PIORateLimiterWait *> *queue in _queues.objectEnumerator) {
+                if (next == nil || queue.firstObject.finish < next.finish) next = queue.firstObject;
+            }
+            
+            if (_tokens < next.weight) {
+                [self scheduleDrainAfterDelay:(next.weight - _tokens) / _rate];
+                break;
+            }
+            
+            NSTimeInterval waitTime = _refilledAt - next.enqueuedAt;
+            
+            _tokens -= next.weight;
+            _virtualTime = MAX(_virtualTime, next.finish - next.weight);
+            
+            _requestCount++;
+            _delayedRequestCount++;
+            _totalWaitTime += waitTime;
+            _maximumWaitTime = MAX(_maximumWaitTime, waitTime);
+            
+            [self removeWait:next];
+            [handlers addObject:next.handler];
+            next.handler = nil;
+        }
+    }
+    
+    for (dispatch_block_t handler in handlers) handler();
+}
+
+#pragma mark - Metrics
+
+- (PIORateLimiterMetrics *)metrics {
+    @synchronized (self) {
+        NSMutableDictionary<NSString *, NSNumber *> *queueDepthByCaller = [NSMutableDictionary dictionaryWithCapacity:_queues.count];
+        
+        [_queues enumerateKeysAndObjectsUsingBlock:^(NSString *caller, NSMutableArray<PIORateLimiterWait *> *queue, BOOL *stop) {
+            queueDepthByCaller[caller] = @(queue.count);
+        }];
+        
+        return [[PIORateLimiterMetrics alloc] initWithRequestCount:_requestCount
+                                               delayedRequestCount:_delayedRequestCount
+                                                queueDepthByCaller:queueDepthByCaller
+                                                    peakQueueDepth:_peakQueueDepth
+                                                     totalWaitTime:_totalWaitTime
+                                                   maximumWaitTime:_maximumWaitTime];
+    }
+}
+
+- (void)resetMetrics {
+    @synchronized (self) {
+        _requestCount = 0;
+        _delayedRequestCount = 0;
+        _peakQueueDepth = _queueDepth;
+        _totalWaitTime = 0;
+        _maximumWaitTime = 0;
+    }
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p> rate = %lf; capacity = %lf; weights = %@", [self class], self, self.rate, self.capacity, _weights];
+}
+
+@end
@@ -0,0 +1,105 @@
+//
+//  PIOResumableUpload.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+#import "PIOErrorOnlyCallback.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An upload to @b upload.put.io that survives dropped connections and application restarts.
+ 
+ The file is sent in chunks of `chunkSize` bytes using the tus resumable upload protocol. Every chunk the server acknowledges is recorded in a small journal on disk, so after a network failure the upload carries on from the last acknowledged offset instead of starting over, and after a restart it can be picked up again from `pendingUploads`.
+ 
+ Unlike `uploadFileAtURL:toFolderWithID:newFileName:callback:`, only one chunk of the file is ever held in memory.
+ */
+NS_SWIFT_NAME(ResumableUpload)
+@interface PIOResumableUpload : NSObject
+
+/**
+ Every upload that was started but neither finished nor cancelled, including those started by a previous launch of the application. Call `resumeWithCallback:` on them to carry on uploading.
+ */
+@property (class, strong, nonatomic, readonly) NSArray<PIOResumableUpload *> *pendingUploads;
+
+/**
+ Creates a new upload. Nothing is sent and nothing is journaled until `resumeWithCallback:` is first called.
+ 
+ @param fileURL             A url pointing to a valid file on the current device.
+ @param parentIdentifier    The identifier of the folder to which the file should be uploaded.
+ @param fileName            The name to change the file to when it has been successfully uploaded to @b Put.io. If `nil` is passed in, the original file name will be kept.
+ */
+- (instancetype)initWithFileAtURL:(NSURL *)fileURL
+                   toFolderWithID:(NSInteger)parentIdentifier
+                      newFileName:(NSString * _Nullable)fileName NS_DESIGNATED_INITIALIZER NS_SWIFT_NAME(init(file:toFolder:newName:));
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/** A unique identifier for the upload that stays the same across launches. */
+@property (strong, nonatomic, readonly) NSString *identifier;
+
+/** The file being uploaded. */
+@property (strong, nonatomic, readonly) NSURL *fileURL NS_SWIFT_NAME(fileUrl);
+
+/** The identifier of the folder to which the file is being uploaded. */
+@property (nonatomic, readonly) NSInteger parentIdentifier NS_SWIFT_NAME(parentId);
+
+/** The name the file will have on @b Put.io. */
+@property (strong, nonatomic, readonly) NSString *fileName;
+
+/** The total size of the file (in bytes). */
+@property (nonatomic, readonly) int64_t totalBytes;
+
+/** The number of bytes the server has acknowledged. An upload resumes from here. */
+@property (nonatomic, readonly) int64_t uploadedBytes;
+
+/** The number of bytes sent in each request. Only this many bytes of the file are held in memory at once, and at most this many bytes have to be sent again after a dropped connection. Defaults to @b 8 MB. */
+@property (nonatomic) NSUInteger chunkSize;
+
+/** The number of times in a row a chunk is retried after a network failure or server error before the upload gives up and calls its callback with the error. Defaults to @b 5. */
+@property (nonatomic) NSUInteger maximumRetryCount;
+
+/** A block called on the callback queue as bytes are sent, with the total number of bytes sent so far and the size of the file. */
+@property (copy, nonatomic, nullable) void (^progressCallback)(int64_t bytesSent, int64_t totalBytes);
+
+/**
+ Starts or carries on uploading the file from the last acknowledged offset.
+ 
+ @param callback    The block that is called on the callback queue when the upload finishes or gives up. If the upload gives up, it is still journaled and can be resumed again later.
+ */
+- (void)resumeWithCallback:(PIOErrorOnlyCallback _Nullable)callback NS_SWIFT_NAME(resume(callback:));
+
+/**
+ Stops sending the file but keeps the journal, so the upload can be resumed later. The callback of the last call to `resumeWithCallback:` is not called.
+ */
+- (void)suspend;
+
+/**
+ Stops sending the file, deletes the journal and asks the server to discard the bytes it has received.
+ */
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,465 @@
+//
+//  PIOResumableUpload.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIOResumableUpload.h"
+#import "PIOSession.h"
+#import "PIOEndpoints.h"
+#import "PIOError.h"
+#import "PIOAuth.h"
+#import "AFOAuthCredential.h"
+#import "PIOCallbackQueue.h"
+
+static NSString * const kPIOTusVersion = @"1.0.0";
+static NSUInteger const kPIOResumableUploadDefaultChunkSize = 8 * 1024 * 1024;
+static NSUInteger const kPIOResumableUploadDefaultMaximumRetryCount = 5;
+static NSTimeInterval const kPIOResumableUploadRetryBaseDelay = 0.5;
+static NSTimeInterval const kPIOResumableUploadRetryMaximumDelay = 30;
+
+static NSString * const kPIOJournalIdentifierKey = @"identifier";
+static NSString * const kPIOJournalFilePathKey = @"file_path";
+static NSString * const kPIOJournalParentIdentifierKey = @"parent_id";
+static NSString * const kPIOJournalFileNameKey = @"file_name";
+static NSString * const kPIOJournalTotalBytesKey = @"total_bytes";
+static NSString * const kPIOJournalUploadedBytesKey = @"uploaded_bytes";
+static NSString * const kPIOJournalModificationDateKey = @"modification_date";
+static NSString * const kPIOJournalUploadURLKey = @"upload_url";
+
+/**
+ Returns whether the tus server turned a chunk down because its offset doesn't match the server's (409) or because another request is still writing to the upload (423), both of which are fixed by asking for the offset again.
+ */
+static BOOL pk_error_is_offset_conflict(NSError *error) {
+    return [error.domain isEqualToString:kPIOErrorDomain] && (error.code == 409 || error.code == 423);
+}
+
+@interface PIOResumableUpload () <NSURLSessionDataDelegate>
+
+@property (strong, nonatomic, readwrite) NSString *identifier;
+@property (nonatomic, readwrite) int64_t totalBytes;
+@property (nonatomic, readwrite) int64_t uploadedBytes;
+
+@end
+
+@implementation PIOResumableUpload {
+    dispatch_queue_t _queue;
+    NSOperationQueue *_callbackQueue; // The callback queue of whoever last resumed the upload, or `nil` to call back inline.
+    NSURL *_uploadURL;
+    NSDate *_modificationDate;
+    BOOL _offsetConfirmed;
+    BOOL _running;
+    NSUInteger _retryCount;
+    NSUInteger _generation; // Bumped every time the upload is suspended so that the handlers of abandoned requests do nothing.
+    NSURLSessionTask *_task;
+    PIOErrorOnlyCallback _callback;
+}
+
+#pragma mark - Journal
+
++ (NSURL *)journalDirectoryURL {
+#if TARGET_OS_TV
+    NSSearchPathDirectory directory = NSCachesDirectory; // tvOS applications can't write to Application Support.
+#else
+    NSSearchPathDirectory directory = NSApplicationSupportDirectory;
+#endif
+    NSURL *URL = [[NSFileManager defaultManager] URLsForDirectory:directory inDomains:NSUserDomainMask].firstObject;
+    
+    return [URL URLByAppendingPathComponent:@"io.put.kit/uploads" isDirectory:YES];
+}
+
++ (NSArray<PIOResumableUpload *> *)pendingUploads {
+    NSArray<NSURL *> *journalURLs = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:[self journalDirectoryURL] includingPropertiesForKeys:nil options:NSDirectoryEnumerationSkipsHiddenFiles error:nil];
+    NSMutableArray *uploads = [NSMutableArray arrayWithCapacity:journalURLs.count];
+    
+    for (NSURL *journalURL in journalURLs) {
+        PIOResumableUpload *upload = [[PIOResumableUpload alloc] initWithJournal:[NSDictionary dictionaryWithContentsOfURL:journalURL]];
+        
+        upload == nil ?: [uploads addObject:upload];
+    }
+    
+    return uploads;
+}
+
+- (instancetype)initWithJournal:(NSDictionary *)journal {
+    NSString *identifier = [journal objectForKey:kPIOJournalIdentifierKey];
+    NSString *filePath = [journal objectForKey:kPIOJournalFilePathKey];
+    NSString *fileName = [journal objectForKey:kPIOJournalFileNameKey];
+    
+    if (![identifier isKindOfClass:NSString.class] || ![filePath isKindOfClass:NSString.class] || ![fileName isKindOfClass:NSString.class]) return nil;
+    
+    self = [self initWithFileAtURL:[NSURL fileURLWithPath:filePath.stringByExpandingTildeInPath]
+                    toFolderWithID:[[journal objectForKey:kPIOJournalParentIdentifierKey] integerValue]
+                       newFileName:fileName];
+    
+    if (self) {
+        NSString *uploadURLString = [journal objectForKey:kPIOJournalUploadURLKey];
+        
+        _identifier = identifier;
+        _totalBytes = [[journal objectForKey:kPIOJournalTotalBytesKey] longLongValue];
+        _uploadedBytes = [[journal objectForKey:kPIOJournalUploadedBytesKey] longLongValue];
+        _modificationDate = [journal objectForKey:kPIOJournalModificationDateKey];
+        _uploadURL = [uploadURLString isKindOfClass:NSString.class] ? [NSURL URLWithString:uploadURLString] : nil;
+    }
+    
+    return self;
+}
+
+- (NSURL *)journalURL {
+    return [[self.class journalDirectoryURL] URLByAppendingPathComponent:[_identifier stringByAppendingPathExtension:@"plist"]];
+}
+
+- (void)writeJournal {
+    NSMutableDictionary *journal = [NSMutableDictionary dictionary];
+    
+    // Paths are stored relative to the home directory, which moves when an iOS application is updated.
+    [journal setObject:_identifier forKey:kPIOJournalIdentifierKey];
+    [journal setObject:_fileURL.path.stringByAbbreviatingWithTildeInPath forKey:kPIOJournalFilePathKey];
+    [journal setObject:@(_parentIdentifier) forKey:kPIOJournalParentIdentifierKey];
+    [journal setObject:_fileName forKey:kPIOJournalFileNameKey];
+    [journal setObject:@(_totalBytes) forKey:kPIOJournalTotalBytesKey];
+    [journal setObject:@(_uploadedBytes) forKey:kPIOJournalUploadedBytesKey];
+    
+    _modificationDate == nil ?: [journal setObject:_modificationDate forKey:kPIOJournalModificationDateKey];
+    _uploadURL == nil ?: [journal setObject:_uploadURL.absoluteString forKey:kPIOJournalUploadURLKey];
+    
+    [[NSFileManager defaultManager] createDirectoryAtURL:[self.class journalDirectoryURL] withIntermediateDirectories:YES attributes:nil error:nil];
+    [journal writeToURL:[self journalURL] atomically:YES];
+}
+
+- (void)removeJournal {
+    [[NSFileManager defaultManager] removeItemAtURL:[self journalURL] error:nil];
+}
+
+#pragma mark - Initialisation
+
+- (instancetype)initWithFileAtURL:(NSURL *)fileURL
+                   toFolderWithID:(NSInteger)parentIdentifier
+                      newFileName:(NSString *)fileName {
+    self = [super init];
+    
+    if (self) {
+        _identifier = [NSUUID UUID].UUIDString;
+        _fileURL = fileURL;
+        _parentIdentifier = parentIdentifier;
+        _fileName = fileName ?: fileURL.lastPathComponent;
+        _chunkSize = kPIOResumableUploadDefaultChunkSize;
+        _maximumRetryCount = kPIOResumableUploadDefaultMaximumRetryCount;
+        _queue = dispatch_queue_create("io.put.kit.upload", DISPATCH_QUEUE_SERIAL);
+    }
+    
+    return self;
+}
+
+#pragma mark - Uploading
+
+- (void)resumeWithCallback:(PIOErrorOnlyCallback)callback {
+    NSOperationQueue *callbackQueue = pk_callback_queue();
+    
+    dispatch_async(_queue, ^{
+        self->_callback = [callback copy];
+        self->_callbackQueue = callbackQueue;
+        
+        if (self->_running) return;
+        
+        self->_running = YES;
+        self->_retryCount = 0;
+        self->_offsetConfirmed = NO;
+        
+        NSError *error;
+        
+        if (![self validateFileWithError:&error]) {
+            [self finishWithError:error];
+            return;
+        }
+        
+        [self step];
+    });
+}
+
+- (void)suspend {
+    dispatch_async(_queue, ^{
+        self->_generation++;
+        self->_running = NO;
+        self->_callback = nil;
+        
+        [self->_task cancel];
+        self->_task = nil;
+    });
+}
+
+- (void)cancel {
+    [self suspend];
+    
+    dispatch_async(_queue, ^{
+        [self removeJournal];
+        
+        if (self->_uploadURL != nil) {
+            [[[PIOSession sharedInstance] dataTaskWithRequest:[self requestWithURL:self->_uploadURL method:@"DELETE"] completionHandler:^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {}] resume];
+        }
+        
+        self->_uploadURL = nil;
+        self.uploadedBytes = 0;
+    });
+}
+
+- (BOOL)validateFileWithError:(NSError * _Nullable *)error {
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:_fileURL.path error:error];
+    
+    if (attributes == nil) return NO;
+    
+    int64_t fileSize = (int64_t)attributes.fileSize;
+    NSDate *modificationDate = attributes.fileModificationDate;
+    
+    // The bytes already on the server are only worth keeping if they came from the file as it is now.
+    if (_uploadURL != nil && (fileSize != _totalBytes || ![modificationDate isEqualToDate:_modificationDate])) {
+        _uploadURL = nil;
+        self.uploadedBytes = 0;
+    }
+    
+    self.totalBytes = fileSize;
+    _modificationDate = modificationDate;
+    
+    [self writeJournal];
+    
+    return YES;
+}
+
+- (void)step {
+    if (_uploadURL == nil) {
+        [self createUpload];
+    } else if (!_offsetConfirmed) {
+        [self fetchOffset];
+    } else if (_uploadedBytes >= _totalBytes) {
+        [self finishWithError:nil];
+    } else {
+        [self sendChunk];
+    }
+}
+
+- (NSMutableURLRequest *)requestWithURL:(NSURL *)URL method:(NSString *)method {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:URL cachePolicy:NSURLRequestReloadIgnoringLocalCacheData timeoutInterval:[PIOSession sharedInstance].configuration.timeoutIntervalForRequest];
+    AFOAuthCredential *credential = [PIOAuth sharedInstance].credential;
+    
+    [request setHTTPMethod:method];
+    [request setValue:kPIOTusVersion forHTTPHeaderField:@"Tus-Resumable"];
+    [request setValue:[NSString stringWithFormat:@"%@ %@", credential.tokenType, credential.accessToken] forHTTPHeaderField:@"authorization"];
+    
+    return request;
+}
+
+- (void (^)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable))completionHandlerWithBlock:(void (^)(NSURLResponse * _Nullable response))block {
+    NSUInteger generation = _generation;
+    
+    return ^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
+        dispatch_async(self->_queue, ^{
+            if (generation != self->_generation) return;
+            
+            NSError *responseError = error;
+            
+            self->_task = nil;
+            
+            // tus responses have no body, so only the status code and any error envelope are checked.
+            pk_response_decode(data ?: [NSData data], response, &responseError);
+            
+            responseError == nil ? block(response) : [self retryAfterError:responseError];
+        });
+    };
+}
+
+/**
+ Creates a task for a request with no body to upload. Failed requests are retried by `retryAfterError:`, so the session doesn't retry them as well.
+ */
+- (NSURLSessionDataTask *)dataTaskWithRequest:(NSURLRequest *)request block:(void (^)(NSURLResponse * _Nullable response))block {
+    __block NSURLSessionDataTask *task;
+    
+    [PIOSession performWithoutRetries:^{
+        task = [[PIOSession sharedInstance] dataTaskWithRequest:request completionHandler:[self completionHandlerWithBlock:block]];
+    }];
+    
+    return task;
+}
+
+- (void)startTask:(NSURLSessionTask *)task {
+    _task = task;
+    [task resume];
+}
+
+- (void)createUpload {
+    NSMutableURLRequest *request = [self requestWithURL:[NSURL URLWithString:kPIOEndpointResumableUploads] method:@"POST"];
+    NSString *encodedName = [[_fileName dataUsingEncoding:NSUTF8StringEncoding] base64EncodedStringWithOptions:0];
+    NSString *encodedParent = [[@(_parentIdentifier).stringValue dataUsingEncoding:NSUTF8StringEncoding] base64EncodedStringWithOptions:0];
+    
+    [request setValue:@(_totalBytes).stringValue forHTTPHeaderField:@"Upload-Length"];
+    [request setValue:[NSString stringWithFormat:@"name %@,parent_id %@", encodedName, encodedParent] forHTTPHeaderField:@"Upload-Metadata"];
+    
+    [self startTask:[self dataTaskWithRequest:request block:^(NSURLResponse *response) {
+        NSString *location = pk_header_value(response, @"Location");
+        
+        if (location == nil) {
+            [self finishWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil]];
+            return;
+        }
+        
+        self->_uploadURL = [NSURL URLWithString:location relativeToURL:request.URL].absoluteURL;
+        self->_offsetConfirmed = YES;
+        self->_retryCount = 0;
+        self.uploadedBytes = 0;
+        
+        [self writeJournal];
+        [self step];
+    }]];
+}
+
+- (void)fetchOffset {
+    NSMutableURLRequest *request = [self requestWithURL:_uploadURL method:@"HEAD"];
+    
+    [self startTask:[self dataTaskWithRequest:request block:^(NSURLResponse *response) {
+        [self acknowledgeOffset:pk_header_value(response, @"Upload-Offset")];
+    }]];
+}
+
+- (void)sendChunk {
+    NSError *error;
+    NSData *chunk = [self readChunkAtOffset:_uploadedBytes error:&error];
+    
+    if (chunk == nil) {
+        [self finishWithError:error];
+        return;
+    }
+    
+    NSMutableURLRequest *request = [self requestWithURL:_uploadURL method:@"PATCH"];
+    
+    [request setValue:@(_uploadedBytes).stringValue forHTTPHeaderField:@"Upload-Offset"];
+    [request setValue:@"application/offset+octet-stream" forHTTPHeaderField:@"Content-Type"];
+    
+    PIOSession *session = [PIOSession sharedInstance];
+    NSURLSessionUploadTask *task = [session uploadTaskWithRequest:request fromData:chunk completionHandler:[self completionHandlerWithBlock:^(NSURLResponse *response) {
+        self->_retryCount = 0;
+        [self acknowledgeOffset:pk_header_value(response, @"Upload-Offset")];
+    }]];
+    
+    [session setDelegate:self forTask:task];
+    [self startTask:task];
+}
+
+- (void)acknowledgeOffset:(NSString *)offsetString {
+    if (offsetString == nil) {
+        [self finishWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil]];
+        return;
+    }
+    
+    self.uploadedBytes = offsetString.longLongValue;
+    _offsetConfirmed = YES;
+    
+    [self writeJournal];
+    [self reportProgress:_uploadedBytes];
+    [self step];
+}
+
+- (NSData *)readChunkAtOffset:(int64_t)offset error:(NSError * _Nullable *)error {
+    size_t length = (size_t)MIN((int64_t)_chunkSize, _totalBytes - offset);
+    NSMutableData *chunk = [NSMutableData dataWithLength:length];
+    FILE *file = fopen(_fileURL.fileSystemRepresentation, "rb");
+    size_t count = 0;
+    int code = EIO;
+    
+    if (file != NULL) {
+        if (fseeko(file, offset, SEEK_SET) == 0) count = fread(chunk.mutableBytes, 1, length, file);
+        if (count != length && ferror(file)) code = errno;
+        fclose(file);
+    } else {
+        code = errno;
+    }
+    
+    if (count != length) {
+        *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:code userInfo:@{NSFilePathErrorKey: _fileURL.path}];
+        return nil;
+    }
+    
+    return chunk;
+}
+
+- (void)retryAfterError:(NSError *)error {
+    BOOL expired = _uploadURL != nil && [error.domain isEqualToString:kPIOErrorDomain] && (error.code == 404 || error.code == 410);
+    
+    if (!pk_error_is_transient(error) && !pk_error_is_offset_conflict(error) && !expired) {
+        [self finishWithError:error];
+        return;
+    }
+    
+    if (_retryCount >= _maximumRetryCount) {
+        [self finishWithError:error];
+        return;
+    }
+    
+    // The server has forgotten the upload (tus uploads expire), so the file has to be sent again from the start.
+    if (expired) {
+        _uploadURL = nil;
+        self.uploadedBytes = 0;
+        [self writeJournal];
+    }
+    
+    NSTimeInterval delay = MIN(kPIOResumableUploadRetryBaseDelay * pow(2, _retryCount), kPIOResumableUploadRetryMaximumDelay);
+    NSUInteger generation = _generation;
+    
+    _retryCount++;
+    _offsetConfirmed = NO; // The server may have stored part of the chunk before the connection dropped.
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), _queue, ^{
+        if (generation == self->_generation) [self step];
+    });
+}
+
+- (void)finishWithError:(NSError *)error {
+    PIOErrorOnlyCallback callback = _callback;
+    
+    _running = NO;
+    _callback = nil;
+    
+    error != nil ?: [self removeJournal];
+    
+    pk_dispatch_callback_on(_callbackQueue, ^{
+        callback == nil ?: callback(error);
+    });
+}
+
+- (void)reportProgress:(int64_t)bytesSent {
+    void (^progressCallback)(int64_t, int64_t) = self.progressCallback;
+    int64_t totalBytes = _totalBytes;
+    
+    if (progressCallback == nil) return;
+    
+    pk_dispatch_callback_on(_callbackQueue, ^{
+        progressCallback(bytesSent, totalBytes);
+    });
+}
+
+#pragma mark - NSURLSessionTaskDelegate
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didSendBodyData:(int64_t)bytesSent totalBytesSent:(int64_t)totalBytesSent totalBytesExpectedToSend:(int64_t)totalBytesExpectedToSend {
+    dispatch_async(_queue, ^{
+        if (task == self->_task) [self reportProgress:self->_uploadedBytes + totalBytesSent];
+    });
+}
+
+@end
@@ -0,0 +1,72 @@
+//
+//  PIORetryPolicy.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Describes how requests that fail for a reason that may go away on its own are sent again: when the connection drops or times out, when @b Put.io answers with @b 429 (Too Many Requests), or with @b 500, @b 502, @b 503 or @b 504.
+ 
+ Retries wait for a random time between zero and an exponentially growing ceiling ("full jitter"), so that clients that failed together don't retry together. If the server says how long to wait with a `Retry-After` header, the retry waits at least that long.
+ 
+ Every request shares one retry budget: each request that could be retried adds `retryBudgetRatio` of a retry to it, up to `retryBudgetCapacity`, and each retry spends a whole one. Once the budget is spent, requests fail straight away rather than adding to the load on a server that is already struggling.
+ 
+ Only requests whose method is in `retryableMethods` and whose body can be sent again are retried. Downloads, uploads and requests whose responses are handed over while they arrive are never retried by the session. Nor are the requests of `PIODownloadManager`, `PIOResumableUpload`, `PIOFolderWalker` and `PIOBulkOperation`, which retry on their own, so that a failure isn't retried by both.
+ 
+ The task handed out for a request stands for every attempt at it: cancelling it cancels a retry that is waiting to be sent or is in flight, and the callback is called with an `NSURLErrorCancelled` error.
+ */
+NS_SWIFT_NAME(RetryPolicy)
+@interface PIORetryPolicy : NSObject <NSCopying>
+
+/**
+ A policy with the default values for every property. This is the policy used if one is never explicitly set.
+ */
++ (PIORetryPolicy *)defaultPolicy NS_SWIFT_NAME(default());
+
+/** The number of times a request is retried before its error is returned. Defaults to @b 3. */
+@property (nonatomic) NSUInteger maximumRetryCount;
+
+/** The ceiling (in seconds) of the wait before the first retry. It doubles with every retry of the same request. Defaults to @b 0.5. */
+@property (nonatomic) NSTimeInterval baseDelay;
+
+/** The highest ceiling (in seconds) of the wait before a retry, however many retries have been made. Defaults to @b 30. */
+@property (nonatomic) NSTimeInterval maximumDelay;
+
+/** The longest `Retry-After` (in seconds) that is waited for. If the server asks for a longer wait, the error is returned straight away. Defaults to @b 120. */
+@property (nonatomic) NSTimeInterval maximumRetryAfter;
+
+/** The HTTP methods of the requests that may be retried. Defaults to the idempotent methods: @b GET, @b HEAD, @b OPTIONS, @b PUT and @b DELETE. */
+@property (copy, nonatomic) NSSet<NSString *> *retryableMethods;
+
+/** The fraction of a retry each completed request adds to the budget. Defaults to @b 0.1, so that retries add at most a tenth to the number of requests sent once the budget has been spent. */
+@property (nonatomic) double retryBudgetRatio;
+
+/** The largest number of retries the budget can save up, which is also what it starts with. Defaults to @b 10. */
+@property (nonatomic) double retryBudgetCapacity;
+
+@end
+
+NS_ASSUME_NONNULL_END
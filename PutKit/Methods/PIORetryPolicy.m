@@ -0,0 +1,75 @@
+//
+//  PIORetryPolicy.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIORetryPolicy.h"
+
+static NSUInteger const kPIORetryPolicyDefaultMaximumRetryCount = 3;
+static NSTimeInterval const kPIORetryPolicyDefaultBaseDelay = 0.5;
+static NSTimeInterval const kPIORetryPolicyDefaultMaximumDelay = 30;
+static NSTimeInterval const kPIORetryPolicyDefaultMaximumRetryAfter = 120;
+static double const kPIORetryPolicyDefaultRetryBudgetRatio = 0.1;
+static double const kPIORetryPolicyDefaultRetryBudgetCapacity = 10;
+
+@implementation PIORetryPolicy
+
++ (PIORetryPolicy *)defaultPolicy {
+    return [PIORetryPolicy new];
+}
+
+- (instancetype)init {
+    self = [super init];
+    
+    if (self) {
+        _maximumRetryCount = kPIORetryPolicyDefaultMaximumRetryCount;
+        _baseDelay = kPIORetryPolicyDefaultBaseDelay;
+        _maximumDelay = kPIORetryPolicyDefaultMaximumDelay;
+        _maximumRetryAfter = kPIORetryPolicyDefaultMaximumRetryAfter;
+        _retryableMethods = [NSSet setWithObjects:@"GET", @"HEAD", @"OPTIONS", @"PUT", @"DELETE", nil];
+        _retryBudgetRatio = kPIORetryPolicyDefaultRetryBudgetRatio;
+        _retryBudgetCapacity = kPIORetryPolicyDefaultRetryBudgetCapacity;
+    }
+    
+    return self;
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    PIORetryPolicy *policy = [[self.class allocWithZone:zone] init];
+    
+    policy.maximumRetryCount = self.maximumRetryCount;
+    policy.baseDelay = self.baseDelay;
+    policy.maximumDelay = self.maximumDelay;
+    policy.maximumRetryAfter = self.maximumRetryAfter;
+    policy.retryableMethods = self.retryableMethods;
+    policy.retryBudgetRatio = self.retryBudgetRatio;
+    policy.retryBudgetCapacity = self.retryBudgetCapacity;
+    
+    return policy;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p> maximumRetryCount = %tu; baseDelay = %lf; maximumDelay = %lf; maximumRetryAfter = %lf; retryableMethods = %@; retryBudgetRatio = %lf; retryBudgetCapacity = %lf", [self class], self, self.maximumRetryCount, self.baseDelay, self.maximumDelay, self.maximumRetryAfter, self.retryableMethods, self.retryBudgetRatio, self.retryBudgetCapacity];
+}
+
+@end
@@ -0,0 +1,78 @@
+//
+//  PIOSearchSession
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+
+@class PIOFile;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Searches your files a page at a time for a search field, such as one that searches as the user types.
+ 
+ The results of each query are kept for `cacheLifetime` seconds, so going back to an earlier query, e.g. by deleting what was just typed, or scrolling back up, doesn't go back to the server. Whenever a page is handed out, the page after it is fetched in the background, so that it is usually ready by the time the list is scrolled to the end.
+ 
+ Only one query is current at a time: searching for a different query cancels every request still running for the previous ones. Results are kept for the account that is signed in; once somebody else signs in, the next search drops them and cancels anything still being fetched.
+ */
+NS_SWIFT_NAME(SearchSession)
+@interface PIOSearchSession : NSObject
+
+/** The time (in seconds) the results of a query are handed out from the cache before the query is sent again. All pages of a query expire together, so that they never come from different searches. Defaults to @b 60. */
+@property (nonatomic) NSTimeInterval cacheLifetime;
+
+/** The number of queries whose results are kept. The queries that were searched for longest ago are dropped first. Defaults to @b 20. */
+@property (nonatomic) NSUInteger maximumCachedQueries;
+
+/** A boolean value indicating whether the page after each page that is handed out is fetched in advance. Defaults to `YES`. */
+@property (nonatomic) BOOL prefetchesNextPage;
+
+/** The query that was last searched for, whose requests are the only ones allowed to run. */
+@property (copy, nonatomic, readonly, nullable) NSString *currentQuery;
+
+/**
+ Returns a page of the results of a query, from the cache if it was fetched recently enough, and makes the query the current one.
+ 
+ @param query       The keyword to search, in the syntax described in `+[PIOAPI searchFilesWithQuery:onPage:callback:]`.
+ @param page        The page of results. The first page is @b 1.
+ @param callback    The block that is called on the callback queue with the page of results and the url of the next page, if there is one. If the request fails, the underlying error will be returned. If the query stops being the current one before the page arrives, `NSURLErrorCancelled` will be returned.
+ */
+- (void)searchFilesWithQuery:(NSString *)query
+                      onPage:(NSInteger)page
+                    callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> *, NSURL * _Nullable))callback NS_SWIFT_NAME(searchFiles(query:page:callback:));
+
+/**
+ Cancels every request that is running, including prefetches. Callbacks that are waiting are called with `NSURLErrorCancelled`.
+ */
+- (void)cancel;
+
+/**
+ Empties the cache, so that every query is sent again.
+ */
+- (void)removeAllResults;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,314 @@
+//
+//  PIOSearchSession.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOSearchSession.h"
+#import "PIOAPI+Files.h"
+#import "PIOCallbackQueue.h"
+#import "PIOAccountScope.h"
+
+static NSTimeInterval const kPIOSearchSessionDefaultCacheLifetime = 60;
+static NSUInteger const kPIOSearchSessionDefaultMaximumCachedQueries = 20;
+
+typedef void (^PIOSearchCallback)(NSError * _Nullable, NSArray<PIOFile *> *, NSURL * _Nullable);
+
+/**
+ The pages of a query's results that have been fetched, which expire together.
+ */
+@interface PIOSearchResults : NSObject
+
+@property (strong, nonatomic) NSDate *date; // When the first page was fetched.
+@property (strong, nonatomic) NSMutableDictionary<NSNumber *, NSArray<PIOFile *> *> *files; // By page.
+@property (strong, nonatomic) NSMutableDictionary<NSNumber *, NSURL *> *nextPageURLs; // By page, for pages that aren't the last.
+
+@end
+
+@implementation PIOSearchResults
+
+@end
+
+/**
+ A page that is being fetched, along with the callbacks waiting for it. A prefetch has none until the page is asked for.
+ */
+@interface PIOSearchFetch : NSObject
+
+@property (copy, nonatomic) NSString *query;
+@property (nonatomic) NSInteger page;
+@property (strong, nonatomic) NSURLSessionDataTask *task;
+@property (strong, nonatomic) NSMutableArray<PIOSearchCallback> *callbacks;
+
+@end
+
+@implementation PIOSearchFetch
+
+@end
+
+static NSString *pk_fetch_key(NSString *query, NSInteger page) {
+    return [NSString stringWithFormat:@"%zd/%@", page, query];
+}
+
+@implementation PIOSearchSession {
+    // Guarded by `self`.
+    NSMutableDictionary<NSString *, PIOSearchResults *> *_results; // By query.
+    NSMutableArray<NSString *> *_recentQueries; // Queries with results, least recently searched for first.
+    NSMutableDictionary<NSString *, PIOSearchFetch *> *_fetches; // By `pk_fetch_key`.
+    NSString *_account; // The account the results were fetched for.
+}
+
+@synthesize currentQuery = _currentQuery;
+
+- (instancetype)init {
+    self = [super init];
+    
+    if (self) {
+        _cacheLifetime = kPIOSearchSessionDefaultCacheLifetime;
+        _maximumCachedQueries = kPIOSearchSessionDefaultMaximumCachedQueries;
+        _prefetchesNextPage = YES;
+        _results = [NSMutableDictionary dictionary];
+        _recentQueries = [NSMutableArray array];
+        _fetches = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+- (NSString *)currentQuery {
+    @synchronized (self) {
+        return _currentQuery;
+    }
+}
+
+- (void)searchFilesWithQuery:(NSString *)query
+                      onPage:(NSInteger)page
+                    callback:(void (^)(NSError * _Nullable, NSArray<PIOFile *> * _Nonnull, NSURL * _Nullable))callback {
+    NSOperationQueue *queue = pk_callback_queue();
+    PIOSearchCallback deliver = ^(NSError *error, NSArray<PIOFile *> *files, NSURL *nextPageURL) {
+        pk_dispatch_callback_on(queue, ^{
+            callback(error, files, nextPageURL);
+        });
+    };
+    
+    NSArray<PIOSearchFetch *> *staleFetches = @[];
+    NSArray<PIOFile *> *files;
+    NSURL *nextPageURL;
+    NSURLSessionDataTask *task;
+    
+    @synchronized (self) {
+        NSString *account = pk_account_scope() ?: @"";
+        
+        // Another account's results are nothing to do with this one's, even for the same query.
+        if (![account isEqualToString:_account]) {
+            _account = account;
+            [_results removeAllObjects];
+            [_recentQueries removeAllObjects];
+            staleFetches = [self removeFetchesPassingTest:^BOOL(PIOSearchFetch *fetch) {
+                return YES;
+            }];
+        }
+        
+        if (![query isEqualToString:_currentQuery]) {
+            _currentQuery = [query copy];
+            staleFetches = [staleFetches arrayByAddingObjectsFromArray:[self removeFetchesPassingTest:^BOOL(PIOSearchFetch *fetch) {
+                return ![fetch.query isEqualToString:query];
+            }]];
+        }
+        
+        PIOSearchResults *results = [self resultsForQuery:query];
+        
+        files = [results.files objectForKey:@(page)];
+        nextPageURL = [results.nextPageURLs objectForKey:@(page)];
+        
+        if (files == nil) task = [self fetchPage:page ofQuery:query callback:deliver];
+    }
+    
+    [self cancelFetches:staleFetches];
+    [task resume];
+    
+    if (files == nil) return;
+    
+    deliver(nil, files, nextPageURL);
+    
+    nextPageURL == nil ?: [self prefetchPage:page + 1 ofQuery:query];
+}
+
+- (void)cancel {
+    NSArray<PIOSearchFetch *> *fetches;
+    
+    @synchronized (self) {
+        fetches = [self removeFetchesPassingTest:^BOOL(PIOSearchFetch *fetch) {
+            return YES;
+        }];
+    }
+    
+    [self cancelFetches:fetches];
+}
+
+- (void)removeAllResults {
+    @synchronized (self) {
+        [_results removeAllObjects];
+        [_recentQueries removeAllObjects];
+    }
+}
+
+#pragma mark - Cache
+
+/**
+ Returns the results of a query if they haven't expired, and marks the query as the most recently searched for. Must be called while synchronized on `self`.
+ */
+- (PIOSearchResults *)resultsForQuery:(NSString *)query {
+    PIOSearchResults *results = [_results objectForKey:query];
+    
+    if (results == nil) return nil;
+    
+    [_recentQueries removeObject:query];
+    
+    if (-results.date.timeIntervalSinceNow >= self.cacheLifetime) {
+        [_results removeObjectForKey:query];
+        return nil;
+    }
+    
+    [_recentQueries addObject:query];
+    
+    return results;
+}
+
+/**
+ Keeps a page of a query's results, dropping the queries that were searched for longest ago if there are too many. Must be called while synchronized on `self`.
+ */
+- (void)storeFiles:(NSArray<PIOFile *> *)files nextPageURL:(NSURL *)nextPageURL page:(NSInteger)page ofQuery:(NSString *)query {
+    PIOSearchResults *results = [self resultsForQuery:query];
+    
+    if (results == nil) {
+        results = [PIOSearchResults new];
+        results.date = [NSDate date];
+        results.files = [NSMutableDictionary dictionary];
+        results.nextPageURLs = [NSMutableDictionary dictionary];
+        
+        [_results setObject:results forKey:query];
+        [_recentQueries addObject:query];
+    }
+    
+    [results.files setObject:files forKey:@(page)];
+    nextPageURL == nil ?: [results.nextPageURLs setObject:nextPageURL forKey:@(page)];
+    
+    while (_recentQueries.count > self.maximumCachedQueries) {
+        [_results removeObjectForKey:_recentQueries.firstObject];
+        [_recentQueries removeObjectAtIndex:0];
+    }
+}
+
+#pragma mark - Fetching
+
+/**
+ Starts fetching a page unless it is already being fetched, in which case the callback waits for that request. Returns the task to be resumed, if a new one was made. Must be called while synchronized on `self`.
+ */
+- (NSURLSessionDataTask *)fetchPage:(NSInteger)page ofQuery:(NSString *)query callback:(PIOSearchCallback)callback {
+    NSString *key = pk_fetch_key(query, page);
+    PIOSearchFetch *fetch = [_fetches objectForKey:key];
+    
+    if (fetch != nil) {
+        callback == nil ?: [fetch.callbacks addObject:callback];
+        return nil;
+    }
+    
+    fetch = [PIOSearchFetch new];
+    fetch.query = query;
+    fetch.page = page;
+    fetch.callbacks = callback == nil ? [NSMutableArray array] : [NSMutableArray arrayWithObject:callback];
+    
+    // The results are handled straight from the delegate queue; each callback hops to the queue it was asked for on.
+    pk_perform_with_callback_queue(nil, ^{
+        fetch.task = [PIOAPI searchFilesWithQuery:query onPage:page callback:^(NSError * _Nullable error, NSArray<PIOFile *> * _Nonnull files, NSURL * _Nullable nextPageURL) {
+            [self finishFetch:fetch error:error files:files nextPageURL:nextPageURL];
+        }];
+    });
+    
+    [_fetches setObject:fetch forKey:key];
+    
+    return fetch.task;
+}
+
+- (void)prefetchPage:(NSInteger)page ofQuery:(NSString *)query {
+    if (!self.prefetchesNextPage) return;
+    
+    NSURLSessionDataTask *task;
+    
+    @synchronized (self) {
+        // Prefetches for a query that is no longer current would only be cancelled.
+        if (![query isEqualToString:_currentQuery] || [[self resultsForQuery:query].files objectForKey:@(page)] != nil) return;
+        
+        task = [self fetchPage:page ofQuery:query callback:nil];
+    }
+    
+    [task resume];
+}
+
+- (void)finishFetch:(PIOSearchFetch *)fetch error:(NSError *)error files:(NSArray<PIOFile *> *)files nextPageURL:(NSURL *)nextPageURL {
+    NSArray<PIOSearchCallback> *callbacks;
+    
+    @synchronized (self) {
+        NSString *key = pk_fetch_key(fetch.query, fetch.page);
+        
+        // A fetch that was cancelled has already called back.
+        if ([_fetches objectForKey:key] != fetch) return;
+        
+        [_fetches removeObjectForKey:key];
+        
+        if (error == nil) [self storeFiles:files nextPageURL:nextPageURL page:fetch.page ofQuery:fetch.query];
+        callbacks = [fetch.callbacks copy];
+    }
+    
+    for (PIOSearchCallback callback in callbacks) callback(error, files, nextPageURL);
+    
+    // Only a page that has been handed out brings on the next one, so that prefetching doesn't run ahead of the list.
+    if (error == nil && callbacks.count > 0 && nextPageURL != nil) [self prefetchPage:fetch.page + 1 ofQuery:fetch.query];
+}
+
+/**
+ Removes the fetches passing a test, so that their results are dropped, and returns them. Must be called while synchronized on `self`.
+ */
+- (NSArray<PIOSearchFetch *> *)removeFetchesPassingTest:(BOOL (^)(PIOSearchFetch *fetch))predicate {
+    NSMutableArray<PIOSearchFetch *> *fetches = [NSMutableArray array];
+    
+    [_fetches enumerateKeysAndObjectsUsingBlock:^(NSString *key, PIOSearchFetch *fetch, BOOL *stop) {
+        if (predicate(fetch)) [fetches addObject:fetch];
+    }];
+    
+    for (PIOSearchFetch *fetch in fetches) [_fetches removeObjectForKey:pk_fetch_key(fetch.query, fetch.page)];
+    
+    return fetches;
+}
+
+- (void)cancelFetches:(NSArray<PIOSearchFetch *> *)fetches {
+    NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+    
+    for (PIOSearchFetch *fetch in fetches) {
+        [fetch.task cancel];
+        
+        for (PIOSearchCallback callback in fetch.callbacks) callback(error, @[], nil);
+    }
+}
+
+@end
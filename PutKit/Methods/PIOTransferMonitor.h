@@ -0,0 +1,89 @@
+//
+//  PIOTransferMonitor.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+
+@class PIOTransfer;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A transfer being watched by a `PIOTransferMonitor`.
+ */
+NS_SWIFT_NAME(TransferSubscription)
+@interface PIOTransferSubscription : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/** The identifier of the transfer being watched. */
+@property (nonatomic, readonly) NSInteger transferIdentifier NS_SWIFT_NAME(transferId);
+
+/**
+ Stops watching the transfer. Neither callback is called again.
+ */
+- (void)cancel;
+
+@end
+
+/**
+ Watches any number of transfers with a single request to @b Put.io's transfer list per poll, handing the result out to whoever is watching each transfer.
+ 
+ While any watched transfer is making progress, the list is polled every `minimumPollInterval` seconds. Each poll in which nothing changed, or which failed, waits longer than the one before, up to `maximumPollInterval`, so idle and stalled transfers cost next to nothing. Watching a new transfer polls straight away.
+ 
+ A transfer stops being watched as soon as it has finished, whether it completed, started seeding, failed or was cancelled.
+ 
+ Every list that is fetched is also passed to the shared `PIOTransferStore`, so its observers are kept up to date while anything is being watched.
+ */
+NS_SWIFT_NAME(TransferMonitor)
+@interface PIOTransferMonitor : NSObject
+
+/**
+ Shared singleton instance of the `PIOTransferMonitor` class.
+ */
++ (PIOTransferMonitor *)sharedInstance NS_SWIFT_NAME(shared());
+
+/** The time (in seconds) between polls while transfers are making progress. Defaults to @b 1. */
+@property (nonatomic) NSTimeInterval minimumPollInterval;
+
+/** The longest time (in seconds) between polls, however long the transfers have been idle. Defaults to @b 30. */
+@property (nonatomic) NSTimeInterval maximumPollInterval;
+
+/**
+ Starts watching a transfer.
+ 
+ @param transferIdentifier  The identifier of the transfer to be watched.
+ @param progressCallback    The block that is called on the callback queue after every poll while the transfer is still running. If the poll failed, the underlying error will be returned instead of the transfer. If the transfer no longer exists, the error is returned one last time and the transfer stops being watched.
+ @param completionCallback  The block that is called on the callback queue at most once, when the transfer has finished. The status of the transfer says how it finished.
+ 
+ @return    The subscription, which can be cancelled to stop watching the transfer.
+ */
+- (PIOTransferSubscription *)monitorTransferWithID:(NSInteger)transferIdentifier
+                                  progressCallback:(void (^ _Nullable)(NSError * _Nullable, PIOTransfer * _Nullable))progressCallback
+                                completionCallback:(void (^ _Nullable)(PIOTransfer *))completionCallback NS_SWIFT_NAME(monitor(transfer:progress:completion:));
+
+@end
+
+NS_ASSUME_NONNULL_END
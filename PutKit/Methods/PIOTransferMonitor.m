@@ -0,0 +1,266 @@
+//
+//  PIOTransferMonitor.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOTransferMonitor.h"
+#import "PIOAPI+Transfers.h"
+#import "PIOTransfer.h"
+#import "PIOTransferStore.h"
+#import "PIOError.h"
+#import "PIOCallbackQueue.h"
+#import "PIORateLimiter.h"
+
+static NSTimeInterval const kPIOTransferMonitorDefaultMinimumPollInterval = 1;
+static NSTimeInterval const kPIOTransferMonitorDefaultMaximumPollInterval = 30;
+static double const kPIOTransferMonitorBackoffFactor = 2;
+
+@interface PIOTransferMonitor ()
+
+- (void)cancelSubscription:(PIOTransferSubscription *)subscription;
+
+@end
+
+@interface PIOTransferSubscription ()
+
+@property (nonatomic, readwrite) NSInteger transferIdentifier;
+@property (copy, nonatomic, nullable) void (^progressCallback)(NSError * _Nullable, PIOTransfer * _Nullable);
+@property (copy, nonatomic, nullable) void (^completionCallback)(PIOTransfer *);
+@property (strong, nonatomic, nullable) NSOperationQueue *callbackQueue; // The callback queue the subscription was made with.
+@property (weak, nonatomic) PIOTransferMonitor *monitor;
+@property (atomic, getter=isCancelled) BOOL cancelled;
+
+/** The transfer as it was after the last poll. */
+@property (strong, nonatomic, nullable) PIOTransfer *transfer;
+
+/** Whether the transfer is being fetched on its own because it was missing from the list. */
+@property (nonatomic, getter=isFetching) BOOL fetching;
+
+@end
+
+@implementation PIOTransferSubscription
+
+- (void)cancel {
+    // Set straight away, so that callbacks already on their way to the callback queue aren't called either.
+    self.cancelled = YES;
+    
+    [self.monitor cancelSubscription:self];
+}
+
+@end
+
+@implementation PIOTransferMonitor {
+    NSOperationQueue *_queue; // Serial, and where the requests call back.
+    
+    // Only touched on `_queue`.
+    NSMutableArray<PIOTransferSubscription *> *_subscriptions;
+    NSTimeInterval _interval;
+    NSURLSessionDataTask *_task;
+    NSUInteger _generation; // Bumped whenever a poll is scheduled, so that polls scheduled before it do nothing.
+}
+
++ (PIOTransferMonitor *)sharedInstance {
+    static PIOTransferMonitor *sharedInstance;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [PIOTransferMonitor new];
+    });
+    return sharedInstance;
+}
+
+- (instancetype)init {
+    self = [super init];
+    
+    if (self) {
+        _minimumPollInterval = kPIOTransferMonitorDefaultMinimumPollInterval;
+        _maximumPollInterval = kPIOTransferMonitorDefaultMaximumPollInterval;
+        _interval = _minimumPollInterval;
+        _subscriptions = [NSMutableArray array];
+        _queue = [NSOperationQueue new];
+        _queue.name = @"io.put.kit.transfer-monitor";
+        _queue.maxConcurrentOperationCount = 1;
+    }
+    
+    return self;
+}
+
+- (PIOTransferSubscription *)monitorTransferWithID:(NSInteger)transferIdentifier
+                                  progressCallback:(void (^)(NSError * _Nullable, PIOTransfer * _Nullable))progressCallback
+                                completionCallback:(void (^)(PIOTransfer * _Nonnull))completionCallback {
+    PIOTransferSubscription *subscription = [PIOTransferSubscription new];
+    
+    subscription.transferIdentifier = transferIdentifier;
+    subscription.progressCallback = progressCallback;
+    subscription.completionCallback = completionCallback;
+    subscription.callbackQueue = pk_callback_queue();
+    subscription.monitor = self;
+    
+    [_queue addOperationWithBlock:^{
+        [self->_subscriptions addObject:subscription];
+        
+        self->_interval = self.minimumPollInterval;
+        [self schedulePollAfterDelay:0];
+    }];
+    
+    return subscription;
+}
+
+- (void)cancelSubscription:(PIOTransferSubscription *)subscription {
+    [_queue addOperationWithBlock:^{
+        [self removeSubscription:subscription];
+    }];
+}
+
+- (void)removeSubscription:(PIOTransferSubscription *)subscription {
+    [_subscriptions removeObjectIdenticalTo:subscription];
+    
+    if (_subscriptions.count == 0) _generation++;
+}
+
+#pragma mark - Polling
+
+- (void)schedulePollAfterDelay:(NSTimeInterval)delay {
+    NSUInteger generation = ++_generation;
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [self->_queue addOperationWithBlock:^{
+            if (generation == self->_generation) [self poll];
+        }];
+    });
+}
+
+- (void)poll {
+    // A poll that is still running schedules the next one when it finishes.
+    if (_task != nil || _subscriptions.count == 0) return;
+    
+    // Everything is kept on the monitor's queue, whatever queue the configuration calls back on, and the requests queue for the rate limiter apart from everyone else's.
+    [PIORateLimiter performAsCaller:@"PIOTransferMonitor" block:^{
+        pk_perform_with_callback_queue(self->_queue, ^{
+            self->_task = [PIOAPI listActiveTransfersWithCallback:^(NSError * _Nullable error, NSArray<PIOTransfer *> * _Nonnull transfers) {
+                self->_task = nil;
+                
+                BOOL changed = error == nil ? [self handleTransfers:transfers] : [self handleError:error];
+                
+                self->_interval = changed ? self.minimumPollInterval : MIN(self->_interval * kPIOTransferMonitorBackoffFactor, self.maximumPollInterval);
+                
+                if (self->_subscriptions.count > 0) [self schedulePollAfterDelay:self->_interval];
+            }];
+        });
+    }];
+    
+    [_task resume];
+}
+
+- (BOOL)handleError:(NSError *)error {
+    for (PIOTransferSubscription *subscription in _subscriptions) [self callBackSubscription:subscription error:error transfer:nil];
+    
+    return NO;
+}
+
+- (BOOL)handleTransfers:(NSArray<PIOTransfer *> *)transfers {
+    // The list is there anyway, so anyone watching the store hears about it too.
+    [[PIOTransferStore sharedInstance] updateWithTransfers:transfers];
+    
+    NSMutableDictionary<NSNumber *, PIOTransfer *> *transfersByIdentifier = [NSMutableDictionary dictionaryWithCapacity:transfers.count];
+    BOOL changed = NO;
+    
+    for (PIOTransfer *transfer in transfers) [transfersByIdentifier setObject:transfer forKey:@(transfer.identifier)];
+    
+    // Finished subscriptions are removed as they go.
+    for (PIOTransferSubscription *subscription in [_subscriptions copy]) {
+        PIOTransfer *transfer = [transfersByIdentifier objectForKey:@(subscription.transferIdentifier)];
+        
+        if (transfer == nil) {
+            [self fetchMissingTransferForSubscription:subscription];
+        } else if ([self updateSubscription:subscription withTransfer:transfer]) {
+            changed = YES;
+        }
+    }
+    
+    return changed;
+}
+
+- (BOOL)updateSubscription:(PIOTransferSubscription *)subscription withTransfer:(PIOTransfer *)transfer {
+    PIOTransfer *previous = subscription.transfer;
+    BOOL changed = previous == nil || previous.totalDownloaded != transfer.totalDownloaded || ![previous.status isEqualToString:transfer.status];
+    
+    subscription.transfer = transfer;
+    
+    if (transfer.isFinished) {
+        [self removeSubscription:subscription];
+        [self completeSubscription:subscription transfer:transfer];
+    } else {
+        [self callBackSubscription:subscription error:nil transfer:transfer];
+    }
+    
+    return changed;
+}
+
+- (void)fetchMissingTransferForSubscription:(PIOTransferSubscription *)subscription {
+    if (subscription.isFetching) return;
+    
+    subscription.fetching = YES;
+    
+    // Transfers drop off the list once they have been cleaned up, so the transfer is asked for by itself to find out how it ended.
+    [PIORateLimiter performAsCaller:@"PIOTransferMonitor" block:^{
+        pk_perform_with_callback_queue(self->_queue, ^{
+            [[PIOAPI getTransferForID:subscription.transferIdentifier callback:^(NSError * _Nullable error, PIOTransfer * _Nullable transfer) {
+                subscription.fetching = NO;
+                
+                if (![self->_subscriptions containsObject:subscription]) return;
+                
+                if (transfer != nil) {
+                    [self updateSubscription:subscription withTransfer:transfer];
+                } else if (error == nil || !pk_error_is_transient(error)) {
+                    [self removeSubscription:subscription];
+                    [self callBackSubscription:subscription error:error ?: [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil] transfer:nil];
+                }
+            }] resume];
+        });
+    }];
+}
+
+#pragma mark - Callbacks
+
+- (void)callBackSubscription:(PIOTransferSubscription *)subscription error:(NSError *)error transfer:(PIOTransfer *)transfer {
+    void (^progressCallback)(NSError *, PIOTransfer *) = subscription.progressCallback;
+    
+    if (progressCallback == nil) return;
+    
+    pk_dispatch_callback_on(subscription.callbackQueue, ^{
+        if (!subscription.isCancelled) progressCallback(error, transfer);
+    });
+}
+
+- (void)completeSubscription:(PIOTransferSubscription *)subscription transfer:(PIOTransfer *)transfer {
+    void (^completionCallback)(PIOTransfer *) = subscription.completionCallback;
+    
+    if (completionCallback == nil) return;
+    
+    pk_dispatch_callback_on(subscription.callbackQueue, ^{
+        if (!subscription.isCancelled) completionCallback(transfer);
+    });
+}
+
+@end
@@ -0,0 +1,135 @@
+//
+//  PIOTransferStore.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+#import "PIOTransfer.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A transfer that is in both the previous and the current list, but with some of its fields changed.
+ */
+NS_SWIFT_NAME(TransferUpdate)
+@interface PIOTransferUpdate : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/** The transfer as it is now. */
+@property (strong, nonatomic, readonly) PIOTransfer *transfer;
+
+/** The transfer as it was in the previous list. */
+@property (strong, nonatomic, readonly) PIOTransfer *previousTransfer;
+
+/** The fields that differ between the two. Never @b 0. */
+@property (nonatomic, readonly) PIOTransferField changedFields;
+
+@end
+
+/**
+ The difference between two lists of transfers.
+ */
+NS_SWIFT_NAME(TransferChangeSet)
+@interface PIOTransferChangeSet : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/** Transfers that weren't in the previous list, in the order they appear in the current one. */
+@property (strong, nonatomic, readonly) NSArray<PIOTransfer *> *insertedTransfers;
+
+/** Transfers that are no longer in the list, as they were the last time they were seen. */
+@property (strong, nonatomic, readonly) NSArray<PIOTransfer *> *removedTransfers;
+
+/** Transfers whose fields have changed, in the order they appear in the current list. Transfers that haven't changed are left out. */
+@property (strong, nonatomic, readonly) NSArray<PIOTransferUpdate *> *updatedTransfers;
+
+/** The union of the changed fields of every updated transfer. */
+@property (nonatomic, readonly) PIOTransferField changedFields;
+
+/** A boolean value indicating whether nothing was inserted, removed or changed. */
+@property (nonatomic, readonly, getter=isEmpty) BOOL empty;
+
+@end
+
+/**
+ Keeps the latest list of transfers, keyed by `PIOTransfer.identifier`, and works out what changed each time a new list arrives, so that the work done with each list scales with how much changed rather than with how many transfers there are.
+ */
+NS_SWIFT_NAME(TransferStore)
+@interface PIOTransferStore : NSObject
+
+/**
+ Shared singleton instance of the `PIOTransferStore` class.
+ */
++ (PIOTransferStore *)sharedInstance NS_SWIFT_NAME(shared());
+
+/** The transfers in the latest list, in the order @b Put.io returned them. */
+@property (strong, nonatomic, readonly) NSArray<PIOTransfer *> *transfers;
+
+/**
+ Looks up a transfer in the latest list.
+ 
+ @param transferIdentifier  The identifier of the transfer.
+ 
+ @return    The transfer, or `nil` if it isn't in the latest list.
+ */
+- (nullable PIOTransfer *)transferWithID:(NSInteger)transferIdentifier NS_SWIFT_NAME(transfer(for:));
+
+/**
+ Replaces the stored list with a new one and tells every observer what changed, unless nothing did.
+ 
+ @param transfers   The complete new list, e.g. as returned by `listActiveTransfersWithCallback:`.
+ 
+ @return    What changed since the previous list.
+ */
+- (PIOTransferChangeSet *)updateWithTransfers:(NSArray<PIOTransfer *> *)transfers NS_SWIFT_NAME(update(with:));
+
+/**
+ Fetches the list of transfers and updates the store with it.
+ 
+ @param callback    The block that is called when the request completes. If the request completes successfully, what changed will be returned. However, if it fails, the underlying error will be returned and the store is left as it was.
+ 
+ @return    The request's `NSURLSessionDataTask` to be resumed.
+ */
+- (NSURLSessionDataTask *)refreshWithCallback:(void (^ _Nullable)(NSError * _Nullable, PIOTransferChangeSet * _Nullable))callback NS_SWIFT_NAME(refresh(callback:));
+
+/**
+ Registers a block to be called on the callback queue with every non-empty change set, in the order the store was updated in.
+ 
+ @param block   The block to be called.
+ 
+ @return    An opaque object to be passed to `removeObserver:`.
+ */
+- (id<NSObject>)addObserverWithBlock:(void (^)(PIOTransferChangeSet *changes))block NS_SWIFT_NAME(addObserver(_:));
+
+/**
+ Stops calling a block registered with `addObserverWithBlock:`.
+ 
+ @param observer    The object returned when the block was registered.
+ */
+- (void)removeObserver:(id<NSObject>)observer;
+
+@end
+
+NS_ASSUME_NONNULL_END
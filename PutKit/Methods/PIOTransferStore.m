@@ -0,0 +1,229 @@
+//
+//  PIOTransferStore.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOTransferStore.h"
+#import "PIOAPI+Transfers.h"
+#import "PIOCallbackQueue.h"
+
+@interface PIOTransferUpdate ()
+
+- (instancetype)initWithTransfer:(PIOTransfer *)transfer previousTransfer:(PIOTransfer *)previousTransfer changedFields:(PIOTransferField)changedFields NS_DESIGNATED_INITIALIZER;
+
+@end
+
+@implementation PIOTransferUpdate
+
+- (instancetype)initWithTransfer:(PIOTransfer *)transfer previousTransfer:(PIOTransfer *)previousTransfer changedFields:(PIOTransferField)changedFields {
+    self = [super init];
+    
+    if (self) {
+        _transfer = transfer;
+        _previousTransfer = previousTransfer;
+        _changedFields = changedFields;
+    }
+    
+    return self;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p> identifier = %zd; changedFields = %#tx", [self class], self, self.transfer.identifier, self.changedFields];
+}
+
+@end
+
+@interface PIOTransferChangeSet ()
+
+- (instancetype)initWithInsertedTransfers:(NSArray<PIOTransfer *> *)insertedTransfers
+                         removedTransfers:(NSArray<PIOTransfer *> *)removedTransfers
+                         updatedTransfers:(NSArray<PIOTransferUpdate *> *)updatedTransfers NS_DESIGNATED_INITIALIZER;
+
+@end
+
+@implementation PIOTransferChangeSet
+
+- (instancetype)initWithInsertedTransfers:(NSArray<PIOTransfer *> *)insertedTransfers
+                         removedTransfers:(NSArray<PIOTransfer *> *)removedTransfers
+                         updatedTransfers:(NSArray<PIOTransferUpdate *> *)updatedTransfers {
+    self = [super init];
+    
+    if (self) {
+        _insertedTransfers = insertedTransfers;
+        _removedTransfers = removedTransfers;
+        _updatedTransfers = updatedTransfers;
+        
+        for (PIOTransferUpdate *update in updatedTransfers) _changedFields |= update.changedFields;
+    }
+    
+    return self;
+}
+
+- (BOOL)isEmpty {
+    return _insertedTransfers.count == 0 && _removedTransfers.count == 0 && _updatedTransfers.count == 0;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p> inserted = %tu; removed = %tu; updated = %tu; changedFields = %#tx", [self class], self, self.insertedTransfers.count, self.removedTransfers.count, self.updatedTransfers.count, self.changedFields];
+}
+
+@end
+
+/**
+ A block registered with `addObserverWithBlock:`, along with the queue it is called on.
+ */
+@interface PIOTransferObserver : NSObject
+
+@property (copy, nonatomic) void (^block)(PIOTransferChangeSet *);
+@property (strong, nonatomic, nullable) NSOperationQueue *queue;
+
+@end
+
+@implementation PIOTransferObserver
+
+@end
+
+@implementation PIOTransferStore {
+    NSArray<PIOTransfer *> *_transfers;
+    NSDictionary<NSNumber *, PIOTransfer *> *_transfersByIdentifier;
+    NSMutableArray<PIOTransferObserver *> *_observers;
+    NSOperationQueue *_observerQueue;
+}
+
++ (PIOTransferStore *)sharedInstance {
+    static PIOTransferStore *sharedInstance;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [PIOTransferStore new];
+    });
+    return sharedInstance;
+}
+
+- (instancetype)init {
+    self = [super init];
+    
+    if (self) {
+        _transfers = @[];
+        _transfersByIdentifier = @{};
+        _observers = [NSMutableArray array];
+        _observerQueue = [NSOperationQueue new];
+        _observerQueue.name = @"io.put.kit.transfer-store";
+        _observerQueue.maxConcurrentOperationCount = 1;
+    }
+    
+    return self;
+}
+
+- (NSArray<PIOTransfer *> *)transfers {
+    @synchronized (self) {
+        return _transfers;
+    }
+}
+
+- (PIOTransfer *)transferWithID:(NSInteger)transferIdentifier {
+    @synchronized (self) {
+        return [_transfersByIdentifier objectForKey:@(transferIdentifier)];
+    }
+}
+
+- (PIOTransferChangeSet *)updateWithTransfers:(NSArray<PIOTransfer *> *)transfers {
+    NSMutableDictionary<NSNumber *, PIOTransfer *> *transfersByIdentifier = [NSMutableDictionary dictionaryWithCapacity:transfers.count];
+    NSMutableArray *insertedTransfers = [NSMutableArray array];
+    NSMutableArray *removedTransfers = [NSMutableArray array];
+    NSMutableArray *updatedTransfers = [NSMutableArray array];
+    PIOTransferChangeSet *changes;
+    
+    @synchronized (self) {
+        for (PIOTransfer *transfer in transfers) {
+            NSNumber *key = @(transfer.identifier);
+            PIOTransfer *previousTransfer = [_transfersByIdentifier objectForKey:key];
+            
+            [transfersByIdentifier setObject:transfer forKey:key];
+            
+            if (previousTransfer == nil) {
+                [insertedTransfers addObject:transfer];
+                continue;
+            }
+            
+            PIOTransferField changedFields = [transfer fieldsDifferingFromTransfer:previousTransfer];
+            
+            if (changedFields != 0) [updatedTransfers addObject:[[PIOTransferUpdate alloc] initWithTransfer:transfer previousTransfer:previousTransfer changedFields:changedFields]];
+        }
+        
+        for (PIOTransfer *previousTransfer in _transfers) {
+            if ([transfersByIdentifier objectForKey:@(previousTransfer.identifier)] == nil) [removedTransfers addObject:previousTransfer];
+        }
+        
+        _transfers = [transfers copy];
+        _transfersByIdentifier = transfersByIdentifier;
+        
+        changes = [[PIOTransferChangeSet alloc] initWithInsertedTransfers:insertedTransfers removedTransfers:removedTransfers updatedTransfers:updatedTransfers];
+        
+        // Queued before the lock is let go, so that observers hear about updates in the order they were made in, whichever thread made them. The store's own serial queue hands each change set on to every observer's queue in turn, which keeps that order without calling observers under the lock.
+        if (!changes.isEmpty && _observers.count > 0) {
+            NSArray<PIOTransferObserver *> *observers = [_observers copy];
+            
+            [_observerQueue addOperationWithBlock:^{
+                for (PIOTransferObserver *observer in observers) {
+                    void (^block)(PIOTransferChangeSet *) = observer.block;
+                    
+                    pk_dispatch_callback_on(observer.queue, ^{
+                        block(changes);
+                    });
+                }
+            }];
+        }
+    }
+    
+    return changes;
+}
+
+- (NSURLSessionDataTask *)refreshWithCallback:(void (^)(NSError * _Nullable, PIOTransferChangeSet * _Nullable))callback {
+    return [PIOAPI listActiveTransfersWithCallback:^(NSError * _Nullable error, NSArray<PIOTransfer *> * _Nonnull transfers) {
+        PIOTransferChangeSet *changes = error == nil ? [self updateWithTransfers:transfers] : nil;
+        
+        if (callback != nil) callback(error, changes);
+    }];
+}
+
+- (id<NSObject>)addObserverWithBlock:(void (^)(PIOTransferChangeSet * _Nonnull))block {
+    PIOTransferObserver *observer = [PIOTransferObserver new];
+    
+    observer.block = block;
+    observer.queue = pk_callback_queue();
+    
+    @synchronized (self) {
+        [_observers addObject:observer];
+    }
+    
+    return observer;
+}
+
+- (void)removeObserver:(id<NSObject>)observer {
+    @synchronized (self) {
+        [_observers removeObjectIdenticalTo:observer];
+    }
+}
+
+@end
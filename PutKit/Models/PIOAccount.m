@@ -25,6 +25,7 @@
 
 #import "PIOAccount.h"
 #import "PIOObjectProtocol.h"
+#import "PIODate.h"
 
 @interface PIOAccount() <PIOObjectProtocol>
 
@@ -48,9 +49,6 @@
         _totalDiskSize = [[diskDictionary objectForKey:@"size"] integerValue];
         
         
-        NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
-        [dateFormatter setDateFormat:@"yyyy-MM-dd'T'HH:mm:ss"];
-        
         NSString *planExpiryDateString = [dictionary objectForKey:@"plan_expiration_date"];
         
         if (_username != nil &&
@@ -62,7 +60,7 @@
             !isnan(_totalDiskSize) &&
             planExpiryDateString != nil)
         {
-            _planExpiryDate = [dateFormatter dateFromString:planExpiryDateString];
+            _planExpiryDate = pk_date_from_string(planExpiryDateString);
             
             return self;
         }
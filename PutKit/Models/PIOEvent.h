@@ -34,6 +34,9 @@ NS_ASSUME_NONNULL_BEGIN
 NS_SWIFT_NAME(Event)
 @interface PIOEvent : NSObject
 
+/** The unique identifier for the event. Events that happened later have larger identifiers. */
+@property (nonatomic, readonly) NSInteger identifier NS_SWIFT_NAME(id);
+
 /** The event's type. */
 @property (nonatomic, readonly) PIOEventType type;
 
@@ -25,6 +25,7 @@
 
 #import "PIOEvent.h"
 #import "PIOObjectProtocol.h"
+#import "PIODate.h"
 
 @interface PIOEvent() <PIOObjectProtocol>
 
@@ -36,6 +37,7 @@
     self = [super init];
     
     if (self) {
+        _identifier = [[dictionary objectForKey:@"id"] integerValue];
         _type = [dictionary objectForKey:@"type"];
         
         if (_type == nil) return nil;
@@ -48,10 +50,7 @@
             _size = [[dictionary objectForKey:@"transfer_size"] unsignedIntegerValue];
         }
         
-        NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
-        [dateFormatter setDateFormat:@"yyyy-MM-dd'T'HH:mm:ss"];
-        
-        _dateOfCreation = [dateFormatter dateFromString:[dictionary objectForKey:@"created_at"]];
+        _dateOfCreation = pk_date_from_string([dictionary objectForKey:@"created_at"]);
         
         if (_name != nil &&
             !isnan(_size) &&
@@ -60,6 +59,9 @@
             NSString *sharingUsername = [dictionary objectForKey:@"sharing_user_name"];
             if ([sharingUsername isKindOfClass:NSString.class]) _sharingUsername = sharingUsername;
             
+            NSNumber *fileIdentifier = [dictionary objectForKey:@"file_id"];
+            if ([fileIdentifier isKindOfClass:NSNumber.class]) _fileIdentifier = fileIdentifier.integerValue;
+            
             return self;
         }
     }
@@ -68,7 +70,7 @@
 }
 
 - (NSString *)description {
-    return [NSString stringWithFormat:@"<%@: %p> type = %@; name = %@; dateOfCreation = %@; sharingUsername = %@; fileIdentifier = %zd; size = %tu", [self class], self, self.type, self.name, self.dateOfCreation, self.sharingUsername, self.fileIdentifier, self.size];
+    return [NSString stringWithFormat:@"<%@: %p> identifier = %zd; type = %@; name = %@; dateOfCreation = %@; sharingUsername = %@; fileIdentifier = %zd; size = %tu", [self class], self, self.identifier, self.type, self.name, self.dateOfCreation, self.sharingUsername, self.fileIdentifier, self.size];
 }
 
 @end
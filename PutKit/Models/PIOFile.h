@@ -30,10 +30,12 @@ NS_ASSUME_NONNULL_BEGIN
 /**
  A file object.
  
+ Files can be archived with `NSKeyedArchiver`, which is how `PIOFileCache` keeps them across launches.
+ 
  @important `File` objects are not always file types - they can be folders too. In order to check, there is a `contentType` variable on this object which will uncover exactly what type of file this is.
  */
 NS_SWIFT_NAME(File)
-@interface PIOFile : NSObject
+@interface PIOFile : NSObject <NSSecureCoding>
 
 /** The name of the file. */
 @property (strong, nonatomic, readonly) NSString *name;
@@ -77,6 +79,16 @@ NS_SWIFT_NAME(File)
 /** A boolean value indicating whether or not the file is actually a folder. */
 @property (nonatomic, readonly, getter=isFolder) BOOL folder;
 
+/**
+ Checks whether a file on the current device has the same contents as this file, by comparing its CRC32 checksum with `cyclicRedundancyCode`. Useful for skipping an upload of a file that is already on @b Put.io, or for checking a copy that was downloaded some other way.
+ 
+ @param fileURL A url pointing to a valid file on the current device.
+ @param error   An error pointer, set if the file couldn't be read, if this file has no checksum, or if the contents don't match.
+ 
+ @return    `YES` if the contents match, otherwise `NO`.
+ */
+- (BOOL)matchesContentsOfURL:(NSURL *)fileURL error:(NSError * _Nullable *)error NS_SWIFT_NAME(matchesContents(of:));
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -25,6 +25,8 @@
 
 #import "PIOFile.h"
 #import "PIOObjectProtocol.h"
+#import "PIOModelDecoder.h"
+#import "PIOChecksum.h"
 
 @interface PIOFile() <PIOObjectProtocol>
 
@@ -32,50 +34,76 @@
 
 @implementation PIOFile
 
+static PIOModelField const PIOFileFields[] = {
+    {"name", "_name", PIOModelFieldRequired, NULL},
+    {"content_type", "_contentType", PIOModelFieldRequired, NULL},
+    {"icon", "_iconURL", PIOModelFieldRequired, pk_model_url},
+    {"created_at", "_dateOfCreation", PIOModelFieldRequired, pk_model_date},
+    {"id", "_identifier", 0, NULL},
+    {"size", "_size", 0, NULL},
+    {"parent_id", "_parentIdentifier", 0, NULL},
+    {"crc32", "_cyclicRedundancyCode", 0, NULL},
+    {"opensubtitles_hash", "_openSubtitlesHash", 0, NULL},
+    {"screenshot", "_screenshotURL", 0, pk_model_url},
+    {"first_accessed_at", "_dateFirstAccessed", 0, pk_model_date},
+    {"is_mp4_available", "_MP4Available", 0, NULL},
+    {"is_shared", "_shared", 0, NULL}
+};
+
 - (nullable instancetype)initFromDictionary:(NSDictionary *)dictionary {
     self = [super init];
     
+    return self != nil && [[PIOFile modelDecoder] decodeDictionary:dictionary intoObject:self] ? self : nil;
+}
+
++ (PIOModelDecoder *)modelDecoder {
+    static PIOModelDecoder *decoder;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        decoder = [[PIOModelDecoder alloc] initWithClass:PIOFile.class fields:PIOFileFields count:sizeof(PIOFileFields) / sizeof(PIOModelField)];
+    });
+    return decoder;
+}
+
++ (BOOL)supportsSecureCoding {
+    return YES;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder {
+    [coder encodeObject:self.name forKey:@"name"];
+    [coder encodeObject:self.contentType forKey:@"contentType"];
+    [coder encodeInteger:self.identifier forKey:@"identifier"];
+    [coder encodeInteger:self.parentIdentifier forKey:@"parentIdentifier"];
+    [coder encodeObject:self.cyclicRedundancyCode forKey:@"cyclicRedundancyCode"];
+    [coder encodeObject:self.dateOfCreation forKey:@"dateOfCreation"];
+    [coder encodeObject:self.dateFirstAccessed forKey:@"dateFirstAccessed"];
+    [coder encodeObject:self.iconURL forKey:@"iconURL"];
+    [coder encodeObject:self.screenshotURL forKey:@"screenshotURL"];
+    [coder encodeBool:self.isMP4Available forKey:@"MP4Available"];
+    [coder encodeBool:self.isShared forKey:@"shared"];
+    [coder encodeObject:self.openSubtitlesHash forKey:@"openSubtitlesHash"];
+    [coder encodeInt64:self.size forKey:@"size"];
+}
+
+- (nullable instancetype)initWithCoder:(NSCoder *)coder {
+    self = [super init];
+    
     if (self) {
-        _contentType = [dictionary objectForKey:@"content_type"];
-        _iconURL = [NSURL URLWithString:[dictionary objectForKey:@"icon"]];
-        _identifier = [[dictionary objectForKey:@"id"] integerValue];
-        _name = [dictionary objectForKey:@"name"];
-        _size = [[dictionary objectForKey:@"size"] integerValue];
+        _name = [coder decodeObjectOfClass:NSString.class forKey:@"name"];
+        _contentType = [coder decodeObjectOfClass:NSString.class forKey:@"contentType"];
+        _identifier = [coder decodeIntegerForKey:@"identifier"];
+        _parentIdentifier = [coder decodeIntegerForKey:@"parentIdentifier"];
+        _cyclicRedundancyCode = [coder decodeObjectOfClass:NSString.class forKey:@"cyclicRedundancyCode"];
+        _dateOfCreation = [coder decodeObjectOfClass:NSDate.class forKey:@"dateOfCreation"];
+        _dateFirstAccessed = [coder decodeObjectOfClass:NSDate.class forKey:@"dateFirstAccessed"];
+        _iconURL = [coder decodeObjectOfClass:NSURL.class forKey:@"iconURL"];
+        _screenshotURL = [coder decodeObjectOfClass:NSURL.class forKey:@"screenshotURL"];
+        _MP4Available = [coder decodeBoolForKey:@"MP4Available"];
+        _shared = [coder decodeBoolForKey:@"shared"];
+        _openSubtitlesHash = [coder decodeObjectOfClass:NSString.class forKey:@"openSubtitlesHash"];
+        _size = (NSUInteger)[coder decodeInt64ForKey:@"size"];
         
-        NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
-        [dateFormatter setDateFormat:@"yyyy-MM-dd'T'HH:mm:ss"];
-        
-        _dateOfCreation = [dateFormatter dateFromString:[dictionary objectForKey:@"created_at"]];
-        
-        if (!isnan(_identifier) &&
-            _contentType != nil &&
-            _iconURL != nil &&
-            !isnan(_identifier) &&
-            _name != nil &&
-            !isnan(_size) &&
-            _dateOfCreation != nil)
-        {
-            _MP4Available = [[dictionary objectForKey:@"is_mp4_available"] boolValue];
-            _shared = [[dictionary objectForKey:@"is_shared"] boolValue];
-            
-            NSString *cyclicRedundancyCode = [dictionary objectForKey:@"crc32"];
-            if ([cyclicRedundancyCode isKindOfClass:NSString.class]) _cyclicRedundancyCode = cyclicRedundancyCode;
-            
-            NSString *openSubtitlesHash = [dictionary objectForKey:@"opensubtitles_hash"];
-            if ([openSubtitlesHash isKindOfClass:NSString.class]) _openSubtitlesHash = openSubtitlesHash;
-            
-            id parentIdentifier = [dictionary objectForKey:@"parent_id"];
-            if (parentIdentifier != [NSNull null]) _parentIdentifier = [parentIdentifier integerValue];
-            
-            NSString *screenshotString = [dictionary objectForKey:@"screenshot"];
-            if ([screenshotString isKindOfClass:NSString.class]) _screenshotURL = [NSURL URLWithString:screenshotString];
-            
-            NSString *dateFirstAccessedString = [dictionary objectForKey:@"first_accessed_at"];
-            
-            if ([dateFirstAccessedString isKindOfClass:NSString.class]) _dateFirstAccessed = [dateFormatter dateFromString: dateFirstAccessedString];
-            
-            return self;
-        }
+        if (_name != nil && _contentType != nil && _dateOfCreation != nil && _iconURL != nil) return self;
     }
     
     return nil;
@@ -85,6 +113,24 @@
     return [self.contentType isEqualToString:@"application/x-directory"];
 }
 
+- (BOOL)matchesContentsOfURL:(NSURL *)fileURL error:(NSError **)error {
+    uint32_t expectedChecksum, checksum;
+    
+    if (!pk_crc32_from_string(self.cyclicRedundancyCode, &expectedChecksum)) {
+        if (error != NULL) *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFeatureUnsupportedError userInfo:@{NSLocalizedDescriptionKey: @"The file has no checksum to compare against."}];
+        return NO;
+    }
+    
+    if (!pk_crc32_file(fileURL, &checksum, error)) return NO;
+    
+    if (checksum != expectedChecksum) {
+        if (error != NULL) *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:@{NSLocalizedDescriptionKey: @"The file does not match its checksum.", NSFilePathErrorKey: fileURL.path}];
+        return NO;
+    }
+    
+    return YES;
+}
+
 - (NSString *)description {
     return [NSString stringWithFormat:@"<%@: %p> name = %@; contentType = %@; identifier = %zd; parentIdentifier = %zd; cyclicRedundancyCode = %@; dateOfCreation = %@; dateFirstAccessed = %@; iconURL = %@; screenshotURL = %@; isMP4Available = %@; isShared = %@; openSubtitlesHash = %@; size = %tu; isFolder = %@", [self class], self, self.name, self.contentType, self.identifier, self.parentIdentifier, self.cyclicRedundancyCode, self.dateOfCreation, self.dateFirstAccessed, self.iconURL, self.screenshotURL, self.isMP4Available ? @"YES" : @"NO", self.isShared ? @"YES" : @"NO", self.openSubtitlesHash, self.size, self.isFolder ? @"YES" : @"NO"];
 }
@@ -28,6 +28,31 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ The properties of a transfer that can change while it runs, used to say which of them differ between two snapshots of the same transfer.
+ */
+typedef NS_OPTIONS(NSUInteger, PIOTransferField) {
+    PIOTransferFieldName                    = 1 << 0,
+    PIOTransferFieldStatus                  = 1 << 1,
+    PIOTransferFieldStatusMessage           = 1 << 2,
+    PIOTransferFieldPercentageDownloaded    = 1 << 3,
+    PIOTransferFieldTotalDownloaded         = 1 << 4,
+    PIOTransferFieldTotalUploaded           = 1 << 5,
+    PIOTransferFieldDownloadSpeed           = 1 << 6,
+    PIOTransferFieldUploadSpeed             = 1 << 7,
+    PIOTransferFieldEstimatedTimeRemaining  = 1 << 8,
+    /** Any of `peers`, `peersLeaching` or `peersGiving`. */
+    PIOTransferFieldPeers                   = 1 << 9,
+    PIOTransferFieldSeedToPeerRatio         = 1 << 10,
+    PIOTransferFieldError                   = 1 << 11,
+    PIOTransferFieldFileIdentifier          = 1 << 12,
+    PIOTransferFieldParentIdentifier        = 1 << 13,
+    PIOTransferFieldSize                    = 1 << 14,
+    PIOTransferFieldDateFinished            = 1 << 15,
+    PIOTransferFieldTimeSeeding             = 1 << 16,
+    PIOTransferFieldTrackerMessage          = 1 << 17
+} NS_SWIFT_NAME(TransferField);
+
 /**
  A transfer object. Transfers are associated with the transmission of a file to a user's computer.
  */
@@ -103,6 +128,9 @@ NS_SWIFT_NAME(Transfer)
 /** The status of transfer. */
 @property (nonatomic, readonly) PIOTransferStatus status;
 
+/** A boolean value indicating whether the transfer will never download anything more, because it has completed, is seeding, has failed or was cancelled. */
+@property (nonatomic, readonly, getter=isFinished) BOOL finished;
+
 /** The status message of transfer containing an unlocalised concatination of the download speed, the number of peers and seeds connected, and the amount of the file that has been uploaded and downloaded. */
 @property (strong, nonatomic, readonly) NSString *statusMessage;
 
@@ -118,6 +146,15 @@ NS_SWIFT_NAME(Transfer)
 /** The tracker message of the transfer, if any. */
 @property (nonatomic, nullable, readonly) NSString *trackerMessage;
 
+/**
+ Compares this snapshot of a transfer with another one.
+ 
+ @param transfer    Another snapshot of the same transfer, usually an earlier one.
+ 
+ @return    The fields whose values differ between the two snapshots, or @b 0 if none do.
+ */
+- (PIOTransferField)fieldsDifferingFromTransfer:(PIOTransfer *)transfer NS_SWIFT_NAME(fieldsDiffering(from:));
+
 @end
 
 NS_ASSUME_NONNULL_END
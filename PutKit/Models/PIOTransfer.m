@@ -25,6 +25,7 @@
 
 #import "PIOTransfer.h"
 #import "PIOObjectProtocol.h"
+#import "PIOModelDecoder.h"
 
 @interface PIOTransfer() <PIOObjectProtocol>
 
@@ -32,82 +33,89 @@
 
 @implementation PIOTransfer
 
+static id pk_transfer_error(id message) {
+    return [message isKindOfClass:NSString.class] ? [NSError errorWithDomain:@"io.put.kit.error" code:-1 userInfo:@{NSLocalizedDescriptionKey: message}] : nil;
+}
+
+static PIOModelField const PIOTransferFields[] = {
+    {"created_at", "_dateOfCreation", PIOModelFieldRequired, pk_model_date},
+    {"name", "_name", PIOModelFieldRequired, NULL},
+    {"status_message", "_statusMessage", PIOModelFieldRequired, NULL},
+    {"status", "_status", 0, NULL},
+    {"id", "_identifier", 0, NULL},
+    {"current_ratio", "_seedToPeerRatio", 0, NULL},
+    {"down_speed", "_downloadSpeed", 0, NULL},
+    {"up_speed", "_uploadSpeed", 0, NULL},
+    {"downloaded", "_totalDownloaded", 0, NULL},
+    {"uploaded", "_totalUploaded", 0, NULL},
+    {"peers_connected", "_peers", 0, NULL},
+    {"peers_getting_from_us", "_peersLeaching", 0, NULL},
+    {"peers_sending_to_us", "_peersGiving", 0, NULL},
+    {"percent_done", "_percentageDownloaded", 0, NULL},
+    {"save_parent_id", "_parentIdentifier", 0, NULL},
+    {"size", "_size", 0, NULL},
+    {"callback_url", "_callbackURL", 0, pk_model_url},
+    {"error_message", "_error", 0, pk_transfer_error},
+    {"estimated_time", "_estimatedTimeRemaining", 0, NULL},
+    {"file_id", "_fileIdentifier", 0, NULL},
+    {"source", "_source", 0, NULL},
+    {"subscription_id", "_subscriptionIdentifier", 0, NULL},
+    {"tracker_message", "_trackerMessage", 0, NULL},
+    {"finished_at", "_dateFinished", 0, pk_model_date},
+    {"extract", "_willExtract", 0, NULL},
+    {"is_private", "_private", 0, NULL},
+    {"seconds_seeding", "_timeSeeding", 0, NULL}
+};
+
 - (nullable instancetype)initFromDictionary:(NSDictionary * _Nonnull)dictionary {
     self = [super init];
     
-    if (self) {
-        NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
-        [dateFormatter setDateFormat:@"yyyy-MM-dd'T'HH:mm:ss"];
-        
-        _dateOfCreation = [dateFormatter dateFromString:[dictionary objectForKey:@"created_at"]];
-        _seedToPeerRatio = [[dictionary objectForKey:@"current_ratio"] floatValue];
-        _downloadSpeed = [[dictionary objectForKey:@"down_speed"] doubleValue];
-        _totalDownloaded = [[dictionary objectForKey:@"downloaded"] integerValue];
-        _identifier = [[dictionary objectForKey:@"id"] integerValue];
-        _name = [dictionary objectForKey:@"name"];
-        _peers = [[dictionary objectForKey:@"peers_connected"] integerValue];
-        _peersLeaching = [[dictionary objectForKey:@"peers_getting_from_us"] integerValue];
-        _peersGiving = [[dictionary objectForKey:@"peers_sending_to_us"] integerValue];
-        _percentageDownloaded = [[dictionary objectForKey:@"percent_done"] doubleValue];
-        _parentIdentifier = [[dictionary objectForKey:@"save_parent_id"] integerValue];
-        _size = [[dictionary objectForKey:@"size"] integerValue];
-        _status = [dictionary objectForKey:@"status"];
-        _statusMessage = [dictionary objectForKey:@"status_message"];
-        _uploadSpeed = [[dictionary objectForKey:@"up_speed"] doubleValue];
-        _totalUploaded = [[dictionary objectForKey:@"uploaded"] doubleValue];
-        
-        if (_dateOfCreation != nil &&
-            !isnan(_seedToPeerRatio) &&
-            !isnan(_downloadSpeed) &&
-            !isnan(_totalDownloaded) &&
-            !isnan(_identifier) &&
-            _name != nil &&
-            !isnan(_peers) &&
-            !isnan(_peersLeaching) &&
-            !isnan(_peersGiving) &&
-            !isnan(_percentageDownloaded) &&
-            !isnan(_parentIdentifier) &&
-            !isnan(_size) &&
-            ![_status isEqualToString:PIOTransferStatusUnknown] &&
-            _statusMessage != nil &&
-            !isnan(_uploadSpeed) &&
-            !isnan(_totalUploaded))
-        {
-            NSString *callbackString = [dictionary objectForKey:@"callback_url"];
-            if ([callbackString isKindOfClass:NSString.class]) _callbackURL = [NSURL URLWithString:callbackString];
-            
-            NSString *errorMessage = [dictionary objectForKey:@"error_message"];
-            if ([errorMessage isKindOfClass:NSString.class]) _error = [NSError errorWithDomain:@"io.put.kit.error" code:-1 userInfo:@{NSLocalizedDescriptionKey: errorMessage}];
-            
-            id estimatedTimeRemaining = [dictionary objectForKey:@"estimated_time"];
-            if (estimatedTimeRemaining != [NSNull null]) _estimatedTimeRemaining = [estimatedTimeRemaining doubleValue];
-            
-            id fileIdentifier = [dictionary objectForKey:@"file_id"];
-            if (fileIdentifier != [NSNull null]) _fileIdentifier = [fileIdentifier integerValue];
-            
-            id source = [dictionary objectForKey:@"source"];
-            if ([source isKindOfClass:NSString.class]) _source = source;
-            
-            id subscriptionIdentifier = [dictionary objectForKey:@"subscription_id"];
-            if (subscriptionIdentifier != [NSNull null]) _subscriptionIdentifier = [subscriptionIdentifier integerValue];
-            
-            NSString *trackerMessage = [dictionary objectForKey:@"tracker_message"];
-            if ([trackerMessage isKindOfClass:NSString.class]) _trackerMessage = trackerMessage;
-            
-            NSString *dateFinishedString = [dictionary objectForKey:@"finished_at"];
-            if ([dateFinishedString isKindOfClass:NSString.class]) _dateFinished = [dateFormatter dateFromString:dateFinishedString];
-            
-            _willExtract = [[dictionary objectForKey:@"extract"] boolValue];
-            _private = [[dictionary objectForKey:@"is_private"] boolValue];
-            
-            id timeSeeding = [dictionary objectForKey:@"seconds_seeding"];
-            if (timeSeeding != [NSNull null]) _timeSeeding = [timeSeeding doubleValue];
-            
-            return self;
-        }
-    }
+    return self != nil && [[PIOTransfer modelDecoder] decodeDictionary:dictionary intoObject:self] ? self : nil;
+}
+
++ (PIOModelDecoder *)modelDecoder {
+    static PIOModelDecoder *decoder;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        decoder = [[PIOModelDecoder alloc] initWithClass:PIOTransfer.class fields:PIOTransferFields count:sizeof(PIOTransferFields) / sizeof(PIOModelField)];
+    });
+    return decoder;
+}
+
+static BOOL pk_objects_equal(id _Nullable a, id _Nullable b) {
+    return a == b || [a isEqual:b];
+}
+
+- (PIOTransferField)fieldsDifferingFromTransfer:(PIOTransfer *)transfer {
+    PIOTransferField fields = 0;
+    
+    if (!pk_objects_equal(_name, transfer.name)) fields |= PIOTransferFieldName;
+    if (!pk_objects_equal(_status, transfer.status)) fields |= PIOTransferFieldStatus;
+    if (!pk_objects_equal(_statusMessage, transfer.statusMessage)) fields |= PIOTransferFieldStatusMessage;
+    if (_percentageDownloaded != transfer.percentageDownloaded) fields |= PIOTransferFieldPercentageDownloaded;
+    if (_totalDownloaded != transfer.totalDownloaded) fields |= PIOTransferFieldTotalDownloaded;
+    if (_totalUploaded != transfer.totalUploaded) fields |= PIOTransferFieldTotalUploaded;
+    if (_downloadSpeed != transfer.downloadSpeed) fields |= PIOTransferFieldDownloadSpeed;
+    if (_uploadSpeed != transfer.uploadSpeed) fields |= PIOTransferFieldUploadSpeed;
+    if (_estimatedTimeRemaining != transfer.estimatedTimeRemaining) fields |= PIOTransferFieldEstimatedTimeRemaining;
+    if (_peers != transfer.peers || _peersLeaching != transfer.peersLeaching || _peersGiving != transfer.peersGiving) fields |= PIOTransferFieldPeers;
+    if (_seedToPeerRatio != transfer.seedToPeerRatio) fields |= PIOTransferFieldSeedToPeerRatio;
+    if (!pk_objects_equal(_error.localizedDescription, transfer.error.localizedDescription)) fields |= PIOTransferFieldError;
+    if (_fileIdentifier != transfer.fileIdentifier) fields |= PIOTransferFieldFileIdentifier;
+    if (_parentIdentifier != transfer.parentIdentifier) fields |= PIOTransferFieldParentIdentifier;
+    if (_size != transfer.size) fields |= PIOTransferFieldSize;
+    if (!pk_objects_equal(_dateFinished, transfer.dateFinished)) fields |= PIOTransferFieldDateFinished;
+    if (_timeSeeding != transfer.timeSeeding) fields |= PIOTransferFieldTimeSeeding;
+    if (!pk_objects_equal(_trackerMessage, transfer.trackerMessage)) fields |= PIOTransferFieldTrackerMessage;
     
-    return nil;
+    return fields;
+}
+
+- (BOOL)isFinished {
+    return [_status isEqualToString:PIOTransferStatusCompleted] ||
+           [_status isEqualToString:PIOTransferStatusSeeding] ||
+           [_status isEqualToString:PIOTransferStatusError] ||
+           [_status isEqualToString:PIOTransferStatusCancelled];
 }
 
 - (NSString *)description {
@@ -36,9 +36,24 @@ extern PIOTransferStatus const PIOTransferStatusDownloading;
 /** The transfer is queued and will be started shortly. */
 extern PIOTransferStatus const PIOTransferStatusInQueue;
 
+/** The transfer is waiting for a download slot on the account. */
+extern PIOTransferStatus const PIOTransferStatusWaiting;
+
+/** The transfer is fetching metadata before it starts downloading. */
+extern PIOTransferStatus const PIOTransferStatusPreparingDownload;
+
+/** The transfer has downloaded everything and is being moved into the user's files. */
+extern PIOTransferStatus const PIOTransferStatusCompleting;
+
+/** The transfer has completed and is uploading to other peers. */
+extern PIOTransferStatus const PIOTransferStatusSeeding;
+
 /** The transfer has completed. */
 extern PIOTransferStatus const PIOTransferStatusCompleted;
 
+/** The transfer failed. The reason is in the transfer's `error`. */
+extern PIOTransferStatus const PIOTransferStatusError;
+
 /** The transfer was manually cancelled. */
 extern PIOTransferStatus const PIOTransferStatusCancelled;
 
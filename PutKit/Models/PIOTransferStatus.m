@@ -27,6 +27,11 @@
 
 PIOTransferStatus const PIOTransferStatusDownloading = @"DOWNLOADING";
 PIOTransferStatus const PIOTransferStatusInQueue = @"IN_QUEUE";
+PIOTransferStatus const PIOTransferStatusWaiting = @"WAITING";
+PIOTransferStatus const PIOTransferStatusPreparingDownload = @"PREPARING_DOWNLOAD";
+PIOTransferStatus const PIOTransferStatusCompleting = @"COMPLETING";
+PIOTransferStatus const PIOTransferStatusSeeding = @"SEEDING";
 PIOTransferStatus const PIOTransferStatusCompleted = @"COMPLETED";
+PIOTransferStatus const PIOTransferStatusError = @"ERROR";
 PIOTransferStatus const PIOTransferStatusCancelled = @"CANCELLED";
 PIOTransferStatus const PIOTransferStatusUnknown;
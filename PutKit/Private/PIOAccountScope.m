@@ -0,0 +1,47 @@
+//
+//  PIOAccountScope.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIOAccountScope.h"
+#import "PIOAuth.h"
+#import "AFOAuthCredential.h"
+#import <CommonCrypto/CommonDigest.h>
+
+static NSUInteger const kPIOAccountScopeLength = 8; // Bytes of the hash kept, which is plenty to tell the accounts on one device apart.
+
+NSString *pk_account_scope(void) {
+    NSString *accessToken = [PIOAuth sharedInstance].credential.accessToken;
+    
+    if (accessToken.length == 0) return nil;
+    
+    NSData *data = [accessToken dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    NSMutableString *scope = [NSMutableString stringWithCapacity:kPIOAccountScopeLength * 2];
+    
+    CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+    
+    for (NSUInteger index = 0; index < kPIOAccountScopeLength; index++) [scope appendFormat:@"%02x", digest[index]];
+    
+    return scope;
+}
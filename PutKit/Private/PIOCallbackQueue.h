@@ -0,0 +1,53 @@
+//
+//  PIOCallbackQueue.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Returns the queue that callbacks made from the current thread should be performed on: the one set by the innermost `pk_perform_with_callback_queue` call if there is one, otherwise the `callbackQueue` of the session's configuration. `nil` means callbacks are performed inline, on whatever queue they are made from.
+ */
+FOUNDATION_EXTERN NSOperationQueue * _Nullable pk_callback_queue(void);
+
+/**
+ Performs a block synchronously with the callback queue of the current thread set to the specified queue, so that every request created inside it calls back on that queue. The previous callback queue is restored afterwards.
+ 
+ @param queue   The queue to call back on, or `nil` to call back inline.
+ @param block   The block to perform.
+ */
+FOUNDATION_EXTERN void pk_perform_with_callback_queue(NSOperationQueue * _Nullable queue, NS_NOESCAPE dispatch_block_t block);
+
+/**
+ Performs a block on the current callback queue, as returned by `pk_callback_queue`.
+ */
+FOUNDATION_EXTERN void pk_dispatch_callback(dispatch_block_t block);
+
+/**
+ Performs a block on the specified queue, or straight away if the queue is `nil`. The block is performed with the callback queue of the current thread set to the specified queue.
+ */
+FOUNDATION_EXTERN void pk_dispatch_callback_on(NSOperationQueue * _Nullable queue, dispatch_block_t block);
+
+NS_ASSUME_NONNULL_END
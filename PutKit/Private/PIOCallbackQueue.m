@@ -0,0 +1,67 @@
+//
+//  PIOCallbackQueue.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIOCallbackQueue.h"
+#import "PIOSession.h"
+#import "PIOConfiguration.h"
+
+static NSString * const kPIOCallbackQueueThreadKey = @"io.put.kit.callback-queue";
+
+NSOperationQueue *pk_callback_queue(void) {
+    id queue = [NSThread currentThread].threadDictionary[kPIOCallbackQueueThreadKey];
+    
+    if (queue == nil) return [PIOSession sharedInstance].configuration.callbackQueue;
+    
+    return queue == [NSNull null] ? nil : queue;
+}
+
+void pk_perform_with_callback_queue(NSOperationQueue *queue, dispatch_block_t block) {
+    NSMutableDictionary *threadDictionary = [NSThread currentThread].threadDictionary;
+    id previousQueue = threadDictionary[kPIOCallbackQueueThreadKey];
+    
+    threadDictionary[kPIOCallbackQueueThreadKey] = queue ?: [NSNull null];
+    
+    @try {
+        block();
+    } @finally {
+        threadDictionary[kPIOCallbackQueueThreadKey] = previousQueue;
+    }
+}
+
+void pk_dispatch_callback(dispatch_block_t block) {
+    pk_dispatch_callback_on(pk_callback_queue(), block);
+}
+
+void pk_dispatch_callback_on(NSOperationQueue *queue, dispatch_block_t block) {
+    if (queue == nil) {
+        pk_perform_with_callback_queue(nil, block);
+        return;
+    }
+    
+    // Requests made by the callback call back on the same queue as it did.
+    [queue addOperationWithBlock:^{
+        pk_perform_with_callback_queue(queue, block);
+    }];
+}
@@ -0,0 +1,75 @@
+//
+//  PIOChecksum.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Updates a CRC32 checksum (the same polynomial used by zlib and by @b Put.io's `crc32` field) with more bytes.
+ 
+ Uses the CRC32 instructions on ARMv8, carry-less multiplication on x86_64 and a slicing-by-8 table everywhere else.
+ 
+ @param crc     The checksum of the bytes before these ones, or @b 0 to start a new checksum.
+ @param bytes   The bytes to be added.
+ @param length  The number of bytes.
+ 
+ @returns   The checksum of all the bytes so far.
+ */
+uint32_t pk_crc32(uint32_t crc, const void *bytes, size_t length);
+
+/**
+ Combines the checksums of two consecutive blocks of bytes into the checksum of both, without needing the bytes themselves.
+ 
+ @param crc1    The checksum of the first block.
+ @param crc2    The checksum of the second block.
+ @param length2 The length of the second block.
+ 
+ @returns   The checksum of the first block followed by the second.
+ */
+uint32_t pk_crc32_combine(uint32_t crc1, uint32_t crc2, int64_t length2);
+
+/**
+ Computes the CRC32 checksum of a file, reading it in fixed-size chunks.
+ 
+ @param fileURL     The file whose checksum is to be computed.
+ @param checksum    Set to the checksum of the file.
+ @param error       An error pointer, set if the file couldn't be read.
+ 
+ @returns   `YES` if the checksum was computed, otherwise `NO`.
+ */
+BOOL pk_crc32_file(NSURL *fileURL, uint32_t *checksum, NSError * _Nullable * _Nullable error);
+
+/**
+ Parses a checksum in the hexadecimal form @b Put.io sends it in.
+ 
+ @param string  The checksum string, e.g. `PIOFile.cyclicRedundancyCode`.
+ @param checksum    Set to the parsed checksum.
+ 
+ @returns   `YES` if the string was a valid checksum, otherwise `NO`.
+ */
+BOOL pk_crc32_from_string(NSString * _Nullable string, uint32_t *checksum);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,341 @@
+//
+//  PIOChecksum.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIOChecksum.h"
+
+#if defined(__ARM_FEATURE_CRC32)
+#import <arm_acle.h>
+#elif defined(__x86_64__)
+#import <immintrin.h>
+#endif
+
+static size_t const kPIOChecksumFileChunkSize = 1024 * 1024;
+static uint32_t const kPIOChecksumPolynomial = 0xEDB88320; // The reflected CRC32 polynomial used by zlib.
+
+#pragma mark - Slicing-by-8
+
+// pk_crc32_tables[k][n] is the CRC of byte n followed by k zero bytes, which lets eight bytes be folded in with eight independent lookups.
+static uint32_t pk_crc32_tables[8][256];
+
+static void pk_crc32_make_tables(void) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t crc = n;
+        
+        for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (kPIOChecksumPolynomial & -(crc & 1));
+        
+        pk_crc32_tables[0][n] = crc;
+    }
+    
+    for (uint32_t n = 0; n < 256; n++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t crc = pk_crc32_tables[k - 1][n];
+            pk_crc32_tables[k][n] = (crc >> 8) ^ pk_crc32_tables[0][crc & 0xFF];
+        }
+    }
+}
+
+static uint32_t pk_crc32_sliced(uint32_t crc, const uint8_t *buffer, size_t length) {
+    while (length > 0 && ((uintptr_t)buffer & 7) != 0) {
+        crc = pk_crc32_tables[0][(crc ^ *buffer++) & 0xFF] ^ (crc >> 8);
+        length--;
+    }
+    
+    while (length >= 8) {
+        uint32_t low, high;
+        
+        memcpy(&low, buffer, 4);
+        memcpy(&high, buffer + 4, 4);
+        low ^= crc;
+        
+        crc = pk_crc32_tables[7][low & 0xFF] ^
+              pk_crc32_tables[6][(low >> 8) & 0xFF] ^
+              pk_crc32_tables[5][(low >> 16) & 0xFF] ^
+              pk_crc32_tables[4][low >> 24] ^
+              pk_crc32_tables[3][high & 0xFF] ^
+              pk_crc32_tables[2][(high >> 8) & 0xFF] ^
+              pk_crc32_tables[1][(high >> 16) & 0xFF] ^
+              pk_crc32_tables[0][high >> 24];
+        
+        buffer += 8;
+        length -= 8;
+    }
+    
+    while (length-- > 0) crc = pk_crc32_tables[0][(crc ^ *buffer++) & 0xFF] ^ (crc >> 8);
+    
+    return crc;
+}
+
+#pragma mark - ARMv8 CRC32 instructions
+
+// ARMv8 has optional instructions for exactly this polynomial; the compiler only advertises them when every processor the target architecture allows has them.
+#if defined(__ARM_FEATURE_CRC32)
+
+static uint32_t pk_crc32_arm(uint32_t crc, const uint8_t *buffer, size_t length) {
+    while (length > 0 && ((uintptr_t)buffer & 7) != 0) {
+        crc = __crc32b(crc, *buffer++);
+        length--;
+    }
+    
+    while (length >= 8) {
+        uint64_t word;
+        
+        memcpy(&word, buffer, 8);
+        crc = __crc32d(crc, word);
+        
+        buffer += 8;
+        length -= 8;
+    }
+    
+    while (length-- > 0) crc = __crc32b(crc, *buffer++);
+    
+    return crc;
+}
+
+#endif
+
+#pragma mark - x86 carry-less multiplication
+
+#if defined(__x86_64__)
+
+// Folds 64 bytes at a time with PCLMULQDQ, as described in "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Gopal et al., Intel). The buffer must be at least 64 bytes long and a multiple of 16 bytes.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t pk_crc32_clmul(uint32_t crc, const uint8_t *buffer, size_t length) {
+    static const uint64_t k1k2[] __attribute__((aligned(16))) = {0x0154442bd4, 0x01c6e41596};
+    static const uint64_t k3k4[] __attribute__((aligned(16))) = {0x01751997d0, 0x00ccaa009e};
+    static const uint64_t k5k0[] __attribute__((aligned(16))) = {0x0163cd6124, 0x0000000000};
+    static const uint64_t poly[] __attribute__((aligned(16))) = {0x01db710641, 0x01f7011641};
+    
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+    
+    x1 = _mm_loadu_si128((const __m128i *)(buffer + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buffer + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buffer + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buffer + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    
+    buffer += 64;
+    length -= 64;
+    
+    // Fold four 128 bit lanes forward by 512 bits at a time.
+    while (length >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        
+        y5 = _mm_loadu_si128((const __m128i *)(buffer + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(buffer + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(buffer + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(buffer + 0x30));
+        
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        
+        buffer += 64;
+        length -= 64;
+    }
+    
+    // Fold the four lanes into one.
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+    
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+    
+    while (length >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)buffer);
+        
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        
+        buffer += 16;
+        length -= 16;
+    }
+    
+    // Fold 128 bits down to 64.
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    
+    // Barrett reduction to 32 bits.
+    x0 = _mm_load_si128((const __m128i *)poly);
+    
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+#endif
+
+#pragma mark - Public
+
+#if defined(__x86_64__)
+static BOOL pk_crc32_has_clmul; // Every Mac since 2010 has it, but the simulator may be running on something older.
+#endif
+
+uint32_t pk_crc32(uint32_t crc, const void *bytes, size_t length) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pk_crc32_make_tables();
+#if defined(__x86_64__)
+        pk_crc32_has_clmul = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+    });
+    
+    const uint8_t *buffer = bytes;
+    
+    crc = ~crc;
+    
+#if defined(__x86_64__)
+    if (pk_crc32_has_clmul && length >= 64) {
+        size_t folded = length & ~(size_t)15;
+        
+        crc = pk_crc32_clmul(crc, buffer, folded);
+        buffer += folded;
+        length -= folded;
+    }
+#endif
+    
+#if defined(__ARM_FEATURE_CRC32)
+    crc = pk_crc32_arm(crc, buffer, length);
+#else
+    crc = pk_crc32_sliced(crc, buffer, length);
+#endif
+    
+    return ~crc;
+}
+
+#pragma mark - Combining
+
+// Multiplies two polynomials modulo the CRC polynomial, where bit 31 holds the coefficient of x^0.
+static uint32_t pk_crc32_multiply(uint32_t a, uint32_t b) {
+    uint32_t m = (uint32_t)1 << 31, product = 0;
+    
+    for (;;) {
+        if (a & m) {
+            product ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ kPIOChecksumPolynomial : b >> 1;
+    }
+    
+    return product;
+}
+
+uint32_t pk_crc32_combine(uint32_t crc1, uint32_t crc2, int64_t length2) {
+    // x2n[k] is x^(2^k) modulo the polynomial, so x^(8 * length2) can be built from the bits of length2.
+    static uint32_t x2n[32];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        uint32_t p = (uint32_t)1 << 30; // x^1
+        
+        x2n[0] = p;
+        for (int k = 1; k < 32; k++) x2n[k] = p = pk_crc32_multiply(p, p);
+    });
+    
+    uint32_t p = (uint32_t)1 << 31; // x^0
+    
+    for (unsigned k = 3; length2 > 0; length2 >>= 1, k++) {
+        if (length2 & 1) p = pk_crc32_multiply(x2n[k & 31], p);
+    }
+    
+    return pk_crc32_multiply(p, crc1) ^ crc2;
+}
+
+#pragma mark - Files and strings
+
+BOOL pk_crc32_file(NSURL *fileURL, uint32_t *checksum, NSError **error) {
+    FILE *file = fopen(fileURL.fileSystemRepresentation, "rb");
+    
+    if (file == NULL) {
+        if (error != NULL) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSFilePathErrorKey: fileURL.path}];
+        return NO;
+    }
+    
+    void *buffer = malloc(kPIOChecksumFileChunkSize);
+    uint32_t crc = 0;
+    size_t count;
+    
+    while ((count = fread(buffer, 1, kPIOChecksumFileChunkSize, file)) > 0) crc = pk_crc32(crc, buffer, count);
+    
+    BOOL failed = ferror(file) != 0;
+    int code = errno;
+    
+    free(buffer);
+    fclose(file);
+    
+    if (failed) {
+        if (error != NULL) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:code userInfo:@{NSFilePathErrorKey: fileURL.path}];
+        return NO;
+    }
+    
+    *checksum = crc;
+    
+    return YES;
+}
+
+BOOL pk_crc32_from_string(NSString *string, uint32_t *checksum) {
+    if (![string isKindOfClass:NSString.class] || string.length == 0 || string.length > 8) return NO;
+    
+    unsigned int value = 0;
+    NSScanner *scanner = [NSScanner scannerWithString:string];
+    
+    if (![scanner scanHexInt:&value] || !scanner.isAtEnd) return NO;
+    
+    *checksum = value;
+    
+    return YES;
+}
@@ -0,0 +1,37 @@
+//
+//  PIODate.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Parses a timestamp in the fixed `yyyy-MM-dd'T'HH:mm:ss` format used by every @b Put.io api response.
+ 
+ The string is parsed by hand rather than with an `NSDateFormatter`, so no formatter has to be created, configured or locked, and this function is safe to call from any thread. Timestamps are interpreted as UTC, which is the time zone the @b Put.io servers report in.
+ 
+ @param string  The timestamp string. Any object that is not an `NSString` (e.g. `NSNull`) is accepted and results in `nil`.
+ 
+ @returns   The parsed date, or `nil` if the string is not a valid timestamp.
+ */
+NSDate * _Nullable pk_date_from_string(id _Nullable string);
@@ -0,0 +1,90 @@
+//
+//  PIODate.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIODate.h"
+
+#define PIO_TIMESTAMP_LENGTH 19 // yyyy-MM-dd'T'HH:mm:ss
+
+static inline BOOL pk_parse_digits(const unichar *characters, NSUInteger count, NSInteger *value) {
+    NSInteger result = 0;
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        unichar character = characters[i];
+        if (character < '0' || character > '9') return NO;
+        result = result * 10 + (character - '0');
+    }
+    
+    *value = result;
+    return YES;
+}
+
+/**
+ The number of days between 1970-01-01 and the given date in the proleptic Gregorian calendar. See http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+ */
+static inline NSInteger pk_days_from_civil(NSInteger year, NSInteger month, NSInteger day) {
+    year -= month <= 2;
+    NSInteger era = (year >= 0 ? year : year - 399) / 400;
+    NSInteger yearOfEra = year - era * 400;
+    NSInteger dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    NSInteger dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+/**
+ The number of days in the given month of the proleptic Gregorian calendar.
+ */
+static inline NSInteger pk_days_in_month(NSInteger year, NSInteger month) {
+    static const NSInteger days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    BOOL leapYear = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    
+    return month == 2 && leapYear ? 29 : days[month - 1];
+}
+
+NSDate *pk_date_from_string(id string) {
+    if (![string isKindOfClass:NSString.class] || [string length] != PIO_TIMESTAMP_LENGTH) return nil;
+    
+    unichar c[PIO_TIMESTAMP_LENGTH];
+    [string getCharacters:c range:NSMakeRange(0, PIO_TIMESTAMP_LENGTH)];
+    
+    if (c[4] != '-' || c[7] != '-' || c[10] != 'T' || c[13] != ':' || c[16] != ':') return nil;
+    
+    NSInteger year, month, day, hour, minute, second;
+    
+    if (!pk_parse_digits(c, 4, &year) ||
+        !pk_parse_digits(c + 5, 2, &month) ||
+        !pk_parse_digits(c + 8, 2, &day) ||
+        !pk_parse_digits(c + 11, 2, &hour) ||
+        !pk_parse_digits(c + 14, 2, &minute) ||
+        !pk_parse_digits(c + 17, 2, &second))
+    {
+        return nil;
+    }
+    
+    if (month < 1 || month > 12 || day < 1 || day > pk_days_in_month(year, month) || hour > 23 || minute > 59 || second > 60) return nil;
+    
+    NSTimeInterval interval = pk_days_from_civil(year, month, day) * 86400.0 + hour * 3600 + minute * 60 + second;
+    
+    return [NSDate dateWithTimeIntervalSince1970:interval];
+}
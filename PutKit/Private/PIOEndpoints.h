@@ -31,8 +31,10 @@ extern NSString * const kPIOEndpointClients;
 
 extern NSString * const kPIOEndpointFiles;
 extern NSString * const kPIOEndpointListFiles;
+extern NSString * const kPIOEndpointContinueListingFiles;
 extern NSString * const kPIOEndpointSearchFiles;
 extern NSString * const kPIOEndpointUploadFiles;
+extern NSString * const kPIOEndpointResumableUploads;
 extern NSString * const kPIOEndpointCreateFolder;
 extern NSString * const kPIOEndpointDeleteFiles;
 extern NSString * const kPIOEndpointRenameFile;
@@ -27,6 +27,7 @@
 
 #define PIO_ENDPOINT_BASE @"https://api.put.io/v2"
 #define PIO_ENDPOINT_UPLOAD_BASE @"https://upload.put.io/v2"
+#define PIO_ENDPOINT_UPLOAD_ROOT @"https://upload.put.io"
 
 NSString * const kPIOEndpointAuthenticate = PIO_ENDPOINT_BASE @"/oauth2/authenticate";
 NSString * const kPIOEndpointAccessToken = PIO_ENDPOINT_BASE @"/oauth2/access_token";
@@ -34,8 +35,10 @@ NSString * const kPIOEndpointClients = PIO_ENDPOINT_BASE @"/oauth/clients";
 
 NSString * const kPIOEndpointFiles = PIO_ENDPOINT_BASE @"/files";
 NSString * const kPIOEndpointListFiles = PIO_ENDPOINT_BASE @"/files/list";
+NSString * const kPIOEndpointContinueListingFiles = PIO_ENDPOINT_BASE @"/files/list/continue";
 NSString * const kPIOEndpointSearchFiles = PIO_ENDPOINT_BASE @"/files/search";
 NSString * const kPIOEndpointUploadFiles = PIO_ENDPOINT_UPLOAD_BASE @"/files/upload";
+NSString * const kPIOEndpointResumableUploads = PIO_ENDPOINT_UPLOAD_ROOT @"/files/";
 NSString * const kPIOEndpointCreateFolder = PIO_ENDPOINT_BASE @"/files/create-folder";
 NSString * const kPIOEndpointDeleteFiles = PIO_ENDPOINT_BASE @"/files/delete";
 NSString * const kPIOEndpointRenameFile = PIO_ENDPOINT_BASE @"/files/rename";
@@ -25,12 +25,53 @@
 
 #import <Foundation/Foundation.h>
 
+/** The error domain of every error created by PutKit. */
+extern NSString * const kPIOErrorDomain;
+
 /**
- Validates valid response JSON for any server-side @b Put.io errors.
+ Decodes a response body exactly once and validates the decoded object for any server-side @b Put.io errors.
+ 
+ The body is parsed a single time and the resulting object tree is both checked for the @b Put.io error envelope (`error_message`, `error_type` and `status_code`) and returned to the caller, so the model layer never has to parse the same data again. If the body carries no error envelope, the HTTP status code of the response is checked instead.
  
  @param responseData    Unparsed JSON response data recieved from a call to any @b Put.io API method.
- @param error           An error pointer. If there is a server side error, an `NSError` object will be created with the same code and message description as the server side error.
+ @param response        The response the data was recieved with, if any.
+ @param error           An error pointer. If it already points to an error (e.g. a transport error), the body is not decoded. If there is a server side error, an `NSError` object will be created with the same code and message description as the server side error.
+ 
+ @returns   The decoded response dictionary, or `nil` if there was an error or the body was not a JSON dictionary.
+ */
+NSDictionary * _Nullable pk_response_decode(NSData * _Nullable responseData, NSURLResponse * _Nullable response, NSError * _Nullable * _Nonnull error);
+
+/**
+ Validates a response that has already been decoded, e.g. by a streaming decoder, in the same way as `pk_response_decode`: the @b Put.io error envelope is checked first, then the HTTP status code of the response.
+ 
+ @param responseDictionary  The decoded response, if any.
+ @param response            The response the body was recieved with, if any.
+ @param error               An error pointer. If there is a server side error, an `NSError` object will be created with the same code and message description as the server side error.
+ 
+ @returns   `NO` if the response is an error.
+ */
+BOOL pk_response_validate(NSDictionary * _Nullable responseDictionary, NSURLResponse * _Nullable response, NSError * _Nullable * _Nonnull error);
+
+/**
+ Returns whether a request that failed with the specified error could succeed if it was sent again as it is, i.e. the connection timed out or dropped, the host couldn't be reached or the server is temporarily unable to handle it. This is the one rule for what is worth retrying, used by the session and by every component that retries on its own.
+ 
+ @param error   The error the request failed with.
+ */
+BOOL pk_error_is_transient(NSError * _Nonnull error);
+
+/**
+ Returns whether a response with the specified HTTP status code is temporarily unable to be handled, i.e. the server is overloaded or rate limited, in the same way as `pk_error_is_transient`.
+ 
+ @param statusCode  The HTTP status code of the response.
+ */
+BOOL pk_status_code_is_transient(NSInteger statusCode);
+
+/**
+ Looks up the value of an HTTP header in a response, ignoring the case of the header's name.
+ 
+ @param response    The response the header was recieved with.
+ @param name        The name of the header.
  
- @returns   Boolean indicating whether or not there is an error - i.e. returns `YES` when there is no error and `NO` when there is an error.
+ @returns   The value of the header, or `nil` if the response is not an HTTP response or the header is missing.
  */
-BOOL pk_response_validate(NSData *responseData, NSError * *error);
+NSString * _Nullable pk_header_value(NSURLResponse * _Nullable response, NSString * _Nonnull name);
@@ -24,18 +24,101 @@
 //
 
 #import "PIOError.h"
+#import <objc/runtime.h>
 
-BOOL pk_response_validate(NSData *responseData, NSError * *error) {
-    if (responseData == nil) return NO;
-    NSDictionary *responseDictionary = [NSJSONSerialization JSONObjectWithData:responseData options:NSJSONReadingMutableContainers error:error];
+NSString * const kPIOErrorDomain = @"io.put.kit.error";
+
+/** The key the parsed body is kept on its data with, so that callers sharing a response only parse it once. */
+static char kPIOResponseObjectKey;
+
+NSDictionary *pk_response_decode(NSData *responseData, NSURLResponse *response, NSError * *error) {
+    if (*error != nil || responseData == nil) return nil;
+    
+    NSError *parseError;
+    id responseObject;
+    
+    // Callers sharing a response may decode it at the same time, on their own queues, so only the first one parses it.
+    @synchronized (responseData) {
+        responseObject = objc_getAssociatedObject(responseData, &kPIOResponseObjectKey);
+        
+        if (responseObject == nil && responseData.length > 0) {
+            responseObject = [NSJSONSerialization JSONObjectWithData:responseData options:0 error:&parseError];
+            
+            // The parsed objects are immutable, so they can be handed to everyone the data was. Mutable data may still change, so its parse isn't kept.
+            if (responseObject != nil && ![responseData isKindOfClass:NSMutableData.class]) objc_setAssociatedObject(responseData, &kPIOResponseObjectKey, responseObject, OBJC_ASSOCIATION_RETAIN);
+        }
+    }
+    
+    NSDictionary *responseDictionary = [responseObject isKindOfClass:NSDictionary.class] ? responseObject : nil;
+    
+    if (!pk_response_validate(responseDictionary, response, error)) return nil;
     
+    if (parseError != nil) {
+        *error = parseError;
+        return nil;
+    }
+    
+    return responseDictionary;
+}
+
+BOOL pk_response_validate(NSDictionary *responseDictionary, NSURLResponse *response, NSError * *error) {
     NSString *errorMessage = [responseDictionary objectForKey:@"error_message"];
     NSString *errorTitle = [responseDictionary objectForKey:@"error_type"];
     NSUInteger errorCode = [[responseDictionary objectForKey:@"status_code"] unsignedIntegerValue];
     
-    if (errorMessage != nil && !isnan(errorCode) && errorTitle != nil) {
-        *error = [NSError errorWithDomain:@"io.put.kit.error" code:errorCode userInfo:@{NSLocalizedDescriptionKey: errorMessage, NSLocalizedFailureReasonErrorKey: errorTitle}];
+    if ([errorMessage isKindOfClass:NSString.class] && [errorTitle isKindOfClass:NSString.class]) {
+        *error = [NSError errorWithDomain:kPIOErrorDomain code:errorCode userInfo:@{NSLocalizedDescriptionKey: errorMessage, NSLocalizedFailureReasonErrorKey: errorTitle}];
+        return NO;
+    }
+    
+    NSInteger statusCode = [response isKindOfClass:NSHTTPURLResponse.class] ? ((NSHTTPURLResponse *)response).statusCode : 200;
+    
+    if (statusCode >= 400) {
+        *error = [NSError errorWithDomain:kPIOErrorDomain code:statusCode userInfo:@{NSLocalizedDescriptionKey: [NSHTTPURLResponse localizedStringForStatusCode:statusCode]}];
+        return NO;
+    }
+    
+    return YES;
+}
+
+BOOL pk_error_is_transient(NSError *error) {
+    if ([error.domain isEqualToString:kPIOErrorDomain]) return pk_status_code_is_transient(error.code);
+    
+    if (![error.domain isEqualToString:NSURLErrorDomain]) return NO;
+    
+    switch (error.code) {
+        case NSURLErrorTimedOut:
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorNetworkConnectionLost:
+        case NSURLErrorDNSLookupFailed:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+BOOL pk_status_code_is_transient(NSInteger statusCode) {
+    switch (statusCode) {
+        case 429:
+        case 500:
+        case 502:
+        case 503:
+        case 504:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+NSString *pk_header_value(NSURLResponse *response, NSString *name) {
+    if (![response isKindOfClass:NSHTTPURLResponse.class]) return nil;
+    
+    NSDictionary *headers = ((NSHTTPURLResponse *)response).allHeaderFields;
+    
+    for (NSString *key in headers) {
+        if ([key caseInsensitiveCompare:name] == NSOrderedSame) return headers[key];
     }
     
-    return *error == nil ? YES : NO;
+    return nil;
 }
@@ -0,0 +1,85 @@
+//
+//  PIOJSONStreamParser.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+
+@class PIOJSONStreamParser;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Receives the events of a `PIOJSONStreamParser` in document order.
+ */
+@protocol PIOJSONStreamParserDelegate <NSObject>
+
+- (void)parserDidStartObject:(PIOJSONStreamParser *)parser;
+- (void)parserDidEndObject:(PIOJSONStreamParser *)parser;
+- (void)parserDidStartArray:(PIOJSONStreamParser *)parser;
+- (void)parserDidEndArray:(PIOJSONStreamParser *)parser;
+
+/** Called with each key of an object. The key's value follows as the next value, object or array. */
+- (void)parser:(PIOJSONStreamParser *)parser didParseKey:(NSString *)key;
+
+/** Called with each string, number, boolean (as an `NSNumber`) and `null` (as `NSNull`). */
+- (void)parser:(PIOJSONStreamParser *)parser didParseValue:(id)value;
+
+@end
+
+/**
+ An event based JSON parser that is fed a document a piece at a time, e.g. as it arrives from the network.
+ 
+ Nothing but the token being read is held on to: every key and value is handed to the delegate as soon as it is complete, and the bytes it came from are dropped. Tokens may be split anywhere between pieces, including in the middle of a multi-byte character or an escape sequence.
+ */
+@interface PIOJSONStreamParser : NSObject
+
+/** The object events are sent to. */
+@property (weak, nonatomic, nullable) id<PIOJSONStreamParserDelegate> delegate;
+
+/** The number of objects and arrays that the parser is inside of. */
+@property (nonatomic, readonly) NSUInteger depth;
+
+/**
+ Parses the next piece of the document.
+ 
+ @param data    The bytes following the last piece that was parsed.
+ @param error   Set to an error in `NSCocoaErrorDomain` if the document is not valid JSON.
+ 
+ @return    `NO` if the document is not valid JSON, in which case the parser should not be used again.
+ */
+- (BOOL)parseData:(NSData *)data error:(NSError * _Nullable *)error;
+
+/**
+ Tells the parser that the document has ended.
+ 
+ @param error   Set to an error in `NSCocoaErrorDomain` if the document ended before it was complete.
+ 
+ @return    `NO` if the document was incomplete.
+ */
+- (BOOL)finishWithError:(NSError * _Nullable *)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
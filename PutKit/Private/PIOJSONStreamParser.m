@@ -0,0 +1,369 @@
+//
+//  PIOJSONStreamParser.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOJSONStreamParser.h"
+
+typedef NS_ENUM(uint8_t, PIOJSONExpectation) {
+    PIOJSONExpectValue,         // At the start of the document, after a colon, or after a comma in an array.
+    PIOJSONExpectValueOrEnd,    // After '['.
+    PIOJSONExpectKey,           // After a comma in an object.
+    PIOJSONExpectKeyOrEnd,      // After '{'.
+    PIOJSONExpectColon,
+    PIOJSONExpectCommaOrEnd,
+    PIOJSONExpectNothing        // After the root value.
+};
+
+typedef NS_ENUM(uint8_t, PIOJSONToken) {
+    PIOJSONTokenNone,
+    PIOJSONTokenKey,
+    PIOJSONTokenString,
+    PIOJSONTokenNumber,
+    PIOJSONTokenLiteral
+};
+
+static NSError *pk_json_error(NSUInteger offset, NSString *reason) {
+    return [NSError errorWithDomain:NSCocoaErrorDomain code:NSPropertyListReadCorruptError userInfo:@{NSLocalizedDescriptionKey: @"The data couldn’t be read because it isn’t in the correct format.", NSDebugDescriptionErrorKey: [NSString stringWithFormat:@"%@ (at byte %tu)", reason, offset]}];
+}
+
+static inline BOOL pk_json_token_byte(uint8_t byte, PIOJSONToken token) {
+    if (token == PIOJSONTokenLiteral) return byte >= 'a' && byte <= 'z';
+    return (byte >= '0' && byte <= '9') || byte == '-' || byte == '+' || byte == '.' || byte == 'e' || byte == 'E';
+}
+
+static inline int pk_json_hex(uint8_t byte) {
+    if (byte >= '0' && byte <= '9') return byte - '0';
+    if (byte >= 'a' && byte <= 'f') return byte - 'a' + 10;
+    if (byte >= 'A' && byte <= 'F') return byte - 'A' + 10;
+    return -1;
+}
+
+/**
+ Creates a string from the bytes between the quotes of a JSON string.
+ */
+static NSString *pk_json_string(const uint8_t *bytes, NSUInteger length, BOOL hasEscapes) {
+    if (!hasEscapes) return [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+    
+    NSMutableString *string = [NSMutableString stringWithCapacity:length];
+    NSUInteger i = 0;
+    
+    while (i < length) {
+        NSUInteger start = i;
+        
+        while (i < length && bytes[i] != '\\') i++;
+        
+        if (i > start) {
+            NSString *run = [[NSString alloc] initWithBytes:bytes + start length:i - start encoding:NSUTF8StringEncoding];
+            if (run == nil) return nil;
+            [string appendString:run];
+        }
+        
+        if (i++ == length) break;
+        if (i == length) return nil;
+        
+        unichar character;
+        
+        switch (bytes[i++]) {
+            case '"': character = '"'; break;
+            case '\\': character = '\\'; break;
+            case '/': character = '/'; break;
+            case 'b': character = '\b'; break;
+            case 'f': character = '\f'; break;
+            case 'n': character = '\n'; break;
+            case 'r': character = '\r'; break;
+            case 't': character = '\t'; break;
+            case 'u': {
+                if (length - i < 4) return nil;
+                
+                int a = pk_json_hex(bytes[i]), b = pk_json_hex(bytes[i + 1]), c = pk_json_hex(bytes[i + 2]), d = pk_json_hex(bytes[i + 3]);
+                if (a < 0 || b < 0 || c < 0 || d < 0) return nil;
+                
+                character = (unichar)(a << 12 | b << 8 | c << 4 | d); // Surrogate pairs come as two escapes, which make up the pair once both are appended.
+                i += 4;
+                break;
+            }
+            default: return nil;
+        }
+        
+        CFStringAppendCharacters((__bridge CFMutableStringRef)string, &character, 1);
+    }
+    
+    return string;
+}
+
+static NSNumber *pk_json_number(const uint8_t *bytes, NSUInteger length) {
+    char buffer[64];
+    
+    if (length == 0 || length >= sizeof(buffer) || !(bytes[0] == '-' || (bytes[0] >= '0' && bytes[0] <= '9'))) return nil;
+    
+    memcpy(buffer, bytes, length);
+    buffer[length] = '\0';
+    
+    char *end;
+    BOOL integral = memchr(buffer, '.', length) == NULL && memchr(buffer, 'e', length) == NULL && memchr(buffer, 'E', length) == NULL;
+    
+    if (integral) {
+        errno = 0;
+        long long value = strtoll(buffer, &end, 10);
+        if (errno == 0 && *end == '\0') return @(value);
+        
+        errno = 0;
+        unsigned long long unsignedValue = buffer[0] == '-' ? 0 : strtoull(buffer, &end, 10);
+        if (buffer[0] != '-' && errno == 0 && *end == '\0') return @(unsignedValue);
+    }
+    
+    double value = strtod(buffer, &end);
+    
+    return *end == '\0' ? @(value) : nil;
+}
+
+@implementation PIOJSONStreamParser {
+    NSMutableData *_containers; // An 'o' or an 'a' for every object and array that is open.
+    NSMutableData *_token; // The bytes of a token that is split between pieces.
+    PIOJSONExpectation _expectation;
+    PIOJSONToken _tokenType;
+    BOOL _escaped; // Whether the last byte of a split string is a backslash that escapes the next one.
+    BOOL _tokenHasEscapes;
+    NSUInteger _offset; // The offset of the current piece in the document, for errors.
+    BOOL _failed;
+}
+
+- (instancetype)init {
+    self = [super init];
+    
+    if (self) {
+        _containers = [NSMutableData data];
+        _token = [NSMutableData data];
+    }
+    
+    return self;
+}
+
+- (NSUInteger)depth {
+    return _containers.length;
+}
+
+- (BOOL)failAtByte:(NSUInteger)offset reason:(NSString *)reason error:(NSError **)error {
+    _failed = YES;
+    if (error != NULL) *error = pk_json_error(offset, reason);
+    return NO;
+}
+
+- (char)openContainer {
+    return _containers.length == 0 ? 0 : ((const char *)_containers.bytes)[_containers.length - 1];
+}
+
+- (void)valueDidEnd {
+    _expectation = _containers.length == 0 ? PIOJSONExpectNothing : PIOJSONExpectCommaOrEnd;
+}
+
+- (BOOL)finishScalarWithBytes:(const uint8_t *)bytes length:(NSUInteger)length offset:(NSUInteger)offset error:(NSError **)error {
+    if (_token.length > 0) {
+        [_token appendBytes:bytes length:length];
+        bytes = _token.bytes;
+        length = _token.length;
+    }
+    
+    id value;
+    
+    if (_tokenType == PIOJSONTokenNumber) {
+        value = pk_json_number(bytes, length);
+    } else if (length == 4 && memcmp(bytes, "true", 4) == 0) {
+        value = @YES;
+    } else if (length == 5 && memcmp(bytes, "false", 5) == 0) {
+        value = @NO;
+    } else if (length == 4 && memcmp(bytes, "null", 4) == 0) {
+        value = [NSNull null];
+    }
+    
+    _token.length = 0;
+    _tokenType = PIOJSONTokenNone;
+    
+    if (value == nil) return [self failAtByte:offset reason:@"Invalid number or literal." error:error];
+    
+    [self.delegate parser:self didParseValue:value];
+    [self valueDidEnd];
+    
+    return YES;
+}
+
+- (BOOL)parseData:(NSData *)data error:(NSError **)error {
+    if (_failed) return [self failAtByte:_offset reason:@"The document has already failed to parse." error:error];
+    
+    id<PIOJSONStreamParserDelegate> delegate = self.delegate;
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    NSUInteger i = 0;
+    
+    while (i < length) {
+        if (_tokenType == PIOJSONTokenKey || _tokenType == PIOJSONTokenString) {
+            NSUInteger start = i;
+            BOOL closed = NO;
+            
+            for (; i < length; i++) {
+                uint8_t byte = bytes[i];
+                
+                if (_escaped) {
+                    _escaped = NO;
+                } else if (byte == '\\') {
+                    _escaped = YES;
+                    _tokenHasEscapes = YES;
+                } else if (byte == '"') {
+                    closed = YES;
+                    break;
+                } else if (byte < 0x20) {
+                    return [self failAtByte:_offset + i reason:@"Unescaped control character in string." error:error];
+                }
+            }
+            
+            if (!closed) {
+                [_token appendBytes:bytes + start length:i - start];
+                break;
+            }
+            
+            NSString *string;
+            
+            if (_token.length == 0) {
+                string = pk_json_string(bytes + start, i - start, _tokenHasEscapes);
+            } else {
+                [_token appendBytes:bytes + start length:i - start];
+                string = pk_json_string(_token.bytes, _token.length, _tokenHasEscapes);
+                _token.length = 0;
+            }
+            
+            if (string == nil) return [self failAtByte:_offset + i reason:@"Invalid string." error:error];
+            
+            PIOJSONToken tokenType = _tokenType;
+            
+            _tokenType = PIOJSONTokenNone;
+            i++; // The closing quote.
+            
+            if (tokenType == PIOJSONTokenKey) {
+                [delegate parser:self didParseKey:string];
+                _expectation = PIOJSONExpectColon;
+            } else {
+                [delegate parser:self didParseValue:string];
+                [self valueDidEnd];
+            }
+            
+            continue;
+        }
+        
+        if (_tokenType != PIOJSONTokenNone) {
+            NSUInteger start = i;
+            
+            while (i < length && pk_json_token_byte(bytes[i], _tokenType)) i++;
+            
+            if (i == length) {
+                [_token appendBytes:bytes + start length:i - start]; // The token may carry on in the next piece.
+                break;
+            }
+            
+            if (![self finishScalarWithBytes:bytes + start length:i - start offset:_offset + i error:error]) return NO;
+            
+            continue;
+        }
+        
+        uint8_t byte = bytes[i];
+        BOOL expectsValue = _expectation == PIOJSONExpectValue || _expectation == PIOJSONExpectValueOrEnd;
+        char container = [self openContainer];
+        
+        switch (byte) {
+            case ' ': case '\t': case '\n': case '\r':
+                break;
+            case '{':
+            case '[': {
+                if (!expectsValue) return [self failAtByte:_offset + i reason:@"Unexpected start of a container." error:error];
+                
+                char opened = byte == '{' ? 'o' : 'a';
+                [_containers appendBytes:&opened length:1];
+                
+                _expectation = byte == '{' ? PIOJSONExpectKeyOrEnd : PIOJSONExpectValueOrEnd;
+                byte == '{' ? [delegate parserDidStartObject:self] : [delegate parserDidStartArray:self];
+                break;
+            }
+            case '}':
+            case ']': {
+                BOOL closesObject = byte == '}' && container == 'o' && (_expectation == PIOJSONExpectKeyOrEnd || _expectation == PIOJSONExpectCommaOrEnd);
+                BOOL closesArray = byte == ']' && container == 'a' && (_expectation == PIOJSONExpectValueOrEnd || _expectation == PIOJSONExpectCommaOrEnd);
+                
+                if (!closesObject && !closesArray) return [self failAtByte:_offset + i reason:@"Unexpected end of a container." error:error];
+                
+                _containers.length -= 1;
+                
+                closesObject ? [delegate parserDidEndObject:self] : [delegate parserDidEndArray:self];
+                [self valueDidEnd];
+                break;
+            }
+            case ':':
+                if (_expectation != PIOJSONExpectColon) return [self failAtByte:_offset + i reason:@"Unexpected colon." error:error];
+                _expectation = PIOJSONExpectValue;
+                break;
+            case ',':
+                if (_expectation != PIOJSONExpectCommaOrEnd) return [self failAtByte:_offset + i reason:@"Unexpected comma." error:error];
+                _expectation = container == 'o' ? PIOJSONExpectKey : PIOJSONExpectValue;
+                break;
+            case '"':
+                if (_expectation == PIOJSONExpectKey || _expectation == PIOJSONExpectKeyOrEnd) {
+                    _tokenType = PIOJSONTokenKey;
+                } else if (expectsValue) {
+                    _tokenType = PIOJSONTokenString;
+                } else {
+                    return [self failAtByte:_offset + i reason:@"Unexpected string." error:error];
+                }
+                
+                _tokenHasEscapes = NO;
+                _escaped = NO;
+                break;
+            default:
+                if (!expectsValue || !(pk_json_token_byte(byte, PIOJSONTokenNumber) || pk_json_token_byte(byte, PIOJSONTokenLiteral))) {
+                    return [self failAtByte:_offset + i reason:[NSString stringWithFormat:@"Unexpected character '%c'.", byte] error:error];
+                }
+                
+                _tokenType = pk_json_token_byte(byte, PIOJSONTokenLiteral) && byte != 'e' ? PIOJSONTokenLiteral : PIOJSONTokenNumber;
+                continue; // The first byte is read as part of the token.
+        }
+        
+        i++;
+    }
+    
+    _offset += length;
+    
+    return YES;
+}
+
+- (BOOL)finishWithError:(NSError **)error {
+    if (_failed) return [self failAtByte:_offset reason:@"The document has already failed to parse." error:error];
+    
+    if (_tokenType == PIOJSONTokenNumber || _tokenType == PIOJSONTokenLiteral) {
+        if (![self finishScalarWithBytes:NULL length:0 offset:_offset error:error]) return NO;
+    }
+    
+    if (_tokenType != PIOJSONTokenNone || _expectation != PIOJSONExpectNothing) return [self failAtByte:_offset reason:@"Unexpected end of data." error:error];
+    
+    return YES;
+}
+
+@end
@@ -0,0 +1,122 @@
+//
+//  PIOModelDecoder.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_OPTIONS(uint8_t, PIOModelFieldOptions) {
+    /** The model isn't decoded unless the key is present and its value converts to the type of the instance variable. */
+    PIOModelFieldRequired = 1 << 0
+};
+
+/** Converts a value from a response before it is stored in an object instance variable. Returning `nil` leaves the variable unset. */
+typedef id _Nullable (*PIOModelFieldTransform)(id value);
+
+/**
+ One row of a model's key table: which instance variable a response key is decoded into.
+ */
+typedef struct {
+    const char *key;
+    const char *ivarName;
+    PIOModelFieldOptions options;
+    PIOModelFieldTransform _Nullable transform;
+} PIOModelField;
+
+/**
+ Decodes response dictionaries straight into the instance variables of a model, so that `initFromDictionary:` doesn't have to look every key up by hand.
+ 
+ The offset and type of each instance variable in the table are looked up once, when the decoder is created, and each dictionary is then decoded in a single pass over its entries. Numbers are read out of the response without being boxed again, and each value is checked against the type of its variable: numbers (or numeric strings) for scalars, and an instance of the declared class for objects. `NSNull` and values of the wrong type leave the variable untouched.
+ */
+@interface PIOModelDecoder : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ Creates a decoder for a model class. Every instance variable named in the table must exist in the class; asserts otherwise.
+ 
+ @param modelClass  The class whose instance variables are decoded into.
+ @param fields      The key table. It is copied, so it doesn't have to outlive the decoder. No more than 64 fields are supported.
+ @param count       The number of fields in the table.
+ */
+- (instancetype)initWithClass:(Class)modelClass fields:(const PIOModelField *)fields count:(NSUInteger)count NS_DESIGNATED_INITIALIZER;
+
+/**
+ Decodes a response dictionary into a model.
+ 
+ @param dictionary  The response dictionary. Keys that aren't in the table are ignored.
+ @param object      The model, which must be an instance of the class the decoder was created with, or one of its subclasses.
+ 
+ @return    `NO` if a required field was missing or couldn't be converted, in which case the object should be discarded.
+ */
+- (BOOL)decodeDictionary:(NSDictionary *)dictionary intoObject:(id)object;
+
+/**
+ Decodes a single value into a model, for models that are decoded a key at a time (see `PIOModelStream`).
+ 
+ @param value   The value of the key in the response.
+ @param key     The key in the response.
+ @param object  The model, which must be an instance of the class the decoder was created with, or one of its subclasses.
+ 
+ @return    A mask with the bit of the field the value was stored in set, or @b 0 if the key isn't in the table or the value couldn't be converted.
+ */
+- (uint64_t)decodeValue:(id)value forKey:(NSString *)key intoObject:(id)object;
+
+/** Returns whether the specified key is in the table. */
+- (BOOL)decodesKey:(NSString *)key;
+
+/** The bits of the fields that have to be decoded for a model to be valid. */
+@property (nonatomic, readonly) uint64_t requiredFields;
+
+@end
+
+/** Transforms a timestamp string into an `NSDate`. See `pk_date_from_string`. */
+id _Nullable pk_model_date(id value);
+
+/** Transforms a string into an `NSURL`. */
+id _Nullable pk_model_url(id value);
+
+/**
+ Creates a model from a response dictionary. A model is only created once for the same immutable dictionary, so callers that are handed the same parsed response, e.g. callers sharing a request, are handed the same model.
+ 
+ @param modelClass  The class of the model, which must conform to `PIOObjectProtocol`.
+ @param dictionary  The response dictionary.
+ 
+ @return    The model, or `nil` if the value isn't a dictionary or doesn't decode into a valid model.
+ */
+id _Nullable pk_model_from_dictionary(Class modelClass, id _Nullable dictionary);
+
+/**
+ Creates models from an array of response dictionaries, leaving out any that don't decode into a valid model. Like `pk_model_from_dictionary`, the models are only created once for the same immutable array.
+ 
+ @param modelClass      The class of the models, which must conform to `PIOObjectProtocol`.
+ @param dictionaries    The array of response dictionaries.
+ 
+ @return    The models, which is empty if the value isn't an array.
+ */
+NSArray *pk_models_from_dictionaries(Class modelClass, id _Nullable dictionaries);
+
+NS_ASSUME_NONNULL_END
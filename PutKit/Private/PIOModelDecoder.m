@@ -0,0 +1,243 @@
+//
+//  PIOModelDecoder.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOModelDecoder.h"
+#import "PIODate.h"
+#import "PIOObjectProtocol.h"
+#import <objc/runtime.h>
+
+/**
+ A field of the key table, resolved against the class it decodes into.
+ */
+typedef struct {
+    ptrdiff_t offset;
+    char type; // The first character of the instance variable's type encoding.
+    uint64_t bit;
+    PIOModelFieldTransform _Nullable transform;
+    __unsafe_unretained Class _Nullable valueClass; // For objects, the declared class, if there is one.
+} pk_model_ivar;
+
+typedef struct {
+    CFDictionaryRef indexes;
+    const pk_model_ivar *ivars;
+    uint8_t *base;
+    uint64_t decoded; // A bit for every field that was stored.
+} pk_model_context;
+
+id pk_model_date(id value) {
+    return pk_date_from_string(value);
+}
+
+id pk_model_url(id value) {
+    return [value isKindOfClass:NSString.class] ? [NSURL URLWithString:value] : nil;
+}
+
+/**
+ Returns the result of decoding a parsed response object, decoding it only the first time it is asked for. The result is kept on the object, keyed by the model class, so that everyone handed the same parse (see `pk_response_decode`) is handed the same models too. Models are immutable, so they can be shared. Mutable objects may still change, so their results aren't kept.
+ */
+static id pk_model_shared_result(id object, Class modelClass, id (^decode)(void)) {
+    if ([object isKindOfClass:NSMutableDictionary.class] || [object isKindOfClass:NSMutableArray.class]) return decode();
+    
+    const void *key = (__bridge const void *)modelClass;
+    
+    @synchronized (object) {
+        id result = objc_getAssociatedObject(object, key);
+        
+        if (result == nil) {
+            result = decode();
+            
+            if (result != nil) objc_setAssociatedObject(object, key, result, OBJC_ASSOCIATION_RETAIN);
+        }
+        
+        return result;
+    }
+}
+
+static id pk_model_decode(Class modelClass, id dictionary) {
+    if (![dictionary isKindOfClass:NSDictionary.class] || ![modelClass conformsToProtocol:@protocol(PIOObjectProtocol)]) return nil;
+    
+    return [(id<PIOObjectProtocol>)[modelClass alloc] initFromDictionary:dictionary];
+}
+
+id pk_model_from_dictionary(Class modelClass, id dictionary) {
+    if (![dictionary isKindOfClass:NSDictionary.class]) return nil;
+    
+    return pk_model_shared_result(dictionary, modelClass, ^id {
+        return pk_model_decode(modelClass, dictionary);
+    });
+}
+
+NSArray *pk_models_from_dictionaries(Class modelClass, id dictionaries) {
+    if (![dictionaries isKindOfClass:NSArray.class]) return @[];
+    
+    return pk_model_shared_result(dictionaries, modelClass, ^id {
+        NSMutableArray *models = [NSMutableArray arrayWithCapacity:[dictionaries count]];
+        
+        for (id dictionary in dictionaries) {
+            id model = pk_model_decode(modelClass, dictionary);
+            
+            model == nil ?: [models addObject:model];
+        }
+        
+        return [models copy];
+    });
+}
+
+static BOOL pk_model_ivar_type_supported(char type) {
+    return strchr("@cBsSiIlLqQfd", type) != NULL;
+}
+
+static BOOL pk_model_store(const pk_model_ivar *ivar, uint8_t *base, id value) {
+    void *slot = base + ivar->offset;
+    
+    if (ivar->type == '@') {
+        id object = ivar->transform == NULL ? value : ivar->transform(value);
+        
+        if (object == nil || object == (id)kCFNull || (ivar->valueClass != Nil && ![object isKindOfClass:ivar->valueClass])) return NO;
+        
+        *(__strong id *)slot = object;
+        return YES;
+    }
+    
+    // Scalars are read straight out of the response's numbers, or out of strings, which respond to the same accessors.
+    if (![value isKindOfClass:NSNumber.class] && ![value isKindOfClass:NSString.class]) return NO;
+    
+    switch (ivar->type) {
+        case 'c': *(signed char *)slot = [value boolValue]; break;
+        case 'B': *(bool *)slot = [value boolValue]; break;
+        case 's': *(short *)slot = (short)[value longLongValue]; break;
+        case 'S': *(unsigned short *)slot = (unsigned short)[value unsignedLongLongValue]; break;
+        case 'i': *(int *)slot = (int)[value longLongValue]; break;
+        case 'I': *(unsigned int *)slot = (unsigned int)[value unsignedLongLongValue]; break;
+        case 'l': *(long *)slot = (long)[value longLongValue]; break;
+        case 'L': *(unsigned long *)slot = (unsigned long)[value unsignedLongLongValue]; break;
+        case 'q': *(long long *)slot = [value longLongValue]; break;
+        case 'Q': *(unsigned long long *)slot = [value unsignedLongLongValue]; break;
+        case 'f': *(float *)slot = [value floatValue]; break;
+        case 'd': *(double *)slot = [value doubleValue]; break;
+        default: return NO;
+    }
+    
+    return YES;
+}
+
+static void pk_model_decode_entry(const void *key, const void *value, void *context) {
+    pk_model_context *decoding = context;
+    const void *index;
+    
+    if (!CFDictionaryGetValueIfPresent(decoding->indexes, key, &index)) return;
+    
+    const pk_model_ivar *ivar = &decoding->ivars[(uintptr_t)index - 1]; // Indexes are stored one higher, so that none of them is NULL.
+    
+    if (pk_model_store(ivar, decoding->base, (__bridge id)value)) decoding->decoded |= ivar->bit;
+}
+
+@implementation PIOModelDecoder {
+    Class _modelClass;
+    pk_model_ivar *_ivars;
+    CFDictionaryRef _indexes; // Response key to index in `_ivars`, plus one.
+}
+
+- (instancetype)initWithClass:(Class)modelClass fields:(const PIOModelField *)fields count:(NSUInteger)count {
+    NSAssert(count <= 64, @"No more than 64 fields can be decoded into a model.");
+    
+    self = [super init];
+    
+    if (self) {
+        _modelClass = modelClass;
+        _ivars = calloc(MAX(count, 1), sizeof(pk_model_ivar));
+        
+        CFMutableDictionaryRef indexes = CFDictionaryCreateMutable(kCFAllocatorDefault, count, &kCFTypeDictionaryKeyCallBacks, NULL);
+        
+        for (NSUInteger i = 0; i < count; i++) {
+            Ivar ivar = class_getInstanceVariable(modelClass, fields[i].ivarName);
+            const char *encoding = ivar == NULL ? NULL : ivar_getTypeEncoding(ivar);
+            
+            NSAssert(encoding != NULL && pk_model_ivar_type_supported(encoding[0]), @"%@ has no instance variable named %s that can be decoded.", modelClass, fields[i].ivarName);
+            NSAssert(encoding == NULL || encoding[0] == '@' || fields[i].transform == NULL, @"Only object instance variables can be transformed.");
+            
+            if (encoding == NULL) continue;
+            
+            pk_model_ivar *resolved = &_ivars[i];
+            
+            resolved->offset = ivar_getOffset(ivar);
+            resolved->type = encoding[0];
+            resolved->bit = 1ULL << i;
+            resolved->transform = fields[i].transform;
+            
+            // Object encodings name their class, e.g. @"NSString".
+            size_t length = strlen(encoding);
+            
+            if (resolved->type == '@' && length > 3 && encoding[1] == '"') {
+                NSString *className = [[NSString alloc] initWithBytes:encoding + 2 length:length - 3 encoding:NSUTF8StringEncoding];
+                resolved->valueClass = NSClassFromString(className);
+            }
+            
+            if (fields[i].options & PIOModelFieldRequired) _requiredFields |= resolved->bit;
+            
+            CFDictionarySetValue(indexes, (__bridge CFStringRef)@(fields[i].key), (const void *)(uintptr_t)(i + 1));
+        }
+        
+        _indexes = indexes;
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    free(_ivars);
+    if (_indexes != NULL) CFRelease(_indexes);
+}
+
+- (BOOL)decodeDictionary:(NSDictionary *)dictionary intoObject:(id)object {
+    NSParameterAssert([object isKindOfClass:_modelClass]);
+    
+    if (![dictionary isKindOfClass:NSDictionary.class]) return NO;
+    
+    pk_model_context context = {_indexes, _ivars, (uint8_t *)(__bridge void *)object, 0};
+    
+    CFDictionaryApplyFunction((__bridge CFDictionaryRef)dictionary, pk_model_decode_entry, &context);
+    
+    return (context.decoded & _requiredFields) == _requiredFields;
+}
+
+- (uint64_t)decodeValue:(id)value forKey:(NSString *)key intoObject:(id)object {
+    NSParameterAssert([object isKindOfClass:_modelClass]);
+    
+    const void *index;
+    
+    if (!CFDictionaryGetValueIfPresent(_indexes, (__bridge CFStringRef)key, &index)) return 0;
+    
+    const pk_model_ivar *ivar = &_ivars[(uintptr_t)index - 1];
+    
+    return pk_model_store(ivar, (uint8_t *)(__bridge void *)object, value) ? ivar->bit : 0;
+}
+
+- (BOOL)decodesKey:(NSString *)key {
+    return CFDictionaryContainsKey(_indexes, (__bridge CFStringRef)key);
+}
+
+@end
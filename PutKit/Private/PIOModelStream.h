@@ -0,0 +1,57 @@
+//
+//  PIOModelStream.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A task delegate that decodes the models in one array of a response while the response is still downloading, without decoding the response into a tree of dictionaries first.
+ 
+ Each piece of the body is parsed as it arrives with a `PIOJSONStreamParser`, and every item of the array is decoded straight into a new model, a key at a time, through the model's `PIOModelDecoder`. Models without a decoder are decoded from a dictionary of just their own item. The models decoded from each piece are handed over together, so the first of them can be shown long before the last has arrived, and neither the body nor a tree decoded from it is ever held in memory in one go.
+ 
+ The rest of the response (e.g. the parent folder or the cursor of the next page) is decoded as usual and handed over once the request has completed, after being checked for errors in the same way as `pk_response_decode`.
+ */
+@interface PIOModelStream : NSObject <NSURLSessionDataDelegate>
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ Creates a stream. Pass it to `-[PIOSession dataTaskWithRequest:delegate:]`.
+ 
+ @param modelClass      The class of the models in the array. It must adopt `PIOObjectProtocol`.
+ @param arrayKey        The key of the array in the response, e.g. @b files or @b transfers.
+ @param modelsCallback  The block that is called on the main queue with the models decoded from each piece of the response, in order. It isn't called for error responses.
+ @param completion      The block that is called on the main queue once the request has completed, after the last of the models has been handed over, with every other key in the response. If the request failed, the underlying error will be returned.
+ */
+- (instancetype)initWithModelClass:(Class)modelClass
+                          arrayKey:(NSString *)arrayKey
+                    modelsCallback:(void (^)(NSArray *models))modelsCallback
+                        completion:(void (^)(NSError * _Nullable error, NSDictionary * _Nullable responseDictionary))completion NS_DESIGNATED_INITIALIZER;
+
+@end
+
+NS_ASSUME_NONNULL_END
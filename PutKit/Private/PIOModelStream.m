@@ -0,0 +1,258 @@
+//
+//  PIOModelStream.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOModelStream.h"
+#import "PIOJSONStreamParser.h"
+#import "PIOModelDecoder.h"
+#import "PIOObjectProtocol.h"
+#import "PIOError.h"
+#import "PIOCallbackQueue.h"
+
+@interface PIOModelStream () <PIOJSONStreamParserDelegate>
+
+@end
+
+@implementation PIOModelStream {
+    // Only touched on the session's delegate queue, apart from the callbacks.
+    Class _modelClass;
+    NSString *_arrayKey;
+    void (^_modelsCallback)(NSArray *);
+    void (^_completion)(NSError *, NSDictionary *);
+    
+    PIOJSONStreamParser *_parser;
+    PIOModelDecoder *_decoder; // nil if the models have to be decoded from dictionaries.
+    NSURLResponse *_response;
+    NSError *_parseError;
+    
+    NSMutableDictionary *_responseDictionary; // Every key of the response but the array.
+    NSMutableArray *_models; // The models decoded from the current piece.
+    NSUInteger _depth;
+    NSString *_responseKey; // The last key of the response object itself.
+    BOOL _streaming; // Whether the parser is inside the array.
+    
+    id _model; // The model being decoded a key at a time.
+    uint64_t _modelFields;
+    NSString *_modelKey;
+    
+    NSMutableArray *_containers; // The objects and arrays of a value being decoded as usual.
+    NSMutableArray *_containerKeys; // The last key of each object in `_containers`.
+    NSUInteger _skippedDepth; // How deep the parser is inside a value of a model that isn't decoded.
+}
+
+- (instancetype)initWithModelClass:(Class)modelClass
+                          arrayKey:(NSString *)arrayKey
+                    modelsCallback:(void (^)(NSArray * _Nonnull))modelsCallback
+                        completion:(void (^)(NSError * _Nullable, NSDictionary * _Nullable))completion {
+    NSParameterAssert([modelClass conformsToProtocol:@protocol(PIOObjectProtocol)]);
+    
+    self = [super init];
+    
+    if (self) {
+        _modelClass = modelClass;
+        _arrayKey = [arrayKey copy];
+        _modelsCallback = [modelsCallback copy];
+        _completion = [completion copy];
+        _decoder = [modelClass respondsToSelector:@selector(modelDecoder)] ? [(Class<PIOObjectProtocol>)modelClass modelDecoder] : nil;
+        _parser = [PIOJSONStreamParser new];
+        _parser.delegate = self;
+        _responseDictionary = [NSMutableDictionary dictionary];
+        _models = [NSMutableArray array];
+        _containers = [NSMutableArray array];
+        _containerKeys = [NSMutableArray array];
+    }
+    
+    return self;
+}
+
+- (BOOL)isErrorResponse {
+    return [_response isKindOfClass:NSHTTPURLResponse.class] && ((NSHTTPURLResponse *)_response).statusCode >= 400;
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
+    _response = response;
+    completionHandler(NSURLSessionResponseAllow);
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+    // Bodies that aren't JSON (e.g. an error page from a proxy) are left to the status code once the request completes.
+    if (_parseError != nil) return;
+    
+    NSError *error;
+    
+    if (![_parser parseData:data error:&error]) _parseError = error;
+    
+    [self handOverModels];
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    NSError *parseError = _parseError;
+    
+    if (error == nil && parseError == nil) [_parser finishWithError:&parseError];
+    
+    [self handOverModels];
+    
+    NSDictionary *responseDictionary = [_responseDictionary copy];
+    
+    if (error == nil && pk_response_validate(responseDictionary, _response, &error)) error = parseError;
+    
+    void (^completion)(NSError *, NSDictionary *) = _completion;
+    
+    pk_dispatch_callback(^{
+        completion(error, error == nil ? responseDictionary : nil);
+    });
+}
+
+- (void)handOverModels {
+    if (_models.count == 0) return;
+    
+    NSArray *models = [_models copy];
+    void (^modelsCallback)(NSArray *) = _modelsCallback;
+    
+    [_models removeAllObjects];
+    
+    if ([self isErrorResponse]) return;
+    
+    pk_dispatch_callback(^{
+        modelsCallback(models);
+    });
+}
+
+#pragma mark - PIOJSONStreamParserDelegate
+
+- (void)pushContainerOfClass:(Class)containerClass {
+    [_containers addObject:[containerClass new]];
+    [_containerKeys addObject:[NSNull null]];
+}
+
+- (void)startContainerOfClass:(Class)containerClass {
+    _depth++;
+    
+    if (_skippedDepth > 0) {
+        _skippedDepth++;
+        return;
+    }
+    
+    if (_containers.count > 0) {
+        [self pushContainerOfClass:containerClass];
+    } else if (_depth == 1) {
+        // The response object itself.
+    } else if (_depth == 2 && containerClass == NSMutableArray.class && [_responseKey isEqualToString:_arrayKey]) {
+        _streaming = YES;
+    } else if (_streaming && _depth == 3 && _decoder != nil && containerClass == NSMutableDictionary.class) {
+        _model = [_modelClass new];
+        _modelFields = 0;
+        _modelKey = nil;
+    } else if (_model != nil && ![_decoder decodesKey:_modelKey]) {
+        _skippedDepth = 1;
+    } else {
+        [self pushContainerOfClass:containerClass];
+    }
+}
+
+- (void)endContainer {
+    _depth--;
+    
+    if (_skippedDepth > 0) {
+        _skippedDepth--;
+    } else if (_containers.count > 0) {
+        id value = _containers.lastObject;
+        
+        [_containers removeLastObject];
+        [_containerKeys removeLastObject];
+        
+        [self didDecodeValue:value];
+    } else if (_model != nil && _depth == 2) {
+        uint64_t requiredFields = _decoder.requiredFields;
+        
+        if ((_modelFields & requiredFields) == requiredFields) [_models addObject:_model];
+        
+        _model = nil;
+    } else if (_streaming && _depth == 1) {
+        _streaming = NO;
+    }
+}
+
+- (void)didDecodeValue:(id)value {
+    if (_containers.count > 0) {
+        id container = _containers.lastObject;
+        id key = _containerKeys.lastObject;
+        
+        if ([container isKindOfClass:NSMutableArray.class]) {
+            [container addObject:value];
+        } else if (key != [NSNull null]) {
+            [container setObject:value forKey:key];
+        }
+    } else if (_model != nil) {
+        if (_modelKey != nil) _modelFields |= [_decoder decodeValue:value forKey:_modelKey intoObject:_model];
+    } else if (_streaming) {
+        // An item of a model without a decoder, decoded from a dictionary of just the item.
+        if (![value isKindOfClass:NSDictionary.class]) return;
+        
+        id model = [(id<PIOObjectProtocol>)[_modelClass alloc] initFromDictionary:value];
+        
+        model == nil ?: [_models addObject:model];
+    } else if (_depth == 1 && _responseKey != nil) {
+        [_responseDictionary setObject:value forKey:_responseKey];
+    }
+}
+
+- (void)parserDidStartObject:(PIOJSONStreamParser *)parser {
+    [self startContainerOfClass:NSMutableDictionary.class];
+}
+
+- (void)parserDidEndObject:(PIOJSONStreamParser *)parser {
+    [self endContainer];
+}
+
+- (void)parserDidStartArray:(PIOJSONStreamParser *)parser {
+    [self startContainerOfClass:NSMutableArray.class];
+}
+
+- (void)parserDidEndArray:(PIOJSONStreamParser *)parser {
+    [self endContainer];
+}
+
+- (void)parser:(PIOJSONStreamParser *)parser didParseKey:(NSString *)key {
+    if (_skippedDepth > 0) return;
+    
+    if (_containers.count > 0) {
+        [_containerKeys replaceObjectAtIndex:_containerKeys.count - 1 withObject:key];
+    } else if (_model != nil) {
+        _modelKey = key;
+    } else if (_depth == 1) {
+        _responseKey = key;
+    }
+}
+
+- (void)parser:(PIOJSONStreamParser *)parser didParseValue:(id)value {
+    if (_skippedDepth > 0) return;
+    
+    [self didDecodeValue:value];
+}
+
+@end
@@ -0,0 +1,96 @@
+//
+//  PIOMultipartBodyStream.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An input stream that produces a `multipart/form-data` body without ever holding the body in memory.
+ 
+ The boundary, part headers and trailing form fields are all computed when the parts are appended, so the total length of the body is known up front. Files are read from disk straight into the buffer of whoever is reading the stream, at most `kPIOMultipartBodyStreamChunkSize` bytes at a time, so memory use stays constant no matter how large the files are.
+ 
+ The stream supports `NSCopying`; a copy is a fresh, unopened stream over the same parts, which is what `URLSession:task:needNewBodyStream:` needs when a request has to be retransmitted.
+ */
+@interface PIOMultipartBodyStream : NSInputStream <NSCopying>
+
+/**
+ Creates an empty body with a randomly generated boundary.
+ */
+- (instancetype)init;
+
+/** The value that should be sent in the `Content-Type` header of the request, including the boundary. */
+@property (strong, nonatomic, readonly) NSString *contentType;
+
+/** The total length of the body (in bytes). */
+@property (nonatomic, readonly) unsigned long long contentLength;
+
+/**
+ Appends a plain text form field.
+ 
+ @param value   The value of the field.
+ @param name    The name of the field.
+ */
+- (void)appendFormFieldWithValue:(NSString *)value name:(NSString *)name;
+
+/**
+ Appends a file form field whose contents are streamed from disk.
+ 
+ @param fileURL     A url pointing to a valid file on the current device.
+ @param name        The name of the field.
+ @param fileName    The file name reported to the server.
+ @param mimeType    The MIME type of the file.
+ @param error       An error pointer, set if the size of the file could not be determined.
+ 
+ @return    `YES` if the file was appended, otherwise `NO`.
+ */
+- (BOOL)appendFileAtURL:(NSURL *)fileURL
+                   name:(NSString *)name
+               fileName:(NSString *)fileName
+               mimeType:(NSString *)mimeType
+                  error:(NSError * _Nullable *)error;
+
+/**
+ Sets the body of the request to this stream and sets the `Content-Type` and `Content-Length` headers.
+ 
+ @param request The request to be sent.
+ */
+- (void)attachToRequest:(NSMutableURLRequest *)request;
+
+/**
+ The CRC32 checksum of a file as it was read into the body, computed while it was being read.
+ 
+ @param fileURL The url the file was appended with.
+ 
+ @return    The checksum, or `nil` if neither this stream nor any copy of it has read the whole file yet.
+ */
+- (nullable NSNumber *)checksumOfFileAtURL:(NSURL *)fileURL;
+
+@end
+
+/** The maximum number of bytes read from a file in one go. */
+extern NSUInteger const kPIOMultipartBodyStreamChunkSize;
+
+NS_ASSUME_NONNULL_END
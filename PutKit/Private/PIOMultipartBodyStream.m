@@ -0,0 +1,273 @@
+//
+//  PIOMultipartBodyStream.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIOMultipartBodyStream.h"
+#import "PIOChecksum.h"
+
+NSUInteger const kPIOMultipartBodyStreamChunkSize = 64 * 1024;
+
+static NSString * const kPIOMultipartLineBreak = @"\r\n";
+
+@implementation PIOMultipartBodyStream {
+    NSString *_boundary;
+    NSMutableArray *_parts; // `NSData` objects which are copied verbatim, and file `NSURL`s which are streamed from disk.
+    NSMutableArray<NSNumber *> *_partLengths;
+    
+    NSArray *_readParts; // `_parts` followed by the closing boundary, fixed when the stream is opened.
+    NSArray<NSNumber *> *_readPartLengths;
+    NSUInteger _partIndex;
+    unsigned long long _partOffset;
+    NSInputStream *_fileStream;
+    uint32_t _fileChecksum; // The checksum of the bytes read so far from `_fileStream`.
+    NSMutableDictionary<NSURL *, NSNumber *> *_fileChecksums; // Shared with copies, since whichever of them ends up being sent is the one that counts.
+    
+    NSStreamStatus _streamStatus;
+    NSError *_streamError;
+    id<NSStreamDelegate> __weak _delegate;
+}
+
+- (instancetype)init {
+    return [self initWithBoundary:[NSString stringWithFormat:@"----%@", [NSUUID UUID].UUIDString]];
+}
+
+- (instancetype)initWithBoundary:(NSString *)boundary {
+    self = [super initWithData:[NSData data]];
+    
+    if (self) {
+        _boundary = boundary;
+        _parts = [NSMutableArray array];
+        _partLengths = [NSMutableArray array];
+        _fileChecksums = [NSMutableDictionary dictionary];
+        _streamStatus = NSStreamStatusNotOpen;
+    }
+    
+    return self;
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    PIOMultipartBodyStream *stream = [[self.class allocWithZone:zone] initWithBoundary:_boundary];
+    
+    [stream->_parts addObjectsFromArray:_parts];
+    [stream->_partLengths addObjectsFromArray:_partLengths];
+    stream->_fileChecksums = _fileChecksums;
+    
+    return stream;
+}
+
+#pragma mark - Building
+
+- (NSString *)contentType {
+    return [NSString stringWithFormat:@"multipart/form-data; boundary=%@", _boundary];
+}
+
+- (unsigned long long)contentLength {
+    unsigned long long length = 0;
+    
+    for (NSNumber *partLength in _partLengths) length += partLength.unsignedLongLongValue;
+    
+    return length + [self closingBoundaryData].length;
+}
+
+- (NSData *)closingBoundaryData {
+    return [[NSString stringWithFormat:@"--%@--%@", _boundary, kPIOMultipartLineBreak] dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (void)appendData:(NSData *)data {
+    [_parts addObject:data];
+    [_partLengths addObject:@(data.length)];
+}
+
+- (void)appendFormFieldWithValue:(NSString *)value name:(NSString *)name {
+    NSParameterAssert(_streamStatus == NSStreamStatusNotOpen);
+    
+    NSString *part = [NSString stringWithFormat:@"--%1$@%2$@Content-Disposition: form-data; name=\"%3$@\"%2$@%2$@%4$@%2$@", _boundary, kPIOMultipartLineBreak, name, value];
+    [self appendData:[part dataUsingEncoding:NSUTF8StringEncoding]];
+}
+
+- (BOOL)appendFileAtURL:(NSURL *)fileURL
+                   name:(NSString *)name
+               fileName:(NSString *)fileName
+               mimeType:(NSString *)mimeType
+                  error:(NSError * _Nullable *)error {
+    NSParameterAssert(_streamStatus == NSStreamStatusNotOpen);
+    
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:fileURL.path error:error];
+    if (attributes == nil) return NO;
+    
+    NSString *header = [NSString stringWithFormat:@"--%1$@%2$@Content-Disposition: form-data; name=\"%3$@\"; filename=\"%4$@\"%2$@Content-Type: %5$@%2$@%2$@", _boundary, kPIOMultipartLineBreak, name, fileName, mimeType];
+    
+    [self appendData:[header dataUsingEncoding:NSUTF8StringEncoding]];
+    [_parts addObject:fileURL];
+    [_partLengths addObject:@(attributes.fileSize)];
+    [self appendData:[kPIOMultipartLineBreak dataUsingEncoding:NSUTF8StringEncoding]];
+    
+    return YES;
+}
+
+- (void)attachToRequest:(NSMutableURLRequest *)request {
+    [request setValue:self.contentType forHTTPHeaderField:@"Content-Type"];
+    [request setValue:@(self.contentLength).stringValue forHTTPHeaderField:@"Content-Length"];
+    [request setHTTPBodyStream:self];
+}
+
+- (NSNumber *)checksumOfFileAtURL:(NSURL *)fileURL {
+    @synchronized (_fileChecksums) {
+        return [_fileChecksums objectForKey:fileURL];
+    }
+}
+
+#pragma mark - NSInputStream
+
+- (void)open {
+    if (_streamStatus != NSStreamStatusNotOpen) return;
+    
+    NSData *closingBoundary = [self closingBoundaryData];
+    
+    _readParts = [_parts arrayByAddingObject:closingBoundary];
+    _readPartLengths = [_partLengths arrayByAddingObject:@(closingBoundary.length)];
+    
+    _streamStatus = NSStreamStatusOpen;
+}
+
+- (void)close {
+    [_fileStream close];
+    _fileStream = nil;
+    _streamStatus = NSStreamStatusClosed;
+}
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)length {
+    if (_streamStatus != NSStreamStatusOpen) return _streamStatus == NSStreamStatusError ? -1 : 0;
+    
+    NSUInteger totalRead = 0;
+    
+    while (totalRead < length && _partIndex < _readParts.count) {
+        id part = _readParts[_partIndex];
+        
+        if ([part isKindOfClass:NSData.class]) {
+            NSData *data = part;
+            NSUInteger count = MIN(length - totalRead, data.length - (NSUInteger)_partOffset);
+            
+            [data getBytes:buffer + totalRead range:NSMakeRange((NSUInteger)_partOffset, count)];
+            totalRead += count;
+            _partOffset += count;
+        } else {
+            if (_fileStream == nil) {
+                _fileStream = [NSInputStream inputStreamWithURL:part];
+                _fileChecksum = 0;
+                [_fileStream open];
+            }
+            
+            // Never read past the length that was sent in the `Content-Length` header, even if the file has grown since.
+            unsigned long long remaining = _readPartLengths[_partIndex].unsignedLongLongValue - _partOffset;
+            NSUInteger maxLength = (NSUInteger)MIN((unsigned long long)MIN(length - totalRead, kPIOMultipartBodyStreamChunkSize), remaining);
+            NSInteger count = [_fileStream read:buffer + totalRead maxLength:maxLength];
+            
+            if (count < 0) {
+                _streamError = _fileStream.streamError;
+                _streamStatus = NSStreamStatusError;
+                return -1;
+            }
+            
+            _fileChecksum = pk_crc32(_fileChecksum, buffer + totalRead, count);
+            totalRead += count;
+            _partOffset += count;
+            
+            if (count == 0 && _partOffset < _readPartLengths[_partIndex].unsignedLongLongValue) {
+                _streamError = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:@{NSFilePathErrorKey: [part path]}]; // The file shrank after its length was sent to the server.
+                _streamStatus = NSStreamStatusError;
+                return -1;
+            }
+        }
+        
+        if (_partOffset >= _readPartLengths[_partIndex].unsignedLongLongValue) {
+            if ([part isKindOfClass:NSURL.class]) {
+                @synchronized (_fileChecksums) {
+                    [_fileChecksums setObject:@(_fileChecksum) forKey:part];
+                }
+            }
+            
+            [_fileStream close];
+            _fileStream = nil;
+            _partOffset = 0;
+            _partIndex++;
+        }
+    }
+    
+    if (totalRead == 0 && _partIndex >= _readParts.count) _streamStatus = NSStreamStatusAtEnd;
+    
+    return totalRead;
+}
+
+- (BOOL)getBuffer:(uint8_t * _Nullable *)buffer length:(NSUInteger *)length {
+    return NO;
+}
+
+- (BOOL)hasBytesAvailable {
+    return _streamStatus == NSStreamStatusOpen;
+}
+
+#pragma mark - NSStream
+
+- (NSStreamStatus)streamStatus {
+    return _streamStatus;
+}
+
+- (NSError *)streamError {
+    return _streamError;
+}
+
+- (id<NSStreamDelegate>)delegate {
+    return _delegate;
+}
+
+- (void)setDelegate:(id<NSStreamDelegate>)delegate {
+    _delegate = delegate;
+}
+
+- (id)propertyForKey:(NSStreamPropertyKey)key {
+    return nil;
+}
+
+- (BOOL)setProperty:(id)property forKey:(NSStreamPropertyKey)key {
+    return NO;
+}
+
+- (void)scheduleInRunLoop:(NSRunLoop *)runLoop forMode:(NSRunLoopMode)mode {}
+
+- (void)removeFromRunLoop:(NSRunLoop *)runLoop forMode:(NSRunLoopMode)mode {}
+
+#pragma mark - CFReadStream bridging
+
+// The URL loading system talks to body streams through CFReadStream, which calls these methods on `NSInputStream` subclasses. Without them, a subclass used as an `HTTPBodyStream` raises an exception.
+
+- (void)_scheduleInCFRunLoop:(CFRunLoopRef)runLoop forMode:(CFStringRef)mode {}
+
+- (void)_unscheduleFromCFRunLoop:(CFRunLoopRef)runLoop forMode:(CFStringRef)mode {}
+
+- (BOOL)_setCFClientFlags:(CFOptionFlags)flags callback:(CFReadStreamClientCallBack)callback context:(CFStreamClientContext *)context {
+    return NO;
+}
+
+@end
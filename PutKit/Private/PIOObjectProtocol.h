@@ -23,8 +23,15 @@
 //  THE SOFTWARE
 //
 
+@class PIOModelDecoder;
+
 @protocol PIOObjectProtocol <NSObject>
 
 @required - (nullable instancetype)initFromDictionary:(NSDictionary * _Nonnull)dictionary;
 
+/**
+ The decoder `initFromDictionary:` decodes through, for models that are decoded through a key table. Models that have one can also be decoded a key at a time, straight from a streamed response.
+ */
+@optional + (PIOModelDecoder * _Nonnull)modelDecoder;
+
 @end
@@ -0,0 +1,102 @@
+//
+//  PIOSession.h
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <Foundation/Foundation.h>
+
+@class PIOConfiguration;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The session layer used by every request PutKit makes. Requests to @b upload.put.io and requests to @b api.put.io are sent through separate `NSURLSession`s so that each host can be given its own connection limit.
+ 
+ Data tasks created with a completion handler are retried according to the `retryPolicy` of the configuration. Each retry is a new task, so such tasks are handed out as stand-ins that last from the first attempt to the last: the completion handler is only called once the last attempt has finished, `cancel` cancels whichever attempt is in flight or the wait for the next one, and `state` is running until then.
+ 
+ If the configuration has a `rateLimiter`, tasks to @b api.put.io are handed out as stand-ins that wait for the limiter when they are first resumed and forward everything else to the real task. Delegates are called with the stand-in they were registered with.
+ 
+ If the configuration `sharesIdenticalRequests`, GETs created with a completion handler are handed out as stand-ins too: one request is sent for every stand-in with the same URL and headers that is resumed while it is in flight, and its response is passed to each of their completion handlers. Its body is parsed once, and the models decoded from it are shared between the callers. Cancelling a stand-in only cancels the request once no one else is waiting on it.
+ */
+@interface PIOSession : NSObject <NSURLSessionDataDelegate>
+
+/**
+ Shared singleton instance of the `PIOSession` class.
+ */
++ (PIOSession *)sharedInstance;
+
+/**
+ Performs a block in which the data tasks created are never retried by the session, for callers that retry requests themselves and would otherwise multiply the retries sent for each failure.
+ 
+ @param block   The block in which the tasks are created. It is performed synchronously.
+ */
++ (void)performWithoutRetries:(NS_NOESCAPE void (^)(void))block;
+
+/**
+ The configuration the sessions are built from. Setting a new configuration lets any tasks in flight on the old sessions finish before they are invalidated; new tasks are created on sessions built from the new configuration.
+ */
+@property (copy, nonatomic) PIOConfiguration *configuration;
+
+/** The session used for requests to @b api.put.io. */
+@property (strong, nonatomic, readonly) NSURLSession *APISession;
+
+/** The session used for requests to @b upload.put.io. */
+@property (strong, nonatomic, readonly) NSURLSession *uploadSession;
+
+/**
+ Returns the session that requests to the specified URL should be sent through.
+ 
+ @param URL The URL of the request.
+ */
+- (NSURLSession *)sessionForURL:(NSURL *)URL;
+
+- (NSURLSessionDataTask *)dataTaskWithURL:(NSURL *)URL
+                        completionHandler:(void (^)(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error))completionHandler;
+
+- (NSURLSessionDataTask *)dataTaskWithRequest:(NSURLRequest *)request
+                            completionHandler:(void (^)(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error))completionHandler;
+
+/**
+ Creates a task without a completion handler whose session delegate calls are all sent to the specified delegate, as if `setDelegate:forTask:` had been called.
+ */
+- (NSURLSessionDataTask *)dataTaskWithRequest:(NSURLRequest *)request
+                                     delegate:(id<NSURLSessionDataDelegate>)delegate;
+
+- (NSURLSessionUploadTask *)uploadTaskWithRequest:(NSURLRequest *)request
+                                         fromData:(NSData *)bodyData
+                                completionHandler:(void (^)(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error))completionHandler;
+
+- (NSURLSessionDownloadTask *)downloadTaskWithURL:(NSURL *)URL
+                                completionHandler:(void (^)(NSURL * _Nullable location, NSURLResponse * _Nullable response, NSError * _Nullable error))completionHandler;
+
+/**
+ Registers an object to receive the task level session delegate calls (e.g. upload progress) of a single task. The delegate is retained until the task completes, and receives `URLSession:task:didCompleteWithError:` before it is released. Its calls are made with the callback queue that was current when it was registered, as are the completion handlers of the other tasks with the queue that was current when they were created.
+ 
+ @param delegate    The object that should receive the delegate calls.
+ @param task        A task created by this session layer.
+ */
+- (void)setDelegate:(id<NSURLSessionDataDelegate>)delegate forTask:(NSURLSessionTask *)task;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,1085 @@
+//
+//  PIOSession.m
+//  PutKit
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import "PIOSession.h"
+#import "PIOConfiguration.h"
+#import "PIOEndpoints.h"
+#import "PIOCallbackQueue.h"
+#import "PIORetryPolicy.h"
+#import "PIOError.h"
+#import "PIORateLimiter.h"
+#import <objc/runtime.h>
+
+static NSString * const kPIOSessionWithoutRetriesThreadKey = @"io.put.kit.session.without-retries";
+
+/**
+ A request that is retried according to a `PIORetryPolicy`, from its first attempt until its completion handler has been called.
+ */
+@interface PIOSessionRetry : NSObject
+
+/** The request as the first attempt sent it. */
+@property (strong, nonatomic) NSURLRequest *request;
+
+/** The caller the first attempt was attributed to by the rate limiter. */
+@property (copy, nonatomic, nullable) NSString *caller;
+
+@property (copy, nonatomic) PIORetryPolicy *policy;
+@property (copy, nonatomic) void (^completionHandler)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable);
+
+/** The number of retries that have been sent. */
+@property (nonatomic) NSUInteger attempt;
+
+/** The attempt that is in flight, or `nil` while waiting to send a retry. */
+@property (strong, nonatomic, nullable) NSURLSessionTask *task;
+
+/** The attempt that was sent last, which the stand-in forwards to. */
+@property (strong, nonatomic) NSURLSessionTask *latestTask;
+
+@property (nonatomic, getter=isCancelled) BOOL cancelled;
+
+/** Whether the completion handler has been, or is about to be, called. */
+@property (nonatomic, getter=isFinished) BOOL finished;
+
+@end
+
+@implementation PIOSessionRetry
+
+@end
+
+@interface PIOSession ()
+
+- (void)cancelRetry:(PIOSessionRetry *)retry;
+
+@end
+
+/**
+ Stands in for a request that may be retried, for as long as it takes. `cancel` cancels whichever attempt is in flight, or the wait for the next one, and `state` stays running until the last attempt has finished. Every other message is forwarded to the latest attempt.
+ */
+@interface PIORetryingTask : NSProxy
+
+- (instancetype)initWithSession:(PIOSession *)session retry:(PIOSessionRetry *)retry;
+
+@end
+
+@implementation PIORetryingTask {
+    __weak PIOSession *_session;
+    PIOSessionRetry *_retry;
+}
+
+- (instancetype)initWithSession:(PIOSession *)session retry:(PIOSessionRetry *)retry {
+    _session = session;
+    _retry = retry;
+    
+    return self;
+}
+
+- (NSURLSessionTask *)latestTask {
+    @synchronized (_retry) {
+        return _retry.latestTask;
+    }
+}
+
+- (void)resume {
+    NSURLSessionTask *task;
+    
+    @synchronized (_retry) {
+        task = _retry.task;
+    }
+    
+    // While waiting to send a retry there is nothing to resume; the retry is sent when the wait is over.
+    [task resume];
+}
+
+- (void)suspend {
+    NSURLSessionTask *task;
+    
+    @synchronized (_retry) {
+        task = _retry.task;
+    }
+    
+    [task suspend];
+}
+
+- (void)cancel {
+    [_session cancelRetry:_retry];
+}
+
+- (NSURLSessionTaskState)state {
+    NSURLSessionTask *task;
+    
+    @synchronized (_retry) {
+        if (_retry.isFinished) return NSURLSessionTaskStateCompleted;
+        
+        // As far as the caller is concerned, the request is still running while it waits to be sent again.
+        if (_retry.task == nil) return _retry.isCancelled ? NSURLSessionTaskStateCanceling : NSURLSessionTaskStateRunning;
+        
+        task = _retry.task;
+    }
+    
+    return task.state;
+}
+
+- (BOOL)isKindOfClass:(Class)aClass {
+    return [self.latestTask isKindOfClass:aClass];
+}
+
+- (BOOL)respondsToSelector:(SEL)aSelector {
+    return [self.latestTask respondsToSelector:aSelector];
+}
+
+- (id)forwardingTargetForSelector:(SEL)aSelector {
+    return self.latestTask;
+}
+
+- (NSMethodSignature *)methodSignatureForSelector:(SEL)aSelector {
+    return [self.latestTask methodSignatureForSelector:aSelector];
+}
+
+- (void)forwardInvocation:(NSInvocation *)invocation {
+    [invocation invokeWithTarget:self.latestTask];
+}
+
+- (NSString *)description {
+    return self.latestTask.description;
+}
+
+@end
+
+/**
+ Stands in for a task to @b api.put.io, holding back its first `resume` until the rate limiter lets it through. Every other message is forwarded to the task.
+ */
+@interface PIORateLimitedTask : NSProxy
+
+- (instancetype)initWithTask:(NSURLSessionTask *)task limiter:(PIORateLimiter *)limiter caller:(nullable NSString *)caller;
+
+@property (strong, nonatomic, readonly) NSURLSessionTask *task;
+
+@end
+
+@implementation PIORateLimitedTask {
+    // Guarded by `self`.
+    PIORateLimiter *_limiter;
+    NSString *_caller;
+    id<NSObject> _wait; // While waiting for tokens.
+    BOOL _admitted; // Once the limiter has let the task through, it is resumed and suspended like any other task.
+    BOOL _cancelled;
+}
+
+- (instancetype)initWithTask:(NSURLSessionTask *)task limiter:(PIORateLimiter *)limiter caller:(NSString *)caller {
+    _task = task;
+    _limiter = limiter;
+    _caller = [caller copy];
+    
+    return self;
+}
+
+- (void)resume {
+    @synchronized (self) {
+        if (_wait != nil) return;
+        
+        if (!_admitted && !_cancelled) {
+            id<NSObject> wait = [_limiter waitForRequest:_task.originalRequest caller:_caller handler:^{
+                [self admit];
+            }];
+            
+            // The handler is called straight away if there are tokens to spare.
+            if (!_admitted) _wait = wait;
+            
+            return;
+        }
+    }
+    
+    [_task resume];
+}
+
+- (void)admit {
+    @synchronized (self) {
+        _wait = nil;
+        _admitted = YES;
+    }
+    
+    [_task resume];
+}
+
+- (void)suspend {
+    id<NSObject> wait;
+    
+    @synchronized (self) {
+        wait = _wait;
+        _wait = nil;
+    }
+    
+    // A task that hasn't been let through gives up its place, and waits again when it is resumed.
+    wait == nil ? [_task suspend] : [_limiter cancelWait:wait];
+}
+
+- (void)cancel {
+    id<NSObject> wait;
+    
+    @synchronized (self) {
+        wait = _wait;
+        _wait = nil;
+        _cancelled = YES;
+    }
+    
+    wait == nil ?: [_limiter cancelWait:wait];
+    [_task cancel];
+}
+
+- (NSURLSessionTaskState)state {
+    @synchronized (self) {
+        // As far as the caller is concerned, the task was resumed.
+        if (_wait != nil) return NSURLSessionTaskStateRunning;
+    }
+    
+    return _task.state;
+}
+
+- (BOOL)isKindOfClass:(Class)aClass {
+    return [_task isKindOfClass:aClass];
+}
+
+- (BOOL)respondsToSelector:(SEL)aSelector {
+    return [_task respondsToSelector:aSelector];
+}
+
+- (id)forwardingTargetForSelector:(SEL)aSelector {
+    return _task;
+}
+
+- (NSMethodSignature *)methodSignatureForSelector:(SEL)aSelector {
+    return [_task methodSignatureForSelector:aSelector];
+}
+
+- (void)forwardInvocation:(NSInvocation *)invocation {
+    [invocation invokeWithTarget:_task];
+}
+
+- (NSString *)description {
+    return _task.description;
+}
+
+@end
+
+@class PIOSessionFlight;
+
+/**
+ Stands in for a GET that is shared with identical requests made at the same time. Each caller is given their own stand-in, so that cancelling one only gives up that caller's share of the request. Every other message is forwarded to the shared task.
+ */
+@interface PIOSharedTask : NSProxy
+
+- (instancetype)initWithSession:(PIOSession *)session
+                            key:(NSString *)key
+              completionHandler:(void (^)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable))completionHandler
+                      taskBlock:(NSURLSessionDataTask * (^)(void (^)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable)))taskBlock;
+
+@property (copy, nonatomic, readonly) NSString *key;
+@property (copy, nonatomic, readonly) void (^completionHandler)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable);
+
+/** Creates the task that sends the request, which is shared with everyone who makes it while it is in flight. */
+@property (copy, nonatomic, readonly) NSURLSessionDataTask * (^taskBlock)(void (^)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable));
+
+// Guarded by the session's `_flights`.
+
+/** The request the caller is waiting on, or `nil` if the caller is to send it again when resumed. */
+@property (strong, nonatomic, nullable) PIOSessionFlight *flight;
+
+/** The shared task, or the last one if the caller has none at the moment. */
+@property (strong, nonatomic) NSURLSessionDataTask *task;
+
+@property (nonatomic, getter=isResumed) BOOL resumed;
+
+/** Whether the completion handler has been, or is about to be, called. */
+@property (nonatomic, getter=isFinished) BOOL finished;
+
+@end
+
+/**
+ A GET that one or more `PIOSharedTask`s are waiting on.
+ */
+@interface PIOSessionFlight : NSObject
+
+@property (copy, nonatomic) NSString *key;
+@property (strong, nonatomic) NSURLSessionDataTask *task;
+@property (strong, nonatomic) NSMutableArray<PIOSharedTask *> *participants;
+
+@end
+
+@implementation PIOSessionFlight
+
+@end
+
+@interface PIOSession ()
+
+- (void)resumeSharedTask:(PIOSharedTask *)sharedTask;
+- (void)suspendSharedTask:(PIOSharedTask *)sharedTask;
+- (void)cancelSharedTask:(PIOSharedTask *)sharedTask;
+- (NSURLSessionTaskState)stateOfSharedTask:(PIOSharedTask *)sharedTask;
+
+@end
+
+@implementation PIOSharedTask {
+    __weak PIOSession *_session;
+}
+
+- (instancetype)initWithSession:(PIOSession *)session
+                            key:(NSString *)key
+              completionHandler:(void (^)(NSData *, NSURLResponse *, NSError *))completionHandler
+                      taskBlock:(NSURLSessionDataTask * (^)(void (^)(NSData *, NSURLResponse *, NSError *)))taskBlock {
+    _session = session;
+    _key = [key copy];
+    _completionHandler = [completionHandler copy];
+    _taskBlock = [taskBlock copy];
+    
+    return self;
+}
+
+- (void)resume {
+    [_session resumeSharedTask:self];
+}
+
+- (void)suspend {
+    [_session suspendSharedTask:self];
+}
+
+- (void)cancel {
+    [_session cancelSharedTask:self];
+}
+
+- (NSURLSessionTaskState)state {
+    return [_session stateOfSharedTask:self];
+}
+
+- (BOOL)isKindOfClass:(Class)aClass {
+    return [self.task isKindOfClass:aClass];
+}
+
+- (BOOL)respondsToSelector:(SEL)aSelector {
+    return [self.task respondsToSelector:aSelector];
+}
+
+- (id)forwardingTargetForSelector:(SEL)aSelector {
+    return self.task;
+}
+
+- (NSMethodSignature *)methodSignatureForSelector:(SEL)aSelector {
+    return [self.task methodSignatureForSelector:aSelector];
+}
+
+- (void)forwardInvocation:(NSInvocation *)invocation {
+    [invocation invokeWithTarget:self.task];
+}
+
+- (NSString *)description {
+    return self.task.description;
+}
+
+@end
+
+/**
+ Returns the task the session created for a task handed out by this session layer.
+ */
+static NSURLSessionTask *pk_session_task(NSURLSessionTask *task) {
+    return object_getClass(task) == PIORateLimitedTask.class ? ((PIORateLimitedTask *)task).task : task;
+}
+
+/**
+ Returns whether a request that failed with the specified response or error could succeed if it was sent again as it is.
+ */
+static BOOL pk_response_is_retryable(NSURLResponse *response, NSError *error) {
+    if (error != nil) return pk_error_is_transient(error);
+    
+    return [response isKindOfClass:NSHTTPURLResponse.class] && pk_status_code_is_transient(((NSHTTPURLResponse *)response).statusCode);
+}
+
+/**
+ Returns how long (in seconds) the `Retry-After` header of a response asks for, whether it is given in seconds or as an HTTP date, or @b 0 if it has none.
+ */
+static NSTimeInterval pk_retry_after(NSURLResponse *response) {
+    NSString *value = [pk_header_value(response, @"Retry-After") stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    
+    if (value.length == 0) return 0;
+    
+    NSScanner *scanner = [NSScanner scannerWithString:value];
+    double seconds;
+    
+    if ([scanner scanDouble:&seconds] && scanner.isAtEnd) return MAX(seconds, 0);
+    
+    static NSDateFormatter *formatter;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        formatter = [NSDateFormatter new];
+        formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+        formatter.dateFormat = @"EEE, dd MMM yyyy HH:mm:ss zzz";
+    });
+    
+    NSDate *date;
+    
+    @synchronized (formatter) {
+        date = [formatter dateFromString:value];
+    }
+    
+    return MAX(date.timeIntervalSinceNow, 0);
+}
+
+@implementation PIOSession {
+    NSURLSession *_APISession;
+    NSURLSession *_uploadSession;
+    NSOperationQueue *_delegateQueue;
+    NSMapTable<NSURLSessionTask *, id<NSURLSessionDataDelegate>> *_taskDelegates;
+    NSMapTable<NSURLSessionTask *, id> *_taskCallbackQueues; // The callback queue each delegate was registered with, or `NSNull` for none.
+    NSMapTable<NSURLSessionTask *, NSURLSessionTask *> *_publicTasks; // The task each delegate was registered with, which is what it is called with.
+    double _retryBudget; // Guarded by `self`.
+    NSMutableDictionary<NSString *, PIOSessionFlight *> *_flights; // The shared requests that are in flight, by key.
+}
+
+@synthesize configuration = _configuration;
+
++ (PIOSession *)sharedInstance {
+    static PIOSession *sharedInstance;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [PIOSession new];
+    });
+    return sharedInstance;
+}
+
++ (void)performWithoutRetries:(void (^)(void))block {
+    NSMutableDictionary *threadDictionary = [NSThread currentThread].threadDictionary;
+    id previousValue = threadDictionary[kPIOSessionWithoutRetriesThreadKey];
+    
+    threadDictionary[kPIOSessionWithoutRetriesThreadKey] = @YES;
+    
+    @try {
+        block();
+    } @finally {
+        threadDictionary[kPIOSessionWithoutRetriesThreadKey] = previousValue;
+    }
+}
+
+- (instancetype)init {
+    self = [super init];
+    
+    if (self) {
+        _configuration = [PIOConfiguration defaultConfiguration];
+        _taskDelegates = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+        _taskCallbackQueues = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+        _publicTasks = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+        _retryBudget = _configuration.retryPolicy.retryBudgetCapacity;
+        _flights = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+- (PIOConfiguration *)configuration {
+    @synchronized (self) {
+        return _configuration;
+    }
+}
+
+- (void)setConfiguration:(PIOConfiguration *)configuration {
+    @synchronized (self) {
+        _configuration = [configuration copy];
+        _retryBudget = _configuration.retryPolicy.retryBudgetCapacity;
+        
+        [_APISession finishTasksAndInvalidate];
+        [_uploadSession finishTasksAndInvalidate];
+        
+        _APISession = nil;
+        _uploadSession = nil;
+    }
+}
+
+- (NSOperationQueue *)delegateQueue {
+    if (_configuration.delegateQueue != nil) return _configuration.delegateQueue;
+    
+    if (_delegateQueue == nil) {
+        _delegateQueue = [NSOperationQueue new];
+        _delegateQueue.name = @"io.put.kit.session";
+        _delegateQueue.maxConcurrentOperationCount = 1;
+    }
+    
+    return _delegateQueue;
+}
+
+- (NSURLSession *)sessionWithMaximumConnectionsPerHost:(NSInteger)maximumConnectionsPerHost {
+    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+    
+    configuration.HTTPMaximumConnectionsPerHost = maximumConnectionsPerHost;
+    configuration.timeoutIntervalForRequest = _configuration.timeoutIntervalForRequest;
+    configuration.timeoutIntervalForResource = _configuration.timeoutIntervalForResource;
+    configuration.requestCachePolicy = _configuration.requestCachePolicy;
+    configuration.URLCache = _configuration.URLCache;
+    configuration.HTTPShouldUsePipelining = _configuration.HTTPShouldUsePipelining;
+    
+    if (_configuration.protocolClasses != nil) {
+        configuration.protocolClasses = [_configuration.protocolClasses arrayByAddingObjectsFromArray:configuration.protocolClasses];
+    }
+    
+    return [NSURLSession sessionWithConfiguration:configuration delegate:self delegateQueue:[self delegateQueue]];
+}
+
+- (NSURLSession *)APISession {
+    @synchronized (self) {
+        if (_APISession == nil) _APISession = [self sessionWithMaximumConnectionsPerHost:_configuration.maximumConnectionsPerAPIHost];
+        return _APISession;
+    }
+}
+
+- (NSURLSession *)uploadSession {
+    @synchronized (self) {
+        if (_uploadSession == nil) _uploadSession = [self sessionWithMaximumConnectionsPerHost:_configuration.maximumConnectionsPerUploadHost];
+        return _uploadSession;
+    }
+}
+
+static BOOL pk_is_upload_URL(NSURL *URL) {
+    static NSString *uploadHost;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        uploadHost = [NSURL URLWithString:kPIOEndpointUploadFiles].host;
+    });
+    
+    return [URL.host isEqualToString:uploadHost];
+}
+
+- (NSURLSession *)sessionForURL:(NSURL *)URL {
+    return pk_is_upload_URL(URL) ? self.uploadSession : self.APISession;
+}
+
+/**
+ Returns a stand-in for a task to @b api.put.io that waits for the configuration's rate limiter when it is resumed, attributed to the current caller. Tasks to @b upload.put.io, and every task if there is no limiter, are returned as they are.
+ */
+- (id)rateLimitedTask:(NSURLSessionTask *)task {
+    PIORateLimiter *limiter = self.configuration.rateLimiter;
+    
+    if (limiter == nil || pk_is_upload_URL(task.originalRequest.URL)) return task;
+    
+    return [[PIORateLimitedTask alloc] initWithTask:task limiter:limiter caller:[PIORateLimiter currentCaller]];
+}
+
+/**
+ Wraps a completion handler so that it is called with the callback queue that was current when the task was created, wherever the session calls it from.
+ */
+static void (^pk_completion_handler(void (^completionHandler)(id, NSURLResponse *, NSError *)))(id, NSURLResponse *, NSError *) {
+    if (completionHandler == nil) return nil;
+    
+    NSOperationQueue *queue = pk_callback_queue();
+    
+    return ^(id result, NSURLResponse *response, NSError *error) {
+        pk_perform_with_callback_queue(queue, ^{
+            completionHandler(result, response, error);
+        });
+    };
+}
+
+/**
+ Returns whether a request can wait for the response to an identical request that is already in flight.
+ */
+static BOOL pk_request_is_shareable(NSURLRequest *request) {
+    return [request.HTTPMethod isEqualToString:@"GET"] && request.HTTPBody == nil && request.HTTPBodyStream == nil;
+}
+
+/**
+ Returns a key that is the same for requests that would get the same response: the URL, which holds the access token, along with the cache policy and every header, such as `Range` and `If-None-Match`.
+ */
+static NSString *pk_shared_request_key(NSURLRequest *request) {
+    NSDictionary<NSString *, NSString *> *headers = request.allHTTPHeaderFields;
+    NSMutableString *key = [NSMutableString stringWithFormat:@"%@ %@ %tu", request.HTTPMethod, request.URL.absoluteString, request.cachePolicy];
+    
+    for (NSString *field in [headers.allKeys sortedArrayUsingSelector:@selector(caseInsensitiveCompare:)]) {
+        [key appendFormat:@"\n%@: %@", field.lowercaseString, headers[field]];
+    }
+    
+    return key;
+}
+
+- (NSURLSessionDataTask *)dataTaskWithURL:(NSURL *)URL
+                        completionHandler:(void (^)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable))completionHandler {
+    if (completionHandler == nil || !self.configuration.sharesIdenticalRequests) return [self unsharedDataTaskWithURL:URL completionHandler:completionHandler];
+    
+    return [self sharedDataTaskWithRequest:[NSURLRequest requestWithURL:URL] completionHandler:completionHandler taskBlock:^NSURLSessionDataTask *(void (^handler)(NSData *, NSURLResponse *, NSError *)) {
+        return [self unsharedDataTaskWithURL:URL completionHandler:handler];
+    }];
+}
+
+- (NSURLSessionDataTask *)dataTaskWithRequest:(NSURLRequest *)request
+                            completionHandler:(void (^)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable))completionHandler {
+    if (completionHandler == nil || !self.configuration.sharesIdenticalRequests || !pk_request_is_shareable(request)) return [self unsharedDataTaskWithRequest:request completionHandler:completionHandler];
+    
+    return [self sharedDataTaskWithRequest:request completionHandler:completionHandler taskBlock:^NSURLSessionDataTask *(void (^handler)(NSData *, NSURLResponse *, NSError *)) {
+        return [self unsharedDataTaskWithRequest:request completionHandler:handler];
+    }];
+}
+
+- (NSURLSessionDataTask *)unsharedDataTaskWithURL:(NSURL *)URL
+                                completionHandler:(void (^)(NSData *, NSURLResponse *, NSError *))completionHandler {
+    NSURLSession *session = [self sessionForURL:URL];
+    PIOSessionRetry *retry = [self retryWithMethod:@"GET" bodyStream:nil completionHandler:completionHandler];
+    
+    if (retry == nil) return [self rateLimitedTask:[session dataTaskWithURL:URL completionHandler:pk_completion_handler(completionHandler)]];
+    
+    return [self registerRetry:retry forTask:[self rateLimitedTask:[session dataTaskWithURL:URL completionHandler:[self completionHandlerForRetry:retry]]]];
+}
+
+- (NSURLSessionDataTask *)unsharedDataTaskWithRequest:(NSURLRequest *)request
+                                    completionHandler:(void (^)(NSData *, NSURLResponse *, NSError *))completionHandler {
+    NSURLSession *session = [self sessionForURL:request.URL];
+    PIOSessionRetry *retry = [self retryWithMethod:request.HTTPMethod bodyStream:request.HTTPBodyStream completionHandler:completionHandler];
+    
+    if (retry == nil) return [self rateLimitedTask:[session dataTaskWithRequest:request completionHandler:pk_completion_handler(completionHandler)]];
+    
+    return [self registerRetry:retry forTask:[self rateLimitedTask:[session dataTaskWithRequest:request completionHandler:[self completionHandlerForRetry:retry]]]];
+}
+
+- (NSURLSessionDataTask *)dataTaskWithRequest:(NSURLRequest *)request
+                                     delegate:(id<NSURLSessionDataDelegate>)delegate {
+    NSURLSessionDataTask *task = [self rateLimitedTask:[[self sessionForURL:request.URL] dataTaskWithRequest:request]];
+    [self setDelegate:delegate forTask:task];
+    return task;
+}
+
+- (NSURLSessionUploadTask *)uploadTaskWithRequest:(NSURLRequest *)request
+                                         fromData:(NSData *)bodyData
+                                completionHandler:(void (^)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable))completionHandler {
+    return [self rateLimitedTask:[[self sessionForURL:request.URL] uploadTaskWithRequest:request fromData:bodyData completionHandler:pk_completion_handler(completionHandler)]];
+}
+
+- (NSURLSessionDownloadTask *)downloadTaskWithURL:(NSURL *)URL
+                                completionHandler:(void (^)(NSURL * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable))completionHandler {
+    return [self rateLimitedTask:[[self sessionForURL:URL] downloadTaskWithURL:URL completionHandler:pk_completion_handler(completionHandler)]];
+}
+
+- (void)setDelegate:(id<NSURLSessionDataDelegate>)delegate forTask:(NSURLSessionTask *)task {
+    NSURLSessionTask *sessionTask = pk_session_task(task);
+    
+    @synchronized (_taskDelegates) {
+        [_taskDelegates setObject:delegate forKey:sessionTask];
+        [_taskCallbackQueues setObject:pk_callback_queue() ?: [NSNull null] forKey:sessionTask];
+        [_publicTasks setObject:task forKey:sessionTask];
+    }
+}
+
+- (id<NSURLSessionDataDelegate>)delegateForTask:(NSURLSessionTask *)task {
+    @synchronized (_taskDelegates) {
+        return [_taskDelegates objectForKey:task];
+    }
+}
+
+/**
+ Returns the task a delegate was registered with, which may be a stand-in for the task the session calls back with.
+ */
+- (id)publicTaskForTask:(NSURLSessionTask *)task {
+    @synchronized (_taskDelegates) {
+        return [_publicTasks objectForKey:task] ?: task;
+    }
+}
+
+/**
+ Performs a forwarded delegate call with the callback queue that was current when the task's delegate was registered.
+ */
+- (void)forTask:(NSURLSessionTask *)task performBlock:(NS_NOESCAPE dispatch_block_t)block {
+    id queue;
+    
+    @synchronized (_taskDelegates) {
+        queue = [_taskCallbackQueues objectForKey:task];
+    }
+    
+    pk_perform_with_callback_queue(queue == [NSNull null] ? nil : queue, block);
+}
+
+#pragma mark - Shared Requests
+
+/**
+ Returns a stand-in for a GET that joins an identical request if one is in flight, and makes one with the task block otherwise.
+ */
+- (NSURLSessionDataTask *)sharedDataTaskWithRequest:(NSURLRequest *)request
+                                  completionHandler:(void (^)(NSData *, NSURLResponse *, NSError *))completionHandler
+                                          taskBlock:(NSURLSessionDataTask * (^)(void (^)(NSData *, NSURLResponse *, NSError *)))taskBlock {
+    PIOSharedTask *sharedTask = [[PIOSharedTask alloc] initWithSession:self key:pk_shared_request_key(request) completionHandler:pk_completion_handler(completionHandler) taskBlock:taskBlock];
+    
+    @synchronized (_flights) {
+        [self joinFlightWithSharedTask:sharedTask];
+    }
+    
+    return (NSURLSessionDataTask *)sharedTask;
+}
+
+/**
+ Adds a stand-in to the request in flight with its key, making the request if there is none. Must be called while synchronized on `_flights`.
+ */
+- (void)joinFlightWithSharedTask:(PIOSharedTask *)sharedTask {
+    PIOSessionFlight *flight = [_flights objectForKey:sharedTask.key];
+    
+    if (flight == nil) {
+        flight = [PIOSessionFlight new];
+        flight.key = sharedTask.key;
+        flight.participants = [NSMutableArray array];
+        flight.task = sharedTask.taskBlock(^(NSData *data, NSURLResponse *response, NSError *error) {
+            [self finishFlight:flight data:data response:response error:error];
+        });
+        
+        [_flights setObject:flight forKey:flight.key];
+    }
+    
+    [flight.participants addObject:sharedTask];
+    sharedTask.flight = flight;
+    sharedTask.task = flight.task;
+}
+
+/**
+ Hands the response out to everyone who resumed their stand-in. Everyone else sends the request again when they are resumed, as the response may be out of date by then.
+ */
+- (void)finishFlight:(PIOSessionFlight *)flight data:(NSData *)data response:(NSURLResponse *)response error:(NSError *)error {
+    NSMutableArray<PIOSharedTask *> *recipients = [NSMutableArray array];
+    
+    @synchronized (_flights) {
+        if ([_flights objectForKey:flight.key] == flight) [_flights removeObjectForKey:flight.key];
+        
+        for (PIOSharedTask *sharedTask in flight.participants) {
+            sharedTask.flight = nil;
+            
+            if (!sharedTask.isResumed) continue;
+            
+            sharedTask.finished = YES;
+            [recipients addObject:sharedTask];
+        }
+        
+        [flight.participants removeAllObjects];
+    }
+    
+    // Everyone is given the same data, so the body is only parsed once, and the models decoded from the parse are shared too (see `pk_model_from_dictionary`).
+    for (PIOSharedTask *sharedTask in recipients) sharedTask.completionHandler(data, response, error);
+}
+
+- (void)resumeSharedTask:(PIOSharedTask *)sharedTask {
+    NSURLSessionDataTask *task;
+    
+    @synchronized (_flights) {
+        if (sharedTask.isFinished || sharedTask.isResumed) return;
+        
+        if (sharedTask.flight == nil) [self joinFlightWithSharedTask:sharedTask];
+        
+        sharedTask.resumed = YES;
+        task = sharedTask.task;
+    }
+    
+    // Resuming a task that another caller has already resumed does nothing.
+    [task resume];
+}
+
+- (void)suspendSharedTask:(PIOSharedTask *)sharedTask {
+    NSURLSessionDataTask *task;
+    
+    @synchronized (_flights) {
+        if (sharedTask.isFinished || !sharedTask.isResumed) return;
+        
+        sharedTask.resumed = NO;
+        
+        // The request is only held back once no one else is waiting on it.
+        if ([self flightHasResumedParticipants:sharedTask.flight]) return;
+        
+        task = sharedTask.task;
+    }
+    
+    [task suspend];
+}
+
+- (void)cancelSharedTask:(PIOSharedTask *)sharedTask {
+    NSURLSessionDataTask *task;
+    
+    @synchronized (_flights) {
+        if (sharedTask.isFinished) return;
+        
+        PIOSessionFlight *flight = sharedTask.flight;
+        
+        sharedTask.finished = YES;
+        sharedTask.flight = nil;
+        [flight.participants removeObjectIdenticalTo:sharedTask];
+        
+        // Once no one is waiting on the request, it is cancelled, and anyone who hasn't resumed yet sends it again when they do.
+        if (flight != nil && ![self flightHasResumedParticipants:flight]) {
+            if ([_flights objectForKey:flight.key] == flight) [_flights removeObjectForKey:flight.key];
+            
+            for (PIOSharedTask *participant in flight.participants) participant.flight = nil;
+            [flight.participants removeAllObjects];
+            
+            task = flight.task;
+        }
+    }
+    
+    [task cancel];
+    
+    // Called from the delegate queue, as it would be by the session.
+    [self.APISession.delegateQueue addOperationWithBlock:^{
+        sharedTask.completionHandler(nil, nil, [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]);
+    }];
+}
+
+- (NSURLSessionTaskState)stateOfSharedTask:(PIOSharedTask *)sharedTask {
+    NSURLSessionDataTask *task;
+    
+    @synchronized (_flights) {
+        if (sharedTask.isFinished) return NSURLSessionTaskStateCompleted;
+        if (!sharedTask.isResumed) return NSURLSessionTaskStateSuspended;
+        
+        task = sharedTask.task;
+    }
+    
+    return task.state;
+}
+
+- (BOOL)flightHasResumedParticipants:(PIOSessionFlight *)flight {
+    for (PIOSharedTask *participant in flight.participants) {
+        if (participant.isResumed) return YES;
+    }
+    
+    return NO;
+}
+
+#pragma mark - Retries
+
+/**
+ Returns the state of the retries of a request with the specified method and body, or `nil` if the request isn't to be retried.
+ */
+- (PIOSessionRetry *)retryWithMethod:(NSString *)method
+                          bodyStream:(NSInputStream *)bodyStream
+                   completionHandler:(void (^)(NSData * _Nullable, NSURLResponse * _Nullable, NSError * _Nullable))completionHandler {
+    PIORetryPolicy *policy = self.configuration.retryPolicy;
+    
+    if ([[NSThread currentThread].threadDictionary[kPIOSessionWithoutRetriesThreadKey] boolValue]) return nil;
+    
+    // A streamed body has been read by the time the request fails, so it can't be sent again.
+    if (completionHandler == nil || policy == nil || policy.maximumRetryCount == 0 || bodyStream != nil || ![policy.retryableMethods containsObject:method ?: @"GET"]) return nil;
+    
+    PIOSessionRetry *retry = [PIOSessionRetry new];
+    
+    retry.policy = policy;
+    retry.completionHandler = pk_completion_handler(completionHandler);
+    retry.caller = [PIORateLimiter currentCaller];
+    
+    return retry;
+}
+
+/**
+ Returns a stand-in for the first attempt of a request that may be retried, which is the task the caller is given.
+ */
+- (NSURLSessionDataTask *)registerRetry:(PIOSessionRetry *)retry forTask:(NSURLSessionDataTask *)task {
+    // Retries are sent with the request as the session made it, with the configuration's defaults filled in.
+    retry.request = task.originalRequest;
+    retry.task = task;
+    retry.latestTask = task;
+    
+    return (NSURLSessionDataTask *)[[PIORetryingTask alloc] initWithSession:self retry:retry];
+}
+
+- (void (^)(NSData *, NSURLResponse *, NSError *))completionHandlerForRetry:(PIOSessionRetry *)retry {
+    return ^(NSData *data, NSURLResponse *response, NSError *error) {
+        BOOL cancelled;
+        
+        @synchronized (retry) {
+            cancelled = retry.isCancelled;
+        }
+        
+        NSTimeInterval delay = cancelled ? -1 : [self delayBeforeRetrying:retry response:response error:error];
+        
+        @synchronized (retry) {
+            if (retry.isCancelled) {
+                delay = -1;
+            } else if (delay >= 0) {
+                retry.task = nil;
+            }
+        }
+        
+        if (delay < 0) {
+            [self finishRetry:retry];
+            retry.completionHandler(data, response, error);
+            return;
+        }
+        
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            [self sendRetry:retry];
+        });
+    };
+}
+
+/**
+ Returns how long to wait before retrying a request that finished with the specified response or error, or a negative number if it shouldn't be retried, in which case the result is returned as it is. A retry is taken out of the budget.
+ */
+- (NSTimeInterval)delayBeforeRetrying:(PIOSessionRetry *)retry response:(NSURLResponse *)response error:(NSError *)error {
+    PIORetryPolicy *policy = retry.policy;
+    
+    @synchronized (self) {
+        if (retry.attempt == 0) _retryBudget = MIN(_retryBudget + policy.retryBudgetRatio, policy.retryBudgetCapacity);
+    }
+    
+    if (retry.attempt >= policy.maximumRetryCount || !pk_response_is_retryable(response, error)) return -1;
+    
+    NSTimeInterval retryAfter = pk_retry_after(response);
+    
+    if (retryAfter > policy.maximumRetryAfter) return -1;
+    
+    @synchronized (self) {
+        if (_retryBudget < 1) return -1;
+        _retryBudget -= 1;
+    }
+    
+    // Full jitter: anywhere between nothing and the ceiling, so that clients that failed together spread out.
+    NSTimeInterval ceiling = MIN(policy.baseDelay * pow(2, retry.attempt), policy.maximumDelay);
+    NSTimeInterval delay = ceiling * ((double)arc4random() / UINT32_MAX);
+    
+    return MAX(delay, retryAfter);
+}
+
+- (void)sendRetry:(PIOSessionRetry *)retry {
+    // Retries wait for the rate limiter like any other request, attributed to whoever made the first attempt.
+    __block NSURLSessionDataTask *task;
+    dispatch_block_t createTask = ^{
+        task = [self rateLimitedTask:[[self sessionForURL:retry.request.URL] dataTaskWithRequest:retry.request completionHandler:[self completionHandlerForRetry:retry]]];
+    };
+    
+    retry.caller == nil ? createTask() : [PIORateLimiter performAsCaller:retry.caller block:createTask];
+    
+    @synchronized (retry) {
+        // The completion handler was called when the retry was cancelled.
+        if (retry.isCancelled) return;
+        
+        retry.attempt++;
+        retry.task = task;
+        retry.latestTask = task;
+    }
+    
+    [task resume];
+}
+
+- (void)finishRetry:(PIOSessionRetry *)retry {
+    @synchronized (retry) {
+        retry.finished = YES;
+    }
+}
+
+- (void)cancelRetry:(PIOSessionRetry *)retry {
+    NSURLSessionTask *currentTask;
+    
+    @synchronized (retry) {
+        if (retry.isCancelled || retry.isFinished) return;
+        
+        retry.cancelled = YES;
+        currentTask = retry.task;
+    }
+    
+    if (currentTask != nil) {
+        // The attempt's completion handler sees that the retry was cancelled and returns the cancellation error.
+        [currentTask cancel];
+    } else {
+        [self finishRetry:retry];
+        retry.completionHandler(nil, nil, [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]);
+    }
+}
+
+#pragma mark - NSURLSessionTaskDelegate
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task needNewBodyStream:(void (^)(NSInputStream * _Nullable))completionHandler {
+    id<NSURLSessionDataDelegate> delegate = [self delegateForTask:task];
+    
+    if ([delegate respondsToSelector:_cmd]) {
+        NSURLSessionTask *publicTask = [self publicTaskForTask:task];
+        
+        [self forTask:task performBlock:^{
+            [delegate URLSession:session task:publicTask needNewBodyStream:completionHandler];
+        }];
+        return;
+    }
+    
+    // Streamed bodies can't be rewound, so a request that has to be retransmitted (after an authentication challenge or a dropped connection) is given a fresh copy of its stream.
+    NSInputStream *stream = task.originalRequest.HTTPBodyStream;
+    completionHandler([stream conformsToProtocol:@protocol(NSCopying)] ? [stream copy] : nil);
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didSendBodyData:(int64_t)bytesSent totalBytesSent:(int64_t)totalBytesSent totalBytesExpectedToSend:(int64_t)totalBytesExpectedToSend {
+    id<NSURLSessionDataDelegate> delegate = [self delegateForTask:task];
+    
+    if ([delegate respondsToSelector:_cmd]) {
+        NSURLSessionTask *publicTask = [self publicTaskForTask:task];
+        
+        [self forTask:task performBlock:^{
+            [delegate URLSession:session task:publicTask didSendBodyData:bytesSent totalBytesSent:totalBytesSent totalBytesExpectedToSend:totalBytesExpectedToSend];
+        }];
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    id<NSURLSessionDataDelegate> delegate;
+    id queue;
+    NSURLSessionTask *publicTask;
+    
+    @synchronized (_taskDelegates) {
+        delegate = [_taskDelegates objectForKey:task];
+        queue = [_taskCallbackQueues objectForKey:task];
+        publicTask = [_publicTasks objectForKey:task] ?: task;
+        
+        [_taskDelegates removeObjectForKey:task];
+        [_taskCallbackQueues removeObjectForKey:task];
+        [_publicTasks removeObjectForKey:task];
+    }
+    
+    if ([delegate respondsToSelector:_cmd]) {
+        pk_perform_with_callback_queue(queue == [NSNull null] ? nil : queue, ^{
+            [delegate URLSession:session task:publicTask didCompleteWithError:error];
+        });
+    }
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
+    id<NSURLSessionDataDelegate> delegate = [self delegateForTask:dataTask];
+    
+    if ([delegate respondsToSelector:_cmd]) {
+        NSURLSessionDataTask *publicTask = [self publicTaskForTask:dataTask];
+        
+        [self forTask:dataTask performBlock:^{
+            [delegate URLSession:session dataTask:publicTask didReceiveResponse:response completionHandler:completionHandler];
+        }];
+    } else {
+        completionHandler(NSURLSessionResponseAllow);
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+    id<NSURLSessionDataDelegate> delegate = [self delegateForTask:dataTask];
+    
+    if ([delegate respondsToSelector:_cmd]) {
+        NSURLSessionDataTask *publicTask = [self publicTaskForTask:dataTask];
+        
+        [self forTask:dataTask performBlock:^{
+            [delegate URLSession:session dataTask:publicTask didReceiveData:data];
+        }];
+    }
+}
+
+@end
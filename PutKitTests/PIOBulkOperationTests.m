@@ -0,0 +1,212 @@
+//
+//  PIOBulkOperationTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSMutableSet<NSNumber *> *PIOStubBulkFiles; // The files that exist, by identifier.
+static NSUInteger PIOStubBulkLimit; // The most identifiers accepted in one request.
+static NSUInteger PIOStubBulkUnavailableCount; // The number of requests still to be turned away as if the server were down.
+static BOOL PIOStubBulkUnauthorized; // Whether every request is turned away as if the token had expired.
+static NSUInteger PIOStubBulkRequestCount;
+static NSUInteger PIOStubBulkConcurrentCount;
+static NSUInteger PIOStubBulkMaximumConcurrentCount;
+
+/**
+ A stand-in for the file deletion endpoint of @b api.put.io. A request fails if any one of its files doesn't exist.
+ */
+@interface PIOStubBulkServer : PIOStubServer
+
+@end
+
+@implementation PIOStubBulkServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path isEqualToString:@"/v2/files/delete"];
+}
+
+- (void)startLoading {
+    NSDictionary *parameters = [NSJSONSerialization JSONObjectWithData:[self requestBody] options:0 error:nil];
+    NSArray<NSString *> *identifiers = [parameters[@"file_ids"] componentsSeparatedByString:@","];
+    NSInteger statusCode = 200;
+    
+    @synchronized (PIOStubBulkFiles) {
+        PIOStubBulkRequestCount++;
+        PIOStubBulkMaximumConcurrentCount = MAX(PIOStubBulkMaximumConcurrentCount, ++PIOStubBulkConcurrentCount);
+        
+        if (PIOStubBulkUnauthorized) {
+            statusCode = 401;
+        } else if (PIOStubBulkUnavailableCount > 0) {
+            PIOStubBulkUnavailableCount--;
+            statusCode = 503;
+        } else if (identifiers.count > PIOStubBulkLimit) {
+            statusCode = 413;
+        } else {
+            for (NSString *identifier in identifiers) {
+                if (![PIOStubBulkFiles containsObject:@(identifier.integerValue)]) statusCode = 404;
+            }
+            
+            for (NSString *identifier in identifiers) {
+                if (statusCode == 200) [PIOStubBulkFiles removeObject:@(identifier.integerValue)];
+            }
+        }
+    }
+    
+    NSDictionary *body = statusCode == 200 ? @{@"status": @"OK"} : @{@"status": @"ERROR", @"error_type": @"Error", @"error_message": @"Request failed", @"status_code": @(statusCode)};
+    
+    // Answered a little later, so that requests overlap.
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.005 * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+        @synchronized (PIOStubBulkFiles) {
+            PIOStubBulkConcurrentCount--;
+        }
+        
+        [self respondWithStatusCode:statusCode JSONObject:body];
+    });
+}
+
+@end
+
+@interface PIOBulkOperationTests : PIOStubServerTestCase
+
+@end
+
+@implementation PIOBulkOperationTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubBulkFiles = [NSMutableSet set];
+    PIOStubBulkLimit = NSUIntegerMax;
+    PIOStubBulkUnavailableCount = 0;
+    PIOStubBulkUnauthorized = NO;
+    PIOStubBulkRequestCount = 0;
+    PIOStubBulkConcurrentCount = 0;
+    PIOStubBulkMaximumConcurrentCount = 0;
+    
+    [self useStubServer:PIOStubBulkServer.class];
+}
+
+- (NSArray<NSNumber *> *)addFileCount:(NSInteger)count {
+    NSMutableArray<NSNumber *> *identifiers = [NSMutableArray arrayWithCapacity:count];
+    
+    for (NSInteger identifier = 1; identifier <= count; identifier++) [identifiers addObject:@(identifier)];
+    
+    [PIOStubBulkFiles addObjectsFromArray:identifiers];
+    
+    return identifiers;
+}
+
+- (void)runOperation:(PIOBulkOperation *)operation completion:(void (^)(NSArray<NSNumber *> *, NSDictionary<NSNumber *, NSError *> *))completion {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Operation finished"];
+    
+    [operation startWithCompletion:^(NSArray<NSNumber *> *succeeded, NSDictionary<NSNumber *, NSError *> *failed) {
+        completion(succeeded, failed);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+}
+
+- (void)testLargeDeletionShrinksBatchesToServerLimit {
+    NSArray<NSNumber *> *identifiers = [self addFileCount:5000];
+    PIOBulkOperation *operation = [PIOBulkOperation deleteFilesWithIDs:identifiers];
+    
+    PIOStubBulkLimit = 100;
+    operation.batchSize = 500;
+    
+    [self runOperation:operation completion:^(NSArray<NSNumber *> *succeeded, NSDictionary<NSNumber *, NSError *> *failed) {
+        XCTAssertEqual(succeeded.count, identifiers.count);
+        XCTAssertEqual(failed.count, 0);
+    }];
+    
+    XCTAssertEqual(PIOStubBulkFiles.count, 0);
+    XCTAssertLessThanOrEqual(PIOStubBulkMaximumConcurrentCount, operation.maximumConcurrentBatches);
+    XCTAssertLessThan(PIOStubBulkRequestCount, 130, @"Once the batch size has been found, no more requests should be turned down for size.");
+}
+
+- (void)testMissingFilesAreNarrowedDown {
+    NSArray<NSNumber *> *identifiers = [self addFileCount:1000];
+    NSSet<NSNumber *> *missing = [NSSet setWithObjects:@7, @500, @999, nil];
+    
+    [PIOStubBulkFiles minusSet:missing];
+    
+    [self runOperation:[PIOBulkOperation deleteFilesWithIDs:identifiers] completion:^(NSArray<NSNumber *> *succeeded, NSDictionary<NSNumber *, NSError *> *failed) {
+        XCTAssertEqual(succeeded.count, identifiers.count - missing.count);
+        XCTAssertEqualObjects([NSSet setWithArray:failed.allKeys], missing);
+        XCTAssertEqual(failed[@7].code, 404);
+    }];
+    
+    XCTAssertEqual(PIOStubBulkFiles.count, 0);
+}
+
+- (void)testUnauthorizedRequestFailsEveryIdentifier {
+    NSArray<NSNumber *> *identifiers = [self addFileCount:1000];
+    PIOBulkOperation *operation = [PIOBulkOperation deleteFilesWithIDs:identifiers];
+    
+    PIOStubBulkUnauthorized = YES;
+    operation.batchSize = 10;
+    
+    [self runOperation:operation completion:^(NSArray<NSNumber *> *succeeded, NSDictionary<NSNumber *, NSError *> *failed) {
+        XCTAssertEqual(succeeded.count, 0);
+        XCTAssertEqual(failed.count, identifiers.count);
+        XCTAssertEqual(failed[@1].code, 401);
+    }];
+    
+    XCTAssertLessThanOrEqual(PIOStubBulkRequestCount, operation.maximumConcurrentBatches, @"An unauthorized batch shouldn't be split up or followed by any others.");
+}
+
+- (void)testUnavailableServerIsRetried {
+    NSArray<NSNumber *> *identifiers = [self addFileCount:10];
+    
+    PIOStubBulkUnavailableCount = 2;
+    
+    [self runOperation:[PIOBulkOperation deleteFilesWithIDs:identifiers] completion:^(NSArray<NSNumber *> *succeeded, NSDictionary<NSNumber *, NSError *> *failed) {
+        XCTAssertEqual(succeeded.count, identifiers.count);
+        XCTAssertEqual(failed.count, 0);
+    }];
+    
+    XCTAssertEqual(PIOStubBulkRequestCount, 3);
+}
+
+- (void)testCancelledIdentifiersAreReported {
+    NSArray<NSNumber *> *identifiers = [self addFileCount:2000];
+    PIOBulkOperation *operation = [PIOBulkOperation deleteFilesWithIDs:identifiers];
+    
+    operation.batchSize = 10;
+    operation.maximumConcurrentBatches = 1;
+    operation.progressCallback = ^(NSUInteger completed, NSUInteger total) {
+        if (completed == 100) [operation cancel];
+    };
+    
+    [self runOperation:operation completion:^(NSArray<NSNumber *> *succeeded, NSDictionary<NSNumber *, NSError *> *failed) {
+        XCTAssertGreaterThanOrEqual(succeeded.count, 100);
+        XCTAssertEqual(succeeded.count + failed.count, identifiers.count);
+        XCTAssertEqual(failed.allValues.firstObject.code, NSURLErrorCancelled);
+    }];
+}
+
+@end
@@ -0,0 +1,197 @@
+//
+//  PIOCallbackQueueTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSUInteger const PIOCallbackRequestCount = 200;
+
+/**
+ A stand-in for @b api.put.io that answers every request with an empty success.
+ */
+@interface PIOStubCallbackServer : PIOStubServer
+
+@end
+
+@implementation PIOStubCallbackServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"];
+}
+
+- (void)startLoading {
+    [self respondWithStatusCode:200 JSONObject:@{@"status": @"OK"}];
+}
+
+@end
+
+@interface PIOCallbackQueueTests : PIOStubServerTestCase
+
+@property (strong, nonatomic) NSOperationQueue *delegateQueue;
+
+@end
+
+@implementation PIOCallbackQueueTests
+
+- (void)setUp {
+    [super setUp];
+    
+    self.delegateQueue = [NSOperationQueue new];
+    self.delegateQueue.maxConcurrentOperationCount = 1;
+    
+    [self setCallbackQueue:[NSOperationQueue mainQueue]];
+}
+
+- (void)setCallbackQueue:(NSOperationQueue *)callbackQueue {
+    PIOConfiguration *configuration = [self configurationWithStubServers:@[PIOStubCallbackServer.class]];
+    configuration.delegateQueue = self.delegateQueue;
+    configuration.callbackQueue = callbackQueue;
+    PIOAPI.configuration = configuration;
+}
+
+- (NSOperationQueue *)serialQueue {
+    NSOperationQueue *queue = [NSOperationQueue new];
+    queue.maxConcurrentOperationCount = 1;
+    return queue;
+}
+
+- (void)sendRequestWithCallback:(PIOErrorOnlyCallback)callback {
+    [[PIOAPI deleteFilesWithIDs:@[@1] callback:callback] resume];
+}
+
+- (void)testMainQueueIsTheDefault {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Called back"];
+    
+    XCTAssertEqual([PIOConfiguration defaultConfiguration].callbackQueue, [NSOperationQueue mainQueue]);
+    
+    [self sendRequestWithCallback:^(NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertTrue([NSThread isMainThread]);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)testConfiguredQueue {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Called back"];
+    NSOperationQueue *queue = [self serialQueue];
+    
+    [self setCallbackQueue:queue];
+    
+    XCTAssertEqual([PIOAPI.configuration copy].callbackQueue, queue);
+    
+    [self sendRequestWithCallback:^(NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqual([NSOperationQueue currentQueue], queue);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)testInlineDeliveryDoesNotNeedTheMainQueue {
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block NSOperationQueue *queue;
+    
+    [self setCallbackQueue:nil];
+    
+    [self sendRequestWithCallback:^(NSError *error) {
+        queue = [NSOperationQueue currentQueue];
+        dispatch_semaphore_signal(semaphore);
+    }];
+    
+    // The main queue is blocked for as long as this waits, so a callback that hopped to it would never arrive.
+    XCTAssertEqual(dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)), 0);
+    XCTAssertEqual(queue, self.delegateQueue);
+}
+
+- (void)testScopedQueueOverridesConfigurationAndCarriesOver {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Called back twice"];
+    NSOperationQueue *queue = [self serialQueue];
+    
+    [PIOAPI performWithCallbackQueue:queue block:^{
+        [self sendRequestWithCallback:^(NSError *error) {
+            XCTAssertEqual([NSOperationQueue currentQueue], queue);
+            
+            // Requests made from a callback call back on the same queue.
+            [self sendRequestWithCallback:^(NSError *error) {
+                XCTAssertEqual([NSOperationQueue currentQueue], queue);
+                [expectation fulfill];
+            }];
+        }];
+    }];
+    
+    XCTestExpectation *unscopedExpectation = [self expectationWithDescription:@"Called back outside the scope"];
+    
+    [self sendRequestWithCallback:^(NSError *error) {
+        XCTAssertTrue([NSThread isMainThread]);
+        [unscopedExpectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)testMonitorStaysOnMainQueue {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Polled"];
+    
+    [self setCallbackQueue:nil];
+    
+    PIOTransferSubscription *subscription = [[PIOTransferMonitor new] monitorTransferWithID:1 progressCallback:^(NSError *error, PIOTransfer *transfer) {
+        XCTAssertTrue([NSThread isMainThread]);
+        [expectation fulfill];
+    } completionCallback:nil];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [subscription cancel];
+}
+
+- (void)measureRequestsWithCallbackQueue:(NSOperationQueue *)callbackQueue {
+    [self setCallbackQueue:callbackQueue];
+    
+    [self measureBlock:^{
+        XCTestExpectation *expectation = [self expectationWithDescription:@"Every request called back"];
+        expectation.expectedFulfillmentCount = PIOCallbackRequestCount;
+        
+        for (NSUInteger i = 0; i < PIOCallbackRequestCount; i++) {
+            [self sendRequestWithCallback:^(NSError *error) {
+                [expectation fulfill];
+            }];
+        }
+        
+        [self waitForExpectationsWithTimeout:10 handler:nil];
+    }];
+}
+
+- (void)testMainQueueDeliveryPerformance {
+    [self measureRequestsWithCallbackQueue:[NSOperationQueue mainQueue]];
+}
+
+- (void)testInlineDeliveryPerformance {
+    [self measureRequestsWithCallbackQueue:nil];
+}
+
+@end
@@ -0,0 +1,147 @@
+//
+//  PIOChecksumTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOChecksum.h"
+#import "PIOObjectProtocol.h"
+
+static NSUInteger const PIOChecksumBenchmarkSize = 256 * 1024 * 1024;
+
+/** A bit at a time, straight from the definition, to check the fast kernels against. */
+static uint32_t PIOReferenceCRC32(const uint8_t *bytes, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    
+    return ~crc;
+}
+
+@interface PIOChecksumTests : XCTestCase
+
+@end
+
+@implementation PIOChecksumTests
+
+- (void)testKnownAnswers {
+    XCTAssertEqual(pk_crc32(0, "", 0), 0x00000000);
+    XCTAssertEqual(pk_crc32(0, "123456789", 9), 0xCBF43926);
+    XCTAssertEqual(pk_crc32(0, "The quick brown fox jumps over the lazy dog", 43), 0x414FA339);
+}
+
+- (void)testIncrementalMatchesSinglePass {
+    const char *string = "The quick brown fox jumps over the lazy dog";
+    
+    XCTAssertEqual(pk_crc32(pk_crc32(0, string, 10), string + 10, 33), pk_crc32(0, string, 43));
+}
+
+- (void)testEveryLengthAndAlignmentMatchesReference {
+    uint8_t bytes[1024 + 8];
+    arc4random_buf(bytes, sizeof(bytes));
+    
+    // Covers the unaligned head, the 8 and 64 byte bodies and the tail of every kernel.
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t length = 0; length <= 1024; length++) {
+            XCTAssertEqual(pk_crc32(0, bytes + offset, length), PIOReferenceCRC32(bytes + offset, length), @"offset = %zu; length = %zu", offset, length);
+        }
+    }
+}
+
+- (void)testCombineMatchesSinglePass {
+    uint8_t bytes[4096];
+    arc4random_buf(bytes, sizeof(bytes));
+    
+    for (size_t split = 0; split <= sizeof(bytes); split += 97) {
+        uint32_t combined = pk_crc32_combine(pk_crc32(0, bytes, split), pk_crc32(0, bytes + split, sizeof(bytes) - split), sizeof(bytes) - split);
+        XCTAssertEqual(combined, pk_crc32(0, bytes, sizeof(bytes)), @"split = %zu", split);
+    }
+}
+
+- (void)testFileMatchesContents {
+    NSMutableData *data = [NSMutableData dataWithLength:3 * 1024 * 1024 + 5];
+    arc4random_buf(data.mutableBytes, data.length);
+    
+    NSURL *fileURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [data writeToURL:fileURL atomically:YES];
+    
+    uint32_t checksum = 0;
+    NSError *error;
+    
+    XCTAssertTrue(pk_crc32_file(fileURL, &checksum, &error));
+    XCTAssertEqual(checksum, pk_crc32(0, data.bytes, data.length));
+    
+    NSDictionary *dictionary = @{@"id": @1,
+                                 @"name": @"video.mkv",
+                                 @"content_type": @"video/x-matroska",
+                                 @"icon": @"https://put.io/icon.png",
+                                 @"size": @(data.length),
+                                 @"created_at": @"2018-01-01T00:00:00",
+                                 @"crc32": [NSString stringWithFormat:@"%08x", checksum]};
+    PIOFile *file = [(id<PIOObjectProtocol>)[PIOFile alloc] initFromDictionary:dictionary];
+    
+    XCTAssertTrue([file matchesContentsOfURL:fileURL error:&error]);
+    
+    ((uint8_t *)data.mutableBytes)[data.length / 2] ^= 1;
+    [data writeToURL:fileURL atomically:YES];
+    
+    XCTAssertFalse([file matchesContentsOfURL:fileURL error:&error]);
+    XCTAssertEqual(error.code, NSFileReadCorruptFileError);
+    
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+}
+
+- (void)testThroughput {
+    NSMutableData *data = [NSMutableData dataWithLength:PIOChecksumBenchmarkSize];
+    arc4random_buf(data.mutableBytes, data.length);
+    
+    __block CFTimeInterval elapsed = 0;
+    __block NSUInteger runs = 0;
+    
+    [self measureBlock:^{
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        pk_crc32(0, data.bytes, data.length);
+        elapsed += CFAbsoluteTimeGetCurrent() - start;
+        runs++;
+    }];
+    
+    NSLog(@"CRC32 throughput: %.2f GB/s", runs * (double)PIOChecksumBenchmarkSize / elapsed / 1e9);
+}
+
+- (void)testParsesPutIOChecksums {
+    uint32_t checksum = 0;
+    
+    XCTAssertTrue(pk_crc32_from_string(@"cbf43926", &checksum));
+    XCTAssertEqual(checksum, 0xCBF43926);
+    
+    XCTAssertFalse(pk_crc32_from_string(nil, &checksum));
+    XCTAssertFalse(pk_crc32_from_string(@"", &checksum));
+    XCTAssertFalse(pk_crc32_from_string(@"cbf43926ff", &checksum));
+    XCTAssertFalse(pk_crc32_from_string(@"not a crc", &checksum));
+}
+
+@end
@@ -0,0 +1,97 @@
+//
+//  PIODateTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIODate.h"
+
+static NSUInteger const PIODateSampleCount = 10000;
+
+@interface PIODateTests : XCTestCase
+
+@property (strong, nonatomic) NSArray<NSString *> *timestamps;
+
+@end
+
+@implementation PIODateTests
+
+- (void)setUp {
+    [super setUp];
+    
+    NSMutableArray *timestamps = [NSMutableArray arrayWithCapacity:PIODateSampleCount];
+    
+    for (NSUInteger i = 0; i < PIODateSampleCount; i++) {
+        [timestamps addObject:[NSString stringWithFormat:@"20%02tu-%02tu-%02tuT%02tu:%02tu:%02tu", i % 30, i % 12 + 1, i % 28 + 1, i % 24, i % 60, (i * 7) % 60]];
+    }
+    
+    self.timestamps = timestamps;
+}
+
+- (void)testMatchesDateFormatter {
+    NSDateFormatter *formatter = [NSDateFormatter new];
+    formatter.dateFormat = @"yyyy-MM-dd'T'HH:mm:ss";
+    formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+    formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+    
+    for (NSString *timestamp in self.timestamps) {
+        XCTAssertEqualObjects(pk_date_from_string(timestamp), [formatter dateFromString:timestamp], @"%@", timestamp);
+    }
+    
+    XCTAssertEqualObjects(pk_date_from_string(@"1970-01-01T00:00:00"), [NSDate dateWithTimeIntervalSince1970:0]);
+    XCTAssertEqualObjects(pk_date_from_string(@"2000-02-29T23:59:59"), [NSDate dateWithTimeIntervalSince1970:951868799]);
+}
+
+- (void)testRejectsMalformedTimestamps {
+    XCTAssertNil(pk_date_from_string(nil));
+    XCTAssertNil(pk_date_from_string([NSNull null]));
+    XCTAssertNil(pk_date_from_string(@""));
+    XCTAssertNil(pk_date_from_string(@"2018-02-20 12:34:56"));
+    XCTAssertNil(pk_date_from_string(@"2018-13-20T12:34:56"));
+    XCTAssertNil(pk_date_from_string(@"2018-02-31T12:34:56"));
+    XCTAssertNil(pk_date_from_string(@"2018-02-29T12:34:56"));
+    XCTAssertNil(pk_date_from_string(@"2018-04-31T12:34:56"));
+    XCTAssertNil(pk_date_from_string(@"2018-02-20T12:3a:56"));
+    XCTAssertNil(pk_date_from_string(@"2018-02-20T12:34:56Z"));
+}
+
+- (void)testFormatterPerObjectPerformance {
+    [self measureBlock:^{
+        for (NSString *timestamp in self.timestamps) {
+            NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
+            [formatter setDateFormat:@"yyyy-MM-dd'T'HH:mm:ss"];
+            [formatter dateFromString:timestamp];
+        }
+    }];
+}
+
+- (void)testFixedWidthParserPerformance {
+    [self measureBlock:^{
+        for (NSString *timestamp in self.timestamps) {
+            pk_date_from_string(timestamp);
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,375 @@
+//
+//  PIODownloadManagerTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+#import "PIOObjectProtocol.h"
+#import "PIOChecksum.h"
+
+static NSUInteger const PIODownloadFileSize = 512 * 1024 + 77;
+static NSUInteger const PIODownloadBenchmarkFileSize = 4 * 1024 * 1024;
+static NSUInteger const PIODownloadBenchmarkSegmentCount = 4;
+
+static NSData *PIOStubFileData;
+static NSMutableArray<NSString *> *PIOStubRanges; // The `Range` header of every request, or "" if there was none.
+static NSMutableArray<NSString *> *PIOStubValidators; // The `If-Range` header of every request, or "" if there was none.
+static BOOL PIOStubDisconnectOnce;
+static BOOL PIOStubIgnoresRanges;
+static NSUInteger PIOStubActiveRequests;
+static NSUInteger PIOStubMaximumActiveRequests;
+static NSTimeInterval PIOStubResponseDelay;
+static NSUInteger PIOStubThrottleChunkSize; // Every connection sends this many bytes per `PIOStubThrottleInterval`. `0` sends everything at once.
+static NSTimeInterval PIOStubThrottleInterval;
+
+/**
+ A stand-in for the download endpoint of @b api.put.io that honours `Range` requests, throttles every connection on its own, and can drop the first connection halfway through its body.
+ */
+@interface PIOStubDownloadServer : PIOStubServer
+
+@end
+
+@implementation PIOStubDownloadServer {
+    BOOL _active;
+    NSData *_body;
+    NSUInteger _sent;
+    BOOL _disconnects;
+}
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"];
+}
+
+- (void)startLoading {
+    @synchronized (PIOStubRanges) {
+        _active = YES;
+        PIOStubActiveRequests++;
+        PIOStubMaximumActiveRequests = MAX(PIOStubMaximumActiveRequests, PIOStubActiveRequests);
+    }
+    
+    [self performSelector:@selector(respond) withObject:nil afterDelay:PIOStubResponseDelay];
+}
+
+- (void)finish {
+    @synchronized (PIOStubRanges) {
+        if (_active) PIOStubActiveRequests--;
+        _active = NO;
+    }
+}
+
+- (void)respond {
+    NSString *range = PIOStubIgnoresRanges ? nil : [self.request valueForHTTPHeaderField:@"Range"];
+    NSUInteger start = 0, end = PIOStubFileData.length - 1;
+    
+    @synchronized (PIOStubRanges) {
+        [PIOStubRanges addObject:[self.request valueForHTTPHeaderField:@"Range"] ?: @""];
+        [PIOStubValidators addObject:[self.request valueForHTTPHeaderField:@"If-Range"] ?: @""];
+        
+        _disconnects = PIOStubDisconnectOnce;
+        PIOStubDisconnectOnce = NO;
+    }
+    
+    if (range != nil) {
+        NSScanner *scanner = [NSScanner scannerWithString:range];
+        NSInteger value = 0;
+        
+        [scanner scanString:@"bytes=" intoString:nil];
+        [scanner scanInteger:&value];
+        start = value;
+        
+        if ([scanner scanString:@"-" intoString:nil] && [scanner scanInteger:&value]) end = value;
+    }
+    
+    NSMutableDictionary *headers = [@{@"ETag": @"\"v1\"",
+                                      @"Content-Length": @(end + 1 - start).stringValue,
+                                      @"Content-Disposition": @"attachment; filename=\"video.mkv\""} mutableCopy];
+    
+    if (range != nil) headers[@"Content-Range"] = [NSString stringWithFormat:@"bytes %tu-%tu/%tu", start, end, PIOStubFileData.length];
+    
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:range == nil ? 200 : 206 HTTPVersion:@"HTTP/1.1" headerFields:headers];
+    
+    _body = [PIOStubFileData subdataWithRange:NSMakeRange(start, end + 1 - start)];
+    
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    [self sendChunk];
+}
+
+- (void)sendChunk {
+    NSUInteger remaining = (_disconnects ? _body.length / 2 : _body.length) - _sent;
+    NSUInteger length = PIOStubThrottleChunkSize == 0 ? remaining : MIN(PIOStubThrottleChunkSize, remaining);
+    
+    [self.client URLProtocol:self didLoadData:[_body subdataWithRange:NSMakeRange(_sent, length)]];
+    _sent += length;
+    
+    if (length < remaining) {
+        [self performSelector:@selector(sendChunk) withObject:nil afterDelay:PIOStubThrottleInterval];
+        return;
+    }
+    
+    if (_disconnects) {
+        [self.client URLProtocol:self didFailWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:nil]];
+    } else {
+        [self.client URLProtocolDidFinishLoading:self];
+    }
+    
+    [self finish];
+}
+
+- (void)stopLoading {
+    [NSObject cancelPreviousPerformRequestsWithTarget:self];
+    [self finish];
+}
+
+@end
+
+@interface PIODownloadManagerTests : PIOStubServerTestCase
+
+@property (strong, nonatomic) NSURL *directoryURL;
+
+@end
+
+@implementation PIODownloadManagerTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubFileData = [self randomDataOfLength:PIODownloadFileSize];
+    PIOStubRanges = [NSMutableArray array];
+    PIOStubValidators = [NSMutableArray array];
+    PIOStubDisconnectOnce = NO;
+    PIOStubIgnoresRanges = NO;
+    PIOStubActiveRequests = 0;
+    PIOStubMaximumActiveRequests = 0;
+    PIOStubResponseDelay = 0;
+    PIOStubThrottleChunkSize = 0;
+    PIOStubThrottleInterval = 0;
+    
+    PIOConfiguration *configuration = [self configurationWithStubServers:@[PIOStubDownloadServer.class]];
+    configuration.maximumConnectionsPerAPIHost = PIODownloadBenchmarkSegmentCount;
+    PIOAPI.configuration = configuration;
+    
+    self.directoryURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString];
+}
+
+- (void)tearDown {
+    PIODownloadManager.sharedInstance.maximumConcurrentDownloads = 2;
+    
+    [[NSFileManager defaultManager] removeItemAtURL:self.directoryURL error:nil];
+    
+    [super tearDown];
+}
+
+- (NSData *)randomDataOfLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, data.length);
+    return data;
+}
+
+- (PIOFile *)fileWithChecksum:(uint32_t)checksum {
+    NSDictionary *dictionary = PIOStubFile(1, @{@"name": @"video.mkv",
+                                                @"size": @(PIOStubFileData.length),
+                                                @"crc32": [NSString stringWithFormat:@"%08x", checksum]});
+    
+    return [(id<PIOObjectProtocol>)[PIOFile alloc] initFromDictionary:dictionary];
+}
+
+- (NSError *)downloadFile:(PIOFile *)file segmentCount:(NSUInteger)segmentCount toURL:(NSURL *)destinationURL {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download finished"];
+    __block NSError *downloadError;
+    
+    [PIODownloadManager.sharedInstance downloadFile:file toURL:destinationURL segmentCount:segmentCount callback:^(NSError * _Nullable error, NSURL * _Nullable fileURL) {
+        downloadError = error;
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:60 handler:nil];
+    
+    return downloadError;
+}
+
+- (void)testDownloadResumesWithRangeAfterDisconnect {
+    PIOStubDisconnectOnce = YES;
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download finished"];
+    NSURL *destinationURL = [self.directoryURL URLByAppendingPathComponent:@"video.mkv"];
+    
+    __block double bytesPerSecond = 0;
+    
+    PIODownload *download = [PIODownloadManager.sharedInstance downloadFileWithID:1 toURL:destinationURL callback:^(NSError * _Nullable error, NSURL * _Nullable fileURL) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(fileURL, destinationURL);
+        [expectation fulfill];
+    }];
+    
+    download.progressCallback = ^(PIODownload *download) {
+        bytesPerSecond = MAX(bytesPerSecond, download.bytesPerSecond);
+    };
+    
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+    
+    NSArray *expectedRanges = @[@"", [NSString stringWithFormat:@"bytes=%tu-%tu", PIODownloadFileSize / 2, PIODownloadFileSize - 1]];
+    
+    XCTAssertEqualObjects(PIOStubRanges, expectedRanges, @"The second request should only ask for the bytes that weren't recieved.");
+    XCTAssertEqualObjects(PIOStubValidators.lastObject, @"\"v1\"");
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:destinationURL], PIOStubFileData);
+    XCTAssertEqual(download.state, PIODownloadStateCompleted);
+    XCTAssertEqual(download.receivedBytes, (int64_t)PIODownloadFileSize);
+    XCTAssertFalse([PIODownloadManager.sharedInstance.downloads containsObject:download]);
+}
+
+- (void)testInlineCallbacksCanReadTheDownloads {
+    PIOConfiguration *configuration = PIOAPI.configuration;
+    configuration.callbackQueue = nil;
+    PIOAPI.configuration = configuration;
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download finished"];
+    NSURL *destinationURL = [self.directoryURL URLByAppendingPathComponent:@"video.mkv"];
+    
+    PIODownload *download = [PIODownloadManager.sharedInstance downloadFileWithID:1 toURL:destinationURL callback:^(NSError * _Nullable error, NSURL * _Nullable fileURL) {
+        XCTAssertNil(error);
+        XCTAssertNotNil(PIODownloadManager.sharedInstance.downloads, @"Asking for the downloads from a callback shouldn't deadlock.");
+        XCTAssertGreaterThan(PIODownloadManager.sharedInstance.maximumConcurrentDownloads, 0);
+        [expectation fulfill];
+    }];
+    
+    download.progressCallback = ^(PIODownload *download) {
+        XCTAssertNotNil(PIODownloadManager.sharedInstance.downloads);
+    };
+    
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+}
+
+- (void)testConcurrentDownloadsAreLimited {
+    PIOStubResponseDelay = 0.2;
+    PIODownloadManager.sharedInstance.maximumConcurrentDownloads = 1;
+    
+    for (NSInteger i = 0; i < 3; i++) {
+        XCTestExpectation *expectation = [self expectationWithDescription:@"Download finished"];
+        NSURL *destinationURL = [self.directoryURL URLByAppendingPathComponent:@(i).stringValue];
+        
+        [PIODownloadManager.sharedInstance downloadFileWithID:i toURL:destinationURL callback:^(NSError * _Nullable error, NSURL * _Nullable fileURL) {
+            XCTAssertNil(error);
+            XCTAssertEqualObjects([NSData dataWithContentsOfURL:destinationURL], PIOStubFileData);
+            [expectation fulfill];
+        }];
+    }
+    
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+    
+    XCTAssertEqual(PIOStubRanges.count, 3);
+    XCTAssertEqual(PIOStubMaximumActiveRequests, 1);
+}
+
+- (void)testSegmentedDownloadReassemblesAndVerifies {
+    PIOStubDisconnectOnce = YES;
+    
+    NSURL *destinationURL = [self.directoryURL URLByAppendingPathComponent:@"video.mkv"];
+    PIOFile *file = [self fileWithChecksum:pk_crc32(0, PIOStubFileData.bytes, PIOStubFileData.length)];
+    
+    XCTAssertNil([self downloadFile:file segmentCount:4 toURL:destinationURL]);
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:destinationURL], PIOStubFileData);
+    
+    // Four segments, plus one request to carry on with the segment that was cut off.
+    XCTAssertEqual(PIOStubRanges.count, 5);
+    XCTAssertEqual([NSSet setWithArray:PIOStubRanges].count, 5);
+    XCTAssertFalse([PIOStubRanges containsObject:@""]);
+}
+
+- (void)testSegmentedDownloadRejectsWrongChecksum {
+    NSURL *destinationURL = [self.directoryURL URLByAppendingPathComponent:@"video.mkv"];
+    PIOFile *file = [self fileWithChecksum:pk_crc32(0, PIOStubFileData.bytes, PIOStubFileData.length) ^ 1];
+    
+    NSError *error = [self downloadFile:file segmentCount:4 toURL:destinationURL];
+    
+    XCTAssertEqualObjects(error.domain, NSCocoaErrorDomain);
+    XCTAssertEqual(error.code, NSFileReadCorruptFileError);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:destinationURL.path]);
+    
+    for (PIODownload *download in PIODownloadManager.sharedInstance.downloads) [download cancel];
+}
+
+- (void)testSuspendedSegmentedDownloadVerifiesAfterResume {
+    PIOStubThrottleChunkSize = 16 * 1024;
+    PIOStubThrottleInterval = 0.01;
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download finished"];
+    NSURL *destinationURL = [self.directoryURL URLByAppendingPathComponent:@"video.mkv"];
+    PIOFile *file = [self fileWithChecksum:pk_crc32(0, PIOStubFileData.bytes, PIOStubFileData.length)];
+    
+    __block BOOL suspended = NO;
+    
+    PIODownload *download = [PIODownloadManager.sharedInstance downloadFile:file toURL:destinationURL segmentCount:4 callback:^(NSError * _Nullable error, NSURL * _Nullable fileURL) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    
+    // The checksum of every segment has to carry over from before the suspension for the finished file to match.
+    download.progressCallback = ^(PIODownload *download) {
+        if (suspended || download.receivedBytes == 0) return;
+        
+        suspended = YES;
+        [download suspend];
+        [download resume];
+    };
+    
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+    
+    XCTAssertTrue(suspended);
+    XCTAssertGreaterThan(PIOStubRanges.count, 4);
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:destinationURL], PIOStubFileData);
+}
+
+- (void)testSegmentedDownloadFallsBackWhenRangesAreIgnored {
+    PIOStubIgnoresRanges = YES;
+    
+    NSURL *destinationURL = [self.directoryURL URLByAppendingPathComponent:@"video.mkv"];
+    PIOFile *file = [self fileWithChecksum:pk_crc32(0, PIOStubFileData.bytes, PIOStubFileData.length)];
+    
+    XCTAssertNil([self downloadFile:file segmentCount:4 toURL:destinationURL]);
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:destinationURL], PIOStubFileData);
+}
+
+- (void)measureDownloadWithSegmentCount:(NSUInteger)segmentCount {
+    PIOStubFileData = [self randomDataOfLength:PIODownloadBenchmarkFileSize];
+    PIOStubThrottleChunkSize = 32 * 1024;
+    PIOStubThrottleInterval = 0.01; // About 3 MB/s per connection.
+    
+    PIOFile *file = [self fileWithChecksum:pk_crc32(0, PIOStubFileData.bytes, PIOStubFileData.length)];
+    NSURL *destinationURL = [self.directoryURL URLByAppendingPathComponent:@"video.mkv"];
+    
+    [self measureBlock:^{
+        XCTAssertNil([self downloadFile:file segmentCount:segmentCount toURL:destinationURL]);
+    }];
+}
+
+- (void)testSingleConnectionThroughput {
+    [self measureDownloadWithSegmentCount:1];
+}
+
+- (void)testSegmentedThroughput {
+    [self measureDownloadWithSegmentCount:PIODownloadBenchmarkSegmentCount];
+}
+
+@end
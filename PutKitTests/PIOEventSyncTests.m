@@ -0,0 +1,227 @@
+//
+//  PIOEventSyncTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSUInteger const PIOStubEventPageSize = 5;
+
+static NSMutableArray<NSDictionary *> *PIOStubEvents; // Every event on the feed, oldest first.
+static NSMutableArray<NSString *> *PIOStubEventQueries; // The `before` parameter of every events request, or "" if there was none.
+
+/**
+ A stand-in for the event feed of @b api.put.io, serving `PIOStubEvents` newest first a page at a time, and for the listing of folder @b 1, which contains files @b 11 and @b 12.
+ */
+@interface PIOStubEventServer : PIOStubServer
+
+@end
+
+@implementation PIOStubEventServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && ([request.URL.path isEqualToString:@"/v2/events/list"] || [request.URL.path isEqualToString:@"/v2/files/list"]);
+}
+
+- (void)startLoading {
+    NSURLComponents *components = [NSURLComponents componentsWithURL:self.request.URL resolvingAgainstBaseURL:NO];
+    NSDictionary *body;
+    
+    if ([components.path isEqualToString:@"/v2/files/list"]) {
+        NSMutableArray *files = [NSMutableArray array];
+        
+        for (NSNumber *identifier in @[@11, @12]) {
+            [files addObject:PIOStubFile(identifier.integerValue, @{@"parent_id": @1, @"name": identifier.stringValue, @"content_type": @"video/mp4"})];
+        }
+        
+        body = @{@"status": @"OK", @"files": files};
+    } else {
+        NSString *before = [components.queryItems filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"name == 'before'"]].firstObject.value;
+        NSMutableArray *page = [NSMutableArray array];
+        
+        @synchronized (PIOStubEvents) {
+            [PIOStubEventQueries addObject:before ?: @""];
+            
+            for (NSDictionary *event in PIOStubEvents.reverseObjectEnumerator) {
+                if (page.count == PIOStubEventPageSize) break;
+                if (before == nil || [event[@"id"] integerValue] < before.integerValue) [page addObject:event];
+            }
+        }
+        
+        body = @{@"status": @"OK", @"events": page};
+    }
+    
+    [self respondWithStatusCode:200 JSONObject:body];
+}
+
+@end
+
+@interface PIOEventSyncTests : PIOStubServerTestCase
+
+@property (strong, nonatomic) PIOFileCache *cache;
+@property (strong, nonatomic) PIOEventSync *sync;
+
+@end
+
+@implementation PIOEventSyncTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubEvents = [NSMutableArray array];
+    PIOStubEventQueries = [NSMutableArray array];
+    
+    [self useStubServer:PIOStubEventServer.class];
+    
+    self.cache = [PIOFileCache new];
+    self.cache.revalidationInterval = 60;
+    self.sync = [[PIOEventSync alloc] initWithFileCache:self.cache stateFileURL:nil];
+}
+
+- (void)addEventCount:(NSUInteger)count fileID:(NSInteger)fileIdentifier {
+    @synchronized (PIOStubEvents) {
+        for (NSUInteger index = 0; index < count; index++) {
+            [PIOStubEvents addObject:@{@"id": @(PIOStubEvents.count + 1),
+                                       @"type": PIOEventTypeTransferCompleted,
+                                       @"transfer_name": @"Transfer",
+                                       @"transfer_size": @0,
+                                       @"file_id": @(fileIdentifier),
+                                       @"created_at": @"2018-01-01T00:00:00"}];
+        }
+    }
+}
+
+- (NSArray<PIOEvent *> *)sync:(PIOEventSync *)sync {
+    __block NSArray<PIOEvent *> *newEvents;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Synced"];
+    
+    [[sync syncWithCallback:^(NSError *error, NSArray<PIOEvent *> *events) {
+        XCTAssertNil(error);
+        newEvents = events;
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    return newEvents;
+}
+
+- (void)cacheFolder {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Listed"];
+    
+    [[self.cache listFilesInFolderWithID:1 callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, BOOL fromCache) {
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (BOOL)isFolderInvalidated {
+    return [self.cache listFilesInFolderWithID:1 callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, BOOL fromCache) {}] != nil;
+}
+
+- (void)testOnlyNewerEventsAreFetched {
+    [self addEventCount:8 fileID:0];
+    
+    XCTAssertEqual([self sync:self.sync].count, PIOStubEventPageSize, @"The first sync shouldn't page back.");
+    XCTAssertEqual(self.sync.lastEventIdentifier, 8);
+    
+    [self addEventCount:12 fileID:0];
+    [PIOStubEventQueries removeAllObjects];
+    
+    NSArray<PIOEvent *> *events = [self sync:self.sync];
+    
+    XCTAssertEqualObjects([events valueForKey:@"identifier"], [[PIOStubEvents subarrayWithRange:NSMakeRange(8, 12)] valueForKey:@"id"], @"Only the new events should be returned, oldest first.");
+    XCTAssertEqualObjects(PIOStubEventQueries, (@[@"", @"16", @"11"]));
+    XCTAssertEqual(self.sync.lastEventIdentifier, 20);
+    
+    [PIOStubEventQueries removeAllObjects];
+    
+    XCTAssertEqual([self sync:self.sync].count, 0);
+    XCTAssertEqual(PIOStubEventQueries.count, 1);
+}
+
+- (void)testFinishedTransferInvalidatesItsFolder {
+    [self addEventCount:1 fileID:0];
+    [self sync:self.sync];
+    [self cacheFolder];
+    
+    [self addEventCount:1 fileID:99];
+    [self sync:self.sync];
+    
+    XCTAssertTrue([self isFolderInvalidated], @"A file the cache hasn't seen could be anywhere.");
+    
+    [self cacheFolder];
+    [self addEventCount:1 fileID:12];
+    [self sync:self.sync];
+    
+    XCTAssertTrue([self isFolderInvalidated]);
+}
+
+- (void)testQuietFeedKeepsFoldersValid {
+    [self addEventCount:1 fileID:0];
+    [self sync:self.sync];
+    [self cacheFolder];
+    [self sync:self.sync];
+    
+    XCTAssertFalse([self isFolderInvalidated]);
+}
+
+- (void)testTooManyEventsInvalidateEverything {
+    [self addEventCount:1 fileID:0];
+    [self sync:self.sync];
+    [self cacheFolder];
+    
+    self.sync.maximumPageCount = 2;
+    [self addEventCount:20 fileID:0];
+    
+    XCTAssertEqual([self sync:self.sync].count, 2 * PIOStubEventPageSize);
+    XCTAssertTrue([self isFolderInvalidated]);
+}
+
+- (void)testPlaceIsKeptAcrossLaunches {
+    NSURL *stateFileURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    PIOEventSync *sync = [[PIOEventSync alloc] initWithFileCache:nil stateFileURL:stateFileURL];
+    
+    [self addEventCount:3 fileID:0];
+    [self sync:sync];
+    
+    XCTAssertEqual([[PIOEventSync alloc] initWithFileCache:nil stateFileURL:stateFileURL].lastEventIdentifier, 3);
+    
+    [sync reset];
+    
+    XCTAssertEqual([[PIOEventSync alloc] initWithFileCache:nil stateFileURL:stateFileURL].lastEventIdentifier, 0);
+}
+
+- (void)testAnotherAccountsPlaceIsIgnored {
+    NSURL *stateFileURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    
+    [@{@"last_event_id": @3, @"account": @"0123456789abcdef"} writeToURL:stateFileURL atomically:YES];
+    
+    XCTAssertEqual([[PIOEventSync alloc] initWithFileCache:nil stateFileURL:stateFileURL].lastEventIdentifier, 0);
+}
+
+@end
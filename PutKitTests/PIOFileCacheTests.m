@@ -0,0 +1,270 @@
+//
+//  PIOFileCacheTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+#import "PIOObjectProtocol.h"
+
+static NSMutableDictionary<NSNumber *, NSNumber *> *PIOStubCacheVersions; // The version of each folder's contents, by folder identifier.
+static NSMutableArray<NSString *> *PIOStubCacheRequests; // The path of every request, followed by ` 304` if it was answered with `Not Modified`.
+
+static NSDictionary *PIOStubCacheFile(NSInteger identifier, NSInteger parentIdentifier, NSInteger version) {
+    return PIOStubFile(identifier, @{@"parent_id": @(parentIdentifier),
+                                     @"name": [NSString stringWithFormat:@"File %zd v%zd", identifier, version],
+                                     @"content_type": @"video/mp4",
+                                     @"size": @(identifier * 1000),
+                                     @"crc32": @"cbf43926"});
+}
+
+/**
+ A stand-in for the file endpoints of @b api.put.io that sends an `ETag` with every listing. Folder @b n contains 50 files with identifiers @b n*1000+1 and up.
+ */
+@interface PIOStubCacheServer : PIOStubServer
+
+@end
+
+@implementation PIOStubCacheServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path hasPrefix:@"/v2/files"];
+}
+
+- (void)startLoading {
+    NSURLComponents *components = [NSURLComponents componentsWithURL:self.request.URL resolvingAgainstBaseURL:NO];
+    NSString *path = components.path;
+    NSMutableDictionary *headers = [@{@"Content-Type": @"application/json"} mutableCopy];
+    NSInteger statusCode = 200;
+    NSDictionary *body;
+    
+    @synchronized (PIOStubCacheRequests) {
+        if ([path isEqualToString:@"/v2/files/list"]) {
+            NSInteger folder = [[components.queryItems filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"name == 'parent_id'"]].firstObject.value integerValue];
+            NSInteger version = PIOStubCacheVersions[@(folder)].integerValue;
+            NSString *entityTag = [NSString stringWithFormat:@"\"%zd-%zd\"", folder, version];
+            NSMutableArray *files = [NSMutableArray array];
+            
+            for (NSInteger index = 1; index <= 50; index++) [files addObject:PIOStubCacheFile(folder * 1000 + index, folder, version)];
+            
+            headers[@"ETag"] = entityTag;
+            
+            if ([[self.request valueForHTTPHeaderField:@"If-None-Match"] isEqualToString:entityTag]) {
+                statusCode = 304;
+                path = [path stringByAppendingString:@" 304"];
+            } else {
+                body = @{@"status": @"OK", @"files": files, @"parent": PIOStubCacheFile(folder, 0, version)};
+            }
+        } else {
+            NSInteger identifier = path.lastPathComponent.integerValue;
+            body = @{@"status": @"OK", @"file": PIOStubCacheFile(identifier, identifier / 1000, PIOStubCacheVersions[@(identifier / 1000)].integerValue)};
+        }
+        
+        [PIOStubCacheRequests addObject:path];
+    }
+    
+    [self respondWithStatusCode:statusCode headers:headers data:body == nil ? nil : [NSJSONSerialization dataWithJSONObject:body options:0 error:nil]];
+}
+
+@end
+
+@interface PIOFileCacheTests : PIOStubServerTestCase
+
+@property (strong, nonatomic) PIOFileCache *cache;
+
+@end
+
+@implementation PIOFileCacheTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubCacheVersions = [NSMutableDictionary dictionary];
+    PIOStubCacheRequests = [NSMutableArray array];
+    
+    [self useStubServer:PIOStubCacheServer.class];
+    
+    self.cache = [PIOFileCache new];
+    self.cache.revalidationInterval = 0;
+}
+
+/** Lists a folder and returns every call of the callback as `[files, fromCache]`. */
+- (NSArray<NSArray *> *)listFolderWithID:(NSInteger)folderIdentifier {
+    NSMutableArray<NSArray *> *calls = [NSMutableArray array];
+    
+    [[self.cache listFilesInFolderWithID:folderIdentifier callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, BOOL fromCache) {
+        XCTAssertNil(error);
+        [calls addObject:@[files, @(fromCache)]];
+    }] resume];
+    
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+    
+    return calls;
+}
+
+- (void)testUnchangedFolderIsRevalidatedWithNotModified {
+    NSArray<NSArray *> *calls = [self listFolderWithID:1];
+    
+    XCTAssertEqual(calls.count, 1);
+    XCTAssertEqual([calls[0][0] count], 50);
+    XCTAssertEqualObjects(calls[0][1], @NO);
+    
+    calls = [self listFolderWithID:1];
+    
+    XCTAssertEqual(calls.count, 1, @"An unchanged folder should only be handed out from the cache.");
+    XCTAssertEqualObjects(calls[0][1], @YES);
+    XCTAssertEqualObjects(PIOStubCacheRequests, (@[@"/v2/files/list", @"/v2/files/list 304"]));
+}
+
+- (void)testChangedFolderIsHandedOutAgain {
+    [self listFolderWithID:1];
+    
+    PIOStubCacheVersions[@1] = @2;
+    
+    NSArray<NSArray *> *calls = [self listFolderWithID:1];
+    
+    XCTAssertEqual(calls.count, 2);
+    XCTAssertEqualObjects(calls[0][1], @YES);
+    XCTAssertEqualObjects(calls[1][1], @NO);
+    XCTAssertEqualObjects([calls[1][0] firstObject].name, @"File 1001 v2");
+    XCTAssertEqualObjects([self.cache cachedFileWithID:1001].name, @"File 1001 v2");
+}
+
+- (void)testRecentlyCheckedFolderMakesNoRequest {
+    self.cache.revalidationInterval = 60;
+    
+    [self listFolderWithID:1];
+    
+    XCTAssertNil([self.cache listFilesInFolderWithID:1 callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, BOOL fromCache) {}]);
+    
+    [self.cache invalidateFolderWithID:1];
+    
+    XCTAssertNotNil([self.cache listFilesInFolderWithID:1 callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, BOOL fromCache) {}]);
+}
+
+- (void)testFileInCachedFolderIsHandedOutStraightAway {
+    self.cache.revalidationInterval = 60;
+    
+    [self listFolderWithID:1];
+    
+    __block PIOFile *cachedFile;
+    
+    XCTAssertNil([self.cache getFileForID:1007 callback:^(NSError *error, PIOFile *file, BOOL fromCache) {
+        XCTAssertTrue(fromCache);
+        cachedFile = file;
+    }]);
+    
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    
+    XCTAssertEqual(cachedFile.identifier, 1007);
+}
+
+- (void)testLeastRecentlyUsedFoldersAreEvicted {
+    self.cache.memoryBudget = 64 * 1024;
+    
+    for (NSInteger folder = 1; folder <= 10; folder++) {
+        [self listFolderWithID:folder];
+        [self.cache cachedFilesInFolderWithID:1]; // Keeps the first folder in use.
+    }
+    
+    XCTAssertLessThanOrEqual(self.cache.cost, self.cache.memoryBudget);
+    XCTAssertNotNil([self.cache cachedFilesInFolderWithID:1]);
+    XCTAssertNotNil([self.cache cachedFilesInFolderWithID:10]);
+    XCTAssertNil([self.cache cachedFilesInFolderWithID:2]);
+}
+
+- (void)testCacheIsKeptAcrossLaunches {
+    NSURL *fileURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    
+    self.cache = [[PIOFileCache alloc] initWithFileURL:fileURL];
+    [self listFolderWithID:1];
+    
+    // Saves are put off for a second.
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:1.5]];
+    
+    PIOFileCache *relaunchedCache = [[PIOFileCache alloc] initWithFileURL:fileURL];
+    PIOFile *file = [relaunchedCache cachedFileWithID:1001];
+    
+    XCTAssertEqual([relaunchedCache cachedFilesInFolderWithID:1].count, 50);
+    XCTAssertEqualObjects(file.name, @"File 1001 v0");
+    XCTAssertEqualObjects(file.cyclicRedundancyCode, @"cbf43926");
+    XCTAssertEqual(file.parentIdentifier, 1);
+    
+    [relaunchedCache removeAllFiles];
+    
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:fileURL.path]);
+}
+
+- (void)testEveryAccountsFileIsRemoved {
+    NSURL *fileURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    NSURL *accountFileURL = [fileURL.URLByDeletingLastPathComponent URLByAppendingPathComponent:[fileURL.lastPathComponent stringByAppendingString:@"-0123456789abcdef"]];
+    
+    [[NSData data] writeToURL:accountFileURL atomically:YES];
+    
+    [[[PIOFileCache alloc] initWithFileURL:fileURL] removeAllFiles];
+    
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:accountFileURL.path], @"Signing out should leave nothing behind for any account.");
+}
+
+- (void)testChangedFilesMarkTheirFolderForRevalidation {
+    self.cache.revalidationInterval = 60;
+    
+    [self listFolderWithID:1];
+    [self listFolderWithID:2];
+    
+    [self.cache invalidateFoldersContainingFilesWithIDs:@[@1001]];
+    
+    XCTAssertNotNil([self.cache listFilesInFolderWithID:1 callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, BOOL fromCache) {}]);
+    XCTAssertNil([self.cache listFilesInFolderWithID:2 callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, BOOL fromCache) {}]);
+}
+
+- (void)testEventsMarkFoldersForRevalidation {
+    self.cache.revalidationInterval = 60;
+    
+    [self listFolderWithID:1];
+    [self listFolderWithID:2];
+    
+    PIOEvent *zipEvent = [(id<PIOObjectProtocol>)[PIOEvent alloc] initFromDictionary:@{@"id": @1, @"type": PIOEventTypeZipCreated, @"file_name": @"Files.zip", @"file_size": @0, @"created_at": @"2018-01-02T00:00:00"}];
+    PIOEvent *shareEvent = [(id<PIOObjectProtocol>)[PIOEvent alloc] initFromDictionary:@{@"id": @2, @"type": PIOEventTypeFileShared, @"file_name": @"File 2003", @"file_size": @0, @"file_id": @2003, @"created_at": @"2018-01-02T00:00:00"}];
+    
+    [self.cache invalidateFilesForEvents:@[zipEvent, shareEvent]];
+    
+    XCTAssertNil([self.cache listFilesInFolderWithID:1 callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, BOOL fromCache) {}]);
+    XCTAssertNotNil([self.cache listFilesInFolderWithID:2 callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, BOOL fromCache) {}]);
+}
+
+- (void)testUnknownFileMarksEveryFolder {
+    self.cache.revalidationInterval = 60;
+    
+    [self listFolderWithID:1];
+    
+    PIOEvent *event = [(id<PIOObjectProtocol>)[PIOEvent alloc] initFromDictionary:@{@"id": @1, @"type": PIOEventTypeTransferCompleted, @"transfer_name": @"New", @"transfer_size": @0, @"file_id": @99999, @"created_at": @"2018-01-02T00:00:00"}];
+    
+    [self.cache invalidateFilesForEvents:@[event]];
+    
+    XCTAssertNotNil([self.cache listFilesInFolderWithID:1 callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, BOOL fromCache) {}]);
+}
+
+@end
@@ -0,0 +1,194 @@
+//
+//  PIOFileListingTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSUInteger const PIOListingFileCount = 250;
+static NSUInteger const PIOListingPerPage = 100;
+
+static NSMutableArray<NSString *> *PIOStubListingPaths; // The path of every request, in order.
+
+/**
+ A stand-in for the listing endpoints of @b api.put.io that serves `PIOListingFileCount` files, where the cursor is the offset of the next page.
+ */
+@interface PIOStubListingServer : PIOStubServer
+
+@end
+
+@implementation PIOStubListingServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path hasPrefix:@"/v2/files/list"];
+}
+
+- (void)startLoading {
+    NSURLComponents *components = [NSURLComponents componentsWithURL:self.request.URL resolvingAgainstBaseURL:NO];
+    NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
+    
+    for (NSURLQueryItem *item in components.queryItems) parameters[item.name] = item.value;
+    
+    if ([self.request.HTTPMethod isEqualToString:@"POST"]) [parameters addEntriesFromDictionary:[NSJSONSerialization JSONObjectWithData:[self requestBody] options:0 error:nil]];
+    
+    @synchronized (PIOStubListingPaths) {
+        [PIOStubListingPaths addObject:self.request.URL.path];
+    }
+    
+    NSUInteger offset = [parameters[@"cursor"] integerValue];
+    NSUInteger perPage = [parameters[@"per_page"] integerValue];
+    NSUInteger end = MIN(offset + perPage, PIOListingFileCount);
+    NSMutableArray *files = [NSMutableArray array];
+    
+    for (NSUInteger i = offset; i < end; i++) {
+        [files addObject:PIOStubFile(i + 1, @{@"name": [NSString stringWithFormat:@"%tu.mkv", i]})];
+    }
+    
+    NSMutableDictionary *body = [@{@"status": @"OK", @"files": files, @"cursor": end < PIOListingFileCount ? @(end).stringValue : [NSNull null]} mutableCopy];
+    
+    if (offset == 0) {
+        body[@"parent"] = PIOStubFile(0, @{@"name": @"Your Files", @"content_type": @"application/x-directory", @"size": @0});
+    }
+    
+    [self respondWithStatusCode:200 JSONObject:body];
+}
+
+@end
+
+@interface PIOFileListingTests : PIOStubServerTestCase
+
+@end
+
+@implementation PIOFileListingTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubListingPaths = [NSMutableArray array];
+    
+    [self useStubServer:PIOStubListingServer.class];
+}
+
+- (void)testPagesAreDeliveredInOrder {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Listing finished"];
+    NSMutableArray<NSNumber *> *pageSizes = [NSMutableArray array];
+    NSMutableArray<NSString *> *names = [NSMutableArray array];
+    
+    [PIOAPI enumerateFilesInFolderWithID:0 perPage:PIOListingPerPage usingBlock:^(NSArray<PIOFile *> *files, PIOFile *folder, BOOL *stop) {
+        XCTAssertEqualObjects(folder.name, @"Your Files");
+        
+        [pageSizes addObject:@(files.count)];
+        for (PIOFile *file in files) [names addObject:file.name];
+    } completion:^(NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    
+    XCTAssertEqualObjects(pageSizes, (@[@100, @100, @50]));
+    XCTAssertEqual(names.count, PIOListingFileCount);
+    XCTAssertEqualObjects(names.firstObject, @"0.mkv");
+    XCTAssertEqualObjects(names.lastObject, @"249.mkv");
+    XCTAssertEqualObjects(PIOStubListingPaths, (@[@"/v2/files/list", @"/v2/files/list/continue", @"/v2/files/list/continue"]));
+}
+
+- (void)testStoppingEndsTheListing {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Listing finished"];
+    __block NSUInteger pageCount = 0;
+    
+    [PIOAPI enumerateFilesInFolderWithID:0 perPage:PIOListingPerPage usingBlock:^(NSArray<PIOFile *> *files, PIOFile *folder, BOOL *stop) {
+        pageCount++;
+        *stop = YES;
+    } completion:^(NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    
+    // Give a prefetched page the chance to arrive, to check that it is dropped.
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+    
+    XCTAssertEqual(pageCount, 1);
+    XCTAssertLessThanOrEqual(PIOStubListingPaths.count, 2);
+}
+
+- (void)testCancellingBeforeTheFirstPage {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Listing cancelled"];
+    
+    PIOFileEnumeration *enumeration = [PIOAPI enumerateFilesInFolderWithID:0 perPage:PIOListingPerPage usingBlock:^(NSArray<PIOFile *> *files, PIOFile *folder, BOOL *stop) {
+        XCTFail(@"No page should be handed over once the listing is cancelled.");
+    } completion:^(NSError *error) {
+        XCTAssertEqualObjects(error.domain, NSURLErrorDomain);
+        XCTAssertEqual(error.code, NSURLErrorCancelled);
+        [expectation fulfill];
+    }];
+    
+    [enumeration cancel];
+    
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testCancellingDropsThePrefetchedPage {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Listing cancelled"];
+    __block PIOFileEnumeration *enumeration;
+    __block NSUInteger pageCount = 0;
+    
+    enumeration = [PIOAPI enumerateFilesInFolderWithID:0 perPage:PIOListingPerPage usingBlock:^(NSArray<PIOFile *> *files, PIOFile *folder, BOOL *stop) {
+        pageCount++;
+        [enumeration cancel];
+    } completion:^(NSError *error) {
+        XCTAssertEqual(error.code, NSURLErrorCancelled);
+        enumeration = nil;
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    
+    XCTAssertEqual(pageCount, 1);
+}
+
+- (void)testSinglePageReturnsCursor {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Page listed"];
+    
+    [[PIOAPI listFilesInFolderWithID:0 perPage:PIOListingPerPage callback:^(NSError *error, NSArray<PIOFile *> *files, PIOFile *folder, NSString *cursor) {
+        XCTAssertNil(error);
+        XCTAssertEqual(files.count, PIOListingPerPage);
+        XCTAssertEqualObjects(cursor, @"100");
+        
+        [[PIOAPI continueListingFilesWithCursor:@"200" perPage:PIOListingPerPage callback:^(NSError *error, NSArray<PIOFile *> *files, NSString *cursor) {
+            XCTAssertNil(error);
+            XCTAssertEqual(files.count, 50);
+            XCTAssertNil(cursor, @"There is no cursor after the last page.");
+            [expectation fulfill];
+        }] resume];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+@end
@@ -0,0 +1,205 @@
+//
+//  PIOFolderWalkerTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSUInteger const PIOStubWalkBreadth = 10; // The number of folders in the root and in each of its folders.
+static NSUInteger const PIOStubWalkFileCount = 20; // The number of files in each of the deepest folders, half of them videos.
+
+static NSMutableArray<NSNumber *> *PIOStubWalkListedFolders; // The folders whose first page was asked for, in order.
+static NSUInteger PIOStubWalkConcurrentCount;
+static NSUInteger PIOStubWalkMaximumConcurrentCount;
+
+/**
+ The contents of a folder in a tree three levels deep. Folder @b n (below the root) contains folders @b n*100+1 and up, and the folders below those contain only files.
+ */
+static NSArray<NSDictionary *> *PIOStubWalkContents(NSInteger folder) {
+    NSMutableArray<NSDictionary *> *contents = [NSMutableArray array];
+    BOOL deepest = folder >= 100;
+    NSUInteger count = deepest ? PIOStubWalkFileCount : PIOStubWalkBreadth;
+    
+    for (NSInteger index = 1; index <= (NSInteger)count; index++) {
+        NSInteger identifier = deepest ? folder * 1000 + index : folder * 100 + index;
+        
+        [contents addObject:PIOStubFile(identifier, @{@"parent_id": @(folder),
+                                                      @"name": [NSString stringWithFormat:@"%zd", identifier],
+                                                      @"content_type": deepest ? (index % 2 == 0 ? @"video/mp4" : @"text/plain") : @"application/x-directory",
+                                                      @"size": @(deepest ? index : 0)})];
+    }
+    
+    return contents;
+}
+
+/**
+ A stand-in for the paginated listing endpoints of @b api.put.io serving `PIOStubWalkContents`. Cursors are of the form `folder:offset`.
+ */
+@interface PIOStubWalkServer : PIOStubServer
+
+@end
+
+@implementation PIOStubWalkServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path hasPrefix:@"/v2/files/list"];
+}
+
+- (void)startLoading {
+    NSURLComponents *components = [NSURLComponents componentsWithURL:self.request.URL resolvingAgainstBaseURL:NO];
+    NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
+    
+    for (NSURLQueryItem *item in components.queryItems) parameters[item.name] = item.value;
+    
+    if ([self.request.HTTPMethod isEqualToString:@"POST"]) [parameters addEntriesFromDictionary:[NSJSONSerialization JSONObjectWithData:[self requestBody] options:0 error:nil]];
+    
+    NSArray<NSString *> *cursor = [parameters[@"cursor"] componentsSeparatedByString:@":"];
+    NSInteger folder = cursor != nil ? cursor[0].integerValue : [parameters[@"parent_id"] integerValue];
+    NSUInteger offset = cursor != nil ? cursor[1].integerValue : 0;
+    NSUInteger perPage = [parameters[@"per_page"] integerValue];
+    NSArray *contents = PIOStubWalkContents(folder);
+    NSUInteger length = MIN(perPage, contents.count - offset);
+    NSMutableDictionary *body = [@{@"status": @"OK", @"files": [contents subarrayWithRange:NSMakeRange(offset, length)]} mutableCopy];
+    
+    if (offset + length < contents.count) body[@"cursor"] = [NSString stringWithFormat:@"%zd:%tu", folder, offset + length];
+    
+    @synchronized (PIOStubWalkListedFolders) {
+        if (cursor == nil) [PIOStubWalkListedFolders addObject:@(folder)];
+        
+        PIOStubWalkMaximumConcurrentCount = MAX(PIOStubWalkMaximumConcurrentCount, ++PIOStubWalkConcurrentCount);
+    }
+    
+    // Answered a little later, so that requests overlap.
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.005 * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+        @synchronized (PIOStubWalkListedFolders) {
+            PIOStubWalkConcurrentCount--;
+        }
+        
+        [self respondWithStatusCode:200 JSONObject:body];
+    });
+}
+
+@end
+
+@interface PIOFolderWalkerTests : PIOStubServerTestCase
+
+@end
+
+@implementation PIOFolderWalkerTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubWalkListedFolders = [NSMutableArray array];
+    PIOStubWalkConcurrentCount = 0;
+    PIOStubWalkMaximumConcurrentCount = 0;
+    
+    [self useStubServer:PIOStubWalkServer.class];
+}
+
+- (NSArray<PIOFile *> *)walk:(PIOFolderWalker *)walker {
+    NSMutableArray<PIOFile *> *files = [NSMutableArray array];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Walk finished"];
+    
+    walker.filesCallback = ^(NSArray<PIOFile *> *page, NSUInteger depth) {
+        [files addObjectsFromArray:page];
+    };
+    
+    [walker startWithCompletion:^(NSError *error, uint64_t totalSize) {
+        XCTAssertNil(error);
+        XCTAssertEqual(totalSize, walker.totalSize);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+    
+    return files;
+}
+
+- (void)testWholeTreeIsWalkedInParallel {
+    PIOFolderWalker *walker = [[PIOFolderWalker alloc] initWithFolderID:0];
+    NSUInteger deepestFolderCount = PIOStubWalkBreadth * PIOStubWalkBreadth;
+    
+    walker.perPage = 7;
+    
+    NSArray<PIOFile *> *files = [self walk:walker];
+    
+    XCTAssertEqual(walker.folderCount, 1 + PIOStubWalkBreadth + deepestFolderCount);
+    XCTAssertEqual(walker.fileCount, deepestFolderCount * PIOStubWalkFileCount);
+    XCTAssertEqual(files.count, walker.fileCount + PIOStubWalkBreadth + deepestFolderCount);
+    XCTAssertEqual(walker.totalSize, deepestFolderCount * (PIOStubWalkFileCount * (PIOStubWalkFileCount + 1) / 2));
+    XCTAssertEqual(PIOStubWalkMaximumConcurrentCount, walker.maximumConcurrentRequests);
+}
+
+- (void)testFilterOnlyCountsMatchingFiles {
+    PIOFolderWalker *walker = [[PIOFolderWalker alloc] initWithFolderID:0];
+    
+    walker.filter = ^BOOL(PIOFile *file) {
+        return [file.contentType hasPrefix:@"video/"];
+    };
+    
+    NSArray<PIOFile *> *files = [self walk:walker];
+    
+    XCTAssertEqual(walker.folderCount, 1 + PIOStubWalkBreadth + PIOStubWalkBreadth * PIOStubWalkBreadth, @"Folders should be walked into even if they don't pass.");
+    XCTAssertEqual(files.count, PIOStubWalkBreadth * PIOStubWalkBreadth * PIOStubWalkFileCount / 2);
+    XCTAssertEqual([files filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"NOT contentType BEGINSWITH 'video/'"]].count, 0);
+}
+
+- (void)testDepthIsLimited {
+    PIOFolderWalker *walker = [[PIOFolderWalker alloc] initWithFolderID:0];
+    
+    walker.maximumDepth = 2;
+    
+    [self walk:walker];
+    
+    XCTAssertEqual(walker.folderCount, 1 + PIOStubWalkBreadth);
+    XCTAssertEqual(walker.fileCount, 0);
+}
+
+- (void)testDepthFirstOrder {
+    PIOFolderWalker *walker = [[PIOFolderWalker alloc] initWithFolderID:0];
+    
+    walker.order = PIOFolderWalkOrderDepthFirst;
+    walker.maximumConcurrentRequests = 1;
+    
+    [self walk:walker];
+    
+    XCTAssertEqualObjects([PIOStubWalkListedFolders subarrayWithRange:NSMakeRange(0, 4)], (@[@0, @1, @101, @102]));
+    XCTAssertEqualObjects(PIOStubWalkListedFolders[1 + PIOStubWalkBreadth + 1], @2);
+}
+
+- (void)testBreadthFirstOrder {
+    PIOFolderWalker *walker = [[PIOFolderWalker alloc] initWithFolderID:0];
+    
+    walker.maximumConcurrentRequests = 1;
+    
+    [self walk:walker];
+    
+    XCTAssertEqualObjects([PIOStubWalkListedFolders subarrayWithRange:NSMakeRange(0, 3)], (@[@0, @1, @2]));
+    XCTAssertEqualObjects(PIOStubWalkListedFolders[1 + PIOStubWalkBreadth], @101);
+}
+
+@end
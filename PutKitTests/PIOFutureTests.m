@@ -0,0 +1,268 @@
+//
+//  PIOFutureTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSTimeInterval const PIOStubFutureDelay = 0.3;
+
+static NSLock *PIOStubFutureLock;
+static NSUInteger PIOStubFutureConcurrentCount;
+static NSUInteger PIOStubFutureMaximumConcurrentCount;
+static NSUInteger PIOStubFutureCancelledCount; // Requests that were stopped before they were answered.
+
+/**
+ A stand-in for the file endpoints of @b api.put.io that answers every request after `PIOStubFutureDelay` seconds, except for file @b 404, which is missing and answered straight away.
+ */
+@interface PIOStubFutureServer : PIOStubServer
+
+@end
+
+@implementation PIOStubFutureServer {
+    BOOL _done;
+}
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path hasPrefix:@"/v2/files/"];
+}
+
+- (void)startLoading {
+    NSArray<NSString *> *components = self.request.URL.pathComponents; // "/", "v2", "files", identifier, ...
+    NSInteger identifier = components[3].integerValue;
+    NSString *resource = components.count > 4 ? components[4] : nil;
+    NSInteger statusCode = 200;
+    NSDictionary *body;
+    
+    if (identifier == 404) {
+        statusCode = 404;
+        body = @{@"status": @"ERROR", @"error_type": @"NotFound", @"error_message": @"File not found", @"status_code": @404};
+    } else if ([resource isEqualToString:@"subtitles"]) {
+        body = @{@"status": @"OK", @"subtitles": @[@{@"name": @"English", @"key": @"abc", @"language": @"eng", @"source": @"opensubtitles"}]};
+    } else if ([resource isEqualToString:@"mp4"]) {
+        body = @{@"status": @"OK", @"mp4": @{@"status": @"COMPLETED", @"percent_done": @100, @"size": @1}};
+    } else {
+        body = @{@"status": @"OK", @"file": PIOStubFile(identifier, @{@"name": @"Movie.mkv"})};
+    }
+    
+    [PIOStubFutureLock lock];
+    PIOStubFutureMaximumConcurrentCount = MAX(PIOStubFutureMaximumConcurrentCount, ++PIOStubFutureConcurrentCount);
+    [PIOStubFutureLock unlock];
+    
+    NSTimeInterval delay = statusCode == 200 ? PIOStubFutureDelay : 0;
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+        [PIOStubFutureLock lock];
+        BOOL stopped = self->_done;
+        self->_done = YES;
+        if (!stopped) PIOStubFutureConcurrentCount--;
+        [PIOStubFutureLock unlock];
+        
+        if (stopped) return;
+        
+        [self respondWithStatusCode:statusCode JSONObject:body];
+    });
+}
+
+- (void)stopLoading {
+    [PIOStubFutureLock lock];
+    
+    if (!_done) {
+        _done = YES;
+        PIOStubFutureConcurrentCount--;
+        PIOStubFutureCancelledCount++;
+    }
+    
+    [PIOStubFutureLock unlock];
+}
+
+@end
+
+@interface PIOFutureTests : PIOStubServerTestCase
+
+@end
+
+@implementation PIOFutureTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubFutureLock = [NSLock new];
+    PIOStubFutureConcurrentCount = 0;
+    PIOStubFutureMaximumConcurrentCount = 0;
+    PIOStubFutureCancelledCount = 0;
+    
+    [self useStubServer:PIOStubFutureServer.class];
+}
+
+- (void)waitFor:(NSTimeInterval)interval {
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:interval]];
+}
+
+- (NSUInteger)cancelledCount {
+    [PIOStubFutureLock lock];
+    NSUInteger count = PIOStubFutureCancelledCount;
+    [PIOStubFutureLock unlock];
+    return count;
+}
+
+/**
+ A future that is only finished, with the specified value, after a delay.
+ */
+- (PIOFuture *)futureWithValue:(id)value afterDelay:(NSTimeInterval)delay {
+    return [[PIOFuture alloc] initWithTaskBlock:^NSURLSessionTask *(void (^resolve)(id, NSError *)) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+            resolve(value, nil);
+        });
+        return nil;
+    }];
+}
+
+- (void)testFanOutRunsConcurrently {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Everything fetched"];
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    
+    [[PIOFuture all:@[[PIOAPI futureForFileWithID:1], [PIOAPI futureForSubtitlesOfFileWithID:1], [PIOAPI futureForMP4ConversionStatusOfFileWithID:1]]] getValueWithCompletionHandler:^(NSArray *values, NSError *error) {
+        PIOFile *file = values[0];
+        NSArray<PIOSubtitle *> *subtitles = values[1];
+        PIOMP4Conversion *conversion = values[2];
+        
+        XCTAssertNil(error);
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertEqualObjects(file.name, @"Movie.mkv");
+        XCTAssertEqual(subtitles.count, 1);
+        XCTAssertEqualObjects(conversion.status, PIOMP4StatusCompleted);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual(PIOStubFutureMaximumConcurrentCount, 3);
+    XCTAssertLessThan(CFAbsoluteTimeGetCurrent() - start, PIOStubFutureDelay * 2, @"The requests should overlap rather than run one after another.");
+}
+
+- (void)testFailureCancelsTheOthers {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Failed"];
+    
+    [[PIOFuture all:@[[PIOAPI futureForFileWithID:1], [PIOAPI futureForFileWithID:404], [PIOAPI futureForSubtitlesOfFileWithID:1]]] getValueWithCompletionHandler:^(NSArray *values, NSError *error) {
+        XCTAssertNil(values);
+        XCTAssertEqual(error.code, 404);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [self waitFor:0.1];
+    
+    XCTAssertEqual([self cancelledCount], 2);
+}
+
+- (void)testTimeoutCancelsTheRequest {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Timed out"];
+    PIOFuture<PIOFile *> *request = [PIOAPI futureForFileWithID:1];
+    
+    [[request timeoutAfter:PIOStubFutureDelay / 4] getValueWithCompletionHandler:^(PIOFile *file, NSError *error) {
+        XCTAssertNil(file);
+        XCTAssertEqualObjects(error.domain, NSURLErrorDomain);
+        XCTAssertEqual(error.code, NSURLErrorTimedOut);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [self waitFor:0.1];
+    
+    XCTAssertTrue(request.isCancelled);
+    XCTAssertEqual([self cancelledCount], 1);
+}
+
+- (void)testRaceTakesTheFirstAndCancelsTheRest {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Raced"];
+    PIOFuture *slow = [self futureWithValue:@"slow" afterDelay:1];
+    PIOFuture *fast = [self futureWithValue:@"fast" afterDelay:0.05];
+    
+    [[PIOFuture race:@[slow, fast]] getValueWithCompletionHandler:^(id value, NSError *error) {
+        XCTAssertEqualObjects(value, @"fast");
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertTrue(slow.isCancelled);
+    XCTAssertFalse(fast.isCancelled);
+}
+
+- (void)testThenChainsAndCancellationReachesTheRunningRequest {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Chained"];
+    
+    [[[PIOAPI futureForFileWithID:1] then:^PIOFuture *(PIOFile *file) {
+        return [PIOAPI futureForSubtitlesOfFileWithID:file.identifier];
+    }] getValueWithCompletionHandler:^(NSArray<PIOSubtitle *> *subtitles, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(subtitles.firstObject.language, @"eng");
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTestExpectation *cancelledExpectation = [self expectationWithDescription:@"Cancelled"];
+    PIOFuture *chain = [[PIOAPI futureForFileWithID:1] then:^PIOFuture *(PIOFile *file) {
+        return [PIOAPI futureForSubtitlesOfFileWithID:file.identifier];
+    }];
+    
+    [chain getValueWithCompletionHandler:^(id value, NSError *error) {
+        XCTAssertEqual(error.code, NSURLErrorCancelled);
+        [cancelledExpectation fulfill];
+    }];
+    
+    // Once the first request has finished, cancelling the chain has to reach the second one.
+    [self waitFor:PIOStubFutureDelay * 1.5];
+    [chain cancel];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [self waitFor:0.1];
+    
+    XCTAssertEqual([self cancelledCount], 1);
+}
+
+- (void)testFinishedFutureStillCallsBack {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Called back"];
+    PIOFuture<NSString *> *future = [[PIOFuture futureWithValue:@"value"] map:^id(NSString *value) {
+        return value.uppercaseString;
+    }];
+    
+    [future getValueWithCompletionHandler:^(NSString *value, NSError *error) {
+        XCTAssertEqualObjects(value, @"VALUE");
+        XCTAssertTrue([NSThread isMainThread]);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    [future cancel];
+    
+    XCTAssertFalse(future.isCancelled, @"A future that has finished can't be cancelled.");
+    XCTAssertEqualObjects(future.value, @"VALUE");
+}
+
+@end
@@ -0,0 +1,349 @@
+//
+//  PIOJSONStreamParserTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+#import "PIOJSONStreamParser.h"
+#import "PIOModelStream.h"
+#import "PIOObjectProtocol.h"
+
+static NSUInteger const PIOStreamFileCount = 2000;
+static NSUInteger const PIOStreamTransferCount = 500;
+static NSUInteger const PIOStreamChunkSize = 16 * 1024;
+
+static NSInteger PIOStubStreamStatusCode; // The status code the stub server responds with.
+
+static NSData *PIOStreamFilesResponse(NSUInteger count) {
+    NSMutableArray *files = [NSMutableArray arrayWithCapacity:count];
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        [files addObject:PIOStubFile(i + 1, @{@"name": [NSString stringWithFormat:@"Épisode %tu \"final\".mkv", i],
+                                              @"screenshot": i % 2 ? [NSNull null] : @"https://put.io/screenshot.jpg",
+                                              @"size": @(i * 1024 * 1024),
+                                              @"crc32": @"7d0f2b9c",
+                                              @"is_mp4_available": @(i % 3 == 0),
+                                              @"video_metadata": @{@"codec": @"h264", @"streams": @[@1, @2, @{@"language": @"en"}]},
+                                              @"created_at": @"2018-02-20T12:34:56"})];
+    }
+    
+    NSDictionary *body = @{@"status": @"OK",
+                           @"parent": PIOStubFile(0, @{@"name": @"Your Files", @"content_type": @"application/x-directory", @"size": @0}),
+                           @"files": files,
+                           @"cursor": @"next-page"};
+    
+    return [NSJSONSerialization dataWithJSONObject:body options:0 error:nil];
+}
+
+static NSData *PIOStreamTransfersResponse(NSUInteger count) {
+    NSMutableArray *transfers = [NSMutableArray arrayWithCapacity:count];
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        [transfers addObject:@{@"id": @(i + 1),
+                               @"name": [NSString stringWithFormat:@"Transfer %tu", i],
+                               @"created_at": @"2018-02-20T12:34:56",
+                               @"downloaded": @(i * 100),
+                               @"percent_done": @(i % 100),
+                               @"status": PIOTransferStatusDownloading,
+                               @"status_message": @"↓ 1.2 MB/s",
+                               @"error_message": [NSNull null]}];
+    }
+    
+    return [NSJSONSerialization dataWithJSONObject:@{@"status": @"OK", @"transfers": transfers} options:0 error:nil];
+}
+
+/**
+ Builds the same tree `NSJSONSerialization` would from the events of a `PIOJSONStreamParser`.
+ */
+@interface PIOStreamTreeBuilder : NSObject <PIOJSONStreamParserDelegate>
+
+@property (strong, nonatomic) NSMutableArray *containers;
+@property (strong, nonatomic) NSMutableArray *keys;
+@property (strong, nonatomic) id root;
+
+@end
+
+@implementation PIOStreamTreeBuilder
+
+- (instancetype)init {
+    self = [super init];
+    
+    if (self) {
+        _containers = [NSMutableArray array];
+        _keys = [NSMutableArray array];
+    }
+    
+    return self;
+}
+
+- (void)addValue:(id)value {
+    id container = self.containers.lastObject;
+    
+    if (container == nil) {
+        self.root = value;
+    } else if ([container isKindOfClass:NSMutableArray.class]) {
+        [container addObject:value];
+    } else {
+        [container setObject:value forKey:self.keys.lastObject];
+    }
+}
+
+- (void)parserDidStartObject:(PIOJSONStreamParser *)parser {
+    [self.containers addObject:[NSMutableDictionary dictionary]];
+    [self.keys addObject:[NSNull null]];
+}
+
+- (void)parserDidStartArray:(PIOJSONStreamParser *)parser {
+    [self.containers addObject:[NSMutableArray array]];
+    [self.keys addObject:[NSNull null]];
+}
+
+- (void)parserDidEndObject:(PIOJSONStreamParser *)parser {
+    id container = self.containers.lastObject;
+    
+    [self.containers removeLastObject];
+    [self.keys removeLastObject];
+    [self addValue:container];
+}
+
+- (void)parserDidEndArray:(PIOJSONStreamParser *)parser {
+    [self parserDidEndObject:parser];
+}
+
+- (void)parser:(PIOJSONStreamParser *)parser didParseKey:(NSString *)key {
+    [self.keys replaceObjectAtIndex:self.keys.count - 1 withObject:key];
+}
+
+- (void)parser:(PIOJSONStreamParser *)parser didParseValue:(id)value {
+    [self addValue:value];
+}
+
+@end
+
+/**
+ A stand-in for the list endpoints of @b api.put.io that sends its responses a piece at a time, with a pause between pieces.
+ */
+@interface PIOStubStreamServer : PIOStubServer
+
+@end
+
+@implementation PIOStubStreamServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && ([request.URL.path isEqualToString:@"/v2/files/list"] || [request.URL.path isEqualToString:@"/v2/transfers/list"]);
+}
+
+- (void)startLoading {
+    NSInteger statusCode = PIOStubStreamStatusCode;
+    NSData *body;
+    
+    if (statusCode >= 400) {
+        body = [NSJSONSerialization dataWithJSONObject:@{@"status": @"ERROR", @"error_type": @"NotFound", @"error_message": @"Folder not found", @"status_code": @(statusCode)} options:0 error:nil];
+    } else if ([self.request.URL.path isEqualToString:@"/v2/files/list"]) {
+        body = PIOStreamFilesResponse(PIOStreamFileCount);
+    } else {
+        body = PIOStreamTransfersResponse(PIOStreamTransferCount);
+    }
+    
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:statusCode HTTPVersion:@"HTTP/1.1" headerFields:@{@"Content-Type": @"application/json"}];
+    
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    
+    for (NSUInteger offset = 0; offset < body.length; offset += PIOStreamChunkSize) {
+        [self.client URLProtocol:self didLoadData:[body subdataWithRange:NSMakeRange(offset, MIN(PIOStreamChunkSize, body.length - offset))]];
+        [NSThread sleepForTimeInterval:0.01];
+    }
+    
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+@end
+
+@interface PIOJSONStreamParserTests : PIOStubServerTestCase
+
+@end
+
+@implementation PIOJSONStreamParserTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubStreamStatusCode = 200;
+    
+    [self useStubServer:PIOStubStreamServer.class];
+}
+
+- (id)parseData:(NSData *)data inPiecesOfLength:(NSUInteger)length error:(NSError **)error {
+    PIOStreamTreeBuilder *builder = [PIOStreamTreeBuilder new];
+    PIOJSONStreamParser *parser = [PIOJSONStreamParser new];
+    
+    parser.delegate = builder;
+    
+    for (NSUInteger offset = 0; offset < data.length; offset += length) {
+        if (![parser parseData:[data subdataWithRange:NSMakeRange(offset, MIN(length, data.length - offset))] error:error]) return nil;
+    }
+    
+    return [parser finishWithError:error] ? builder.root : nil;
+}
+
+- (void)testMatchesJSONSerializationWhereverTheDocumentIsSplit {
+    NSString *document = @"{\"name\": \"Caf\\u00e9 \\\"Noir\\\" \\ud83d\\ude00 😀 é\\n\\t\\/\", \"numbers\": [0, -1, 42, -1.5e3, 3.25, 9007199254740993, 1E2], "
+                         @"\"flags\": [true, false, null], \"nested\": {\"empty\": {}, \"list\": [[], [{}]], \"\": \"\"}, \"last\": -0.5}";
+    NSData *data = [document dataUsingEncoding:NSUTF8StringEncoding];
+    id expected = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+    
+    XCTAssertNotNil(expected);
+    
+    for (NSUInteger length = 1; length <= data.length; length++) {
+        NSError *error;
+        
+        XCTAssertEqualObjects([self parseData:data inPiecesOfLength:length error:&error], expected, @"Pieces of %tu bytes", length);
+        XCTAssertNil(error);
+    }
+    
+    XCTAssertEqualObjects([self parseData:[@" 12 " dataUsingEncoding:NSUTF8StringEncoding] inPiecesOfLength:1 error:nil], @12);
+    XCTAssertEqualObjects([self parseData:[@"12" dataUsingEncoding:NSUTF8StringEncoding] inPiecesOfLength:1 error:nil], @12, @"A number can only end with the document.");
+}
+
+- (void)testRejectsInvalidDocuments {
+    for (NSString *document in @[@"{\"a\":}", @"[1,]", @"{\"a\" 1}", @"{1: 2}", @"\"unterminated", @"[1] 2", @"tru", @"nul", @"{\"a\":1", @"[1 2]", @"01x", @"\"\\x\"", @"]", @""]) {
+        NSError *error;
+        
+        for (NSUInteger length = 1; length <= MAX(document.length, 1); length++) {
+            error = nil;
+            XCTAssertNil([self parseData:[document dataUsingEncoding:NSUTF8StringEncoding] inPiecesOfLength:length error:&error], @"%@", document);
+            XCTAssertEqualObjects(error.domain, NSCocoaErrorDomain, @"%@", document);
+        }
+    }
+}
+
+- (void)testFilesAreHandedOverWhileTheListDownloads {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Listing finished"];
+    NSMutableArray<PIOFile *> *files = [NSMutableArray array];
+    __block NSUInteger callbackCount = 0;
+    
+    [[PIOAPI streamFilesInFolderWithID:0 perPage:PIOStreamFileCount filesCallback:^(NSArray<PIOFile *> *page) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertGreaterThan(page.count, 0);
+        
+        callbackCount++;
+        [files addObjectsFromArray:page];
+    } completion:^(NSError *error, PIOFile *folder, NSString *cursor) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(folder.name, @"Your Files");
+        XCTAssertEqualObjects(cursor, @"next-page");
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    
+    XCTAssertGreaterThan(callbackCount, 1, @"Files should arrive in more than one go.");
+    XCTAssertEqual(files.count, PIOStreamFileCount);
+    
+    NSArray *dictionaries = [[NSJSONSerialization JSONObjectWithData:PIOStreamFilesResponse(PIOStreamFileCount) options:0 error:nil] objectForKey:@"files"];
+    
+    [files enumerateObjectsUsingBlock:^(PIOFile *file, NSUInteger index, BOOL *stop) {
+        PIOFile *expected = [(id<PIOObjectProtocol>)[PIOFile alloc] initFromDictionary:dictionaries[index]];
+        
+        XCTAssertEqualObjects(file.name, expected.name);
+        XCTAssertEqual(file.identifier, expected.identifier);
+        XCTAssertEqual(file.size, expected.size);
+        XCTAssertEqual(file.isMP4Available, expected.isMP4Available);
+        XCTAssertEqualObjects(file.screenshotURL, expected.screenshotURL);
+        XCTAssertEqualObjects(file.dateOfCreation, expected.dateOfCreation);
+    }];
+}
+
+- (void)testTransfersAreStreamed {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Listing finished"];
+    NSMutableArray<PIOTransfer *> *transfers = [NSMutableArray array];
+    
+    [[PIOAPI streamActiveTransfersWithTransfersCallback:^(NSArray<PIOTransfer *> *page) {
+        [transfers addObjectsFromArray:page];
+    } completion:^(NSError *error) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    
+    XCTAssertEqual(transfers.count, PIOStreamTransferCount);
+    XCTAssertEqualObjects(transfers.lastObject.name, @"Transfer 499");
+    XCTAssertEqual(transfers.lastObject.totalDownloaded, 49900);
+    XCTAssertNil(transfers.lastObject.error);
+}
+
+- (void)testErrorResponsesAreDecoded {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Listing failed"];
+    
+    PIOStubStreamStatusCode = 404;
+    
+    [[PIOAPI streamFilesInFolderWithID:42 perPage:100 filesCallback:^(NSArray<PIOFile *> *files) {
+        XCTFail(@"An error response has no files.");
+    } completion:^(NSError *error, PIOFile *folder, NSString *cursor) {
+        XCTAssertEqual(error.code, 404);
+        XCTAssertEqualObjects(error.localizedDescription, @"Folder not found");
+        XCTAssertNil(folder);
+        XCTAssertNil(cursor);
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testTreeDecodePerformance {
+    NSData *data = PIOStreamFilesResponse(20000);
+    
+    [self measureBlock:^{
+        @autoreleasepool {
+            NSDictionary *responseDictionary = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+            
+            for (NSDictionary *dictionary in [responseDictionary objectForKey:@"files"]) {
+                (void)[(id<PIOObjectProtocol>)[PIOFile alloc] initFromDictionary:dictionary];
+            }
+        }
+    }];
+}
+
+- (void)testStreamingDecodePerformance {
+    NSData *data = PIOStreamFilesResponse(20000);
+    NSURLSession *session = [NSURLSession sharedSession];
+    NSURLSessionDataTask *task = [session dataTaskWithURL:[NSURL URLWithString:@"https://api.put.io/v2/files/list"]]; // Never resumed; only passed to the delegate methods.
+    
+    [self measureBlock:^{
+        @autoreleasepool {
+            PIOModelStream *stream = [[PIOModelStream alloc] initWithModelClass:PIOFile.class arrayKey:@"files" modelsCallback:^(NSArray *models) {} completion:^(NSError *error, NSDictionary *responseDictionary) {}];
+            
+            for (NSUInteger offset = 0; offset < data.length; offset += PIOStreamChunkSize) {
+                [stream URLSession:session dataTask:task didReceiveData:[data subdataWithRange:NSMakeRange(offset, MIN(PIOStreamChunkSize, data.length - offset))]];
+            }
+            
+            [stream URLSession:session task:task didCompleteWithError:nil];
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,224 @@
+//
+//  PIOMP4ConversionWatcherTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSMutableDictionary<NSNumber *, NSMutableDictionary *> *PIOStubConversions; // Conversions by file identifier.
+static NSMutableArray<NSString *> *PIOStubConversionRequests; // The method and path of every request, in order.
+static NSMutableArray<NSDate *> *PIOStubConversionRequestDates; // When each request arrived.
+static NSInteger PIOStubConversionStep; // How many percent each conversion moves on every time its status is fetched.
+
+/**
+ A stand-in for the MP4 endpoints of @b api.put.io, serving `PIOStubConversions`.
+ */
+@interface PIOStubConversionServer : PIOStubServer
+
+@end
+
+@implementation PIOStubConversionServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path hasSuffix:@"/mp4"];
+}
+
+- (void)startLoading {
+    NSString *path = self.request.URL.path;
+    NSNumber *fileIdentifier = @(path.stringByDeletingLastPathComponent.lastPathComponent.integerValue);
+    NSInteger statusCode = 200;
+    NSDictionary *body;
+    
+    @synchronized (PIOStubConversions) {
+        [PIOStubConversionRequests addObject:[NSString stringWithFormat:@"%@ %@", self.request.HTTPMethod, path]];
+        [PIOStubConversionRequestDates addObject:[NSDate date]];
+        
+        NSMutableDictionary *conversion = PIOStubConversions[fileIdentifier];
+        
+        if (conversion == nil) {
+            statusCode = 404;
+            body = @{@"status": @"ERROR", @"error_type": @"NotFound", @"error_message": @"File not found", @"status_code": @404};
+        } else if ([self.request.HTTPMethod isEqualToString:@"POST"]) {
+            conversion[@"status"] = PIOMP4StatusInQueue;
+            body = @{@"status": @"OK"};
+        } else {
+            body = @{@"status": @"OK", @"mp4": [conversion copy]};
+            
+            if ([conversion[@"status"] isEqualToString:PIOMP4StatusInQueue] || [conversion[@"status"] isEqualToString:PIOMP4StatusConverting]) {
+                NSInteger percentage = MIN([conversion[@"percent_done"] integerValue] + PIOStubConversionStep, 100);
+                
+                conversion[@"percent_done"] = @(percentage);
+                conversion[@"status"] = percentage == 0 ? PIOMP4StatusInQueue : percentage < 100 ? PIOMP4StatusConverting : PIOMP4StatusCompleted;
+            }
+        }
+    }
+    
+    [self respondWithStatusCode:statusCode JSONObject:body];
+}
+
+@end
+
+@interface PIOMP4ConversionWatcherTests : PIOStubServerTestCase
+
+@property (strong, nonatomic) PIOMP4ConversionWatcher *watcher;
+
+@end
+
+@implementation PIOMP4ConversionWatcherTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubConversions = [NSMutableDictionary dictionary];
+    PIOStubConversionRequests = [NSMutableArray array];
+    PIOStubConversionRequestDates = [NSMutableArray array];
+    PIOStubConversionStep = 25;
+    
+    [self useStubServer:PIOStubConversionServer.class];
+    
+    self.watcher = [PIOMP4ConversionWatcher new];
+    self.watcher.minimumPollInterval = 0.05;
+    self.watcher.maximumPollInterval = 0.4;
+    self.watcher.maximumRequestsPerMinute = 3000;
+}
+
+- (void)addFileWithID:(NSInteger)identifier status:(PIOMP4Status)status {
+    @synchronized (PIOStubConversions) {
+        PIOStubConversions[@(identifier)] = [@{@"status": status, @"percent_done": @0, @"size": @0} mutableCopy];
+    }
+}
+
+- (NSUInteger)requestCountForRequest:(NSString *)request {
+    @synchronized (PIOStubConversions) {
+        return [PIOStubConversionRequests indexesOfObjectsPassingTest:^BOOL(NSString *sentRequest, NSUInteger index, BOOL *stop) {
+            return [sentRequest isEqualToString:request];
+        }].count;
+    }
+}
+
+- (void)waitFor:(NSTimeInterval)interval {
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:interval]];
+}
+
+- (void)testSeasonConvertsWithinBudget {
+    NSMutableArray<NSNumber *> *fileIdentifiers = [NSMutableArray array];
+    NSCountedSet<NSNumber *> *completedIdentifiers = [NSCountedSet set];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Every conversion finished"];
+    
+    for (NSInteger identifier = 1; identifier <= 20; identifier++) {
+        [self addFileWithID:identifier status:PIOMP4StatusUnavailable];
+        [fileIdentifiers addObject:@(identifier)];
+    }
+    
+    expectation.expectedFulfillmentCount = fileIdentifiers.count;
+    
+    PIOMP4ConversionWatch *watch = [self.watcher watchFilesWithIDs:fileIdentifiers startConverting:YES progressCallback:nil completionCallback:^(NSInteger fileIdentifier, NSError *error, PIOMP4Conversion *conversion) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(conversion.status, PIOMP4StatusCompleted);
+        [completedIdentifiers addObject:@(fileIdentifier)];
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    
+    XCTAssertEqual(completedIdentifiers.count, fileIdentifiers.count);
+    XCTAssertEqual(watch.pendingFileIdentifiers.count, 0);
+    
+    for (NSNumber *fileIdentifier in fileIdentifiers) {
+        XCTAssertEqual([completedIdentifiers countForObject:fileIdentifier], 1);
+        XCTAssertEqual([self requestCountForRequest:[NSString stringWithFormat:@"POST /v2/files/%@/mp4", fileIdentifier]], 1);
+    }
+    
+    // 3000 requests a minute is one every 20 milliseconds, give or take the timer's leeway.
+    for (NSUInteger index = 1; index < PIOStubConversionRequestDates.count; index++) {
+        XCTAssertGreaterThan([PIOStubConversionRequestDates[index] timeIntervalSinceDate:PIOStubConversionRequestDates[index - 1]], 0.015);
+    }
+}
+
+- (void)testQueuedConversionBacksOff {
+    [self addFileWithID:1 status:PIOMP4StatusInQueue];
+    PIOStubConversionStep = 0;
+    
+    PIOMP4ConversionWatch *watch = [self.watcher watchFilesWithIDs:@[@1] startConverting:NO progressCallback:nil completionCallback:^(NSInteger fileIdentifier, NSError *error, PIOMP4Conversion *conversion) {
+        XCTFail(@"A queued conversion can't finish.");
+    }];
+    
+    [self waitFor:1.5];
+    [watch cancel];
+    
+    // Polling every 0.05 seconds would make 30 requests; backing off to 0.4 seconds makes about 7.
+    XCTAssertLessThan([self requestCountForRequest:@"GET /v2/files/1/mp4"], 10);
+    XCTAssertGreaterThanOrEqual([self requestCountForRequest:@"GET /v2/files/1/mp4"], 4);
+    
+    NSUInteger count = PIOStubConversionRequests.count;
+    [self waitFor:0.5];
+    
+    XCTAssertEqual(PIOStubConversionRequests.count, count, @"Polling should stop once nothing is being watched.");
+}
+
+- (void)testUnavailableAndMissingFilesFinish {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Both files finished"];
+    expectation.expectedFulfillmentCount = 2;
+    
+    [self addFileWithID:1 status:PIOMP4StatusUnavailable];
+    
+    [self.watcher watchFilesWithIDs:@[@1, @2] startConverting:NO progressCallback:nil completionCallback:^(NSInteger fileIdentifier, NSError *error, PIOMP4Conversion *conversion) {
+        if (fileIdentifier == 1) {
+            XCTAssertNil(error);
+            XCTAssertEqualObjects(conversion.status, PIOMP4StatusUnavailable);
+        } else {
+            XCTAssertNil(conversion);
+            XCTAssertEqual(error.code, 404);
+        }
+        
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual(PIOStubConversionRequests.count, 2);
+}
+
+- (void)testFileInSeveralWatchesIsPolledOnce {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Both watches finished"];
+    expectation.expectedFulfillmentCount = 2;
+    
+    [self addFileWithID:1 status:PIOMP4StatusInQueue];
+    PIOStubConversionStep = 50;
+    
+    for (NSUInteger index = 0; index < 2; index++) {
+        [self.watcher watchFilesWithIDs:@[@1] startConverting:NO progressCallback:nil completionCallback:^(NSInteger fileIdentifier, NSError *error, PIOMP4Conversion *conversion) {
+            XCTAssertEqualObjects(conversion.status, PIOMP4StatusCompleted);
+            [expectation fulfill];
+        }];
+    }
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual([self requestCountForRequest:@"GET /v2/files/1/mp4"], 3);
+}
+
+@end
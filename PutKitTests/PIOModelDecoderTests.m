@@ -0,0 +1,348 @@
+//
+//  PIOModelDecoderTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <malloc/malloc.h>
+#import <PutKit/PutKit.h>
+#import "PIOObjectProtocol.h"
+#import "PIODate.h"
+
+static NSUInteger const PIODecoderTransferCount = 100000;
+static NSUInteger const PIODecoderAllocationSampleCount = 10000;
+
+/**
+ A copy of `PIOTransfer` as it was decoded before models were decoded through a key table, to compare against.
+ */
+@interface PIOLegacyTransfer : NSObject
+
+@property (strong, nonatomic, readonly) NSString *name;
+@property (nonatomic, readonly) NSInteger fileIdentifier;
+@property (nonatomic, readonly) NSInteger parentIdentifier;
+@property (nonatomic, readonly) NSInteger identifier;
+@property (strong, nonatomic, nullable, readonly) NSString *source;
+@property (nonatomic, readonly) NSInteger subscriptionIdentifier;
+@property (strong, nonatomic, nullable, readonly) NSURL *callbackURL;
+@property (strong, nonatomic, readonly) NSDate *dateOfCreation;
+@property (strong, nonatomic, readonly) NSDate *dateFinished;
+@property (strong, nonatomic, nullable, readonly) NSError *error;
+@property (nonatomic, readonly, getter=isPrivate) BOOL private;
+@property (nonatomic, readonly) NSInteger size;
+@property (nonatomic, readonly) NSInteger totalUploaded;
+@property (nonatomic, readonly) NSInteger totalDownloaded;
+@property (nonatomic, readonly) double percentageDownloaded;
+@property (nonatomic, readonly) NSTimeInterval estimatedTimeRemaining;
+@property (nonatomic, readonly) double downloadSpeed;
+@property (nonatomic, readonly) double uploadSpeed;
+@property (nonatomic, readonly) NSUInteger peers;
+@property (nonatomic, readonly) NSUInteger peersLeaching;
+@property (nonatomic, readonly) NSUInteger peersGiving;
+@property (nonatomic, readonly) float seedToPeerRatio;
+@property (nonatomic, readonly) PIOTransferStatus status;
+@property (strong, nonatomic, readonly) NSString *statusMessage;
+@property (nonatomic, readonly) BOOL willExtract;
+@property (nonatomic, readonly) NSTimeInterval timeSeeding;
+@property (nonatomic, nullable, readonly) NSString *trackerMessage;
+
+@end
+
+@implementation PIOLegacyTransfer
+
+- (nullable instancetype)initFromDictionary:(NSDictionary * _Nonnull)dictionary {
+    self = [super init];
+    
+    if (self) {
+        _dateOfCreation = pk_date_from_string([dictionary objectForKey:@"created_at"]);
+        _seedToPeerRatio = [[dictionary objectForKey:@"current_ratio"] floatValue];
+        _downloadSpeed = [[dictionary objectForKey:@"down_speed"] doubleValue];
+        _totalDownloaded = [[dictionary objectForKey:@"downloaded"] integerValue];
+        _identifier = [[dictionary objectForKey:@"id"] integerValue];
+        _name = [dictionary objectForKey:@"name"];
+        _peers = [[dictionary objectForKey:@"peers_connected"] integerValue];
+        _peersLeaching = [[dictionary objectForKey:@"peers_getting_from_us"] integerValue];
+        _peersGiving = [[dictionary objectForKey:@"peers_sending_to_us"] integerValue];
+        _percentageDownloaded = [[dictionary objectForKey:@"percent_done"] doubleValue];
+        _parentIdentifier = [[dictionary objectForKey:@"save_parent_id"] integerValue];
+        _size = [[dictionary objectForKey:@"size"] integerValue];
+        _status = [dictionary objectForKey:@"status"];
+        _statusMessage = [dictionary objectForKey:@"status_message"];
+        _uploadSpeed = [[dictionary objectForKey:@"up_speed"] doubleValue];
+        _totalUploaded = [[dictionary objectForKey:@"uploaded"] doubleValue];
+        
+        if (_dateOfCreation != nil &&
+            !isnan(_seedToPeerRatio) &&
+            !isnan(_downloadSpeed) &&
+            !isnan(_totalDownloaded) &&
+            !isnan(_identifier) &&
+            _name != nil &&
+            !isnan(_peers) &&
+            !isnan(_peersLeaching) &&
+            !isnan(_peersGiving) &&
+            !isnan(_percentageDownloaded) &&
+            !isnan(_parentIdentifier) &&
+            !isnan(_size) &&
+            ![_status isEqualToString:PIOTransferStatusUnknown] &&
+            _statusMessage != nil &&
+            !isnan(_uploadSpeed) &&
+            !isnan(_totalUploaded))
+        {
+            NSString *callbackString = [dictionary objectForKey:@"callback_url"];
+            if ([callbackString isKindOfClass:NSString.class]) _callbackURL = [NSURL URLWithString:callbackString];
+            
+            NSString *errorMessage = [dictionary objectForKey:@"error_message"];
+            if ([errorMessage isKindOfClass:NSString.class]) _error = [NSError errorWithDomain:@"io.put.kit.error" code:-1 userInfo:@{NSLocalizedDescriptionKey: errorMessage}];
+            
+            id estimatedTimeRemaining = [dictionary objectForKey:@"estimated_time"];
+            if (estimatedTimeRemaining != [NSNull null]) _estimatedTimeRemaining = [estimatedTimeRemaining doubleValue];
+            
+            id fileIdentifier = [dictionary objectForKey:@"file_id"];
+            if (fileIdentifier != [NSNull null]) _fileIdentifier = [fileIdentifier integerValue];
+            
+            id source = [dictionary objectForKey:@"source"];
+            if ([source isKindOfClass:NSString.class]) _source = source;
+            
+            id subscriptionIdentifier = [dictionary objectForKey:@"subscription_id"];
+            if (subscriptionIdentifier != [NSNull null]) _subscriptionIdentifier = [subscriptionIdentifier integerValue];
+            
+            NSString *trackerMessage = [dictionary objectForKey:@"tracker_message"];
+            if ([trackerMessage isKindOfClass:NSString.class]) _trackerMessage = trackerMessage;
+            
+            NSString *dateFinishedString = [dictionary objectForKey:@"finished_at"];
+            if ([dateFinishedString isKindOfClass:NSString.class]) _dateFinished = pk_date_from_string(dateFinishedString);
+            
+            _willExtract = [[dictionary objectForKey:@"extract"] boolValue];
+            _private = [[dictionary objectForKey:@"is_private"] boolValue];
+            
+            id timeSeeding = [dictionary objectForKey:@"seconds_seeding"];
+            if (timeSeeding != [NSNull null]) _timeSeeding = [timeSeeding doubleValue];
+            
+            return self;
+        }
+    }
+    
+    return nil;
+}
+
+@end
+
+static NSArray<NSDictionary *> *PIODecoderTransferDictionaries(void) {
+    static NSArray<NSDictionary *> *dictionaries;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSArray<PIOTransferStatus> *statuses = @[PIOTransferStatusDownloading, PIOTransferStatusSeeding, PIOTransferStatusCompleted, PIOTransferStatusError];
+        NSMutableArray *transfers = [NSMutableArray arrayWithCapacity:PIODecoderTransferCount];
+        
+        for (NSUInteger i = 0; i < PIODecoderTransferCount; i++) {
+            PIOTransferStatus status = statuses[i % statuses.count];
+            
+            [transfers addObject:@{@"id": @(i),
+                                   @"name": [NSString stringWithFormat:@"Transfer %tu", i],
+                                   @"created_at": @"2018-02-20T12:34:56",
+                                   @"finished_at": i % 2 ? @"2018-02-21T08:00:00" : [NSNull null],
+                                   @"callback_url": i % 5 ? [NSNull null] : @"https://example.com/callback",
+                                   @"current_ratio": @(i % 7 / 2.0),
+                                   @"down_speed": @(i * 3),
+                                   @"up_speed": @(i % 11),
+                                   @"downloaded": @(i * 1024),
+                                   @"uploaded": @(i * 512),
+                                   @"peers_connected": @(i % 50),
+                                   @"peers_getting_from_us": @(i % 20),
+                                   @"peers_sending_to_us": @(i % 30),
+                                   @"percent_done": @(i % 101),
+                                   @"save_parent_id": @(i % 9),
+                                   @"size": @(i * 2048),
+                                   @"status": status,
+                                   @"status_message": @"↓ 1.2 MB/s",
+                                   @"error_message": [status isEqualToString:PIOTransferStatusError] ? @"Tracker is down" : [NSNull null],
+                                   @"estimated_time": i % 3 ? @(i % 3600) : [NSNull null],
+                                   @"file_id": i % 2 ? @(i + 1) : [NSNull null],
+                                   @"source": @"magnet:?xt=urn:btih:0000",
+                                   @"subscription_id": [NSNull null],
+                                   @"tracker_message": i % 4 ? [NSNull null] : @"Announce OK",
+                                   @"extract": @(i % 2 == 0),
+                                   @"is_private": @NO,
+                                   @"seconds_seeding": [status isEqualToString:PIOTransferStatusSeeding] ? @(i) : [NSNull null],
+                                   @"hash": @"0000000000000000000000000000000000000000",
+                                   @"type": @"TORRENT"}];
+        }
+        
+        dictionaries = transfers;
+    });
+    return dictionaries;
+}
+
+static PIOTransfer *PIODecodeTransfer(NSDictionary *dictionary) {
+    return [(id<PIOObjectProtocol>)[PIOTransfer alloc] initFromDictionary:dictionary];
+}
+
+static PIOFile *PIODecodeFile(NSDictionary *dictionary) {
+    return [(id<PIOObjectProtocol>)[PIOFile alloc] initFromDictionary:dictionary];
+}
+
+static size_t PIOBlocksInUse(void) {
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(NULL, &statistics);
+    return statistics.blocks_in_use;
+}
+
+@interface PIOModelDecoderTests : XCTestCase
+
+@end
+
+@implementation PIOModelDecoderTests
+
+- (void)testTransfersMatchLegacyInitializer {
+    NSArray<NSDictionary *> *dictionaries = [PIODecoderTransferDictionaries() subarrayWithRange:NSMakeRange(0, 1000)];
+    
+    for (NSDictionary *dictionary in dictionaries) {
+        PIOTransfer *transfer = PIODecodeTransfer(dictionary);
+        PIOLegacyTransfer *legacy = [[PIOLegacyTransfer alloc] initFromDictionary:dictionary];
+        
+        XCTAssertNotNil(transfer);
+        XCTAssertEqualObjects(transfer.name, legacy.name);
+        XCTAssertEqualObjects(transfer.status, legacy.status);
+        XCTAssertEqualObjects(transfer.statusMessage, legacy.statusMessage);
+        XCTAssertEqualObjects(transfer.source, legacy.source);
+        XCTAssertEqualObjects(transfer.callbackURL, legacy.callbackURL);
+        XCTAssertEqualObjects(transfer.dateOfCreation, legacy.dateOfCreation);
+        XCTAssertEqualObjects(transfer.dateFinished, legacy.dateFinished);
+        XCTAssertEqualObjects(transfer.error.localizedDescription, legacy.error.localizedDescription);
+        XCTAssertEqualObjects(transfer.trackerMessage, legacy.trackerMessage);
+        XCTAssertEqual(transfer.identifier, legacy.identifier);
+        XCTAssertEqual(transfer.fileIdentifier, legacy.fileIdentifier);
+        XCTAssertEqual(transfer.parentIdentifier, legacy.parentIdentifier);
+        XCTAssertEqual(transfer.subscriptionIdentifier, legacy.subscriptionIdentifier);
+        XCTAssertEqual(transfer.isPrivate, legacy.isPrivate);
+        XCTAssertEqual(transfer.willExtract, legacy.willExtract);
+        XCTAssertEqual(transfer.size, legacy.size);
+        XCTAssertEqual(transfer.totalUploaded, legacy.totalUploaded);
+        XCTAssertEqual(transfer.totalDownloaded, legacy.totalDownloaded);
+        XCTAssertEqual(transfer.percentageDownloaded, legacy.percentageDownloaded);
+        XCTAssertEqual(transfer.estimatedTimeRemaining, legacy.estimatedTimeRemaining);
+        XCTAssertEqual(transfer.downloadSpeed, legacy.downloadSpeed);
+        XCTAssertEqual(transfer.uploadSpeed, legacy.uploadSpeed);
+        XCTAssertEqual(transfer.peers, legacy.peers);
+        XCTAssertEqual(transfer.peersLeaching, legacy.peersLeaching);
+        XCTAssertEqual(transfer.peersGiving, legacy.peersGiving);
+        XCTAssertEqual(transfer.seedToPeerRatio, legacy.seedToPeerRatio);
+        XCTAssertEqual(transfer.timeSeeding, legacy.timeSeeding);
+    }
+}
+
+- (void)testRequiredFieldsAndTypesAreChecked {
+    NSMutableDictionary *dictionary = [PIODecoderTransferDictionaries().firstObject mutableCopy];
+    
+    dictionary[@"size"] = @"4096";
+    dictionary[@"downloaded"] = [NSNull null];
+    dictionary[@"source"] = @42;
+    
+    PIOTransfer *transfer = PIODecodeTransfer(dictionary);
+    
+    XCTAssertEqual(transfer.size, 4096, @"Numeric strings should be read as numbers.");
+    XCTAssertEqual(transfer.totalDownloaded, 0);
+    XCTAssertNil(transfer.source, @"Values of the wrong type should be left out.");
+    
+    [dictionary removeObjectForKey:@"name"];
+    XCTAssertNil(PIODecodeTransfer(dictionary));
+    
+    dictionary[@"name"] = @"Transfer";
+    dictionary[@"created_at"] = @"yesterday";
+    XCTAssertNil(PIODecodeTransfer(dictionary), @"A required value that can't be converted counts as missing.");
+    
+    NSMutableDictionary *file = [@{@"id": @7,
+                                   @"parent_id": [NSNull null],
+                                   @"name": @"Episode.mkv",
+                                   @"content_type": @"video/x-matroska",
+                                   @"icon": @"https://put.io/icon.png",
+                                   @"screenshot": @"https://put.io/screenshot.jpg",
+                                   @"size": @(1ULL << 40),
+                                   @"is_mp4_available": @YES,
+                                   @"created_at": @"2018-02-20T12:34:56"} mutableCopy];
+    
+    PIOFile *decoded = PIODecodeFile(file);
+    
+    XCTAssertEqual(decoded.identifier, 7);
+    XCTAssertEqual(decoded.parentIdentifier, 0);
+    XCTAssertEqual(decoded.size, 1ULL << 40);
+    XCTAssertTrue(decoded.isMP4Available);
+    XCTAssertFalse(decoded.isShared);
+    XCTAssertEqualObjects(decoded.screenshotURL, [NSURL URLWithString:@"https://put.io/screenshot.jpg"]);
+    XCTAssertNil(decoded.dateFirstAccessed);
+    
+    file[@"icon"] = [NSNull null];
+    XCTAssertNil(PIODecodeFile(file));
+}
+
+- (double)allocationsPerTransferDecodedWithBlock:(id (^)(NSDictionary *))decode {
+    NSArray<NSDictionary *> *dictionaries = [PIODecoderTransferDictionaries() subarrayWithRange:NSMakeRange(0, PIODecoderAllocationSampleCount)];
+    NSMutableArray *transfers = [NSMutableArray arrayWithCapacity:dictionaries.count];
+    size_t before, after;
+    
+    // Counted before the pool drains, so that autoreleased temporaries are counted too.
+    @autoreleasepool {
+        before = PIOBlocksInUse();
+        for (NSDictionary *dictionary in dictionaries) [transfers addObject:decode(dictionary)];
+        after = PIOBlocksInUse();
+    }
+    
+    return ((double)after - (double)before) / dictionaries.count;
+}
+
+- (void)testDecodingAllocatesNoMoreThanLegacyInitializer {
+    PIODecodeTransfer(PIODecoderTransferDictionaries().firstObject); // Builds the key table outside of the count.
+    
+    double legacyAllocations = [self allocationsPerTransferDecodedWithBlock:^id(NSDictionary *dictionary) {
+        return [[PIOLegacyTransfer alloc] initFromDictionary:dictionary];
+    }];
+    double allocations = [self allocationsPerTransferDecodedWithBlock:^id(NSDictionary *dictionary) {
+        return PIODecodeTransfer(dictionary);
+    }];
+    
+    NSLog(@"Allocations per transfer: before = %.2f; after = %.2f", legacyAllocations, allocations);
+    
+    XCTAssertLessThanOrEqual(allocations, legacyAllocations + 0.1);
+}
+
+- (void)testLegacyInitializerPerformance {
+    NSArray<NSDictionary *> *dictionaries = PIODecoderTransferDictionaries();
+    
+    [self measureBlock:^{
+        @autoreleasepool {
+            for (NSDictionary *dictionary in dictionaries) (void)[[PIOLegacyTransfer alloc] initFromDictionary:dictionary];
+        }
+    }];
+}
+
+- (void)testKeyTableDecodePerformance {
+    NSArray<NSDictionary *> *dictionaries = PIODecoderTransferDictionaries();
+    
+    [self measureBlock:^{
+        @autoreleasepool {
+            for (NSDictionary *dictionary in dictionaries) (void)PIODecodeTransfer(dictionary);
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,151 @@
+//
+//  PIOMultipartBodyStreamTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <XCTest/XCTest.h>
+#import <mach/mach.h>
+#import "PIOMultipartBodyStream.h"
+#import "PIOChecksum.h"
+
+static unsigned long long const PIOMultipartLargeFileSize = 4ULL * 1024 * 1024 * 1024;
+static NSUInteger const PIOMultipartReadBufferSize = 128 * 1024;
+static unsigned long long const PIOMultipartResidentGrowthLimit = 32 * 1024 * 1024;
+
+static unsigned long long pk_resident_size(void) {
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+    
+    return info.resident_size;
+}
+
+@interface PIOMultipartBodyStreamTests : XCTestCase
+
+@property (strong, nonatomic) NSURL *fileURL;
+
+@end
+
+@implementation PIOMultipartBodyStreamTests
+
+- (void)setUp {
+    [super setUp];
+    
+    self.fileURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:self.fileURL error:nil];
+    
+    [super tearDown];
+}
+
+- (NSData *)readStream:(NSInputStream *)stream {
+    NSMutableData *body = [NSMutableData data];
+    uint8_t buffer[7]; // Deliberately small and odd so reads straddle part boundaries.
+    NSInteger count;
+    
+    [stream open];
+    while ((count = [stream read:buffer maxLength:sizeof(buffer)]) > 0) [body appendBytes:buffer length:count];
+    [stream close];
+    
+    XCTAssertEqual(count, 0);
+    
+    return body;
+}
+
+- (void)testBodyFraming {
+    [@"hello world" writeToURL:self.fileURL atomically:YES encoding:NSUTF8StringEncoding error:nil];
+    
+    PIOMultipartBodyStream *stream = [PIOMultipartBodyStream new];
+    XCTAssertTrue([stream appendFileAtURL:self.fileURL name:@"file" fileName:@"hello.txt" mimeType:@"text/plain" error:nil]);
+    [stream appendFormFieldWithValue:@"0" name:@"parent_id"];
+    
+    NSString *boundary = [stream.contentType componentsSeparatedByString:@"boundary="].lastObject;
+    NSString *expected = [NSString stringWithFormat:@"--%1$@\r\nContent-Disposition: form-data; name=\"file\"; filename=\"hello.txt\"\r\nContent-Type: text/plain\r\n\r\nhello world\r\n--%1$@\r\nContent-Disposition: form-data; name=\"parent_id\"\r\n\r\n0\r\n--%1$@--\r\n", boundary];
+    
+    NSData *body = [self readStream:stream];
+    
+    XCTAssertEqualObjects([[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding], expected);
+    XCTAssertEqual(stream.contentLength, body.length);
+    
+    // A copy is what gets handed to `URLSession:task:needNewBodyStream:`, so it must replay the body from the start.
+    XCTAssertEqualObjects([self readStream:[stream copy]], body);
+}
+
+- (void)testFileChecksumIsComputedWhileReading {
+    NSData *data = [@"hello world" dataUsingEncoding:NSUTF8StringEncoding];
+    [data writeToURL:self.fileURL atomically:YES];
+    
+    PIOMultipartBodyStream *stream = [PIOMultipartBodyStream new];
+    XCTAssertTrue([stream appendFileAtURL:self.fileURL name:@"file" fileName:@"hello.txt" mimeType:@"text/plain" error:nil]);
+    
+    XCTAssertNil([stream checksumOfFileAtURL:self.fileURL]);
+    
+    // Only the copy is read, as happens when the request is retransmitted.
+    [self readStream:[stream copy]];
+    
+    XCTAssertEqualObjects([stream checksumOfFileAtURL:self.fileURL], @(pk_crc32(0, data.bytes, data.length)));
+}
+
+- (void)testMissingFileIsReported {
+    NSError *error;
+    PIOMultipartBodyStream *stream = [PIOMultipartBodyStream new];
+    
+    XCTAssertFalse([stream appendFileAtURL:self.fileURL name:@"file" fileName:@"missing" mimeType:@"application/octet-stream" error:&error]);
+    XCTAssertNotNil(error);
+}
+
+- (void)testLargeFileIsStreamedWithBoundedMemory {
+    // A sparse file takes up no disk space but still has to be read in full.
+    XCTAssertTrue([[NSFileManager defaultManager] createFileAtPath:self.fileURL.path contents:nil attributes:nil]);
+    NSFileHandle *handle = [NSFileHandle fileHandleForWritingToURL:self.fileURL error:nil];
+    [handle truncateFileAtOffset:PIOMultipartLargeFileSize];
+    [handle closeFile];
+    
+    PIOMultipartBodyStream *stream = [PIOMultipartBodyStream new];
+    XCTAssertTrue([stream appendFileAtURL:self.fileURL name:@"file" fileName:@"large.bin" mimeType:@"application/octet-stream" error:nil]);
+    [stream appendFormFieldWithValue:@"0" name:@"parent_id"];
+    
+    uint8_t *buffer = malloc(PIOMultipartReadBufferSize);
+    unsigned long long totalRead = 0;
+    unsigned long long baseline = pk_resident_size();
+    unsigned long long peak = baseline;
+    NSInteger count;
+    
+    [stream open];
+    while ((count = [stream read:buffer maxLength:PIOMultipartReadBufferSize]) > 0) {
+        totalRead += count;
+        if (totalRead % (64 * PIOMultipartReadBufferSize) < (unsigned long long)count) peak = MAX(peak, pk_resident_size());
+    }
+    [stream close];
+    free(buffer);
+    
+    XCTAssertEqual(count, 0);
+    XCTAssertEqual(totalRead, stream.contentLength);
+    XCTAssertGreaterThan(totalRead, PIOMultipartLargeFileSize);
+    XCTAssertLessThan(peak - baseline, PIOMultipartResidentGrowthLimit);
+}
+
+@end
@@ -0,0 +1,230 @@
+//
+//  PIORateLimiterTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSUInteger PIOStubLimitedRequestCount;
+
+/**
+ A stand-in for the file endpoints of @b api.put.io that answers every request straight away.
+ */
+@interface PIOStubLimitedServer : PIOStubServer
+
+@end
+
+@implementation PIOStubLimitedServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path hasPrefix:@"/v2/files/"];
+}
+
+- (void)startLoading {
+    @synchronized (PIOStubLimitedServer.class) {
+        PIOStubLimitedRequestCount++;
+    }
+    
+    NSDictionary *body = @{@"status": @"OK", @"file": PIOStubFile(1, @{@"name": @"Movie.mkv"})};
+    [self respondWithStatusCode:200 JSONObject:body];
+}
+
+@end
+
+@interface PIORateLimiterTests : PIOStubServerTestCase
+
+@property (strong, nonatomic) NSURLRequest *fileRequest;
+
+@end
+
+@implementation PIORateLimiterTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubLimitedRequestCount = 0;
+    
+    self.fileRequest = [NSURLRequest requestWithURL:[NSURL URLWithString:@"https://api.put.io/v2/files/1"]];
+}
+
+- (void)testEndpointClasses {
+    XCTAssertEqualObjects([PIORateLimiter endpointClassForRequest:self.fileRequest], PIOEndpointClassDefault);
+    XCTAssertEqualObjects([PIORateLimiter endpointClassForRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"https://api.put.io/v2/files/search/movie/page/1"]]], PIOEndpointClassSearch);
+    XCTAssertEqualObjects([PIORateLimiter endpointClassForRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"https://api.put.io/v2/files/list?parent_id=0"]]], PIOEndpointClassListing);
+    XCTAssertEqualObjects([PIORateLimiter endpointClassForRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"https://api.put.io/v2/files/list/continue"]]], PIOEndpointClassListing);
+    XCTAssertEqualObjects([PIORateLimiter endpointClassForRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"https://api.put.io/v2/transfers/list"]]], PIOEndpointClassListing);
+    
+    PIORateLimiter *limiter = [PIORateLimiter new];
+    
+    XCTAssertGreaterThan([limiter weightForEndpointClass:PIOEndpointClassSearch], [limiter weightForEndpointClass:PIOEndpointClassDefault]);
+}
+
+- (void)testBurstIsLetThroughAndTheRestIsSpreadOut {
+    PIORateLimiter *limiter = [[PIORateLimiter alloc] initWithRate:50 capacity:5];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Every request let through"];
+    __block NSUInteger admittedCount = 0;
+    NSDate *start = [NSDate date];
+    
+    expectation.expectedFulfillmentCount = 30;
+    
+    for (NSUInteger i = 0; i < 30; i++) {
+        [limiter waitForRequest:self.fileRequest caller:nil handler:^{
+            @synchronized (limiter) {
+                admittedCount++;
+            }
+            [expectation fulfill];
+        }];
+    }
+    
+    XCTAssertEqual(admittedCount, 5, @"The burst should be let through straight away.");
+    XCTAssertEqual(limiter.metrics.queueDepth, 25);
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    // 25 tokens at 50 a second.
+    XCTAssertGreaterThanOrEqual(-start.timeIntervalSinceNow, 0.45);
+    
+    PIORateLimiterMetrics *metrics = limiter.metrics;
+    
+    XCTAssertEqual(metrics.requestCount, 30);
+    XCTAssertEqual(metrics.delayedRequestCount, 25);
+    XCTAssertEqual(metrics.queueDepth, 0);
+    XCTAssertEqual(metrics.peakQueueDepth, 25);
+    XCTAssertGreaterThan(metrics.maximumWaitTime, 0.4);
+    XCTAssertGreaterThan(metrics.averageWaitTime, 0);
+}
+
+- (void)testWeightsAreCharged {
+    PIORateLimiter *limiter = [[PIORateLimiter alloc] initWithRate:1 capacity:5];
+    NSURLRequest *searchRequest = [NSURLRequest requestWithURL:[NSURL URLWithString:@"https://api.put.io/v2/files/search/movie/page/1"]];
+    __block NSUInteger admittedCount = 0;
+    
+    [limiter setWeight:5 forEndpointClass:PIOEndpointClassSearch];
+    
+    [limiter waitForRequest:searchRequest caller:nil handler:^{ admittedCount++; }];
+    [limiter waitForRequest:self.fileRequest caller:nil handler:^{ admittedCount++; }];
+    
+    XCTAssertEqual(admittedCount, 1, @"The search should have spent the whole bucket.");
+    XCTAssertEqual(limiter.metrics.queueDepth, 1);
+}
+
+- (void)testCallersAreServedFairly {
+    PIORateLimiter *limiter = [[PIORateLimiter alloc] initWithRate:100 capacity:1];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Every request let through"];
+    NSMutableArray<NSString *> *order = [NSMutableArray array];
+    
+    expectation.expectedFulfillmentCount = 22;
+    
+    for (NSUInteger i = 0; i < 20; i++) {
+        [limiter waitForRequest:self.fileRequest caller:@"batch" handler:^{
+            @synchronized (order) {
+                [order addObject:@"batch"];
+            }
+            [expectation fulfill];
+        }];
+    }
+    
+    XCTAssertEqualObjects(limiter.metrics.queueDepthByCaller, @{@"batch": @19});
+    
+    for (NSUInteger i = 0; i < 2; i++) {
+        [limiter waitForRequest:self.fileRequest caller:@"interactive" handler:^{
+            @synchronized (order) {
+                [order addObject:@"interactive"];
+            }
+            [expectation fulfill];
+        }];
+    }
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    // Queued in order, the interactive requests would be last; shared out fairly, they alternate with the batch.
+    XCTAssertLessThanOrEqual([order indexOfObject:@"interactive"], 2);
+    XCTAssertLessThanOrEqual([order indexOfObject:@"interactive" inRange:NSMakeRange(2, order.count - 2)], 4);
+}
+
+- (void)testCancelledWaitIsNeverLetThrough {
+    PIORateLimiter *limiter = [[PIORateLimiter alloc] initWithRate:20 capacity:1];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Last request let through"];
+    
+    [limiter waitForRequest:self.fileRequest caller:nil handler:^{}];
+    
+    id<NSObject> wait = [limiter waitForRequest:self.fileRequest caller:nil handler:^{
+        XCTFail(@"A cancelled wait shouldn't be let through.");
+    }];
+    
+    [limiter waitForRequest:self.fileRequest caller:nil handler:^{
+        [expectation fulfill];
+    }];
+    
+    [limiter cancelWait:wait];
+    
+    XCTAssertEqual(limiter.metrics.queueDepth, 1);
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+    
+    XCTAssertEqual(limiter.metrics.requestCount, 2);
+}
+
+- (void)testSessionWaitsForTheLimiter {
+    PIORateLimiter *limiter = [[PIORateLimiter alloc] initWithRate:20 capacity:2];
+    PIOConfiguration *configuration = [self configurationWithStubServers:@[PIOStubLimitedServer.class]];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Every file fetched"];
+    XCTestExpectation *cancelledExpectation = [self expectationWithDescription:@"Waiting request cancelled"];
+    
+    configuration.rateLimiter = limiter;
+    PIOAPI.configuration = configuration;
+    
+    expectation.expectedFulfillmentCount = 10;
+    
+    // Different files, so that the requests aren't shared.
+    for (NSUInteger i = 0; i < 10; i++) {
+        [[PIOAPI getFileForID:i + 1 callback:^(NSError *error, PIOFile *file) {
+            XCTAssertNil(error);
+            [expectation fulfill];
+        }] resume];
+    }
+    
+    NSURLSessionDataTask *task = [PIOAPI getFileForID:11 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertEqual(error.code, NSURLErrorCancelled);
+        [cancelledExpectation fulfill];
+    }];
+    
+    [task resume];
+    
+    XCTAssertEqual(task.state, NSURLSessionTaskStateRunning);
+    XCTAssertEqual(limiter.metrics.queueDepth, 9);
+    
+    [task cancel];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual(PIOStubLimitedRequestCount, 10, @"The cancelled request should never have been sent.");
+    XCTAssertEqual(limiter.metrics.requestCount, 10);
+    XCTAssertEqual(limiter.metrics.delayedRequestCount, 8);
+}
+
+@end
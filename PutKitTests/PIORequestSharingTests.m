@@ -0,0 +1,244 @@
+//
+//  PIORequestSharingTests
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSCountedSet<NSString *> *PIOStubSharingPaths; // The path of every request that was sent.
+static NSUInteger PIOStubSharingStoppedCount; // The number of requests that were cancelled before they were answered.
+static NSTimeInterval const PIOStubSharingDelay = 0.2;
+
+/**
+ A stand-in for the file endpoints of @b api.put.io that takes `PIOStubSharingDelay` seconds to answer, so that identical requests overlap.
+ */
+@interface PIOStubSharingServer : PIOStubServer
+
+@end
+
+@implementation PIOStubSharingServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path hasPrefix:@"/v2/files/"];
+}
+
+- (void)startLoading {
+    @synchronized (PIOStubSharingPaths) {
+        [PIOStubSharingPaths addObject:self.request.URL.path];
+    }
+    
+    [self performSelector:@selector(respond) withObject:nil afterDelay:PIOStubSharingDelay];
+}
+
+- (void)respond {
+    NSInteger identifier = self.request.URL.path.lastPathComponent.integerValue;
+    NSDictionary *body = @{@"status": @"OK", @"file": PIOStubFile(identifier, nil)};
+    [self respondWithStatusCode:200 JSONObject:body];
+}
+
+- (void)stopLoading {
+    [NSObject cancelPreviousPerformRequestsWithTarget:self];
+    
+    @synchronized (PIOStubSharingPaths) {
+        PIOStubSharingStoppedCount++;
+    }
+}
+
+@end
+
+@interface PIORequestSharingTests : PIOStubServerTestCase
+
+@end
+
+@implementation PIORequestSharingTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubSharingPaths = [NSCountedSet set];
+    PIOStubSharingStoppedCount = 0;
+    
+    [self useStubServer:PIOStubSharingServer.class];
+}
+
+- (NSUInteger)requestCountForPath:(NSString *)path {
+    @synchronized (PIOStubSharingPaths) {
+        return [PIOStubSharingPaths countForObject:path];
+    }
+}
+
+- (void)testIdenticalRequestsShareOneResponse {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Every file fetched"];
+    expectation.expectedFulfillmentCount = 6;
+    
+    for (NSUInteger i = 0; i < 5; i++) {
+        [[PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+            XCTAssertNil(error);
+            XCTAssertEqualObjects(file.name, @"1.mkv");
+            [expectation fulfill];
+        }] resume];
+    }
+    
+    [[PIOAPI getFileForID:2 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertEqualObjects(file.name, @"2.mkv");
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual([self requestCountForPath:@"/v2/files/1"], 1);
+    XCTAssertEqual([self requestCountForPath:@"/v2/files/2"], 1, @"Requests for another file are sent on their own.");
+}
+
+- (void)testIdenticalRequestsShareOneDecodedResult {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Every file fetched"];
+    NSHashTable<PIOFile *> *files = [NSHashTable hashTableWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality];
+    
+    expectation.expectedFulfillmentCount = 5;
+    
+    for (NSUInteger i = 0; i < 5; i++) {
+        [[PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+            XCTAssertNotNil(file);
+            [files addObject:file];
+            [expectation fulfill];
+        }] resume];
+    }
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual([self requestCountForPath:@"/v2/files/1"], 1);
+    XCTAssertEqual(files.count, 1, @"The response should be decoded once and the same file handed to every caller.");
+}
+
+- (void)testCancellingOneCallerLeavesTheOthers {
+    XCTestExpectation *cancelledExpectation = [self expectationWithDescription:@"First caller cancelled"];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Second caller fetched the file"];
+    
+    NSURLSessionDataTask *cancelledTask = [PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertEqual(error.code, NSURLErrorCancelled);
+        [cancelledExpectation fulfill];
+    }];
+    
+    NSURLSessionDataTask *task = [PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(file.name, @"1.mkv");
+        [expectation fulfill];
+    }];
+    
+    [cancelledTask resume];
+    [task resume];
+    [cancelledTask cancel];
+    
+    XCTAssertEqual(cancelledTask.state, NSURLSessionTaskStateCompleted);
+    XCTAssertNotEqual(task.state, NSURLSessionTaskStateCompleted);
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual([self requestCountForPath:@"/v2/files/1"], 1);
+    XCTAssertEqual(PIOStubSharingStoppedCount, 0);
+}
+
+- (void)testCancellingEveryCallerCancelsTheRequest {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Both callers cancelled"];
+    expectation.expectedFulfillmentCount = 2;
+    
+    NSMutableArray<NSURLSessionDataTask *> *tasks = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 2; i++) {
+        NSURLSessionDataTask *task = [PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+            XCTAssertEqual(error.code, NSURLErrorCancelled);
+            [expectation fulfill];
+        }];
+        
+        [task resume];
+        [tasks addObject:task];
+    }
+    
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:PIOStubSharingDelay / 2]];
+    
+    for (NSURLSessionDataTask *task in tasks) [task cancel];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    
+    XCTAssertEqual([self requestCountForPath:@"/v2/files/1"], 1);
+    XCTAssertEqual(PIOStubSharingStoppedCount, 1, @"The request should be cancelled once no one is waiting on it.");
+}
+
+- (void)testCallerThatResumesLateSendsTheRequestAgain {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"First caller fetched the file"];
+    __block BOOL lateCallerCalled = NO;
+    
+    NSURLSessionDataTask *lateTask = [PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertNil(error);
+        lateCallerCalled = YES;
+    }];
+    
+    [[PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertNil(error);
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertFalse(lateCallerCalled, @"A caller that never resumed their task isn't given the response.");
+    XCTAssertEqual(lateTask.state, NSURLSessionTaskStateSuspended);
+    
+    XCTestExpectation *lateExpectation = [self expectationWithDescription:@"Late caller fetched the file"];
+    
+    [[PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        [lateExpectation fulfill];
+    }] resume];
+    [lateTask resume];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    
+    XCTAssertTrue(lateCallerCalled);
+    XCTAssertEqual([self requestCountForPath:@"/v2/files/1"], 2, @"The late caller shares the second request.");
+}
+
+- (void)testSharingCanBeTurnedOff {
+    PIOConfiguration *configuration = PIOAPI.configuration;
+    configuration.sharesIdenticalRequests = NO;
+    PIOAPI.configuration = configuration;
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Every file fetched"];
+    expectation.expectedFulfillmentCount = 3;
+    
+    for (NSUInteger i = 0; i < 3; i++) {
+        [[PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+            XCTAssertNil(error);
+            [expectation fulfill];
+        }] resume];
+    }
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual([self requestCountForPath:@"/v2/files/1"], 3);
+}
+
+@end
@@ -0,0 +1,149 @@
+//
+//  PIOResponseDecodingTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <XCTest/XCTest.h>
+#import <objc/runtime.h>
+#import <PutKit/PutKit.h>
+#import "PIOError.h"
+
+static NSUInteger PIOParseCount = 0;
+
+@implementation NSJSONSerialization (PIOParseCounting)
+
++ (id)pio_countingJSONObjectWithData:(NSData *)data options:(NSJSONReadingOptions)options error:(NSError **)error {
+    PIOParseCount++;
+    return [self pio_countingJSONObjectWithData:data options:options error:error]; // Swizzled; calls the original implementation.
+}
+
+@end
+
+/**
+ The validation and decoding PutKit performed on every response before bodies were decoded once.
+ */
+static NSDictionary *PIOLegacyDecode(NSData *data, NSError **error) {
+    NSDictionary *validationDictionary = [NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingMutableContainers error:error];
+    if ([validationDictionary objectForKey:@"error_message"] != nil) return nil;
+    return [NSJSONSerialization JSONObjectWithData:data options:0 error:error];
+}
+
+@interface PIOResponseDecodingTests : XCTestCase
+
+@property (strong, nonatomic) NSData *listResponseData;
+
+@end
+
+@implementation PIOResponseDecodingTests
+
++ (void)setUp {
+    [super setUp];
+    
+    Method original = class_getClassMethod(NSJSONSerialization.class, @selector(JSONObjectWithData:options:error:));
+    Method counting = class_getClassMethod(NSJSONSerialization.class, @selector(pio_countingJSONObjectWithData:options:error:));
+    method_exchangeImplementations(original, counting);
+}
+
++ (void)tearDown {
+    Method original = class_getClassMethod(NSJSONSerialization.class, @selector(JSONObjectWithData:options:error:));
+    Method counting = class_getClassMethod(NSJSONSerialization.class, @selector(pio_countingJSONObjectWithData:options:error:));
+    method_exchangeImplementations(original, counting);
+    
+    [super tearDown];
+}
+
+- (void)setUp {
+    [super setUp];
+    
+    NSMutableArray *files = [NSMutableArray array];
+    
+    for (NSInteger i = 0; i < 5000; i++) {
+        [files addObject:@{@"id" : @(i),
+                           @"name" : [NSString stringWithFormat:@"Episode %zd.mkv", i],
+                           @"content_type" : @"video/x-matroska",
+                           @"icon" : @"https://api.put.io/images/file_types/video.png",
+                           @"size" : @(1024 * 1024 * 700),
+                           @"parent_id" : @0,
+                           @"crc32" : @"7d0f2b9c",
+                           @"created_at" : @"2018-02-20T12:34:56",
+                           @"first_accessed_at" : [NSNull null],
+                           @"is_mp4_available" : @NO,
+                           @"is_shared" : @NO}];
+    }
+    
+    self.listResponseData = [NSJSONSerialization dataWithJSONObject:@{@"status" : @"OK", @"files" : files} options:0 error:nil];
+}
+
+- (void)testResponseIsParsedOnce {
+    NSError *error;
+    
+    PIOParseCount = 0;
+    PIOLegacyDecode(self.listResponseData, &error);
+    NSUInteger legacyParseCount = PIOParseCount;
+    
+    PIOParseCount = 0;
+    NSDictionary *responseDictionary = pk_response_decode(self.listResponseData, nil, &error);
+    NSUInteger parseCount = PIOParseCount;
+    
+    NSLog(@"Parses per response: before = %tu; after = %tu", legacyParseCount, parseCount);
+    
+    XCTAssertNil(error);
+    XCTAssertEqual([[responseDictionary objectForKey:@"files"] count], 5000);
+    XCTAssertEqual(legacyParseCount, 2);
+    XCTAssertEqual(parseCount, 1);
+}
+
+- (void)testErrorEnvelopeIsDecoded {
+    NSData *data = [NSJSONSerialization dataWithJSONObject:@{@"error_message" : @"File not found", @"error_type" : @"NotFound", @"status_code" : @404} options:0 error:nil];
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:[NSURL URLWithString:@"https://api.put.io/v2/files/1"] statusCode:404 HTTPVersion:@"HTTP/1.1" headerFields:nil];
+    NSError *error;
+    
+    XCTAssertNil(pk_response_decode(data, response, &error));
+    XCTAssertEqual(error.code, 404);
+    XCTAssertEqualObjects(error.localizedDescription, @"File not found");
+}
+
+- (void)testHTTPStatusIsValidated {
+    NSData *data = [@"<html>Bad Gateway</html>" dataUsingEncoding:NSUTF8StringEncoding];
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:[NSURL URLWithString:@"https://api.put.io/v2/files/list"] statusCode:502 HTTPVersion:@"HTTP/1.1" headerFields:nil];
+    NSError *error;
+    
+    XCTAssertNil(pk_response_decode(data, response, &error));
+    XCTAssertEqual(error.code, 502);
+}
+
+- (void)testLegacyDecodePerformance {
+    [self measureBlock:^{
+        NSError *error;
+        PIOLegacyDecode(self.listResponseData, &error);
+    }];
+}
+
+- (void)testSinglePassDecodePerformance {
+    [self measureBlock:^{
+        NSError *error;
+        pk_response_decode(self.listResponseData, nil, &error);
+    }];
+}
+
+@end
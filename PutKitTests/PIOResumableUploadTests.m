@@ -0,0 +1,197 @@
+//
+//  PIOResumableUploadTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSUInteger const PIOResumableUploadFileSize = 1024 * 1024 + 123;
+static NSUInteger const PIOResumableUploadChunkSize = 64 * 1024;
+
+static NSMutableDictionary<NSString *, NSMutableData *> *PIOStubUploads;
+static NSUInteger PIOStubCreationCount;
+static NSUInteger PIOStubPatchCount;
+static NSUInteger PIOStubDisconnectInterval; // Every nth chunk is cut off halfway through. `0` never disconnects.
+
+/**
+ A stand-in for the tus endpoint of @b upload.put.io that keeps uploads in memory and drops connections on demand.
+ */
+@interface PIOStubUploadServer : PIOStubServer
+
+@end
+
+@implementation PIOStubUploadServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"upload.put.io"];
+}
+
+- (void)startLoading {
+    NSString *method = self.request.HTTPMethod;
+    NSString *identifier = self.request.URL.lastPathComponent;
+    
+    @synchronized (PIOStubUploads) {
+        NSMutableData *upload = PIOStubUploads[identifier];
+        
+        if ([method isEqualToString:@"POST"]) {
+            identifier = [NSUUID UUID].UUIDString;
+            PIOStubUploads[identifier] = [NSMutableData data];
+            PIOStubCreationCount++;
+            
+            [self respondWithStatusCode:201 headers:@{@"Location": [@"/files/" stringByAppendingString:identifier]} data:nil];
+        } else if (upload == nil) {
+            [self respondWithStatusCode:404 headers:nil data:nil];
+        } else if ([method isEqualToString:@"HEAD"]) {
+            [self respondWithStatusCode:200 headers:@{@"Upload-Offset": @(upload.length).stringValue} data:nil];
+        } else if ([method isEqualToString:@"PATCH"]) {
+            NSData *body = [self requestBody];
+            
+            if ([[self.request valueForHTTPHeaderField:@"Upload-Offset"] longLongValue] != (long long)upload.length) {
+                [self respondWithStatusCode:409 headers:nil data:nil];
+                return;
+            }
+            
+            PIOStubPatchCount++;
+            
+            if (PIOStubDisconnectInterval != 0 && PIOStubPatchCount % PIOStubDisconnectInterval == 0) {
+                [upload appendData:[body subdataWithRange:NSMakeRange(0, body.length / 2)]];
+                [self.client URLProtocol:self didFailWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:nil]];
+                return;
+            }
+            
+            [upload appendData:body];
+            [self respondWithStatusCode:204 headers:@{@"Upload-Offset": @(upload.length).stringValue} data:nil];
+        } else if ([method isEqualToString:@"DELETE"]) {
+            [PIOStubUploads removeObjectForKey:identifier];
+            [self respondWithStatusCode:204 headers:nil data:nil];
+        }
+    }
+}
+
+@end
+
+@interface PIOResumableUploadTests : PIOStubServerTestCase
+
+@property (strong, nonatomic) NSURL *fileURL;
+@property (strong, nonatomic) NSData *fileData;
+
+@end
+
+@implementation PIOResumableUploadTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubUploads = [NSMutableDictionary dictionary];
+    PIOStubCreationCount = 0;
+    PIOStubPatchCount = 0;
+    PIOStubDisconnectInterval = 0;
+    
+    [self useStubServer:PIOStubUploadServer.class];
+    
+    NSMutableData *fileData = [NSMutableData dataWithLength:PIOResumableUploadFileSize];
+    arc4random_buf(fileData.mutableBytes, fileData.length);
+    
+    self.fileData = fileData;
+    self.fileURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [self.fileData writeToURL:self.fileURL atomically:YES];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:self.fileURL error:nil];
+    
+    [super tearDown];
+}
+
+- (PIOResumableUpload *)pendingUploadWithIdentifier:(NSString *)identifier {
+    for (PIOResumableUpload *upload in PIOResumableUpload.pendingUploads) {
+        if ([upload.identifier isEqualToString:identifier]) return upload;
+    }
+    
+    return nil;
+}
+
+- (NSError *)resumeUpload:(PIOResumableUpload *)upload {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Upload finished"];
+    __block NSError *uploadError;
+    
+    [upload resumeWithCallback:^(NSError * _Nullable error) {
+        uploadError = error;
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:60 handler:nil];
+    
+    return uploadError;
+}
+
+- (void)testUploadSurvivesDisconnects {
+    PIOStubDisconnectInterval = 3;
+    
+    PIOResumableUpload *upload = [[PIOResumableUpload alloc] initWithFileAtURL:self.fileURL toFolderWithID:0 newFileName:nil];
+    upload.chunkSize = PIOResumableUploadChunkSize;
+    
+    __block int64_t lastBytesSent = 0;
+    upload.progressCallback = ^(int64_t bytesSent, int64_t totalBytes) {
+        XCTAssertEqual(totalBytes, (int64_t)PIOResumableUploadFileSize);
+        lastBytesSent = bytesSent;
+    };
+    
+    XCTAssertNil([self resumeUpload:upload]);
+    
+    XCTAssertEqual(PIOStubCreationCount, 1);
+    XCTAssertEqualObjects(PIOStubUploads.allValues.firstObject, self.fileData);
+    XCTAssertEqual(upload.uploadedBytes, (int64_t)PIOResumableUploadFileSize);
+    XCTAssertEqual(lastBytesSent, (int64_t)PIOResumableUploadFileSize);
+    XCTAssertNil([self pendingUploadWithIdentifier:upload.identifier], @"The journal should be removed once the upload finishes.");
+}
+
+- (void)testUploadResumesFromJournalAfterRestart {
+    PIOStubDisconnectInterval = 4;
+    
+    PIOResumableUpload *upload = [[PIOResumableUpload alloc] initWithFileAtURL:self.fileURL toFolderWithID:0 newFileName:@"renamed.bin"];
+    upload.chunkSize = PIOResumableUploadChunkSize;
+    upload.maximumRetryCount = 0;
+    
+    XCTAssertNotNil([self resumeUpload:upload]);
+    
+    // A fresh object built from the journal stands in for the upload after the application is relaunched.
+    PIOResumableUpload *restoredUpload = [self pendingUploadWithIdentifier:upload.identifier];
+    
+    XCTAssertNotNil(restoredUpload);
+    XCTAssertEqualObjects(restoredUpload.fileName, @"renamed.bin");
+    XCTAssertEqual(restoredUpload.uploadedBytes, (int64_t)(3 * PIOResumableUploadChunkSize));
+    
+    PIOStubDisconnectInterval = 0;
+    restoredUpload.chunkSize = PIOResumableUploadChunkSize;
+    
+    XCTAssertNil([self resumeUpload:restoredUpload]);
+    
+    XCTAssertEqual(PIOStubCreationCount, 1, @"The upload should carry on where it left off rather than start over.");
+    XCTAssertEqual(PIOStubPatchCount, 4 + (PIOResumableUploadFileSize - 3 * PIOResumableUploadChunkSize - PIOResumableUploadChunkSize / 2 + PIOResumableUploadChunkSize - 1) / PIOResumableUploadChunkSize);
+    XCTAssertEqualObjects(PIOStubUploads.allValues.firstObject, self.fileData);
+}
+
+@end
@@ -0,0 +1,258 @@
+//
+//  PIORetryPolicyTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSMutableArray<NSNumber *> *PIOStubRetryStatusCodes; // The status code of each request in turn. Once they have run out, requests succeed.
+static NSString *PIOStubRetryAfter; // The `Retry-After` header sent with every failure, if any.
+static NSUInteger PIOStubRetryRequestCount;
+
+/**
+ A stand-in for the file endpoints of @b api.put.io that fails with each of `PIOStubRetryStatusCodes` in turn before it succeeds.
+ */
+@interface PIOStubRetryServer : PIOStubServer
+
+@end
+
+@implementation PIOStubRetryServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path hasPrefix:@"/v2/files/"];
+}
+
+- (void)startLoading {
+    NSInteger statusCode = 200;
+    
+    @synchronized (PIOStubRetryStatusCodes) {
+        PIOStubRetryRequestCount++;
+        
+        if (PIOStubRetryStatusCodes.count > 0) {
+            statusCode = PIOStubRetryStatusCodes.firstObject.integerValue;
+            [PIOStubRetryStatusCodes removeObjectAtIndex:0];
+        }
+    }
+    
+    NSMutableDictionary *headers = [@{@"Content-Type": @"application/json"} mutableCopy];
+    NSDictionary *body = @{@"status": @"OK", @"file": PIOStubFile(1, @{@"name": @"Movie.mkv"})};
+    
+    if (statusCode != 200) {
+        headers[@"Retry-After"] = PIOStubRetryAfter;
+        body = @{@"status": @"ERROR", @"error_type": @"ServiceUnavailable", @"error_message": @"Try again later", @"status_code": @(statusCode)};
+    }
+    
+    [self respondWithStatusCode:statusCode headers:headers data:[NSJSONSerialization dataWithJSONObject:body options:0 error:nil]];
+}
+
+@end
+
+@interface PIORetryPolicyTests : PIOStubServerTestCase
+
+@property (strong, nonatomic) PIORetryPolicy *policy;
+
+@end
+
+@implementation PIORetryPolicyTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubRetryStatusCodes = [NSMutableArray array];
+    PIOStubRetryAfter = nil;
+    PIOStubRetryRequestCount = 0;
+    
+    self.policy = [PIORetryPolicy defaultPolicy];
+    self.policy.baseDelay = 0.05;
+    
+    [self applyPolicy];
+}
+
+- (void)applyPolicy {
+    PIOConfiguration *configuration = [self configurationWithStubServers:@[PIOStubRetryServer.class]];
+    configuration.retryPolicy = self.policy;
+    PIOAPI.configuration = configuration;
+}
+
+- (void)failWithStatusCodes:(NSArray<NSNumber *> *)statusCodes {
+    @synchronized (PIOStubRetryStatusCodes) {
+        [PIOStubRetryStatusCodes setArray:statusCodes];
+    }
+}
+
+- (void)testTransientFailuresAreRetried {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"File fetched"];
+    
+    [self failWithStatusCodes:@[@503, @502, @500]];
+    
+    [[PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertNil(error);
+        XCTAssertEqual(file.identifier, 1);
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual(PIOStubRetryRequestCount, 4);
+}
+
+- (void)testErrorIsReturnedOnceRetriesRunOut {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"File failed"];
+    
+    [self failWithStatusCodes:@[@503, @503, @503, @503, @503]];
+    
+    [[PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertEqual(error.code, 503);
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual(PIOStubRetryRequestCount, 1 + self.policy.maximumRetryCount);
+}
+
+- (void)testRequestsThatArentIdempotentAreNotRetried {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Rename failed"];
+    
+    [self failWithStatusCodes:@[@503]];
+    
+    [[PIOAPI renameFileWithID:1 toName:@"Film.mkv" callback:^(NSError *error) {
+        XCTAssertEqual(error.code, 503);
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual(PIOStubRetryRequestCount, 1);
+}
+
+- (void)testRetryAfterIsWaitedFor {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"File fetched"];
+    NSDate *start = [NSDate date];
+    
+    [self failWithStatusCodes:@[@429]];
+    PIOStubRetryAfter = @"1";
+    
+    [[PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertNil(error);
+        XCTAssertGreaterThanOrEqual(-start.timeIntervalSinceNow, 1);
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual(PIOStubRetryRequestCount, 2);
+}
+
+- (void)testRetryAfterLongerThanTheMaximumIsNotWaitedFor {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"File failed"];
+    
+    [self failWithStatusCodes:@[@503]];
+    PIOStubRetryAfter = @"3600";
+    
+    [[PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertEqual(error.code, 503);
+        [expectation fulfill];
+    }] resume];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    XCTAssertEqual(PIOStubRetryRequestCount, 1);
+}
+
+- (void)testSpentBudgetStopsRetries {
+    self.policy.retryBudgetRatio = 0;
+    self.policy.retryBudgetCapacity = 2;
+    [self applyPolicy];
+    
+    [self failWithStatusCodes:@[@503, @503, @503, @503, @503, @503]];
+    
+    for (NSUInteger i = 0; i < 2; i++) {
+        XCTestExpectation *expectation = [self expectationWithDescription:@"File failed"];
+        
+        [[PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+            XCTAssertEqual(error.code, 503);
+            [expectation fulfill];
+        }] resume];
+        
+        [self waitForExpectationsWithTimeout:5 handler:nil];
+    }
+    
+    // Two retries of the first request spend the budget, so the second request is sent once.
+    XCTAssertEqual(PIOStubRetryRequestCount, 4);
+}
+
+- (void)testCancellingStopsWaitingRetry {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"File cancelled"];
+    
+    [self failWithStatusCodes:@[@503]];
+    PIOStubRetryAfter = @"2";
+    
+    NSURLSessionDataTask *task = [PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertEqual(error.code, NSURLErrorCancelled);
+        [expectation fulfill];
+    }];
+    
+    [task resume];
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.3 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [task cancel];
+    });
+    
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:2]];
+    
+    XCTAssertEqual(PIOStubRetryRequestCount, 1, @"The retry should never be sent.");
+}
+
+- (void)testTaskStandsInForEveryAttempt {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"File cancelled"];
+    
+    [self failWithStatusCodes:@[@503]];
+    PIOStubRetryAfter = @"2";
+    
+    NSURLSessionDataTask *task = [PIOAPI getFileForID:1 callback:^(NSError *error, PIOFile *file) {
+        XCTAssertEqual(error.code, NSURLErrorCancelled);
+        [expectation fulfill];
+    }];
+    
+    [task resume];
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.3 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        XCTAssertEqual(task.state, NSURLSessionTaskStateRunning, @"The request is still running while it waits to be sent again.");
+        [task cancel];
+    });
+    
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    
+    XCTAssertEqual(task.state, NSURLSessionTaskStateCompleted);
+    
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:2]];
+    
+    XCTAssertEqual(PIOStubRetryRequestCount, 1, @"The retry should never be sent.");
+}
+
+@end
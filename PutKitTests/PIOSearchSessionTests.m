@@ -0,0 +1,208 @@
+//
+//  PIOSearchSessionTests
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSInteger const PIOSearchPageCount = 3;
+
+static NSCountedSet<NSString *> *PIOStubSearchPaths; // The path of every request that was sent.
+static NSUInteger PIOStubSearchStoppedCount; // The number of requests that were cancelled before they were answered.
+static NSTimeInterval PIOStubSearchDelay;
+
+/**
+ A stand-in for the search endpoint of @b api.put.io that answers every query with `PIOSearchPageCount` pages of one file each, after `PIOStubSearchDelay` seconds.
+ */
+@interface PIOStubSearchServer : PIOStubServer
+
+@end
+
+@implementation PIOStubSearchServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path hasPrefix:@"/v2/files/search/"];
+}
+
+- (void)startLoading {
+    @synchronized (PIOStubSearchPaths) {
+        [PIOStubSearchPaths addObject:self.request.URL.path];
+    }
+    
+    [self performSelector:@selector(respond) withObject:nil afterDelay:PIOStubSearchDelay];
+}
+
+- (void)respond {
+    // The path is /v2/files/search/<query>/page/<page>.
+    NSArray<NSString *> *components = self.request.URL.pathComponents;
+    NSString *query = components[components.count - 3];
+    NSInteger page = components.lastObject.integerValue;
+    NSMutableDictionary *body = [@{@"status": @"OK", @"files": @[PIOStubFile(page, @{@"name": [NSString stringWithFormat:@"%@ %zd.mkv", query, page]})]} mutableCopy];
+    
+    if (page < PIOSearchPageCount) body[@"next"] = [NSString stringWithFormat:@"https://api.put.io/v2/files/search/%@/page/%zd", query, page + 1];
+    
+    [self respondWithStatusCode:200 JSONObject:body];
+}
+
+- (void)stopLoading {
+    [NSObject cancelPreviousPerformRequestsWithTarget:self];
+    
+    @synchronized (PIOStubSearchPaths) {
+        PIOStubSearchStoppedCount++;
+    }
+}
+
+@end
+
+@interface PIOSearchSessionTests : PIOStubServerTestCase
+
+@property (strong, nonatomic) PIOSearchSession *session;
+
+@end
+
+@implementation PIOSearchSessionTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubSearchPaths = [NSCountedSet set];
+    PIOStubSearchStoppedCount = 0;
+    PIOStubSearchDelay = 0;
+    
+    [self useStubServer:PIOStubSearchServer.class];
+    
+    self.session = [PIOSearchSession new];
+}
+
+- (void)tearDown {
+    [self.session cancel];
+    
+    [super tearDown];
+}
+
+- (NSUInteger)requestCountForQuery:(NSString *)query page:(NSInteger)page {
+    @synchronized (PIOStubSearchPaths) {
+        return [PIOStubSearchPaths countForObject:[NSString stringWithFormat:@"/v2/files/search/%@/page/%zd", query, page]];
+    }
+}
+
+- (void)waitFor:(NSTimeInterval)interval {
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:interval]];
+}
+
+- (void)searchForQuery:(NSString *)query page:(NSInteger)page expectingName:(NSString *)name {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Page searched"];
+    
+    [self.session searchFilesWithQuery:query onPage:page callback:^(NSError *error, NSArray<PIOFile *> *files, NSURL *nextPageURL) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(files.firstObject.name, name);
+        XCTAssertEqual(nextPageURL == nil, page == PIOSearchPageCount);
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)testNextPageIsPrefetched {
+    [self searchForQuery:@"jazz" page:1 expectingName:@"jazz 1.mkv"];
+    [self waitFor:0.2];
+    
+    XCTAssertEqual([self requestCountForQuery:@"jazz" page:2], 1, @"The second page should be fetched while the first is shown.");
+    XCTAssertEqual([self requestCountForQuery:@"jazz" page:3], 0, @"Prefetching shouldn't run ahead of the pages that have been shown.");
+    
+    [self searchForQuery:@"jazz" page:2 expectingName:@"jazz 2.mkv"];
+    [self waitFor:0.2];
+    
+    XCTAssertEqual([self requestCountForQuery:@"jazz" page:2], 1);
+    XCTAssertEqual([self requestCountForQuery:@"jazz" page:3], 1);
+    
+    [self searchForQuery:@"jazz" page:3 expectingName:@"jazz 3.mkv"];
+    [self waitFor:0.2];
+    
+    XCTAssertEqual(PIOStubSearchPaths.count, 3, @"There is nothing to prefetch after the last page.");
+}
+
+- (void)testRepeatedQueriesAreCachedUntilTheyExpire {
+    self.session.prefetchesNextPage = NO;
+    self.session.cacheLifetime = 0.5;
+    
+    [self searchForQuery:@"jazz" page:1 expectingName:@"jazz 1.mkv"];
+    [self searchForQuery:@"jaz" page:1 expectingName:@"jaz 1.mkv"];
+    [self searchForQuery:@"jazz" page:1 expectingName:@"jazz 1.mkv"];
+    
+    XCTAssertEqual([self requestCountForQuery:@"jazz" page:1], 1);
+    
+    [self waitFor:0.6];
+    [self searchForQuery:@"jazz" page:1 expectingName:@"jazz 1.mkv"];
+    
+    XCTAssertEqual([self requestCountForQuery:@"jazz" page:1], 2, @"Expired results should be fetched again.");
+}
+
+- (void)testOldestQueriesAreDropped {
+    self.session.prefetchesNextPage = NO;
+    self.session.maximumCachedQueries = 2;
+    
+    for (NSString *query in @[@"a", @"b", @"a", @"c", @"a", @"b"]) {
+        [self searchForQuery:query page:1 expectingName:[query stringByAppendingString:@" 1.mkv"]];
+    }
+    
+    XCTAssertEqual([self requestCountForQuery:@"a" page:1], 1, @"The query searched for most recently is kept.");
+    XCTAssertEqual([self requestCountForQuery:@"b" page:1], 2);
+    XCTAssertEqual([self requestCountForQuery:@"c" page:1], 1);
+}
+
+- (void)testTypingCancelsStaleQueries {
+    XCTestExpectation *staleExpectation = [self expectationWithDescription:@"Stale queries cancelled"];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Last query searched"];
+    NSArray<NSString *> *queries = @[@"j", @"ja", @"jaz"];
+    
+    PIOStubSearchDelay = 0.3;
+    staleExpectation.expectedFulfillmentCount = queries.count;
+    
+    for (NSString *query in queries) {
+        [self.session searchFilesWithQuery:query onPage:1 callback:^(NSError *error, NSArray<PIOFile *> *files, NSURL *nextPageURL) {
+            XCTAssertEqual(error.code, NSURLErrorCancelled);
+            [staleExpectation fulfill];
+        }];
+        
+        [self waitFor:0.05];
+    }
+    
+    [self.session searchFilesWithQuery:@"jazz" onPage:1 callback:^(NSError *error, NSArray<PIOFile *> *files, NSURL *nextPageURL) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(files.firstObject.name, @"jazz 1.mkv");
+        [expectation fulfill];
+    }];
+    
+    XCTAssertEqualObjects(self.session.currentQuery, @"jazz");
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [self waitFor:0.1];
+    
+    XCTAssertEqual(PIOStubSearchStoppedCount, queries.count, @"Every stale request should have been cancelled.");
+}
+
+@end
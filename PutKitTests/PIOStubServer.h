@@ -0,0 +1,100 @@
+//
+//  PIOStubServer.h
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Returns a file as @b api.put.io describes it: a one byte video in the root folder, named after its identifier.
+ 
+ @param identifier  The identifier of the file.
+ @param changes     The keys that differ from the defaults, or `nil` to use the defaults.
+ */
+FOUNDATION_EXTERN NSDictionary *PIOStubFile(NSInteger identifier, NSDictionary * _Nullable changes);
+
+/**
+ Returns a transfer as @b api.put.io describes it: a 100 byte download that hasn't started, named after its identifier.
+ 
+ @param identifier  The identifier of the transfer.
+ @param changes     The keys that differ from the defaults, or `nil` to use the defaults.
+ */
+FOUNDATION_EXTERN NSMutableDictionary *PIOStubTransfer(NSInteger identifier, NSDictionary * _Nullable changes);
+
+/**
+ A stand-in for a put.io server that answers requests in memory. Subclasses override `canInitWithRequest:` to pick the requests they answer and `startLoading` to answer them.
+ */
+@interface PIOStubServer : NSURLProtocol
+
+/**
+ Returns the body of the request, whether it was sent as data or as a stream.
+ */
+- (NSData *)requestBody;
+
+/**
+ Answers the request.
+ 
+ @param statusCode  The status code of the response.
+ @param headers     The header fields of the response.
+ @param data        The body of the response, or `nil` if it has none.
+ */
+- (void)respondWithStatusCode:(NSInteger)statusCode headers:(nullable NSDictionary<NSString *, NSString *> *)headers data:(nullable NSData *)data;
+
+/**
+ Answers the request with a JSON body.
+ 
+ @param statusCode  The status code of the response.
+ @param object      The object to be encoded as the body.
+ */
+- (void)respondWithStatusCode:(NSInteger)statusCode JSONObject:(id)object;
+
+@end
+
+/**
+ A test case whose requests go to a stub server. The configuration in use before each test is put back after it.
+ */
+@interface PIOStubServerTestCase : XCTestCase
+
+/** The configuration in use before the test started. */
+@property (strong, nonatomic, readonly) PIOConfiguration *originalConfiguration;
+
+/**
+ Returns a default configuration that sends requests to the specified stub servers, to be adjusted before it is set as `PIOAPI.configuration`.
+ 
+ @param serverClasses   The `PIOStubServer` subclasses that answer requests.
+ */
+- (PIOConfiguration *)configurationWithStubServers:(NSArray<Class> *)serverClasses;
+
+/**
+ Sets `PIOAPI.configuration` to a default configuration that sends requests to the specified stub server.
+ 
+ @param serverClass The `PIOStubServer` subclass that answers requests.
+ */
+- (void)useStubServer:(Class)serverClass;
+
+@end
+
+NS_ASSUME_NONNULL_END
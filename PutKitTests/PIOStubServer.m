@@ -0,0 +1,133 @@
+//
+//  PIOStubServer.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import "PIOStubServer.h"
+
+NSDictionary *PIOStubFile(NSInteger identifier, NSDictionary *changes) {
+    NSMutableDictionary *file = [@{@"id": @(identifier),
+                                   @"parent_id": @0,
+                                   @"name": [NSString stringWithFormat:@"%zd.mkv", identifier],
+                                   @"content_type": @"video/x-matroska",
+                                   @"icon": @"https://put.io/icon.png",
+                                   @"size": @1,
+                                   @"created_at": @"2018-01-01T00:00:00"} mutableCopy];
+    
+    [file addEntriesFromDictionary:changes ?: @{}];
+    
+    return file;
+}
+
+NSMutableDictionary *PIOStubTransfer(NSInteger identifier, NSDictionary *changes) {
+    NSMutableDictionary *transfer = [@{@"id": @(identifier),
+                                       @"name": [NSString stringWithFormat:@"Transfer %zd", identifier],
+                                       @"created_at": @"2018-01-01T00:00:00",
+                                       @"current_ratio": @0,
+                                       @"down_speed": @0,
+                                       @"downloaded": @0,
+                                       @"peers_connected": @0,
+                                       @"peers_getting_from_us": @0,
+                                       @"peers_sending_to_us": @0,
+                                       @"percent_done": @0,
+                                       @"save_parent_id": @0,
+                                       @"size": @100,
+                                       @"status": PIOTransferStatusDownloading,
+                                       @"status_message": @"",
+                                       @"up_speed": @0,
+                                       @"uploaded": @0} mutableCopy];
+    
+    [transfer addEntriesFromDictionary:changes ?: @{}];
+    
+    return transfer;
+}
+
+@implementation PIOStubServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return NO;
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
+    return request;
+}
+
+- (NSData *)requestBody {
+    if (self.request.HTTPBody != nil) return self.request.HTTPBody;
+    
+    NSInputStream *stream = self.request.HTTPBodyStream;
+    NSMutableData *body = [NSMutableData data];
+    uint8_t buffer[16 * 1024];
+    NSInteger count;
+    
+    [stream open];
+    while ((count = [stream read:buffer maxLength:sizeof(buffer)]) > 0) [body appendBytes:buffer length:count];
+    [stream close];
+    
+    return body;
+}
+
+- (void)respondWithStatusCode:(NSInteger)statusCode headers:(NSDictionary<NSString *, NSString *> *)headers data:(NSData *)data {
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:statusCode HTTPVersion:@"HTTP/1.1" headerFields:headers ?: @{}];
+    
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    if (data != nil) [self.client URLProtocol:self didLoadData:data];
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+- (void)respondWithStatusCode:(NSInteger)statusCode JSONObject:(id)object {
+    [self respondWithStatusCode:statusCode headers:@{@"Content-Type": @"application/json"} data:[NSJSONSerialization dataWithJSONObject:object options:0 error:nil]];
+}
+
+- (void)startLoading {}
+
+- (void)stopLoading {}
+
+@end
+
+@implementation PIOStubServerTestCase
+
+- (void)setUp {
+    [super setUp];
+    
+    _originalConfiguration = PIOAPI.configuration;
+}
+
+- (void)tearDown {
+    PIOAPI.configuration = self.originalConfiguration;
+    
+    [super tearDown];
+}
+
+- (PIOConfiguration *)configurationWithStubServers:(NSArray<Class> *)serverClasses {
+    PIOConfiguration *configuration = [PIOConfiguration defaultConfiguration];
+    configuration.protocolClasses = serverClasses;
+    return configuration;
+}
+
+- (void)useStubServer:(Class)serverClass {
+    PIOAPI.configuration = [self configurationWithStubServers:@[serverClass]];
+}
+
+@end
@@ -0,0 +1,234 @@
+//
+//  PIOTransferMonitorTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOStubServer.h"
+
+static NSUInteger const PIOMonitorTransferCount = 300;
+
+static NSMutableDictionary<NSNumber *, NSMutableDictionary *> *PIOStubTransfers; // Transfers on the list, by identifier.
+static NSMutableArray<NSString *> *PIOStubTransferPaths; // The path of every request, in order.
+static BOOL PIOStubTransfersProgress; // Whether every transfer on the list downloads a little more between polls.
+
+/**
+ A stand-in for the transfer endpoints of @b api.put.io, serving `PIOStubTransfers`.
+ */
+@interface PIOStubTransferServer : PIOStubServer
+
+@end
+
+@implementation PIOStubTransferServer
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"api.put.io"] && [request.URL.path hasPrefix:@"/v2/transfers"];
+}
+
+- (void)startLoading {
+    NSString *path = self.request.URL.path;
+    NSInteger statusCode = 200;
+    NSDictionary *body;
+    
+    @synchronized (PIOStubTransfers) {
+        [PIOStubTransferPaths addObject:path];
+        
+        if ([path isEqualToString:@"/v2/transfers/list"]) {
+            for (NSMutableDictionary *transfer in PIOStubTransfers.allValues) {
+                if (PIOStubTransfersProgress) transfer[@"downloaded"] = @([transfer[@"downloaded"] integerValue] + 1);
+            }
+            
+            body = @{@"status": @"OK", @"transfers": [[NSArray alloc] initWithArray:PIOStubTransfers.allValues copyItems:YES]};
+        } else {
+            NSDictionary *transfer = PIOStubTransfers[@(path.lastPathComponent.integerValue)];
+            
+            statusCode = transfer == nil ? 404 : 200;
+            body = transfer == nil ? @{@"status": @"ERROR", @"error_type": @"NotFound", @"error_message": @"Transfer not found", @"status_code": @404} : @{@"status": @"OK", @"transfer": transfer};
+        }
+    }
+    
+    [self respondWithStatusCode:statusCode JSONObject:body];
+}
+
+@end
+
+@interface PIOTransferMonitorTests : PIOStubServerTestCase
+
+@property (strong, nonatomic) PIOTransferMonitor *monitor;
+
+@end
+
+@implementation PIOTransferMonitorTests
+
+- (void)setUp {
+    [super setUp];
+    
+    PIOStubTransfers = [NSMutableDictionary dictionary];
+    PIOStubTransferPaths = [NSMutableArray array];
+    PIOStubTransfersProgress = NO;
+    
+    [self useStubServer:PIOStubTransferServer.class];
+    
+    self.monitor = [PIOTransferMonitor new];
+    self.monitor.minimumPollInterval = 0.05;
+    self.monitor.maximumPollInterval = 0.4;
+}
+
+- (void)addTransferWithID:(NSInteger)identifier status:(PIOTransferStatus)status {
+    @synchronized (PIOStubTransfers) {
+        PIOStubTransfers[@(identifier)] = PIOStubTransfer(identifier, @{@"status": status});
+    }
+}
+
+- (void)setStatus:(PIOTransferStatus)status forTransferWithID:(NSInteger)identifier {
+    @synchronized (PIOStubTransfers) {
+        PIOStubTransfers[@(identifier)][@"status"] = status;
+    }
+}
+
+- (NSUInteger)requestCountForPath:(NSString *)path {
+    @synchronized (PIOStubTransfers) {
+        return [PIOStubTransferPaths indexesOfObjectsPassingTest:^BOOL(NSString *requestPath, NSUInteger index, BOOL *stop) {
+            return [requestPath isEqualToString:path];
+        }].count;
+    }
+}
+
+- (void)waitFor:(NSTimeInterval)interval {
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:interval]];
+}
+
+- (void)testManyTransfersShareOnePollAndStopOnEveryTerminalStatus {
+    NSArray<PIOTransferStatus> *terminalStatuses = @[PIOTransferStatusCompleted, PIOTransferStatusSeeding, PIOTransferStatusError, PIOTransferStatusCancelled];
+    NSCountedSet<NSNumber *> *progressedIdentifiers = [NSCountedSet set];
+    
+    PIOStubTransfersProgress = YES;
+    
+    for (NSInteger identifier = 1; identifier <= PIOMonitorTransferCount; identifier++) {
+        [self addTransferWithID:identifier status:PIOTransferStatusDownloading];
+        
+        XCTestExpectation *expectation = [self expectationWithDescription:@"Transfer finished"];
+        
+        [self.monitor monitorTransferWithID:identifier progressCallback:^(NSError *error, PIOTransfer *transfer) {
+            XCTAssertNil(error);
+            [progressedIdentifiers addObject:@(transfer.identifier)];
+        } completionCallback:^(PIOTransfer *transfer) {
+            XCTAssertTrue(transfer.isFinished);
+            [expectation fulfill];
+        }];
+    }
+    
+    [self waitFor:0.5];
+    
+    NSUInteger listCount = [self requestCountForPath:@"/v2/transfers/list"];
+    
+    XCTAssertGreaterThan(listCount, 1);
+    XCTAssertLessThanOrEqual(listCount, 11, @"One poll per interval, however many transfers are watched.");
+    XCTAssertEqual(PIOStubTransferPaths.count, listCount, @"No transfer should be fetched by itself.");
+    XCTAssertEqual(progressedIdentifiers.count, PIOMonitorTransferCount);
+    
+    for (NSInteger identifier = 1; identifier <= PIOMonitorTransferCount; identifier++) {
+        [self setStatus:terminalStatuses[identifier % terminalStatuses.count] forTransferWithID:identifier];
+    }
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    listCount = [self requestCountForPath:@"/v2/transfers/list"];
+    [self waitFor:0.3];
+    
+    XCTAssertEqual([self requestCountForPath:@"/v2/transfers/list"], listCount, @"Polling should stop once nothing is being watched.");
+}
+
+- (void)testStalledTransfersBackOff {
+    [self addTransferWithID:1 status:PIOTransferStatusInQueue];
+    
+    PIOTransferSubscription *subscription = [self.monitor monitorTransferWithID:1 progressCallback:nil completionCallback:nil];
+    
+    [self waitFor:1.5];
+    [subscription cancel];
+    
+    // Polling every 0.05 seconds would make 30 requests; backing off to 0.4 seconds makes about 7.
+    XCTAssertLessThan([self requestCountForPath:@"/v2/transfers/list"], 10);
+    XCTAssertGreaterThanOrEqual([self requestCountForPath:@"/v2/transfers/list"], 4);
+}
+
+- (void)testProgressResumesPollingQuickly {
+    [self addTransferWithID:1 status:PIOTransferStatusInQueue];
+    
+    PIOTransferSubscription *subscription = [self.monitor monitorTransferWithID:1 progressCallback:nil completionCallback:nil];
+    
+    [self waitFor:1];
+    
+    NSUInteger stalledCount = [self requestCountForPath:@"/v2/transfers/list"];
+    
+    PIOStubTransfersProgress = YES;
+    [self waitFor:1];
+    [subscription cancel];
+    
+    XCTAssertGreaterThan([self requestCountForPath:@"/v2/transfers/list"] - stalledCount, 10);
+}
+
+- (void)testTransferMissingFromListIsFetchedAndDropped {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Transfer dropped"];
+    
+    [self.monitor monitorTransferWithID:42 progressCallback:^(NSError *error, PIOTransfer *transfer) {
+        XCTAssertNil(transfer);
+        XCTAssertEqual(error.code, 404);
+        [expectation fulfill];
+    } completionCallback:^(PIOTransfer *transfer) {
+        XCTFail(@"A transfer that doesn't exist can't finish.");
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [self waitFor:0.3];
+    
+    XCTAssertEqual([self requestCountForPath:@"/v2/transfers/42"], 1);
+    XCTAssertLessThanOrEqual([self requestCountForPath:@"/v2/transfers/list"], 2);
+}
+
+- (void)testLegacyCallbacksArriveOnTheCallersQueue {
+    NSOperationQueue *queue = [NSOperationQueue new];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Transfer finished"];
+    
+    queue.maxConcurrentOperationCount = 1;
+    
+    [self addTransferWithID:1 status:PIOTransferStatusDownloading];
+    
+    [PIOAPI performWithCallbackQueue:queue block:^{
+        [[PIOAPI getTransferForID:1 errorCallback:^(NSError *error) {
+            XCTFail(@"The transfer exists.");
+        } progressCallback:^(NSError *error, PIOTransfer *transfer) {
+            XCTAssertEqual([NSOperationQueue currentQueue], queue);
+            [self setStatus:PIOTransferStatusCompleted forTransferWithID:1];
+        } completionCallback:^(PIOTransfer *transfer) {
+            XCTAssertEqual([NSOperationQueue currentQueue], queue);
+            [expectation fulfill];
+        }] resume];
+    }];
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+@end
@@ -0,0 +1,170 @@
+//
+//  PIOTransferStoreTests.m
+//  PutKitTests
+//
+//  Copyright © 2018 Mark Bourke.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE
+//
+
+
+#import <XCTest/XCTest.h>
+#import <PutKit/PutKit.h>
+#import "PIOObjectProtocol.h"
+#import "PIOStubServer.h"
+
+static NSUInteger const PIOTransferStoreBenchmarkCount = 10000;
+
+@interface PIOTransferStoreTests : XCTestCase
+
+@end
+
+@implementation PIOTransferStoreTests
+
+- (PIOTransfer *)transferWithID:(NSInteger)identifier changes:(NSDictionary *)changes {
+    return [(id<PIOObjectProtocol>)[PIOTransfer alloc] initFromDictionary:PIOStubTransfer(identifier, changes)];
+}
+
+- (void)testChangeMask {
+    PIOTransfer *transfer = [self transferWithID:1 changes:@{}];
+    
+    XCTAssertEqual([[self transferWithID:1 changes:@{}] fieldsDifferingFromTransfer:transfer], 0);
+    XCTAssertEqual([[self transferWithID:1 changes:@{@"percent_done": @50, @"downloaded": @50}] fieldsDifferingFromTransfer:transfer], PIOTransferFieldPercentageDownloaded | PIOTransferFieldTotalDownloaded);
+    XCTAssertEqual([[self transferWithID:1 changes:@{@"status": PIOTransferStatusSeeding}] fieldsDifferingFromTransfer:transfer], PIOTransferFieldStatus);
+    XCTAssertEqual([[self transferWithID:1 changes:@{@"peers_sending_to_us": @3}] fieldsDifferingFromTransfer:transfer], PIOTransferFieldPeers);
+    XCTAssertEqual([[self transferWithID:1 changes:@{@"error_message": @"Tracker is down"}] fieldsDifferingFromTransfer:transfer], PIOTransferFieldError);
+}
+
+- (void)testInsertedRemovedAndUpdated {
+    PIOTransferStore *store = [PIOTransferStore new];
+    
+    PIOTransferChangeSet *changes = [store updateWithTransfers:@[[self transferWithID:1 changes:@{}], [self transferWithID:2 changes:@{}], [self transferWithID:3 changes:@{}]]];
+    
+    XCTAssertEqual(changes.insertedTransfers.count, 3);
+    XCTAssertEqual(changes.removedTransfers.count, 0);
+    XCTAssertEqual(changes.updatedTransfers.count, 0);
+    
+    changes = [store updateWithTransfers:@[[self transferWithID:1 changes:@{}], [self transferWithID:3 changes:@{@"down_speed": @1000}], [self transferWithID:4 changes:@{}]]];
+    
+    XCTAssertEqualObjects([changes.insertedTransfers valueForKey:@"identifier"], @[@4]);
+    XCTAssertEqualObjects([changes.removedTransfers valueForKey:@"identifier"], @[@2]);
+    XCTAssertEqual(changes.updatedTransfers.count, 1);
+    XCTAssertEqual(changes.updatedTransfers.firstObject.transfer.identifier, 3);
+    XCTAssertEqual(changes.updatedTransfers.firstObject.previousTransfer.downloadSpeed, 0);
+    XCTAssertEqual(changes.updatedTransfers.firstObject.changedFields, PIOTransferFieldDownloadSpeed);
+    XCTAssertEqual(changes.changedFields, PIOTransferFieldDownloadSpeed);
+    
+    XCTAssertEqualObjects([store.transfers valueForKey:@"identifier"], (@[@1, @3, @4]));
+    XCTAssertEqual([store transferWithID:3].downloadSpeed, 1000);
+    XCTAssertNil([store transferWithID:2]);
+}
+
+- (void)testObserversOnlyHearAboutChanges {
+    PIOTransferStore *store = [PIOTransferStore new];
+    NSMutableArray<PIOTransferChangeSet *> *received = [NSMutableArray array];
+    
+    id observer = [store addObserverWithBlock:^(PIOTransferChangeSet *changes) {
+        [received addObject:changes];
+    }];
+    
+    [store updateWithTransfers:@[[self transferWithID:1 changes:@{}]]];
+    [store updateWithTransfers:@[[self transferWithID:1 changes:@{}]]];
+    [store updateWithTransfers:@[[self transferWithID:1 changes:@{@"status": PIOTransferStatusCompleted}]]];
+    
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    
+    XCTAssertEqual(received.count, 2, @"An identical list shouldn't be reported.");
+    XCTAssertEqual(received.lastObject.changedFields, PIOTransferFieldStatus);
+    
+    [store removeObserver:observer];
+    [store updateWithTransfers:@[]];
+    
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    
+    XCTAssertEqual(received.count, 2);
+}
+
+- (void)testObserversHearConcurrentUpdatesInOrder {
+    PIOTransferStore *store = [PIOTransferStore new];
+    NSMutableArray<NSNumber *> *observed = [NSMutableArray array];
+
+    id observer = [store addObserverWithBlock:^(PIOTransferChangeSet *changes) {
+        for (PIOTransfer *transfer in changes.insertedTransfers) {
+            [observed addObject:@(transfer.identifier)];
+        }
+    }];
+
+    // Each update adds one transfer, so the order the observer hears about
+    // them in has to match the order the store took them in.
+    dispatch_apply(50, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t iteration) {
+        @synchronized (store) {
+            NSMutableArray *transfers = [store.transfers mutableCopy];
+            [transfers addObject:[self transferWithID:(NSInteger)iteration changes:@{}]];
+            [store updateWithTransfers:transfers];
+        }
+    });
+
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+
+    XCTAssertEqualObjects(observed, [store.transfers valueForKey:@"identifier"]);
+
+    [store removeObserver:observer];
+}
+
+- (void)testObserversAreCalledOnTheirOwnQueue {
+    PIOTransferStore *store = [PIOTransferStore new];
+    NSOperationQueue *queue = [NSOperationQueue new];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Observer called"];
+    __block id observer;
+    
+    queue.maxConcurrentOperationCount = 1;
+    
+    [PIOAPI performWithCallbackQueue:queue block:^{
+        observer = [store addObserverWithBlock:^(PIOTransferChangeSet *changes) {
+            XCTAssertEqual([NSOperationQueue currentQueue], queue);
+            [expectation fulfill];
+        }];
+    }];
+    
+    [store updateWithTransfers:@[[self transferWithID:1 changes:@{}]]];
+    
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    
+    [store removeObserver:observer];
+}
+
+- (void)testDiffPerformance {
+    NSMutableArray *before = [NSMutableArray arrayWithCapacity:PIOTransferStoreBenchmarkCount];
+    NSMutableArray *after = [NSMutableArray arrayWithCapacity:PIOTransferStoreBenchmarkCount];
+    
+    // One transfer in a hundred makes progress between lists.
+    for (NSInteger identifier = 0; identifier < (NSInteger)PIOTransferStoreBenchmarkCount; identifier++) {
+        [before addObject:[self transferWithID:identifier changes:@{}]];
+        [after addObject:identifier % 100 == 0 ? [self transferWithID:identifier changes:@{@"downloaded": @1}] : [self transferWithID:identifier changes:@{}]];
+    }
+    
+    [self measureBlock:^{
+        PIOTransferStore *store = [PIOTransferStore new];
+        
+        [store updateWithTransfers:before];
+        XCTAssertEqual([store updateWithTransfers:after].updatedTransfers.count, PIOTransferStoreBenchmarkCount / 100);
+    }];
+}
+
+@end